@@ -49,6 +49,7 @@
 #import "LDrawStep.h"
 #import "LDrawTriangle.h"
 #import "LDrawUtilities.h"
+#import "LDrawVertexes.h"
 #import "LSynthConfiguration.h"
 #import "MacLDraw.h"
 #import "MinifigureDialogController.h"
@@ -382,7 +383,7 @@ void AppendChoicesToNewItem(
 		
 		optimizeTime = CFAbsoluteTimeGetCurrent() - startTime;
 #if DEBUG
-		NSLog(@"optimize time = %f", optimizeTime);
+		NSLog(@"optimize time = %f, vertex buffers = %lu bytes (estimated VRAM)", optimizeTime, (unsigned long)[LDrawVertexes optimizedBufferBytes]);
 #endif
 	}
 	
@@ -834,6 +835,9 @@ void AppendChoicesToNewItem(
 	LDrawDirective  *currentObject      = nil;
 	NSInteger       counter             = 0;
 	
+	// Let everything move before the observers hear about it.
+	[LDrawDirective beginObserverBatch];
+	
 	//find the nudgable items
 	for(counter = 0; counter < [selectedObjects count]; counter++)
 	{
@@ -845,6 +849,8 @@ void AppendChoicesToNewItem(
 					inDirection: movementVector];
 	}
 	
+	[LDrawDirective endObserverBatch];
+	
 }//end moveSelectionBy:
 
 
@@ -983,6 +989,8 @@ void AppendChoicesToNewItem(
 	}
 	
 	
+	[LDrawDirective beginObserverBatch];
+	
 	//rotate everything that can be rotated. That would be parts and only parts.
 	for(counter = 0; counter < [selectedObjects count]; counter++)
 	{
@@ -998,6 +1006,9 @@ void AppendChoicesToNewItem(
 				 aroundPoint:rotationCenter ];
 		}
 	}
+	
+	[LDrawDirective endObserverBatch];
+	
 }//end rotateSelection:mode:fixedCenter:
 
 
@@ -1122,12 +1133,17 @@ void AppendChoicesToNewItem(
 	id          currentObject       = nil;
 	NSInteger   counter             = 0;
 	
+	[LDrawDirective beginObserverBatch];
+	
 	for(counter = 0; counter < [selectedObjects count]; counter++)
 	{
 		currentObject = [selectedObjects objectAtIndex:counter];
 		if([currentObject respondsToSelector:@selector(setHidden:)])
 			[self setElement:currentObject toHidden:hideFlag]; //undoable hook.
 	}
+	
+	[LDrawDirective endObserverBatch];
+	
 }//end setSelectionToHidden:
 
 
@@ -1665,7 +1681,7 @@ void AppendChoicesToNewItem(
 //==============================================================================
 - (IBAction) delete:(id)sender
 {
-	NSArray         *selectedObjects    = [self selectedObjects];
+	NSArray         *selectedObjects    = [LDrawUtilities topLevelDirectivesInList:[self selectedObjects]];
 	LDrawDirective  *currentObject      = nil;
 	NSInteger       counter;
 
@@ -1674,9 +1690,11 @@ void AppendChoicesToNewItem(
 	// will cause massive thrash of the outliner.
 	[fileContentsOutline deselectAll:sender];
 	
-	//We'll just try to delete everything. Count backwards so that if a 
-	// deletion fails, it's the thing at the top rather than the bottom that 
-	// remains.
+	//We'll just try to delete everything. Parts inside a selected step or 
+	// model go along with it, so only the top-most directives are deleted. 
+	// Count backwards so that if a deletion fails, it's the thing at the top 
+	// rather than the bottom that remains.
+	[LDrawDirective beginObserverBatch];
 	for(counter = [selectedObjects count]-1; counter >= 0; counter--)
 	{
 		currentObject = [selectedObjects objectAtIndex:counter];
@@ -1685,6 +1703,7 @@ void AppendChoicesToNewItem(
 			[self deleteDirective:currentObject];
 		}
 	}
+	[LDrawDirective endObserverBatch];
 	
 	[[self documentContents] noteNeedsDisplay];
 }//end delete:
@@ -2253,6 +2272,8 @@ void AppendChoicesToNewItem(
 			break;
 	}
 	
+	[LDrawDirective beginObserverBatch];
+	
 	//nudge everything that can be rotated. That would be parts and only parts.
 	for(counter = 0; counter < [selectedObjects count]; counter++)
 	{
@@ -2269,6 +2290,8 @@ void AppendChoicesToNewItem(
 		
 	}//end update loop
 	
+	[LDrawDirective endObserverBatch];
+	
 	[[self documentContents] noteNeedsDisplay];
 }//end snapSelectionToGrid
 
@@ -3369,13 +3392,8 @@ void AppendChoicesToNewItem(
 		
 		//Read the first object off the pasteboard so we can figure 
 		// out where this drop is allowed to happen.
-		NSArray			*objects		= [pasteboard propertyListForType:LDrawDirectivePboardType];
-		NSData			*data			= nil;
-		id				 currentObject	= nil;
-		
-		//Unarchive.
-		data			= [objects objectAtIndex:0];
-		currentObject	= [NSKeyedUnarchiver unarchiveObjectWithData:data];
+		NSData			*data			= [pasteboard dataForType:LDrawDirectivePboardType];
+		id				 currentObject	= [LDrawUtilities firstDirectiveFromData:data];
 		
 		//Now pop the data into our file.
 		if(		sourceView == outlineView
@@ -3501,9 +3519,11 @@ void AppendChoicesToNewItem(
 	if(sourceView == outlineView)
 	{
 		//Now that we've inserted the new objects, we need to delete the 
-		// old ones.
-		for(counter = 0; counter < [doomedObjects count]; counter++)
-			[self deleteDirective:[doomedObjects objectAtIndex:counter]];
+		// old ones. Children of a dragged container go with it.
+		NSArray *topLevelDoomed = [LDrawUtilities topLevelDirectivesInList:doomedObjects];
+		
+		for(counter = 0; counter < [topLevelDoomed count]; counter++)
+			[self deleteDirective:[topLevelDoomed objectAtIndex:counter]];
 		
 		[undoManager setActionName:NSLocalizedString(@"UndoReorder", nil)];
 	}
@@ -3991,21 +4011,19 @@ void AppendChoicesToNewItem(
 					  asCopy:(BOOL)copyFlag
 {
 	NSInteger       selectionCount      = [self->selectedDirectives count];
-	NSMutableArray  *archivedParts      = [NSMutableArray array];
+	NSMutableArray  *draggedParts       = [NSMutableArray array];
 	id              currentDirective    = nil;
-	NSData          *partData           = nil;
 	NSInteger       counter             = 0;
 	BOOL            success             = NO;
 	
-	// Archive selected moveable directives.
+	// Encode selected moveable directives.
 	for(counter = 0; counter < selectionCount; counter++)
 	{
 		currentDirective = [self->selectedDirectives objectAtIndex:counter];
 		
 		if([currentDirective isKindOfClass:[LDrawDrawableElement class]])
 		{
-			partData	= [NSKeyedArchiver archivedDataWithRootObject:currentDirective];
-			[archivedParts addObject:partData];
+			[draggedParts addObject:currentDirective];
 			
 			if(copyFlag == NO)
 			{
@@ -4025,10 +4043,10 @@ void AppendChoicesToNewItem(
 	}
 	
 	// Set up pasteboard
-	if([archivedParts count] > 0)
+	if([draggedParts count] > 0)
 	{
 		[pasteboard declareTypes:[NSArray arrayWithObject:LDrawDraggingPboardType] owner:self];
-		[pasteboard setPropertyList:archivedParts forType:LDrawDraggingPboardType];
+		[pasteboard setData:[LDrawUtilities dataForDirectives:draggedParts] forType:LDrawDraggingPboardType];
 		
 		success = YES;
 	}
@@ -5728,9 +5746,9 @@ void AppendChoicesToNewItem(
 // Purpose:		Writes objects to the given pasteboard, ensuring that each 
 //				directive is written only once.
 //
-//				This method places two arrays on the pasteboard for these types:
-//				* LDrawDirectivePboardType: array of LDrawDirectives converted 
-//							to NSData objects.
+//				This method places two representations on the pasteboard:
+//				* LDrawDirectivePboardType: the LDrawDirectives encoded with 
+//							the directive codec (see LDrawDirectiveCodec.h).
 //				* NSStringPboardType: array of strings representing the objects 
 //							in the format written to an LDraw file.
 //
@@ -5746,14 +5764,9 @@ void AppendChoicesToNewItem(
 												NSStringPboardType, //representation for other applications.
 												nil ];
 	LDrawDirective	*currentObject		= nil;
-	NSMutableArray	*objectsToCopy		= [NSMutableArray array];
-	//list of containers we've already archived. We don't want to re-archive any 
-	// of their children.
-	NSMutableArray	*archivedContainers	= [NSMutableArray array];
+	NSArray			*objectsToCopy		= nil;
 	NSData			*data				= nil;
 	NSString		*string				= nil;
-	//list of LDrawDirectives which have been converted to data.
-	NSMutableArray	*archivedObjects	= [NSMutableArray array];
 	//list of LDrawDirectives which have been converted to strings.
 	NSMutableString	*stringedObjects	= [NSMutableString stringWithCapacity:256];
 	NSInteger		counter				= 0;
@@ -5761,36 +5774,18 @@ void AppendChoicesToNewItem(
 	//Write out the selected objects, but only once for each object. 
 	// Don't write out items whose parent is selected; the parent will 
 	// automatically write its children.
-	for(counter = 0; counter < [directives count]; counter++)
-	{
-		currentObject = [directives objectAtIndex:counter];
-		//If we haven't already run into this object (via its parent container)
-		// then we want to write it out. Otherwise, it will be copied implicitly 
-		// along with its parent rather than copied explicitly.
-		if([currentObject isAncestorInList:archivedContainers] == NO){
-			[objectsToCopy addObject:currentObject];
-		}
-		//If this object is a container, we must record that it has been 
-		// archived. Either it was archived just now, or it was archived 
-		// earlier when its parent was archived.
-		if([currentObject isKindOfClass:[LDrawContainer class]]){
-			[archivedContainers addObject:currentObject];
-		}
-	}
+	objectsToCopy = [LDrawUtilities topLevelDirectivesInList:directives];
 	
 	
 	//Now that we have figured out *what* to copy, convert it into the 
 	// *representations* we will use to copy.
+	data = [LDrawUtilities dataForDirectives:objectsToCopy];
+	
 	for(counter = 0; counter < [objectsToCopy count]; counter++)
 	{
-		currentObject = [objectsToCopy objectAtIndex:counter];
-		
-		//Convert the object into the two representations we know how to write.
-		data	= [NSKeyedArchiver archivedDataWithRootObject:currentObject];
-		string	= [currentObject write];
+		currentObject	= [objectsToCopy objectAtIndex:counter];
+		string			= [currentObject write];
 		
-		//Save the representations into the arrays we'll write to the pasteboard.
-		[archivedObjects addObject:data];
 		[stringedObjects appendFormat:@"%@\n", string];
 								//not using CRLF here because any Mac program that 
 								// knows enough to do DOS line-endings will automatically
@@ -5801,8 +5796,8 @@ void AppendChoicesToNewItem(
 	//Set up our pasteboard.
 	[pasteboard declareTypes:pboardTypes owner:nil];
 	
-	//Internally, Bricksmith uses archived LDrawDirectives to copy/paste.
-	[pasteboard setPropertyList:archivedObjects forType:LDrawDirectivePboardType];
+	//Internally, Bricksmith uses encoded LDrawDirectives to copy/paste.
+	[pasteboard setData:data forType:LDrawDirectivePboardType];
 	
 	//For other applications, however, we provide the LDraw file contents for 
 	// the objects. Note that these strings cannot be pasted back into the 
@@ -5837,22 +5832,22 @@ void AppendChoicesToNewItem(
 							index:(NSInteger)insertAtIndex
 {
 	NSArray         *objects        = nil;
-	id              currentObject   = nil; //some kind of unarchived LDrawDirective
-	NSData          *data           = nil;
+	id              currentObject   = nil; //some kind of decoded LDrawDirective
 	NSMutableArray  *addedObjects   = [NSMutableArray array];
 	NSInteger       counter         = 0;
 	
 	//We must make sure we have the proper pasteboard type available.
  	if([[pasteboard types] containsObject:LDrawDirectivePboardType])
 	{
-		//Unarchived everything and dump it into our file.
-		objects = [pasteboard propertyListForType:LDrawDirectivePboardType];
+		//Decode everything and dump it into our file. The observers hear 
+		// about it all at once, when we're done. 
+		objects = [LDrawUtilities directivesFromData:[pasteboard dataForType:LDrawDirectivePboardType]];
+		[LDrawDirective beginObserverBatch];
 		for(counter = 0; counter < [objects count]; counter++)
 		{
 			NSInteger real_index = insertAtIndex;
 			if(real_index != NSNotFound)	real_index += counter;
-			data			= [objects objectAtIndex:counter];
-			currentObject	= [NSKeyedUnarchiver unarchiveObjectWithData:data];
+			currentObject	= [objects objectAtIndex:counter];
 
             // Reset the object icon if we can.  New parents get a chance later (in e.g. outlineView:acceptDrop:)
             // to change them if they want
@@ -5876,6 +5871,7 @@ void AppendChoicesToNewItem(
 			[currentObject optimizeOpenGL];
 			[addedObjects addObject:currentObject];
 		}
+		[LDrawDirective endObserverBatch];
 		
 		//Select all the objects which have been added.
 		[fileContentsOutline selectObjects:addedObjects];
@@ -14,6 +14,8 @@
 #import "LDrawModel.h"
 #import "LDrawPart.h"
 #import "LDrawLSynth.h"
+#import "LDrawSearchIndex.h"
+#import "LDrawUtilities.h"
 #import "LDrawColorPanelController.h"
 #import "LDrawGLView.h"
 #import "LDrawFileOutlineView.h"
@@ -100,9 +102,10 @@ SearchPanelController *sharedSearchPanel = nil;
 //
 //              - Determine where to search (the scope): File, Model, Step or within
 //                the current selection
-//              - Collect all potential matches up
-//              - Filter out parts that don't match our criteria, based on part
-//                type and colour
+//              - Look up potential matches by part name or colour in the file's
+//                search index
+//              - Filter out parts that don't match our criteria, based on
+//                colour and scope
 //              - Select the remaining matching parts
 //
 //==============================================================================
@@ -114,6 +117,7 @@ SearchPanelController *sharedSearchPanel = nil;
     ScopeT                scope              = (ScopeT)[[scopeMatrix selectedCell] tag];
     SearchPartCriteriaT   criterion          = (SearchPartCriteriaT)[[findTypeMatrix selectedCell] tag];
     ColorFilterT          colorCriterion     = (ColorFilterT)[[colorMatrix selectedCell] tag];
+    LDrawSearchIndex     *searchIndex        = [[currentDocument documentContents] searchIndex];
     
     //
     // Determine our search criteria
@@ -218,11 +222,20 @@ SearchPanelController *sharedSearchPanel = nil;
         
         // Add ".dat" to parts without a recognised suffix
         [tmpParts enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-            part = [[obj stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] lowercaseString];
+            NSString *term = [[obj stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] lowercaseString];
+            part = term;
             if (![part hasSuffix:@".dat"] && ![part hasSuffix:@".ldr"]) {
                 part = [NSString stringWithFormat:@"%@.dat", part];
             }
-            [partNames addObject:part];
+            
+            // Not a part used in the file?  Then try the words of the part descriptions,
+            // e.g. "brick 2 x 4"
+            if ([term length] > 0 && [[searchIndex directivesNamed:part] count] == 0) {
+                [partNames addObjectsFromArray:[searchIndex namesMatchingDescription:term]];
+            }
+            else {
+                [partNames addObject:part];
+            }
         }];
         
         partFilter = partNames;
@@ -241,67 +254,52 @@ SearchPanelController *sharedSearchPanel = nil;
     }
     
     //
-    // Collect up all potential matches
+    // Collect up all potential matches from the index, by name or else by color
     //
     
-    NSMutableArray *matchables = [[[NSMutableArray alloc] init] autorelease];
-    for (id searchableObject in searchableObjects) {
-        // Parts
-        if ([searchableObject isKindOfClass:[LDrawPart class]]) {
-            [matchables addObject:searchableObject];
-        }
-        
-        // Containers
-        else if ([searchableObject isKindOfClass:[LDrawContainer class]]) {
-            [matchables addObjectsFromArray:[self partsInContainer:searchableObject]];
+    NSMutableSet *candidates = [NSMutableSet set];
+    if (partFilter) {
+        for (NSString *name in partFilter) {
+            [candidates addObjectsFromArray:[searchIndex directivesNamed:name]];
         }
-        
-        // Include LSynth objects, as well as their contained constraints
-        if ([searchableObject isKindOfClass:[LDrawLSynth class]]) {
-            [matchables addObject:searchableObject];
+    }
+    else if (colorFilter) {
+        for (LDrawColor *color in colorFilter) {
+            [candidates addObjectsFromArray:[searchIndex directivesWithColorCode:[color colorCode]]];
         }
     }
+    else {
+        [candidates addObjectsFromArray:[searchIndex allDirectives]];
+    }
     
     //
     // Filter potential matches against our criteria
     //
     
-    NSMutableArray *nonMatchingParts = [[[NSMutableArray alloc] init] autorelease];
+    NSSet          *scopes     = [NSSet setWithArray:searchableObjects];
+    NSMutableArray *matchables = [[[NSMutableArray alloc] init] autorelease];
     
-    for (id part in matchables) {
+    for (id part in candidates) {
         
-        // Filter on color
+        // Filter on color.  The index goes by color code, but file-local colors can
+        // share a code with library ones.
         if (colorFilter && [colorFilter indexOfObject:[part LDrawColor]] == NSNotFound) {
-            [nonMatchingParts addObject:part];
             continue;
         }
         
-        // Filter on part criterion
-        NSString *name = nil;
-        if ([part isKindOfClass:[LDrawPart class]]) {
-            name = [part referenceName];
-        }
-        else if ([part isKindOfClass:[LDrawLSynth class]]) {
-            name = [part lsynthType];
+        // Filter on scope
+        if (![self directive:part isWithinScopes:scopes]) {
+            continue;
         }
         
-        if (partFilter && [partFilter indexOfObject:name] == NSNotFound) {
-            [nonMatchingParts addObject:part];
+        // Filter hidden parts out if appropriate
+        if ([searchHiddenParts state] == NSOnState
+            && [part respondsToSelector:@selector(setHidden:)] && [part isHidden]) {
             continue;
         }
+        
+        [matchables addObject:part];
     }
-
-    // Filter hidden parts out if appropriate
-    if ([searchHiddenParts state] == NSOnState) {
-        [matchables enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-            if ([obj respondsToSelector:@selector(setHidden:)] && [obj isHidden] &&
-                [nonMatchingParts indexOfObject:obj] == NSNotFound) {
-                [nonMatchingParts addObject:obj];
-            }
-        }];
-    }
-    
-    [matchables removeObjectsInArray:nonMatchingParts];
     
     [currentDocument selectDirectives:matchables];
 } // end doSearchAndSelect:
@@ -368,32 +366,32 @@ SearchPanelController *sharedSearchPanel = nil;
 
 #pragma mark - UTILITIES -
 
-//========== partsInContainer: =================================================
+//========== directive:isWithinScopes: ========================================
 //
-// Purpose:		A recursive helper function to find all parts in a container
+// Purpose:		Is the directive one of the searchable objects, or inside one?
+//              Parts inside an LSynth part only count when we've been asked to
+//              search inside LSynth containers - unless that LSynth part is
+//              itself what we're searching.
 //
 //==============================================================================
--(NSArray *)partsInContainer:(LDrawContainer *)container
+-(BOOL)directive:(LDrawDirective *)directive isWithinScopes:(NSSet *)scopes
 {
-    NSMutableArray *parts = [[[NSMutableArray alloc] init] autorelease];
-    for (id directive in [container subdirectives]) {
-        if ([directive isKindOfClass:[LDrawPart class]]) {
-            [parts addObject:directive];
-        }
-        // Recurse on subcontainers
-        else if (([directive isKindOfClass:[LDrawContainer class]] && ![directive isKindOfClass:[LDrawLSynth class]])
-                 || ([directive isKindOfClass:[LDrawLSynth class]] && [searchInsideLSynthContainers state] == NSOnState)) {
-            [parts addObjectsFromArray:[self partsInContainer:directive]];
+    LDrawDirective *ancestor = directive;
+    
+    while (ancestor != nil) {
+        if ([scopes containsObject:ancestor]) {
+            return YES;
         }
-        
-        // Add LSynth "Parts" specifically. Their contents are handled above
-        if ([directive isKindOfClass:[LDrawLSynth class]]) {
-            [parts addObject:directive];
+        if (ancestor != directive
+            && [ancestor isKindOfClass:[LDrawLSynth class]]
+            && [searchInsideLSynthContainers state] != NSOnState) {
+            return NO;
         }
+        ancestor = [ancestor enclosingDirective];
     }
     
-    return parts;
-} // end partsInContainer:
+    return NO;
+} // end directive:isWithinScopes:
 
 //========== updateInterfaceForSelection: ======================================
 //
@@ -510,12 +508,9 @@ SearchPanelController *sharedSearchPanel = nil;
 //==============================================================================
 - (BOOL)prepareForDragOperation:(id<NSDraggingInfo>)sender
 {
-    NSArray        *archivedDirectives = nil;
+    NSArray        *directives         = nil;
     NSMutableArray *directiveNames     = [[[NSMutableArray alloc] init] autorelease];
-    NSUInteger      directiveCount     = 0;
-	NSUInteger      counter            = 0;
 	id              currentObject      = nil;
-	NSData         *data               = nil;
     NSString       *partNames          = nil;
     
     // Parts can be dragged from the outline view or the part browser.  GLView drags
@@ -528,21 +523,17 @@ SearchPanelController *sharedSearchPanel = nil;
         
         // Outline View
         if ([[sender draggingSource] isKindOfClass:[LDrawFileOutlineView class]]) {
-            archivedDirectives	= [pasteboard propertyListForType:LDrawDirectivePboardType];
+            directives	= [LDrawUtilities directivesFromData:[pasteboard dataForType:LDrawDirectivePboardType]];
         }
         
         // Part browser
         else if ([[sender draggingSource] isKindOfClass:[PartBrowserTableView class]]) {
-            archivedDirectives	= [pasteboard propertyListForType:LDrawDraggingPboardType];
+            directives	= [LDrawUtilities directivesFromData:[pasteboard dataForType:LDrawDraggingPboardType]];
         }
         
         // Grab the part names
-        directiveCount = [archivedDirectives count];
-        for(counter = 0; counter < directiveCount; counter++)
+        for(currentObject in directives)
         {
-            data = [archivedDirectives objectAtIndex:counter];
-            currentObject = [NSKeyedUnarchiver unarchiveObjectWithData:data];
-            
             // We're only interested in LDrawParts we've not already found
             if ([currentObject isKindOfClass:[LDrawPart class]] &&
                 [directiveNames indexOfObject:[currentObject referenceName]] == NSNotFound) {
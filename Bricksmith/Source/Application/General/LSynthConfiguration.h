@@ -11,6 +11,8 @@
 @class LDrawPart;
 @class LDrawLSynth;
 
+struct lsynth_context;
+
 // The class of a synthesis object
 typedef enum
 {
@@ -33,6 +35,12 @@ typedef enum
     NSMutableArray *quickRefParts;
     NSMutableArray *quickRefHoseConstraints;
     NSMutableArray *quickRefBandConstraints;
+
+    struct lsynth_context *synthesisContext;    // the same file, as read by the LSynth library
+    NSString       *configurationDigest;        // hash of the file, so cached results follow it
+
+    NSCache        *synthesisResults;           // synthesis key -> NSArray of part lines
+    NSString       *synthesisCachePath;         // where the results are kept between launches
 }
 
 #pragma mark -
@@ -74,7 +82,16 @@ typedef enum
 -(NSMutableArray *) getQuickRefHoseConstraints;
 -(NSDictionary *)   constraintDefinitionForPart:(LDrawPart *)directive;
 -(NSDictionary *)   typeForTypeName:(NSString *)typeName;
+-(struct lsynth_context *) synthesisContext;
 
 -(void) setLSynthClassForDirective:(LDrawLSynth *)directive withType:(NSString *)type;
 
+#pragma mark -
+#pragma mark SYNTHESIS CACHE
+#pragma mark -
+
+-(NSString *) synthesisKeyForInputs:(NSString *)inputs;
+-(NSArray *)  synthesizedLinesForKey:(NSString *)key;
+-(void)       cacheSynthesizedLines:(NSArray *)lines forKey:(NSString *)key toDisk:(BOOL)persist;
+
 @end
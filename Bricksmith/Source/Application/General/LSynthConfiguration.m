@@ -5,10 +5,15 @@
 //  Created by Robin Macharg on 24/09/2012.
 
 #import "LSynthConfiguration.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
 #import "LDrawUtilities.h"
 #import "MacLDraw.h"
+#import "StringCategory.h"
 #import "LDrawPart.h"
 #import "LDrawLSynth.h"
+#import "lsynth.h"
 
 @implementation LSynthConfiguration
 
@@ -29,6 +34,12 @@ static NSString *DEFAULT_BAND_CONSTRAINT = @"3648a.dat";
 static NSString *DEFAULT_HOSE_TYPE = @"TECHNIC_PNEUMATIC_HOSE";
 static NSString *DEFAULT_BAND_TYPE = @"TECHNIC_CHAIN_LINK";
 
+// Part of every synthesis key.  Bump it whenever the LSynth library's output
+// changes, so results cached by an older Bricksmith aren't used.
+static NSString *SYNTHESIS_CACHE_VERSION = @"1";
+
+static NSString *DigestOfString(NSString *string);
+
 //========== defaultHoseConstraint =============================================
 //
 // Purpose: Return the default hose constraint
@@ -103,6 +114,13 @@ static LSynthConfiguration* instance = nil;
     if (self)
 	{
         [self initializeArrays];
+
+        synthesisResults = [[NSCache alloc] init];
+        [synthesisResults setCountLimit:512];
+
+        synthesisCachePath = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) objectAtIndex:0];
+        synthesisCachePath = [synthesisCachePath stringByAppendingPathComponent:[[NSBundle mainBundle] bundleIdentifier]];
+        synthesisCachePath = [[synthesisCachePath stringByAppendingPathComponent:@"LSynth"] retain];
     }
     return self;
 }
@@ -153,9 +171,23 @@ static LSynthConfiguration* instance = nil;
 {
     // Initialise all arrays, since we may be called after a config file change
     [self initializeArrays];
+
+    // The library keeps its own copy of the configuration for synthesis.
+    if (synthesisContext != NULL)
+        lsynth_context_free(synthesisContext);
+    synthesisContext = NULL;
+    if (lsynthConfigurationPath != nil)
+        synthesisContext = lsynth_context_create((char *)[lsynthConfigurationPath fileSystemRepresentation]);
+    if (synthesisContext == NULL)
+        NSLog(@"LSynth could not read %@", lsynthConfigurationPath);
     
     // Read the file in
    	NSString   *fileContents = [LDrawUtilities stringFromFile:lsynthConfigurationPath];
+
+    // A different configuration means different results.
+    [configurationDigest release];
+    configurationDigest = [DigestOfString(fileContents ? fileContents : @"") retain];
+
     NSArray    *lines        = [fileContents componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]];
 
     // General parsing variables
@@ -567,6 +599,21 @@ static LSynthConfiguration* instance = nil;
     return nil;
 }//end typeForTypeName:
 
+
+//========== synthesisContext ==================================================
+//
+// Purpose:		Returns the configuration as read by the LSynth library, for
+//				passing to lsynth_synthesize.  NULL if it couldn't be read.
+//
+// Notes:		Syntheses on any thread share this context; it is only
+//				replaced when the configuration preference changes.
+//
+//==============================================================================
+-(struct lsynth_context *) synthesisContext
+{
+    return synthesisContext;
+}//end synthesisContext
+
 //========== setLSynthClassForDirective:withType: ==============================
 //
 // Purpose:		Set the class of an LSynthDirective based on the part type name
@@ -589,4 +636,149 @@ static LSynthConfiguration* instance = nil;
         }
 }
 
+
+#pragma mark -
+#pragma mark SYNTHESIS CACHE
+#pragma mark -
+
+//========== synthesisKeyForInputs: ============================================
+//
+// Purpose:		Returns the key for synthesizing the given inputs - the LSynth
+//				type and its constraints, as LDrawLSynth describes them.
+//
+// Notes:		The key also covers everything else the result depends on: the
+//				configuration file, the LSynth executable if the user chose
+//				one, and the version of our own library.  So two equal keys
+//				mean the same synthesized parts, wherever they came from.
+//
+//==============================================================================
+-(NSString *) synthesisKeyForInputs:(NSString *)inputs
+{
+    NSUserDefaults  *userDefaults   = [NSUserDefaults standardUserDefaults];
+    NSString        *executablePath = [userDefaults stringForKey:LSYNTH_EXECUTABLE_PATH_KEY];
+    NSString        *described      = nil;
+
+    executablePath = [executablePath stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+
+    described = [NSString stringWithFormat:@"%@\n%@\n%@\n%@",
+                    SYNTHESIS_CACHE_VERSION,
+                    configurationDigest ? configurationDigest : @"",
+                    executablePath ? executablePath : @"",
+                    inputs];
+
+    return DigestOfString(described);
+
+}//end synthesisKeyForInputs:
+
+
+//========== synthesisCachePathForKey: =========================================
+//
+// Purpose:		Where the synthesized parts for the key live on disk.
+//
+//==============================================================================
+-(NSString *) synthesisCachePathForKey:(NSString *)key
+{
+    return [synthesisCachePath stringByAppendingPathComponent:[key stringByAppendingPathExtension:@"ldr"]];
+
+}//end synthesisCachePathForKey:
+
+
+//========== synthesizedLinesForKey: ===========================================
+//
+// Purpose:		Returns the synthesized parts (as LDraw lines) cached for the
+//				key, or nil if we haven't seen it.
+//
+// Notes:		Results made this session are kept in memory; those written
+//				to disk in earlier ones are read in on first use.
+//
+//==============================================================================
+-(NSArray *) synthesizedLinesForKey:(NSString *)key
+{
+    NSArray     *lines      = nil;
+    NSString    *contents   = nil;
+
+    if (key == nil)
+        return nil;
+
+    lines = [synthesisResults objectForKey:key];
+    if (lines == nil)
+    {
+        contents = [NSString stringWithContentsOfFile:[self synthesisCachePathForKey:key]
+                                             encoding:NSUTF8StringEncoding
+                                                error:NULL];
+        if (contents != nil)
+        {
+            lines = [contents componentsSeparatedByString:[NSString CRLF]];
+            lines = [lines filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"length > 0"]];
+            [synthesisResults setObject:lines forKey:key];
+        }
+    }
+
+    return lines;
+
+}//end synthesizedLinesForKey:
+
+
+//========== cacheSynthesizedLines:forKey:toDisk: ==============================
+//
+// Purpose:		Remembers the synthesized parts for the key.  If persist is
+//				set they are also written to the user's cache folder, so that
+//				later launches can use them.
+//
+// Notes:		Callers only persist results worth keeping - those in files
+//				being opened or saved - not every step of a drag.
+//
+//==============================================================================
+-(void) cacheSynthesizedLines:(NSArray *)lines
+                       forKey:(NSString *)key
+                       toDisk:(BOOL)persist
+{
+    NSFileManager   *fileManager    = [[[NSFileManager alloc] init] autorelease];
+    NSString        *path           = nil;
+    NSString        *contents       = nil;
+
+    if (key == nil || [lines count] == 0)
+        return;
+
+    [synthesisResults setObject:[NSArray arrayWithArray:lines] forKey:key];
+
+    if (persist == YES)
+    {
+        path = [self synthesisCachePathForKey:key];
+        if ([fileManager fileExistsAtPath:path] == NO)
+        {
+            contents = [[lines componentsJoinedByString:[NSString CRLF]] stringByAppendingString:[NSString CRLF]];
+
+            [fileManager createDirectoryAtPath:synthesisCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+            [contents writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+        }
+    }
+
+}//end cacheSynthesizedLines:forKey:toDisk:
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== DigestOfString() ==================================================
+//
+// Purpose:		Returns the SHA-1 of the string's UTF-8, in hex.
+//
+//==============================================================================
+static NSString *DigestOfString(NSString *string)
+{
+    const char      *bytes  = [string UTF8String];
+    unsigned char   digest[CC_SHA1_DIGEST_LENGTH];
+    NSMutableString *hex    = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+    int             counter = 0;
+
+    CC_SHA1(bytes, (CC_LONG)strlen(bytes), digest);
+    for (counter = 0; counter < CC_SHA1_DIGEST_LENGTH; counter++)
+        [hex appendFormat:@"%02x", digest[counter]];
+
+    return hex;
+
+}//end DigestOfString
+
 @end
@@ -29,6 +29,7 @@
 #import "LDrawColorPanelController.h"
 #import "LDrawModel.h"
 #import "LDrawPart.h"
+#import "LDrawUtilities.h"
 #import "MacLDraw.h"
 #import "PartLibrary.h"
 #import "StringCategory.h"
@@ -802,92 +803,56 @@
 //
 // Purpose:		Searches partRecords for all records containing searchString; 
 //				returns the matching records. The search will be conducted on 
-//				both the part numbers and descriptions.
+//				the part numbers, descriptions and keywords. Pass nil 
+//				partRecords to search the whole library. 
 //
-// Returns:		An array with all matching parts, or an empty array if no parts 
-//				match.
+// Returns:		An array with all matching parts, best matches first, or an 
+//				empty array if no parts match.
 //
 // Notes:		The nasty problem is that LDraw names are formed so that they 
 //				line up nicely in a monospaced font. Thus we have names like 
-//				"Brick  2 x  4" (note extra spaces!). I sidestep the problem by 
-//				stripping all the spaces from the search and find strings. It's 
-//				still lame, but probably okay for most uses.
+//				"Brick  2 x  4" (note extra spaces!). Each word of the search 
+//				is matched against the names with all their spaces stripped, 
+//				so "2x4" and "2 x 4" both work, and so do "plate 2x2" and "2x2 
+//				plate". 
 //
-//				Tiger has fantabulous search predicates that would reduce a 
-//				hefty hunk of this code to a 1-liner AND be whitespace neutral 
-//				too. But I don't have Tiger, so instead I'm going for the 
-//				cheeseball approach.  
+//				The matching itself is done by the part library's catalog index, 
+//				which is built once when the catalog is loaded; scanning every 
+//				record on every keystroke was too slow for large libraries. 
 //
 //==============================================================================
 - (NSMutableArray *) filterPartRecords:(NSArray *)partRecords
 						bySearchString:(NSString *)searchString
 						  excludeParts:(NSSet *)excludedParts
 {
-	NSDictionary    *record                 = nil;
-	NSUInteger      counter                 = 0;
+	NSArray         *rankedMatches          = nil;
+	NSSet           *searchedParts          = nil;
 	NSString        *partNumber             = nil;
-	NSString        *partDescription        = nil;
-	NSString        *partSansWhitespace     = nil;
-	NSString		*category				= nil;
 	NSMutableArray  *matchingParts          = nil;
-	NSString        *searchSansWhitespace   = [searchString ams_stringByRemovingWhitespace];
 	
 	if([searchString length] == 0)
 	{
 		//Everybody's a winner here.
+		if(partRecords == nil)
+			partRecords = [self->partLibrary allPartCatalogRecords];
 		matchingParts = [NSMutableArray arrayWithArray:partRecords];
 	}
 	else
 	{
-		matchingParts = [NSMutableArray array];
+		matchingParts	= [NSMutableArray array];
+		rankedMatches	= [self->partLibrary partCatalogRecordsMatchingSearch:searchString];
 		
-		// Search through all the given records and try to find matches on the 
-		// search string. But search part names whitespace-neutral so as not to 
-		// be thrown off by goofy name spacing. 
-		for(counter = 0; counter < [partRecords count]; counter++)
+		if(partRecords != nil)
+			searchedParts = [NSSet setWithArray:[partRecords valueForKey:PART_NUMBER_KEY]];
+		
+		for(NSDictionary *record in rankedMatches)
 		{
-			record				= [partRecords objectAtIndex:counter];
-			partNumber			= [record objectForKey:PART_NUMBER_KEY];
-			partDescription		= [record objectForKey:PART_NAME_KEY];
-			partSansWhitespace	= [partDescription ams_stringByRemovingWhitespace];
-			category			= [record objectForKey:PART_CATEGORY_KEY];
+			partNumber = [record objectForKey:PART_NUMBER_KEY];
 			
-			if([excludedParts containsObject:partNumber] == NO)
+			if(		[excludedParts containsObject:partNumber] == NO
+			   &&	(searchedParts == nil || [searchedParts containsObject:partNumber]) )
 			{
-	            // LLW - Change to treat each word in a search string as an item in a list, and
-	            // a match happens only if each word can be found in the either the part number or
-	            // the name. This is independent of order, so a search like "2x2 plate" and "plate 2x2"
-	            // will return the same results.
-	            //
-	            // Some examples of results that are returned with this change that would _not_
-	            // be returned with the original code:
-	            //  Search          Sample result
-	            //  "2x2 plate"     "Plate 2 x 2"
-	            //  "tile clip"     "Tile 1x1 with clip"
-	            //  "four studs"    "Brick 1 x 1 with Studs on Four Sides"
-	            //  "offset plate"  "Plate 1 x 4 Offset"
-	            //  "axle pin 2x2"  "Brick 2 x 2 with Pin and Axlehole"
-     	       __block BOOL matches = TRUE;
-        	    [searchString enumerateSubstringsInRange:NSMakeRange(0, [searchString length]) options:NSStringEnumerationByWords usingBlock:^(NSString* word, NSRange wordRange, NSRange enclosingRange, BOOL* stop){
-    	            matches = matches && 
-                	        ([partNumber            ams_containsString:word options:NSCaseInsensitiveSearch] ||	
-            	             [partSansWhitespace    ams_containsString:word options:NSCaseInsensitiveSearch]);
-        	    }];            
-				if(matches)
-					[matchingParts addObject:record];
-				else
-				{
-					NSArray *keywords = [record objectForKey:PART_KEYWORDS_KEY];
-					
-					for(NSString* keyword in keywords)
-					{
-						if([[keyword ams_stringByRemovingWhitespace] ams_containsString:searchSansWhitespace options:NSCaseInsensitiveSearch])
-						{
-							[matchingParts addObject:record];
-							break;
-						}
-					}
-				}
+				[matchingParts addObject:record];
 			}
 		}
 	}//end else we have to search
@@ -947,26 +912,44 @@
 //==============================================================================
 - (void) performSearch
 {
-	NSString		*searchString	= [self->searchField stringValue];
-	NSArray 		*allParts		= nil;
-	NSMutableArray	*filteredParts	= nil;
-	NSSet			*excludedParts	= nil;
+	NSString		*searchString		= [self->searchField stringValue];
+	NSString		*originalPartName	= [self selectedPartName];
+	NSString		*bestMatch			= nil;
+	NSArray 		*allParts			= nil;
+	NSMutableArray	*filteredParts		= nil;
+	NSSet			*excludedParts		= nil;
+	NSUInteger		bestMatchIndex		= NSNotFound;
 	
 	if(		[searchString length] == 0 // clearing the search; revert to selected category
 	   ||	self->searchMode == SearchModeSelectedCategory )
 	{
-		allParts = [self->partLibrary partCatalogRecordsInCategory:self->selectedCategory];
+		// (nil searches the whole library, without building a list of it.)
+		if([searchString length] == 0 || [self->selectedCategory isEqualToString:Category_All] == NO)
+			allParts = [self->partLibrary partCatalogRecordsInCategory:self->selectedCategory];
 	}
 	else
 	{
-		allParts		= [self->partLibrary partCatalogRecordsInCategory:Category_All];
+		allParts		= nil; // the whole library
 		excludedParts	= [NSSet setWithArray:[[self->partLibrary partCatalogRecordsInCategory:Category_Alias] valueForKey:PART_NUMBER_KEY]];
 	}
 	
 	// Re-filter the records
 	filteredParts = [self filterPartRecords:allParts bySearchString:searchString excludeParts:excludedParts];
+	if([searchString length] > 0 && [filteredParts count] > 0)
+		bestMatch = [[filteredParts objectAtIndex:0] objectForKey:PART_NUMBER_KEY];
+	
 	[self setTableDataSource:filteredParts];
 	
+	// The table keeps its own sort order, so the ranking is lost there. But if 
+	// the part that was selected didn't survive the search, select the best 
+	// match rather than whatever happens to sort first. 
+	if(bestMatch != nil && [self indexOfPartNamed:originalPartName] == NSNotFound)
+	{
+		bestMatchIndex = [self indexOfPartNamed:bestMatch];
+		[partsTable selectRowIndexes:[NSIndexSet indexSetWithIndex:bestMatchIndex] byExtendingSelection:NO];
+		[partsTable scrollRowToVisible:bestMatchIndex];
+	}
+	
 	[self syncSelectionAndPartDisplayed];
 	[self setConstraints];
 }
@@ -1111,7 +1094,6 @@
 //==============================================================================
 - (BOOL) writeSelectedPartToPasteboard:(NSPasteboard *)pasteboard
 {
-	NSMutableArray	*archivedParts		= [NSMutableArray array];
 	NSString		*partName			= [self selectedPartName];
 	LDrawPart		*newPart			= nil;
 	NSData			*partData			= nil;
@@ -1127,15 +1109,12 @@
 		[newPart setLDrawColor:selectedColor];
 		[newPart setDisplayName:partName];
 		
-		partData	= [NSKeyedArchiver archivedDataWithRootObject:newPart];
-		
-		[archivedParts addObject:partData];
+		partData	= [LDrawUtilities dataForDirectives:[NSArray arrayWithObject:newPart]];
 		
 		// Set up pasteboard
 		[pasteboard declareTypes:[NSArray arrayWithObjects:LDrawDraggingPboardType, LDrawDraggingIsUninitializedPboardType, nil] owner:self];
 		
-		[pasteboard setPropertyList:archivedParts
-							forType:LDrawDraggingPboardType];
+		[pasteboard setData:partData forType:LDrawDraggingPboardType];
 		
 		[pasteboard setPropertyList:[NSNumber numberWithBool:YES]
 							forType:LDrawDraggingIsUninitializedPboardType];
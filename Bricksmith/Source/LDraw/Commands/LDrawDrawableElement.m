@@ -65,7 +65,10 @@
 	//		 and distribute it to all children. 
 	ColorLibrary    *colorLibrary   = [ColorLibrary sharedColorLibrary];
 	LDrawColor      *libraryColor   = [colorLibrary colorForCode:[self->color colorCode]];
-	if(libraryColor)
+	
+	// The library answers codes it doesn't know with the current color; 
+	// those keep what was archived. 
+	if(libraryColor && [libraryColor colorCode] == [self->color colorCode])
 	{
 		[self setLDrawColor:libraryColor];
 	}
@@ -12,6 +12,8 @@
 #import "LDrawMovableDirective.h"
 #import "LSynthConfiguration.h"
 
+struct lsynth_cache;
+
 // The LSynth LDraw format extensions have several mandatory and several optional directives.
 // The following state diagram illustrates the order that directives could occur.
 // The initWithLines: parser in this class implements this state machine.
@@ -36,6 +38,7 @@
 //                                                   V
 //     PARSER_PARSING_SYNTHESIZED                  /\o
 //                                    1 X X X ... |_/|
+//               or 0 SYNTH SYNTHESIZED HASH X       |
 //                                                   |    0 SYNTH SYNTHESIZED END
 //                                                   V
 //     PARSER_SYNTHESIZED_FINISHED                   o
@@ -67,6 +70,8 @@ typedef enum
     BOOL             hidden;
     BOOL             subdirectiveSelected;
     Box3			 cachedBounds;		// cached bounds of the enclosed directives
+    struct lsynth_cache *synthesisCache;	// hose spans from the last synthesis, so edits only redo what moved
+    NSString        *synthesizedKey;		// synthesis key of the inputs synthesizedParts were made from
 }
 
 // Accessors
@@ -84,10 +89,16 @@ typedef enum
 
 // Utilities
 - (void) synthesize;
+- (void) synthesizeInGroup:(dispatch_group_t)parentGroup;
+- (void) synthesizeWithLibraryInGroup:(dispatch_group_t)parentGroup;
+- (void) synthesizeWithExecutable:(NSString *)lsynthPath;
 - (void)colorSelectedSynthesizedParts:(BOOL)yesNo;
 - (NSString *)determineIconName:(LDrawDirective *)directive;
 - (NSMutableArray *)prepareAutoHullData;
 -(int)synthesizedPartsCount;
+- (NSString *) synthesisKey;
+- (NSArray *) synthesizedLines;
+- (BOOL) restoreSynthesizedPartsForKey:(NSString *)key inGroup:(dispatch_group_t)parentGroup;
 
 
 + (BOOL) lineIsLSynthBeginning:(NSString*)line;
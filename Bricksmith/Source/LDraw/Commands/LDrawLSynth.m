@@ -22,6 +22,8 @@
 #import "RegexKitLite.h"
 #import "PreferencesDialogController.h"
 #import "UserDefaultsCategory.h"
+#import "ColorLibrary.h"
+#import "lsynth.h"
 
 @implementation LDrawLSynth
 
@@ -77,11 +79,17 @@
 //
 // <OPTIONALLY:>
 // 0 SYNTH SYNTHESIZED BEGIN
+// 0 SYNTH SYNTHESIZED HASH <SYNTHESIS KEY>
 // 1 <SYNTHESIZED PART SPEC>
 // ...
 // 0 SYNTH SYNTHESIZED END
 // 0 SYNTH END
 //
+// The HASH line (ours; other programs skip it) records the synthesis key of
+// the inputs the parts were made from.  If the constraints have been edited
+// elsewhere since, the key won't match and we synthesize them again; if it
+// does, the parts are used as they are.
+//
 //==============================================================================
 - (id) initWithLines:(NSArray *)lines
              inRange:(NSRange)range
@@ -92,6 +100,8 @@
     NSRange            commandRange        = range;
     NSUInteger         lineIndex           = 0;
     LSynthParserStateT parserState         = PARSER_READY_TO_PARSE;
+    NSString          *savedKey            = nil;
+    NSString          *currentKey          = nil;
 
     self = [self init]; // Basic initialisation, not related to parsing
     self = [super initWithLines:lines inRange:range parentGroup:parentGroup];
@@ -150,6 +160,12 @@
                 parserState = PARSER_SYNTHESIZED_FINISHED;
             }
 
+            // 0 SYNTH SYNTHESIZED HASH <KEY> - what the synthesized parts were made from
+            else if ([currentLine isMatchedByRegex:@"0\\s+SYNTH\\s+SYNTHESIZED\\s+HASH\\s+(\\S+)"] &&
+                    parserState == PARSER_PARSING_SYNTHESIZED) {
+                savedKey = [currentLine stringByMatching:@"0\\s+SYNTH\\s+SYNTHESIZED\\s+HASH\\s+(\\S+)" capture:1];
+            }
+
             // 0 SYNTH INSIDE or
             // 0 SYNTH OUTSIDE or
             // 0 SYNTH CROSS
@@ -209,8 +225,38 @@
         }
     }
 
+    // Saved parts are good if they were made from what we have now.  Files
+    // from before we recorded a key get the benefit of the doubt, but without
+    // a key of their own they aren't cached for anyone else.
+    if ([synthesizedParts count] > 0 && savedKey != nil) {
+        currentKey = [self synthesisKey];
+
+        if ([savedKey isEqualToString:currentKey]) {
+            self->synthesizedKey = [currentKey retain];
+            [[LSynthConfiguration sharedInstance] cacheSynthesizedLines:[self synthesizedLines]
+                                                                 forKey:currentKey
+                                                                 toDisk:YES];
+        }
+        else {
+            [synthesizedParts removeAllObjects];
+        }
+    }
+
     // If we've read in synthesized parts or don't have any constraints then don't initially synthesize
     if ([synthesizedParts count] == 0 && [[self allEnclosedElements] count] > 0) {
+#if USE_BLOCKS
+        // While loading a file, synthesize on a worker alongside everything
+        // else being parsed, rather than one at a time on first draw.
+        if(parentGroup != NULL)
+        {
+            dispatch_group_async(parentGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+            ^{
+                [self synthesizeInGroup:parentGroup];
+                [self colorSelectedSynthesizedParts:NO];
+            });
+        }
+        else
+#endif
         [self invalCache:ContainerInvalid];
     }
 
@@ -313,8 +359,19 @@
     // Constraints' icons should have been encoded/decoded correctly so we do
     // nothing in that respect.
 
-    // Ask for resynthesis since we don't preserve synthesized parts during a copy/paste
-    [self invalCache:ContainerInvalid];
+    // Keep the synthesized parts if they still match the constraints; they
+    // won't if the configuration has changed since they were copied.
+    NSString *savedKey = [decoder decodeObjectForKey:@"synthesizedKey"];
+    NSArray  *savedParts = [decoder decodeObjectForKey:@"synthesizedParts"];
+
+    if (savedKey != nil && [savedParts count] > 0 && [savedKey isEqualToString:[self synthesisKey]]) {
+        [synthesizedParts setArray:savedParts];
+        self->synthesizedKey = [savedKey retain];
+        [self colorSelectedSynthesizedParts:NO];
+    }
+    else {
+        [self invalCache:ContainerInvalid];
+    }
 
     return self;
 
@@ -327,8 +384,8 @@
 //				which is assumed to always be a keyed decoder. This allows us to
 //				read and write LDraw objects as NSData.
 //
-//              We don't store synthesized parts since they'll be recreated when
-//              we initWithCoder.
+//              The synthesized parts go too, with their synthesis key, so a
+//              paste or undo doesn't have to synthesize them again.
 //
 //==============================================================================
 - (void)encodeWithCoder:(NSCoder *)encoder
@@ -339,6 +396,8 @@
     [encoder encodeInt:lsynthClass forKey:@"lsynthClass"];
     [encoder encodeObject:synthType forKey:@"synthType"];
     [encoder encodeObject:color forKey:@"color"];
+    [encoder encodeObject:synthesizedKey forKey:@"synthesizedKey"];
+    [encoder encodeObject:synthesizedParts forKey:@"synthesizedParts"];
 
 }//end encodeWithCoder:
 
@@ -392,7 +451,7 @@
     // TODO: Should we select the constraint at the previous index?
     [self setSubdirectiveSelected:NO];
     [self setSelected:NO]; // remove ourselves from the selection so that we can be selected by the user.
-    [self invalCache:ContainerInvalid];
+    [self invalCache:CacheFlagBounds|DisplayList|ContainerInvalid];
     
     [[NSNotificationCenter defaultCenter]
             postNotificationName:LDrawDirectiveDidChangeNotification
@@ -603,11 +662,20 @@
         [written appendString:CRLF];
     }
 
+    // Whatever we save should open again without synthesis, even if the
+    // parts themselves aren't saved.
+    [[LSynthConfiguration sharedInstance] cacheSynthesizedLines:[self synthesizedLines]
+                                                         forKey:self->synthesizedKey
+                                                         toDisk:YES];
+
     // Write out synthesized parts, if there are any to write out
     if ([self->synthesizedParts count] > 0
         && [userDefaults integerForKey:LSYNTH_SAVE_SYNTHESIZED_PARTS_KEY] == YES) {
         [written appendString:@"0 SYNTH SYNTHESIZED BEGIN"];
         [written appendString:CRLF];
+        if (self->synthesizedKey != nil) {
+            [written appendFormat:@"0 SYNTH SYNTHESIZED HASH %@%@", self->synthesizedKey, CRLF];
+        }
         for (LDrawPart *part in self->synthesizedParts) {
             // Parts aren't smart enough to know that they're temporarily coloured differently
             // during Synth part selection, so we force the parent color in.  It's reset when the
@@ -719,6 +787,7 @@
     [self->synthType release];
     self->synthType = type;
 
+    [self invalCache:(CacheFlagBounds|DisplayList)];
 }//end setLsynthType:
 
 //========== lsynthClass: ====================================================
@@ -821,6 +890,7 @@
     self->color = newColor;
 
     [self colorSelectedSynthesizedParts:[self isSelected]];
+    [self invalCache:(CacheFlagBounds|DisplayList)];
 }//end setLDrawColor:
 
 //========== LDrawColor ========================================================
@@ -883,13 +953,32 @@
 //
 // Purpose:	Synthesizes the part using LSynth
 //
-// TODO: multithread/background
-//
 //==============================================================================
 -(void)synthesize
+{
+    [self synthesizeInGroup:NULL];
+
+}//end synthesize
+
+
+//========== synthesizeInGroup: ================================================
+//
+// Purpose:	Synthesizes the part using LSynth.  Parts referenced by the
+//			synthesized pieces are loaded into parentGroup, if given.
+//
+//			Results are cached by synthesis key (see LSynthConfiguration), so
+//			inputs we've seen before - after an undo, say - are never
+//			synthesized twice.  Those made while loading a file are also kept
+//			on disk for next time.
+//
+//==============================================================================
+- (void) synthesizeInGroup:(dispatch_group_t)parentGroup
 {
     //NSLog(@"SYNTHESIZE");
 
+    LSynthConfiguration *configuration  = [LSynthConfiguration sharedInstance];
+    NSString            *key            = nil;
+
     // Modifies the constraints to provide automatic OUTSIDE/INSIDE determination for
     // constraints inside the convex hull.  Dig down for more details.
     BOOL doAutoHull = YES; // Placeholder until we make it a configurable setting
@@ -901,21 +990,145 @@
     // Clean up first
     [synthesizedParts removeAllObjects];
 
-    NSString *input = @"";
-    Class CommandClass = Nil;
+    key = [[self synthesisKey] retain];
+    [self->synthesizedKey release];
+    self->synthesizedKey = key;
+
+    if ([self restoreSynthesizedPartsForKey:key inGroup:parentGroup] == YES)
+        return;
 
-    // Path to lsynth.  If it's unset or whitespace use the built-in default
+    // Path to lsynth.  If it's unset or whitespace use the built-in library
     NSUserDefaults *userDefaults   = [NSUserDefaults standardUserDefaults];
     NSString       *executablePath = [userDefaults stringForKey:LSYNTH_EXECUTABLE_PATH_KEY];
-    NSString       *configPath     = [userDefaults stringForKey:LSYNTH_CONFIGURATION_PATH_KEY];
-    NSString       *lsynthPath;
-    if ([executablePath length] == 0 || [executablePath isMatchedByRegex:@"^\\s+$"]) {
-        lsynthPath = [[NSBundle mainBundle] pathForAuxiliaryExecutable:@"lsynthcp"];
+    if ([executablePath length] != 0 && [executablePath isMatchedByRegex:@"^\\s+$"] == NO) {
+        [self synthesizeWithExecutable:executablePath];
     }
     else {
-        lsynthPath = executablePath;
+        [self synthesizeWithLibraryInGroup:parentGroup];
     }
 
+    [configuration cacheSynthesizedLines:[self synthesizedLines]
+                                  forKey:key
+                                  toDisk:(parentGroup != NULL)];
+
+}//end synthesizeInGroup:
+
+
+//========== synthesizeWithLibraryInGroup: =====================================
+//
+// Purpose:	Synthesizes the part by calling the LSynth library directly, with
+//			the configuration LSynthConfiguration has already read.
+//
+//			The library keeps no global state, so any number of directives may
+//			synthesize at once.
+//
+//			Each hose keeps the spans it made last time, so dragging one
+//			constraint only resynthesizes the spans next to it.
+//
+//==============================================================================
+- (void) synthesizeWithLibraryInGroup:(dispatch_group_t)parentGroup
+{
+    struct lsynth_context  *context         = [[LSynthConfiguration sharedInstance] synthesisContext];
+    NSArray                *constraints     = [self subdirectives];
+    LDrawColorT             code            = self->subdirectiveSelected ? LDrawClear : [[self LDrawColor] colorCode];
+    part_t                 *input           = NULL;
+    part_t                 *output          = NULL;
+    int                     inputCount      = 0;
+    int                     outputCount     = 0;
+    int                     counter         = 0;
+    int                     row             = 0;
+    int                     column          = 0;
+
+    if (context == NULL || [constraints count] == 0)
+        return;
+
+    if (self->synthesisCache == NULL)
+        self->synthesisCache = lsynth_cache_create();
+
+    // Constraints go to LSynth as LDraw parts; INSIDE/OUTSIDE/CROSS as parts
+    // of that type.
+    input = calloc([constraints count], sizeof(part_t));
+    for (LDrawDirective *directive in constraints)
+    {
+        part_t *constraint = &input[inputCount];
+
+        if ([directive isKindOfClass:[LDrawPart class]])
+        {
+            LDrawPart   *part       = (LDrawPart *)directive;
+            Matrix4     transform   = [part transformationMatrix];
+
+            strncpy(constraint->type, [[part displayName] UTF8String], sizeof(constraint->type) - 1);
+            for (row = 0; row < 3; row++)
+            {
+                for (column = 0; column < 3; column++)
+                    constraint->orient[row][column] = transform.element[column][row];
+                constraint->offset[row] = transform.element[3][row];
+            }
+            inputCount++;
+        }
+        else if ([directive isKindOfClass:[LDrawLSynthDirective class]])
+        {
+            strncpy(constraint->type, [[(LDrawLSynthDirective *)directive stringValue] UTF8String], sizeof(constraint->type) - 1);
+            inputCount++;
+        }
+    }
+
+    // Synthesize at LSynth's default hose quality.
+    if (lsynth_synthesize(context, (char *)[self->synthType UTF8String], code,
+                          input, inputCount, 0, self->synthesisCache,
+                          &output, &outputCount) == 0)
+    {
+        // Each part comes back in its own color; usually ours.
+        for (counter = 0; counter < outputCount; counter++)
+        {
+            LDrawPart   *newPart    = [[LDrawPart alloc] init];
+            Matrix4     transform   = IdentityMatrix4;
+            LDrawColor  *partColor  = nil;
+
+            for (row = 0; row < 3; row++)
+            {
+                for (column = 0; column < 3; column++)
+                    transform.element[column][row] = output[counter].orient[row][column];
+                transform.element[3][row] = output[counter].offset[row];
+            }
+
+            if (output[counter].attrib == [[self LDrawColor] colorCode])
+                partColor = [self LDrawColor];
+            else
+                partColor = [[ColorLibrary sharedColorLibrary] colorForCode:output[counter].attrib];
+
+            [newPart setLDrawColor:partColor];
+            [newPart setTransformationMatrix:&transform];
+            [newPart setDisplayName:[NSString stringWithUTF8String:output[counter].type]
+                              parse:YES
+                            inGroup:parentGroup];
+
+            [synthesizedParts addObject:newPart];
+            [newPart release];
+        }
+        free(output);
+    }
+    else
+        NSLog(@"LSynth could not synthesize %@", self->synthType);
+
+    free(input);
+
+}//end synthesizeWithLibraryInGroup:
+
+
+//========== synthesizeWithExecutable: =========================================
+//
+// Purpose:	Synthesizes the part by running an LSynth executable over it.
+//
+//==============================================================================
+- (void) synthesizeWithExecutable:(NSString *)lsynthPath
+{
+    NSString *input = @"";
+    Class CommandClass = Nil;
+
+    NSUserDefaults *userDefaults   = [NSUserDefaults standardUserDefaults];
+    NSString       *configPath     = [userDefaults stringForKey:LSYNTH_CONFIGURATION_PATH_KEY];
+
     // We run LSynth as follows:
     // - Create an LDraw file in memory
     // - Setup the STDIN/OUT pipes and NSTask
@@ -1033,7 +1246,8 @@
             extract = YES;
         }
     }
-}
+}//end synthesizeWithExecutable:
+
 //========== doAutoHullOnBand ==================================================
 //
 // Purpose:	Calculate the INSIDE/OUTSIDE directives automatically.
@@ -1387,6 +1601,88 @@
     return [synthesizedParts count];
 }
 
+//========== synthesisKey ======================================================
+//
+// Purpose:		Returns the synthesis key of our current inputs: the LSynth
+//				type and the constraints, as they would be written to a file.
+//
+// Notes:		Color isn't part of it; synthesized parts always take ours.
+//
+//==============================================================================
+- (NSString *) synthesisKey
+{
+    NSMutableString *inputs = [NSMutableString stringWithString:self->synthType];
+
+    for (LDrawDirective *constraint in [self subdirectives])
+    {
+        [inputs appendString:[NSString CRLF]];
+        [inputs appendString:[constraint write]];
+    }
+
+    return [[LSynthConfiguration sharedInstance] synthesisKeyForInputs:inputs];
+
+}//end synthesisKey
+
+
+//========== synthesizedLines ==================================================
+//
+// Purpose:		Returns the synthesized parts as LDraw lines for the synthesis
+//				cache, in the current color (16) so anyone can use them.
+//
+//==============================================================================
+- (NSArray *) synthesizedLines
+{
+    NSMutableArray  *lines          = [NSMutableArray arrayWithCapacity:[synthesizedParts count]];
+    LDrawColor      *currentColor   = [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
+    LDrawColor      *partColor      = nil;
+
+    for (LDrawPart *part in self->synthesizedParts)
+    {
+        partColor = [[part LDrawColor] retain];
+        [part setLDrawColor:currentColor];
+        [lines addObject:[part write]];
+        [part setLDrawColor:partColor];
+        [partColor release];
+    }
+
+    return lines;
+
+}//end synthesizedLines
+
+
+//========== restoreSynthesizedPartsForKey:inGroup: ============================
+//
+// Purpose:		Makes our synthesized parts from the synthesis cache, if it has
+//				them for the key.  Returns NO if it doesn't.
+//
+//==============================================================================
+- (BOOL) restoreSynthesizedPartsForKey:(NSString *)key inGroup:(dispatch_group_t)parentGroup
+{
+    NSArray         *lines          = [[LSynthConfiguration sharedInstance] synthesizedLinesForKey:key];
+    Class           CommandClass    = Nil;
+    LDrawDirective  *newDirective   = nil;
+
+    if (lines == nil)
+        return NO;
+
+    for (NSString *line in lines)
+    {
+        CommandClass = [LDrawUtilities classForDirectiveBeginningWithLine:line];
+        newDirective = [[CommandClass alloc] initWithLines:[NSArray arrayWithObject:line]
+                                                   inRange:NSMakeRange(0, 1)
+                                               parentGroup:parentGroup];
+        if ([newDirective isKindOfClass:[LDrawPart class]])
+        {
+            [(LDrawPart *)newDirective setLDrawColor:self->color];
+            [synthesizedParts addObject:newDirective];
+        }
+        [newDirective release];
+    }
+
+    return YES;
+
+}//end restoreSynthesizedPartsForKey:inGroup:
+
 //========== partClass =========================================================
 //
 // Purpose:		Returns the class of a part
@@ -1480,6 +1776,9 @@
     [color release];
     [synthesizedParts release];
     [synthType release];
+    [synthesizedKey release];
+
+    lsynth_cache_free(synthesisCache);
 
     [super dealloc];
 
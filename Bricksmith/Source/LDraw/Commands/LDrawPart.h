@@ -78,6 +78,8 @@ typedef enum PartType {
 - (BOOL) partIsMissing;
 
 - (void) resolvePart;
+- (LDrawModel *) resolvedModel;
+- (PartTypeT) resolvedPartType;
 - (void) unresolvePart;
 - (void) unresolvePartIfPartLibrary;
 
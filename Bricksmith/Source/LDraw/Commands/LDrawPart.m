@@ -48,6 +48,14 @@
 #define SHRINK_SEAMS 0
 #define SHRINK_AMOUNT 0.125		// in LDU
 
+
+@interface LDrawPart ()
+
+- (void) forgetResolvedModel;
+
+@end
+
+
 @implementation LDrawPart
 
 
@@ -315,15 +323,11 @@
 
 		if (cacheType == PartTypeLibrary && cacheDrawable == nil)
 		{
-			// Parts assigned to LDrawCurrentColor may get drawn in many 
-			// different colors in one draw, so we can't cache their 
-			// optimized drawable. We have to retrieve their optimized 
-			// drawable on-the-fly. 
+			// Not linked to the library's shared drawable yet (we haven't 
+			// been through -optimizeOpenGL). Look it up now; it draws in 
+			// whatever color we pass it. 
 			
-			// Parts that have a SPECIFIC color have been linked DIRECTLY to 
-			// their specific colored VBO during -optimizeOpenGL. 
-			
-			drawable = [[PartLibrary sharedPartLibrary] optimizedDrawableForPart:self color:drawingColor];
+			drawable = [[PartLibrary sharedPartLibrary] optimizedDrawableForPart:self];
 		}
 		
 		if(drawBoundsOnly == NO)
@@ -424,7 +428,12 @@
 			[renderer pushMatrix:glTransformation];
 			#endif
 			
-			[cacheModel drawSelf:renderer];
+			// Submodels draw their own parts from a flattened list, 
+			// rather than recursing through all the nested matrices. 
+			if(cacheType == PartTypeSubmodel || cacheType == PartTypePeerFile)
+				[cacheModel drawFlattened:renderer];
+			else
+				[cacheModel drawSelf:renderer];
 
 			[renderer popMatrix];
 			#if SHRINK_SEAMS
@@ -996,6 +1005,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 	assert(parentGroup == NULL || cacheType == PartTypeUnresolved);
 	
 	[self unresolvePart];
+	[self invalCache:CacheFlagBounds];
 	
 	// Force the part library to parse the model this part will display. This 
 	// pushes all parsing into the same operation, which improves loading time 
@@ -1567,41 +1577,30 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 	{
 		case PartTypeSubmodel:
 		{
-			// Tell the submodel we want to draw it with our color.
-			if([self->color colorCode] != LDrawCurrentColor)
-			{
-				[[cacheModel vertexes] optimizeOpenGLWithParentColor:self->color];
-			}
+			// The submodel's vertexes draw in any color, including ours.
+			[[cacheModel vertexes] optimizeOpenGL];
 		}	break;
 	
 		case PartTypePeerFile:
 		{
 			[cacheModel optimizePrimitiveStructure];
-			[[cacheModel vertexes] optimizeOpenGLWithParentColor:self->color];
+			[[cacheModel vertexes] optimizeOpenGL];
 			[cacheDrawable optimizeOpenGL];
 		}	break;
 		
 		case PartTypeLibrary:
 		{
-			// Only optimize explicitly colored parts.
-			// Uncolored parts need to use the color passed at draw time, which 
-			// can't be pre-optimized. 
-			if([self->color colorCode] != LDrawCurrentColor)
-			{
-				cacheDrawable = [[PartLibrary sharedPartLibrary] optimizedDrawableForPart:self color:self->color];
-			}
+			// Library parts share one optimized drawable across all colors, 
+			// so every part - even an uncolored one - can link to it now. 
+			cacheDrawable = [[PartLibrary sharedPartLibrary] optimizedDrawableForPart:self];
 		}	break;
 	
 		default:
 			break;
 	}
 		
-	// Make sure the bounding cube is available in our color
-	LDrawVertexes *unitCube = [LDrawUtilities boundingCube];
-	if([unitCube isOptimizedForColor:self->color] == NO)
-	{
-		[unitCube optimizeOpenGLWithParentColor:self->color];
-	}
+	// Make sure the bounding cube is available
+	[[LDrawUtilities boundingCube] optimizeOpenGL];
 
 }//end optimizeOpenGL
 
@@ -1701,6 +1700,33 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 }
 
 
+//========== resolvedModel =====================================================
+//
+// Purpose:		Resolve the part if needed and return the model it draws, or nil
+//				if the part can't be found.
+//
+//==============================================================================
+- (LDrawModel *) resolvedModel
+{
+	[self resolvePart];
+	return cacheModel;
+	
+}//end resolvedModel
+
+
+//========== resolvedPartType ==================================================
+//
+// Purpose:		Resolve the part if needed and return where its model was found.
+//
+//==============================================================================
+- (PartTypeT) resolvedPartType
+{
+	[self resolvePart];
+	return cacheType;
+	
+}//end resolvedPartType
+
+
 //========== unresolvePart =====================================================
 //
 // Purpose:		This method is called when something potentially breaks the link
@@ -1711,8 +1737,28 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 //				(since parts have weak references to their models, this can in
 //				theory happen).
 //
+//				Whoever caches what we draw - the part tables of steps and the 
+//				flattened part lists of models - finds out through our bounds, 
+//				so they are invalidated too. 
+//
 //==============================================================================
 - (void) unresolvePart
+{
+	if(cacheType != PartTypeUnresolved)
+	{
+		[self forgetResolvedModel];
+		[self invalCache:CacheFlagBounds];
+	}
+}//end unresolvePart
+
+
+//========== forgetResolvedModel ===============================================
+//
+// Purpose:		Drops the link to the model we were resolved to, without telling 
+//				anyone; -dealloc has no one left to tell. 
+//
+//==============================================================================
+- (void) forgetResolvedModel
 {
 	if(cacheType != PartTypeUnresolved)
 	{
@@ -1731,7 +1777,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 		cacheDrawable = nil;
 		cacheModel = nil;
 	}
-}//end unresolvePart
+}//end forgetResolvedModel
 
 
 
@@ -1766,7 +1812,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 //==============================================================================
 - (void) dealloc
 {
-	[self unresolvePart];
+	[self forgetResolvedModel];
 	
 	//release instance variables.
 	[displayName	release];
@@ -345,10 +345,7 @@
 		[currentDirective draw:optionsMask viewScale:scaleFactor parentColor:parentColor];
 	}
 	
-	if([self->vertexes isOptimizedForColor:parentColor] == NO)
-	{
-		[self->vertexes optimizeOpenGLWithParentColor:parentColor];
-	}
+	[self->vertexes optimizeOpenGL];
 
 	[self->vertexes draw:optionsMask viewScale:scaleFactor parentColor:parentColor];
 	
@@ -1121,20 +1118,10 @@
 		[vertexes setLines:lines triangles:triangles quadrilaterals:quadrilaterals other:nil];
 	}
 	
-	// Allow primitives to be visible when displaying the model itself.
-	LDrawColor *parentColor = [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
-	
-	if([vertexes isOptimizedForColor:parentColor])
-	{
-		// The vertexs have already been optimized for any referencing colors. 
-		// Just rebuild the existing color optimizations. 
-		[self->vertexes rebuildAllOptimizations];
-	}
-	else
-	{
-		// Newly-created, empty vertexes. Make a list to display the model itself. 
-		[self->vertexes optimizeOpenGLWithParentColor:parentColor];
-	}
+	// Allow primitives to be visible when displaying the model itself. The 
+	// optimization is shared by every color the model is drawn in, so this 
+	// only does work if the vertexes are new or have changed. 
+	[self->vertexes optimizeOpenGL];
 }//end optimizeVertexes
 
 
@@ -14,6 +14,7 @@
 
 // forward declarations
 @class LDrawMPDModel;
+@class LDrawSearchIndex;
 
 
 //Active model changed.
@@ -31,6 +32,7 @@
 	NSDictionary	*nameModelDict;
 	LDrawMPDModel	*activeModel;
 	NSString		*filePath;			//where this file came from on disk.
+	LDrawSearchIndex *searchIndex;		//built the first time someone searches.
 //	NSUInteger		drawCount;			//number of threads currently drawing us
 //	NSConditionLock *editLock;
 }
@@ -52,6 +54,7 @@
 - (NSArray *) modelNames;
 - (LDrawMPDModel *) modelWithName:(NSString *)soughtName;
 - (NSString *)path;
+- (LDrawSearchIndex *) searchIndex;
 - (NSArray *) submodels;
 
 - (void) setActiveModel:(LDrawMPDModel *)newModel;
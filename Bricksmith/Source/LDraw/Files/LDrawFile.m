@@ -27,6 +27,7 @@
 #import "MacLDraw.h"
 #import "LDrawMPDModel.h"
 #import "LDrawPart.h"
+#import "LDrawSearchIndex.h"
 #import "LDrawUtilities.h"
 #import "PartReport.h"
 #import "StringCategory.h"
@@ -605,6 +606,23 @@
 }//end path
 
 
+//========== searchIndex =======================================================
+//
+// Purpose:		Returns the index used to search this file by part name, color 
+//				or description. It is built on first use and then kept up to 
+//				date as the file is edited. 
+//
+//==============================================================================
+- (LDrawSearchIndex *) searchIndex
+{
+	if(self->searchIndex == nil)
+		self->searchIndex = [[LDrawSearchIndex alloc] initWithContainer:self];
+	
+	return self->searchIndex;
+	
+}//end searchIndex
+
+
 //========== submodels =========================================================
 //
 // Purpose:		Returns an array of the LDrawModels (or more likely, the 
@@ -982,6 +1000,7 @@
 - (void) dealloc
 {
 	//NSLog(@"File %s going away.\n", [filePath UTF8String]);
+	[searchIndex	release];	// first: it still watches our contents.
 	[nameModelDict	release];
 	[activeModel	release];
 	[filePath		release];
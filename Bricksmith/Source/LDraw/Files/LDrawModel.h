@@ -12,6 +12,7 @@
 #import "LDrawContainer.h"
 @class ColorLibrary;
 @class LDrawFile;
+@class LDrawPart;
 @class LDrawStep;
 @class LDrawVertexes;
 
@@ -43,6 +44,13 @@
 													// some drawing on library parts.
 	LDrawDLHandle			dl;						// Cached DL if we have one.
 	LDrawDLCleanup_f		dl_dtor;
+	
+	// Flattening - see -buildFlattenedParts
+	struct LDrawFlatPart	*flatParts;				// every model placed under us, in our coordinates; NULL if stale
+	NSUInteger				flatPartCount;
+	LDrawPart				**flatPath;				// the parts placing each flat part, outermost first
+	NSArray					*flatOthers;			// our own directives which aren't parts
+	BOOL					isFlattening;
 }
 
 //Initialization
@@ -81,12 +89,22 @@
 - (void) didAddDirective:(LDrawDirective *)directive;
 - (void) didRemoveDirective:(LDrawDirective *)directive;
 
+// Display lists
+- (BOOL) hasValidDisplayList;
+- (BOOL) prepareDisplayList;
+- (void) buildDisplayList;
++ (void) buildDisplayListsInParallel:(NSArray *)models;
+
+// Flattening
+- (void) drawFlattened:(id<LDrawRenderer>)renderer;
+
 //Utilities
 - (NSUInteger) maxStepIndexToOutput;
 - (NSUInteger) numberElements;
 - (void) optimizePrimitiveStructure;
 - (void) optimizeStructure;
 - (void) optimizeVertexes;
+- (BOOL) picksThroughVertexes;
 - (NSUInteger) parseHeaderFromLines:(NSArray *)lines beginningAtIndex:(NSUInteger)index;
 - (BOOL) line:(NSString *)line isValidForHeader:(NSString *)headerKey info:(NSString**)infoPtr;
 
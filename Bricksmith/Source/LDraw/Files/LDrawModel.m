@@ -21,12 +21,14 @@
 #import "ColorLibrary.h"
 #import "LDrawColor.h"
 #import "LDrawConditionalLine.h"
+#import "LDrawDLCollector.h"
 #import "LDrawFile.h"
 #import "LDrawKeywords.h"
 #import "LDrawLine.h"
 #import "LDrawQuadrilateral.h"
 #import "LDrawStep.h"
 #import "LDrawPart.h"
+#import "LDrawPartTable.h"
 #import "LDrawTriangle.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
@@ -43,6 +45,38 @@
 
 #define NO_CULL_SMALL_BRICKS 0
 
+// One model placed somewhere under a submodel, with everything needed to draw 
+// or pick it without walking the parts in between. 
+struct LDrawFlatPart
+{
+	LDrawModel		*model;				// retained
+	BOOL			isLeaf;				// draw the whole model; else only what isn't a part
+	Matrix4			transform;			// model coordinates -> our coordinates
+	GLfloat			glTransform[16];
+	Box3			box;				// bounds in our coordinates
+	GLfloat			bounds[6];			// the same, for culling
+	LDrawColor		*color;				// not retained; nil if no part sets one
+	int				compliments;		// compliment colors pushed after color
+	NSUInteger		pathStart;			// index of the placing parts in flatPath
+	NSUInteger		pathCount;
+};
+
+static void FlatPartComposeColor(struct LDrawFlatPart *flatPart, LDrawColor *color);
+static void FlatPartSetTransform(struct LDrawFlatPart *flatPart, Matrix4 transform);
+
+
+@interface LDrawModel ()
+
+- (void) buildFlattenedParts;
+- (void) removeFlattenedParts;
+- (NSArray *) flattenedOtherDirectives;
+- (void) drawDisplayList:(id<LDrawRenderer>)renderer;
+- (void) drawDraggingDirectives:(id<LDrawRenderer>)renderer;
+- (void) drawOwnGeometry:(id<LDrawRenderer>)renderer;
+
+@end
+
+
 @implementation LDrawModel
 
 
@@ -337,33 +371,7 @@
 
 	#endif
 
-	// DL cache control: we may have to throw out our old DL if it has gone
-	// stale. EITHER WAY we mark our DL bit as validated per the rules of
-	// the observable protocol.
-	if(dl)
-	{
-		if([self revalCache:DisplayList] == DisplayList)
-		{
-			dl_dtor(dl);
-			dl_dtor = NULL;
-			dl = NULL;
-		}
-	} else
-		[self revalCache:DisplayList];
-		
-	// Now: if we do not have a DL (no DL or we threw it out because it
-	// was invalid) build one now: get a collector and call "collect" on
-	// ourselves, which will walk our tree picking up primitives.
-	if(!dl)
-	{
-		id<LDrawCollector> collector = [renderer beginDL];
-		[self collectSelf:collector];
-		[renderer endDL:&dl cleanupFunc:&dl_dtor];
-	}
-	
-	// Finally: if we have a DL (cached or brand new, draw it!!)
-	if(dl)
-		[renderer drawDL:dl];	
+	[self drawDisplayList:renderer];
 
 	if (!isOptimized)
 	{
@@ -386,35 +394,317 @@
 			[currentDirective drawSelf:renderer];
 		}
 		
-		// And: if we are currently dragging directives, those 
-		// directives were skipped in the cases above.  So we
-		// do something a little scary.  We build a temporary
-		// DL for those directives, draw the DL and nuke them.
-		// We ALSO pass drawSelf message.
-		//
-		// This isn't terrible unless we are dragging a huge 
-		// number of raw primitives.
+		[self drawDraggingDirectives:renderer];
+	}	
+}//drawSelf:
+
+
+//========== drawDisplayList: ====================================================
+//
+// Purpose:		Draws the primitives directly underneath us from our DL, 
+//				building it first if need be.
+//
+//================================================================================
+- (void) drawDisplayList:(id<LDrawRenderer>)renderer
+{
+	// A renderer that can't draw cached DLs (e.g. the soft renderer) takes
+	// our mesh directly, every time.
+	if([renderer respondsToSelector:@selector(immediateCollector)])
+	{
+		[self collectSelf:[renderer immediateCollector]];
+	}
+	else
+	{
+		// Throw out a stale DL, and if we have none (or it was stale) build one
+		// now.  Our parent step may already have built it for us, in parallel
+		// with other models; in that case there is nothing to do here.
+		if([self prepareDisplayList])
+			[self buildDisplayList];
 		
-		if(self->draggingDirectives != nil)
+		// Finally: if we have a DL (cached or brand new, draw it!!)
+		if(dl)
+			[renderer drawDL:dl];	
+	}
+}//end drawDisplayList:
+
+
+//========== drawDraggingDirectives: =============================================
+//
+// Purpose:		Draws the directives being dragged into this model, if any.
+//
+//================================================================================
+- (void) drawDraggingDirectives:(id<LDrawRenderer>)renderer
+{
+	// If we are currently dragging directives, those 
+	// directives were skipped by our DL and steps.  So we
+	// do something a little scary.  We build a temporary
+	// DL for those directives, draw the DL and nuke them.
+	// We ALSO pass drawSelf message.
+	//
+	// This isn't terrible unless we are dragging a huge 
+	// number of raw primitives.
+	
+	if(self->draggingDirectives != nil)
+	{
+		LDrawDLHandle			drag_dl = NULL;
+		LDrawDLCleanup_f		drag_dl_dtor = NULL;
+
+		id<LDrawCollector> collector = [renderer beginDL];
+		[self->draggingDirectives collectSelf:collector];
+		[renderer endDL:&drag_dl cleanupFunc:&drag_dl_dtor];
+
+		if(drag_dl)
 		{
-			LDrawDLHandle			drag_dl = NULL;
-			LDrawDLCleanup_f		drag_dl_dtor = NULL;
+			[renderer drawDL:drag_dl];
+			drag_dl_dtor(drag_dl);
+		}
+		
+		[self->draggingDirectives drawSelf:renderer];
+	}
+}//end drawDraggingDirectives:
 
-			id<LDrawCollector> collector = [renderer beginDL];
-			[self->draggingDirectives collectSelf:collector];
-			[renderer endDL:&drag_dl cleanupFunc:&drag_dl_dtor];
 
-			if(drag_dl)
+//========== drawFlattened: ======================================================
+//
+// Purpose:		Draws this model as a submodel placed by a part: our own 
+//				geometry, then every model placed anywhere under us straight 
+//				out of our flattened list, each with its matrix and color 
+//				already worked out. 
+//
+// Notes:		This draws exactly what drawSelf: would, except that small 
+//				nested submodels are culled or boxed part by part rather than 
+//				as a whole. 
+//
+//================================================================================
+- (void) drawFlattened:(id<LDrawRenderer>)renderer
+{
+	struct LDrawFlatPart    *flatPart       = NULL;
+	NSMutableSet            *modelsToBuild  = nil;
+	NSUInteger              counter         = 0;
+	NSUInteger              pathCounter     = 0;
+	int                     colorCounter    = 0;
+	int                     colorPushes     = 0;
+	GLfloat                 rgba[4];
+	BOOL                    selected        = NO;
+	
+	// Library parts have nothing to flatten.
+	if(self->isOptimized)
+	{
+		[self drawSelf:renderer];
+		return;
+	}
+	
+	Box3	my_bounds = [self boundingBox3];
+	GLfloat minxyz[3] = { my_bounds.min.x, my_bounds.min.y, my_bounds.min.z };
+	GLfloat maxxyz[3] = { my_bounds.max.x, my_bounds.max.y, my_bounds.max.z };
+
+	int cull_result = [renderer checkCull:minxyz to:maxxyz];
+	
+	#if !NO_CULL_SMALL_BRICKS
+
+	if(cull_result == cull_skip)
+		return;
+		
+	if(cull_result == cull_box)
+	{
+		[renderer drawBoxFrom:minxyz to:maxxyz];
+		return;
+	}
+
+	#endif
+	
+	if(self->flatParts == NULL)
+		[self buildFlattenedParts];
+	
+	// No one else will get a chance to build our nested models' DLs in 
+	// parallel; do it here. 
+	if([renderer respondsToSelector:@selector(immediateCollector)] == NO)
+	{
+		for(counter = 0; counter < self->flatPartCount; counter++)
+		{
+			flatPart = self->flatParts + counter;
+			if([flatPart->model hasValidDisplayList] == NO && [flatPart->model prepareDisplayList])
 			{
-				[renderer drawDL:drag_dl];
-				drag_dl_dtor(drag_dl);
+				if(modelsToBuild == nil)
+					modelsToBuild = [NSMutableSet set];
+				[modelsToBuild addObject:flatPart->model];
 			}
-			
-			[self->draggingDirectives drawSelf:renderer];
 		}
+		if(modelsToBuild)
+			[LDrawModel buildDisplayListsInParallel:[modelsToBuild allObjects]];
+	}
+	
+	[self drawOwnGeometry:renderer];
+	
+	for(counter = 0; counter < self->flatPartCount; counter++)
+	{
+		flatPart = self->flatParts + counter;
 		
-	}	
-}//drawSelf:
+		if([renderer checkCull:flatPart->bounds to:flatPart->bounds + 3] == cull_skip)
+			continue;
+		
+		// A selected part anywhere up the chain draws all its pieces 
+		// selected. 
+		selected = NO;
+		for(pathCounter = 0; pathCounter < flatPart->pathCount && selected == NO; pathCounter++)
+			selected = [self->flatPath[flatPart->pathStart + pathCounter] isSelected];
+		
+		// The color is read now, so edits to its definition show up. 
+		colorPushes = flatPart->compliments;
+		if(flatPart->color)
+		{
+			[flatPart->color getColorRGBA:rgba];
+			[renderer pushColor:rgba];
+			colorPushes++;
+		}
+		for(colorCounter = 0; colorCounter < flatPart->compliments; colorCounter++)
+			[renderer pushColor:LDrawRenderComplimentColor];
+		if(selected)
+			[renderer pushWireFrame];
+		
+		// Don't touch flatPart after drawing; a part resolving for the first 
+		// time in there would throw our list out. 
+		[renderer pushMatrix:flatPart->glTransform];
+		if(flatPart->isLeaf)
+			[flatPart->model drawSelf:renderer];
+		else
+			[flatPart->model drawOwnGeometry:renderer];
+		[renderer popMatrix];
+		
+		if(selected)
+			[renderer popWireFrame];
+		for(colorCounter = 0; colorCounter < colorPushes; colorCounter++)
+			[renderer popColor];
+	}
+	
+}//end drawFlattened:
+
+
+//========== drawOwnGeometry: ====================================================
+//
+// Purpose:		Draws everything in this model except the parts in it: our 
+//				primitives, the other directives in our steps (which may need 
+//				to draw drag handles) and anything being dragged in. 
+//
+//================================================================================
+- (void) drawOwnGeometry:(id<LDrawRenderer>)renderer
+{
+	[self drawDisplayList:renderer];
+	
+	for(LDrawDirective *currentDirective in [self flattenedOtherDirectives])
+	{
+		[currentDirective drawSelf:renderer];
+	}
+	
+	[self drawDraggingDirectives:renderer];
+	
+}//end drawOwnGeometry:
+
+
+//========== hasValidDisplayList ================================================
+//
+// Purpose:		Returns YES if we have a DL and nothing has invalidated it, so
+//				there is no need to prepare or build one before drawing.
+//
+// Notes:		This only reads our cache flags, so callers walking every part
+//				each frame can skip the ones already drawn from a good DL.
+//
+//================================================================================
+- (BOOL) hasValidDisplayList
+{
+	return dl != NULL && [self dirtyCacheFlags:DisplayList] == 0;
+
+}//end hasValidDisplayList
+
+
+//========== prepareDisplayList ==================================================
+//
+// Purpose:		Get our cached DL ready to be rebuilt.  Returns YES if the model
+//				needs a DL built (via buildDisplayList) before it can be drawn.
+//
+// Notes:		DL cache control: we may have to throw out our old DL if it has
+//				gone stale. EITHER WAY we mark our DL bit as validated per the
+//				rules of the observable protocol.
+//
+//				This touches the observable state and destroys GL resources, so
+//				it must be called on the main (GL) thread.
+//
+//================================================================================
+- (BOOL) prepareDisplayList
+{
+	if(dl)
+	{
+		if([self revalCache:DisplayList] == DisplayList)
+		{
+			dl_dtor(dl);
+			dl_dtor = NULL;
+			dl = NULL;
+		}
+	} else
+		[self revalCache:DisplayList];
+
+	return dl == NULL;
+
+}//end prepareDisplayList
+
+
+//========== buildDisplayList ====================================================
+//
+// Purpose:		Build our DL: get a collector and call "collect" on ourselves,
+//				which will walk our tree picking up primitives.
+//
+// Notes:		This does no GL work - the DL is uploaded the first time it is
+//				drawn - so it may run on any thread, as long as no one else is
+//				building this model's DL or editing the model at the same time.
+//				Call prepareDisplayList first.
+//
+//================================================================================
+- (void) buildDisplayList
+{
+	LDrawDLCollector * collector = [[LDrawDLCollector alloc] init];
+
+	[self collectSelf:collector];
+	[collector finish:&dl cleanupFunc:&dl_dtor];
+	[collector release];
+
+}//end buildDisplayList
+
+
+//========== buildDisplayListsInParallel: ========================================
+//
+// Purpose:		Build the DLs of several distinct models at once.
+//
+// Notes:		Smoothing and indexing a part's mesh is by far the most expensive
+//				part of drawing a part for the first time, and each model's
+//				build is independent, so we farm them out to all cores.  The
+//				models must already have been prepared, and must all be
+//				different objects.
+//
+//================================================================================
++ (void) buildDisplayListsInParallel:(NSArray *)models
+{
+	NSUInteger count = [models count];
+
+#if USE_BLOCKS
+	if(count > 1)
+	{
+		dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+		dispatch_apply(count, queue,
+		^(size_t i)
+		{
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			[[models objectAtIndex:i] buildDisplayList];
+			[pool drain];
+		});
+		return;
+	}
+#endif
+
+	NSUInteger counter;
+	for(counter = 0; counter < count; counter++)
+		[[models objectAtIndex:counter] buildDisplayList];
+
+}//end buildDisplayListsInParallel:
 
 
 //========== collectSelf: ========================================================
@@ -490,10 +780,49 @@
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 	
+	// A submodel placed by a part credits everything to the part, so it can 
+	// pick its nested parts out of the flattened list, with their matrices 
+	// already multiplied out. 
+	if(creditObject != nil && boundsOnly == NO && self->isOptimized == NO)
+	{
+		struct LDrawFlatPart    *flatPart   = NULL;
+		
+		if(self->flatParts == NULL)
+			[self buildFlattenedParts];
+		
+		for(LDrawDirective *otherDirective in [self flattenedOtherDirectives])
+		{
+			[otherDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:NO creditObject:creditObject hits:hits];
+		}
+		for(counter = 0; counter < self->flatPartCount; counter++)
+		{
+			flatPart = self->flatParts + counter;
+			Matrix4 combinedTransform = Matrix4Multiply(flatPart->transform, transform);
+			
+			if(flatPart->isLeaf)
+				[flatPart->model hitTest:pickRay transform:combinedTransform viewScale:scaleFactor boundsOnly:NO creditObject:creditObject hits:hits];
+			else
+			{
+				for(LDrawDirective *otherDirective in [flatPart->model flattenedOtherDirectives])
+				{
+					[otherDirective hitTest:pickRay transform:combinedTransform viewScale:scaleFactor boundsOnly:NO creditObject:creditObject hits:hits];
+				}
+			}
+		}
+		return;
+	}
+	
+	// A library part's primitives are all in our vertexes, which can pick 
+	// them without visiting each one. 
+	if([self picksThroughVertexes])
+		[self->vertexes hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
+	
 	// Draw all the steps in the model
 	for(counter = 0; counter <= maxIndex; counter++)
 	{
 		currentDirective = [steps objectAtIndex:counter];
+		if([self picksThroughVertexes] && [currentDirective stepFlavor] != LDrawStepAnyDirectives)
+			continue;
 		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
 	}
 }
@@ -523,10 +852,57 @@
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 
+	// See hitTest; any hit at all is a hit on the credit object. 
+	if(creditObject != nil && boundsOnly == NO && self->isOptimized == NO)
+	{
+		struct LDrawFlatPart    *flatPart   = NULL;
+		
+		if(self->flatParts == NULL)
+			[self buildFlattenedParts];
+		
+		for(LDrawDirective *otherDirective in [self flattenedOtherDirectives])
+		{
+			if([otherDirective boxTest:bounds transform:transform boundsOnly:NO creditObject:creditObject hits:hits])
+				return TRUE;
+		}
+		for(counter = 0; counter < self->flatPartCount; counter++)
+		{
+			flatPart = self->flatParts + counter;
+			if(!VolumeCanIntersectBox(flatPart->box, transform, bounds))
+				continue;
+			
+			Matrix4 combinedTransform = Matrix4Multiply(flatPart->transform, transform);
+			
+			if(flatPart->isLeaf)
+			{
+				if([flatPart->model boxTest:bounds transform:combinedTransform boundsOnly:NO creditObject:creditObject hits:hits])
+					return TRUE;
+			}
+			else
+			{
+				for(LDrawDirective *otherDirective in [flatPart->model flattenedOtherDirectives])
+				{
+					if([otherDirective boxTest:bounds transform:combinedTransform boundsOnly:NO creditObject:creditObject hits:hits])
+						return TRUE;
+				}
+			}
+		}
+		return FALSE;
+	}
+
+	if([self picksThroughVertexes])
+	{
+		if([self->vertexes boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
+			if(creditObject != nil)
+				return TRUE;
+	}
+
 	// Draw all the steps in the model
 	for(counter = 0; counter <= maxIndex; counter++)
 	{
 		currentDirective = [steps objectAtIndex:counter];
+		if([self picksThroughVertexes] && [currentDirective stepFlavor] != LDrawStepAnyDirectives)
+			continue;
 		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
 			if(creditObject != nil)
 				return TRUE;
@@ -558,15 +934,75 @@
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 
+	// See hitTest.
+	if(creditObject != nil && self->isOptimized == NO)
+	{
+		struct LDrawFlatPart    *flatPart   = NULL;
+		
+		if(self->flatParts == NULL)
+			[self buildFlattenedParts];
+		
+		for(LDrawDirective *otherDirective in [self flattenedOtherDirectives])
+		{
+			[otherDirective depthTest:pt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+		}
+		for(counter = 0; counter < self->flatPartCount; counter++)
+		{
+			flatPart = self->flatParts + counter;
+			if(!VolumeCanIntersectPoint(flatPart->box, transform, bounds, *bestDepth))
+				continue;
+			
+			Matrix4 combinedTransform = Matrix4Multiply(flatPart->transform, transform);
+			
+			if(flatPart->isLeaf)
+				[flatPart->model depthTest:pt inBox:bounds transform:combinedTransform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+			else
+			{
+				for(LDrawDirective *otherDirective in [flatPart->model flattenedOtherDirectives])
+				{
+					[otherDirective depthTest:pt inBox:bounds transform:combinedTransform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+				}
+			}
+		}
+		return;
+	}
+
+	if([self picksThroughVertexes])
+		[self->vertexes depthTest:pt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+
 	// Draw all the steps in the model
 	for(counter = 0; counter <= maxIndex; counter++)
 	{
 		currentDirective = [steps objectAtIndex:counter];
+		if([self picksThroughVertexes] && [currentDirective stepFlavor] != LDrawStepAnyDirectives)
+			continue;
 		[currentDirective depthTest:pt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
 	}
 }//end depthTest:inBox:transform:creditObject:bestObject:bestDepth:
 
 
+//========== picksThroughVertexes ==============================================
+//
+// Purpose:		Whether hit tests should go to our vertexes for primitives, 
+//				rather than down through the steps. 
+//
+// Notes:		Only for library parts: optimizeStructure has put all their 
+//				primitives in steps of their own, which our vertexes mirror, 
+//				and no one edits them or drags their handles. We collect the 
+//				vertexes on first use if nobody has yet. 
+//
+//==============================================================================
+- (BOOL) picksThroughVertexes
+{
+	if(self->isOptimized == NO)
+		return NO;
+	
+	[self optimizePrimitiveStructure];
+	return YES;
+	
+}//end picksThroughVertexes
+
+
 //========== write =============================================================
 //
 // Purpose:		Writes out the MPD submodel, wrapped in the MPD file commands.
@@ -1312,6 +1748,206 @@
 	[vertexes removeDirective:directive];
 }
 
+#pragma mark -
+#pragma mark FLATTENING
+#pragma mark -
+
+//========== buildFlattenedParts ===============================================
+//
+// Purpose:		Flattens everything placed under this model into one list: each 
+//				library part, and each submodel (for its own primitives), with 
+//				its transform and color relative to us multiplied out, and the 
+//				chain of parts that placed it. 
+//
+// Notes:		Nested submodels are flattened first and their lists copied 
+//				into ours. When something changes anywhere underneath, the 
+//				bounds invalidation works its way up through every part and 
+//				model on the path to us, and each throws out its list in 
+//				invalCache: - models off that path keep theirs. 
+//
+//==============================================================================
+- (void) buildFlattenedParts
+{
+	NSArray                 *steps          = [self subdirectives];
+	NSUInteger              maxIndex        = [self maxStepIndexToOutput];
+	NSMutableArray          *others         = [NSMutableArray array];
+	struct LDrawPartTable   *table          = NULL;
+	struct LDrawFlatPart    *flatPart       = NULL;
+	struct LDrawFlatPart    *childPart      = NULL;
+	LDrawModel              *model          = nil;
+	LDrawPart               *part           = nil;
+	Matrix4                 partTransform   = IdentityMatrix4;
+	NSUInteger              partCount       = 0;
+	NSUInteger              pathCount       = 0;
+	NSUInteger              partIndex       = 0;
+	NSUInteger              pathIndex       = 0;
+	NSUInteger              stepCounter     = 0;
+	NSUInteger              childCounter    = 0;
+	int                     row             = 0;
+	
+	[self removeFlattenedParts];
+	
+	self->isFlattening = YES;
+	
+	// Flatten the submodels we place, and count what we'll need.
+	for(stepCounter = 0; stepCounter <= maxIndex; stepCounter++)
+	{
+		LDrawStep *step = [steps objectAtIndex:stepCounter];
+		
+		table = [step partTable];
+		[others addObjectsFromArray:[step otherDirectives]];
+		
+		for(row = 0; row < table->count; row++)
+		{
+			model = table->models[row];
+			if(model == nil || (table->flags[row] & part_row_hidden))
+				continue;
+			
+			if(table->flags[row] & part_row_reference)
+			{
+				// A submodel which places itself can't be drawn anyway.
+				if(model->isFlattening)
+					continue;
+				if(model->flatParts == NULL)
+					[model buildFlattenedParts];
+				
+				partCount += 1 + model->flatPartCount;
+				pathCount += 1 + model->flatPartCount;
+				for(childCounter = 0; childCounter < model->flatPartCount; childCounter++)
+					pathCount += model->flatParts[childCounter].pathCount;
+			}
+			else
+			{
+				partCount += 1;
+				pathCount += 1;
+			}
+		}
+	}
+	
+	// Bringing our bounds up to date also re-arms the bounds notifications 
+	// all the way down, so that the next change under us reaches us. This 
+	// comes after the tables are read: reading them resolves parts, which 
+	// invalidates bounds again. 
+	[self boundingBox3];
+	
+	self->flatParts = calloc(MAX(partCount, 1), sizeof(struct LDrawFlatPart));
+	self->flatPath  = calloc(MAX(pathCount, 1), sizeof(LDrawPart *));
+	
+	// Fill in the list.
+	for(stepCounter = 0; stepCounter <= maxIndex; stepCounter++)
+	{
+		table = [[steps objectAtIndex:stepCounter] partTable];
+		
+		for(row = 0; row < table->count; row++)
+		{
+			model = table->models[row];
+			if(model == nil || (table->flags[row] & part_row_hidden))
+				continue;
+			if((table->flags[row] & part_row_reference) && model->isFlattening)
+				continue;
+			
+			part            = table->parts[row];
+			partTransform   = [part transformationMatrix];
+			
+			// The model the part draws
+			flatPart            = self->flatParts + partIndex++;
+			flatPart->model     = [model retain];
+			flatPart->isLeaf    = (table->flags[row] & part_row_reference) == 0;
+			flatPart->pathStart = pathIndex;
+			flatPart->pathCount = 1;
+			self->flatPath[pathIndex++] = part;
+			FlatPartComposeColor(flatPart, table->colors[row]);
+			FlatPartSetTransform(flatPart, partTransform);
+			
+			// and everything that model places in turn.
+			if(flatPart->isLeaf == NO)
+			{
+				for(childCounter = 0; childCounter < model->flatPartCount; childCounter++)
+				{
+					childPart           = model->flatParts + childCounter;
+					flatPart            = self->flatParts + partIndex++;
+					*flatPart           = *childPart;
+					[flatPart->model retain];
+					flatPart->pathStart = pathIndex;
+					flatPart->pathCount = childPart->pathCount + 1;
+					
+					self->flatPath[pathIndex++] = part;
+					memcpy(self->flatPath + pathIndex, model->flatPath + childPart->pathStart, childPart->pathCount * sizeof(LDrawPart *));
+					pathIndex += childPart->pathCount;
+					
+					FlatPartComposeColor(flatPart, table->colors[row]);
+					FlatPartSetTransform(flatPart, Matrix4Multiply(childPart->transform, partTransform));
+				}
+			}
+		}
+	}
+	
+	self->flatPartCount = partIndex;
+	self->flatOthers    = [others retain];
+	self->isFlattening  = NO;
+	
+}//end buildFlattenedParts
+
+
+//========== flattenedOtherDirectives ==========================================
+//
+// Purpose:		Returns the directives in our showing steps which aren't parts.
+//
+//==============================================================================
+- (NSArray *) flattenedOtherDirectives
+{
+	if(self->flatParts == NULL)
+		[self buildFlattenedParts];
+	
+	return self->flatOthers;
+	
+}//end flattenedOtherDirectives
+
+
+//========== removeFlattenedParts ==============================================
+//
+// Purpose:		Throws out our flattened list; the next draw rebuilds it.
+//
+//==============================================================================
+- (void) removeFlattenedParts
+{
+	NSUInteger counter = 0;
+	
+	// The models are retained so that a part which lets go of its model - 
+	// a deleted submodel, a reloaded library - can't leave us pointing at 
+	// a freed one before we hear about it. 
+	for(counter = 0; counter < self->flatPartCount; counter++)
+		[self->flatParts[counter].model release];
+	
+	free(self->flatParts);
+	free(self->flatPath);
+	[self->flatOthers release];
+	
+	self->flatParts     = NULL;
+	self->flatPath      = NULL;
+	self->flatOthers    = nil;
+	self->flatPartCount = 0;
+	
+}//end removeFlattenedParts
+
+
+//========== invalCache: =======================================================
+//
+// Purpose:		Anything that changes our bounds - a part moved, recolored, 
+//				hidden, added or removed anywhere under us, or a different 
+//				step showing - changes our flattened list too. 
+//
+//==============================================================================
+- (void) invalCache:(CacheFlagsT) flags
+{
+	if(flags & CacheFlagBounds)
+		[self removeFlattenedParts];
+	
+	[super invalCache:flags];
+	
+}//end invalCache:
+
+
 #pragma mark -
 #pragma mark UTILITIES
 #pragma mark -
@@ -1566,20 +2202,10 @@
 {
 	[super optimizeVertexes];
 
-	// Allow primitives to be visible when displaying the model itself.
-	LDrawColor *parentColor = [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
-	
-	if([vertexes isOptimizedForColor:parentColor])
-	{
-		// The vertexes have already been optimized for any referencing colors. 
-		// Just rebuild the existing color optimizations. 
-		[self->vertexes rebuildAllOptimizations];
-	}
-	else
-	{
-		// Newly-created, empty vertexes. Make a list to display the model itself. 
-		[self->vertexes optimizeOpenGLWithParentColor:parentColor];
-	}
+	// Allow primitives to be visible when displaying the model itself. The 
+	// optimization is shared by every color the model is drawn in, so this 
+	// only does work if the vertexes are new or have changed. 
+	[self->vertexes optimizeOpenGL];
 }//end optimizeVertexes
 
 
@@ -1753,6 +2379,8 @@
 	[vertexes			release];
 	[colorLibrary		release];
 	
+	[self removeFlattenedParts];
+	
 	[super dealloc];
 	
 }//end dealloc
@@ -1766,3 +2394,67 @@
 
 
 @end
+
+
+//========== FlatPartComposeColor() ============================================
+//
+// Purpose:		Applies the color of a part placing flatPart, from outside 
+//				whatever colors flatPart already has. 
+//
+// Notes:		Drawing pushes the explicit color, then the compliment color 
+//				once for each edge-colored part in between, which is just what 
+//				pushing each part's color in turn would have done. 
+//
+//==============================================================================
+static void FlatPartComposeColor(struct LDrawFlatPart *flatPart, LDrawColor *color)
+{
+	LDrawColorT colorCode = [color colorCode];
+	
+	// A color set further in wins; the current color changes nothing.
+	if(flatPart->color != nil || colorCode == LDrawCurrentColor)
+		return;
+	
+	if(colorCode == LDrawEdgeColor)
+		flatPart->compliments += 1;
+	else
+		flatPart->color = color;
+	
+}//end FlatPartComposeColor
+
+
+//========== FlatPartSetTransform() ============================================
+//
+// Purpose:		Sets the transform of flatPart, and the GL matrix and bounds 
+//				that follow from it. 
+//
+//==============================================================================
+static void FlatPartSetTransform(struct LDrawFlatPart *flatPart, Matrix4 transform)
+{
+	Box3        bounds      = [flatPart->model boundingBox3];
+	Box3        box         = InvalidBox;
+	Point3      vertex      = ZeroPoint3;
+	int         counter     = 0;
+	
+	flatPart->transform = transform;
+	Matrix4GetGLMatrix4(transform, flatPart->glTransform);
+	
+	if(V3EqualBoxes(bounds, InvalidBox) == NO)
+	{
+		for(counter = 0; counter < 8; counter++)
+		{
+			vertex.x	= (counter & 1) ? bounds.max.x : bounds.min.x;
+			vertex.y	= (counter & 2) ? bounds.max.y : bounds.min.y;
+			vertex.z	= (counter & 4) ? bounds.max.z : bounds.min.z;
+			box			= V3UnionBoxAndPoint(box, V3MulPointByProjMatrix(vertex, transform));
+		}
+	}
+	
+	flatPart->box		= box;
+	flatPart->bounds[0]	= box.min.x;
+	flatPart->bounds[1]	= box.min.y;
+	flatPart->bounds[2]	= box.min.z;
+	flatPart->bounds[3]	= box.max.x;
+	flatPart->bounds[4]	= box.max.y;
+	flatPart->bounds[5]	= box.max.z;
+	
+}//end FlatPartSetTransform
@@ -14,6 +14,8 @@
 #import "LDrawContainer.h"
 
 @class LDrawModel;
+struct LDrawInstanceBVH;
+struct LDrawPartTable;
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -58,6 +60,21 @@ typedef enum
 	LDrawStepFlavorT	stepFlavor; //defaults to LDrawStepAnyDirectives
 	LDrawColorT			colorOfAllDirectives;
 	
+	//Picking acceleration
+	struct LDrawInstanceBVH	*pickingBVH;		// over our directives' bounds; built on demand
+	id						*pickingDirectives;	// directive for each ID in pickingBVH
+	CFMutableDictionaryRef	pickingIDs;			// directive -> ID in pickingBVH
+	NSMutableIndexSet		*pickingStaleIDs;	// IDs whose bounds changed since the last pick
+	
+	//Incremental bounds
+	CFMutableDictionaryRef	boundsByDirective;		// directive -> NSValue of the Box3 it put in cachedBounds; NULL means rescan
+	CFMutableSetRef			staleBoundsDirectives;	// directives whose bounds changed since cachedBounds
+	
+	//Flat copy of our parts, for drawing and counting
+	struct LDrawPartTable	*partTable;			// one row per part; built on demand
+	CFMutableDictionaryRef	partTableRows;		// part -> row in partTable
+	NSMutableArray			*partTableOthers;	// everything that isn't a part, in order
+	
 	//Inherited from the superclasses:
 	//NSMutableArray	*containedObjects; //the commands that make up the step.
 	//LDrawContainer	*enclosingDirective; //weak link to enclosing model.
@@ -72,6 +89,8 @@ typedef enum
 
 //Accessors
 - (LDrawModel *) enclosingModel;
+- (NSArray *) otherDirectives;
+- (struct LDrawPartTable *) partTable;
 - (Tuple3) rotationAngle;
 - (Tuple3) rotationAngleZYX;
 - (LDrawStepFlavorT) stepFlavor;
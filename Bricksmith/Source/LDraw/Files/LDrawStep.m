@@ -31,14 +31,55 @@
 #import <dispatch/dispatch.h>
 #endif
 
+#import "LDrawBVH.h"
+#import "LDrawColor.h"
 #import "LDrawKeywords.h"
 #import "LDrawModel.h"
 #import "LDrawMPDModel.h"
 #import "LDRawPart.h"
+#import "LDrawPartTable.h"
 #import "LDrawUtilities.h"
+#import "PartReport.h"
 #import "StringCategory.h"
 #import "LDrawLSynthDirective.h"
 
+// Build the display lists of the models a step's parts draw in parallel,
+// before drawing the step.
+#define PARALLEL_DL_BUILD USE_BLOCKS
+
+// Steps with fewer directives than this just test them all when picking.
+#define PICKING_BVH_MIN_DIRECTIVES 16
+
+// What the instance BVH visit callback needs to run a directive's depth test.
+struct DepthTestContext
+{
+	id					*directives;
+	Point2				pt;
+	Box2				bounds;
+	Matrix4				transform;
+	id					creditObject;
+	id					*bestObject;
+	float				*bestDepth;
+};
+
+static void DepthTestDirective(int directiveID, void *ref);
+static BOOL BoxIsOnBoundary(Box3 box, Box3 bounds);
+static BOOL BoxContainsBox(Box3 outer, Box3 inner);
+static void DrawPartTableRow(struct LDrawPartTable *table, int row, id<LDrawRenderer> renderer);
+
+
+@interface LDrawStep ()
+
+- (struct LDrawInstanceBVH *) pickingBVH;
+- (void) removePickingBVH;
+- (void) rebuildBoundsCache;
+- (BOOL) updateBoundsCache;
+- (void) removeBoundsCache;
+- (void) readPartTableRow:(int)row;
+- (void) removePartTable;
+
+@end
+
 
 @implementation LDrawStep
 
@@ -371,16 +412,60 @@
 //				message.  This is needed because parts "draw" themselves; they do
 //				not "collect" themselves.
 //
+//				Before drawing, we find the distinct models our parts draw that
+//				have no display list yet, and build those DLs in parallel.  The
+//				first draw of a big model is otherwise one long serial pass of
+//				mesh smoothing, one part at a time.  (We may build a DL for a
+//				part that is then culled - it costs only system memory, since
+//				DLs go to VRAM when first drawn, and it will be needed as soon
+//				as the part comes into view anyway.)
+//
 //================================================================================
 - (void) drawSelf:(id<LDrawRenderer>)renderer
 {
-	NSArray         *commandsInStep     = [self subdirectives];
-	LDrawDirective  *currentDirective   = nil;
+	struct LDrawPartTable   *table              = [self partTable];
+	LDrawDirective          *currentDirective   = nil;
+	int                     row                 = 0;
 	
-	//Draw each element in the step.
-	for(currentDirective in commandsInStep)
+#if PARALLEL_DL_BUILD
+	LDrawModel      *model              = nil;
+	NSMutableSet    *modelsToBuild      = nil;
+	BOOL            usesDisplayLists    = ([renderer respondsToSelector:@selector(immediateCollector)] == NO);
+	
+	// Renderers with an immediate collector don't use our DLs.
+	for(row = 0; usesDisplayLists && row < table->count; ++row)
+	{
+		model = table->models[row];
+		
+		// Most rows draw a model whose DL is already good; only the rest are
+		// prepared.  A model used by many parts may be prepared several
+		// times, but the set makes sure it is built only once.
+		if(		model
+			&&	(table->flags[row] & part_row_hidden) == 0
+			&&	[model hasValidDisplayList] == NO
+			&&	[model prepareDisplayList] )
+		{
+			if(modelsToBuild == nil)
+				modelsToBuild = [NSMutableSet set];
+			[modelsToBuild addObject:model];
+		}
+	}
+	
+	if(modelsToBuild)
+		[LDrawModel buildDisplayListsInParallel:[modelsToBuild allObjects]];
+#endif
+	
+	// Draw in file order - translucent parts and meta-commands depend on 
+	// it. The table's rows are in that order too, so a directive which is 
+	// the next row's part is drawn straight out of the table: this is what 
+	// -[LDrawPart drawSelf:] does, minus the lookups. 
+	row = 0;
+	for(currentDirective in [self subdirectives])
 	{
-		[currentDirective drawSelf:renderer];
+		if(row < table->count && currentDirective == table->parts[row])
+			DrawPartTableRow(table, row++, renderer);
+		else
+			[currentDirective drawSelf:renderer];
 	}
 }//end drawSelf:
 
@@ -408,6 +493,34 @@
 	[self revalCache:DisplayList];
 }//end collectSelf:
 
+
+//========== collectPartReport: ================================================
+//
+// Purpose:		Reports our parts out of the part table, which already knows
+//				which ones are library parts and which are submodel
+//				references, instead of asking each part to resolve itself.
+//
+//==============================================================================
+- (void) collectPartReport:(PartReport *)report
+{
+	struct LDrawPartTable   *table  = [self partTable];
+	int                     row     = 0;
+
+	for(row = 0; row < table->count; ++row)
+	{
+		if(table->flags[row] & part_row_library)
+			[report registerPart:(LDrawPart *)table->parts[row]];
+		else if(table->flags[row] & part_row_reference)
+			[(LDrawModel *)table->models[row] collectPartReport:report];
+	}
+
+	for(LDrawDirective *currentDirective in self->partTableOthers)
+	{
+		if([currentDirective respondsToSelector:@selector(collectPartReport:)])
+			[(id)currentDirective collectPartReport:report];
+	}
+}//end collectPartReport:
+
 //========== debugDrawboundingBox ==============================================
 //
 // Purpose:		Draw a translucent visualization of our bounding box to test
@@ -508,10 +621,21 @@
 	if(!VolumeCanIntersectPoint([self boundingBox3], transform, bounds, *bestDepth)) 
 		return;
 
-	NSArray     *commandsInStep     = [self subdirectives];
-	NSUInteger  commandCount        = [commandsInStep count];
-	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	NSArray                 *commandsInStep     = [self subdirectives];
+	NSUInteger              commandCount        = [commandsInStep count];
+	LDrawStep               *currentDirective   = nil;
+	NSUInteger              counter             = 0;
+	struct LDrawInstanceBVH *bvh                = [self pickingBVH];
+
+	// Big steps only descend into the directives whose bounds are under the 
+	// point, nearest first. 
+	if(bvh)
+	{
+		struct DepthTestContext context = { self->pickingDirectives, pt, bounds, transform, creditObject, bestObject, bestDepth };
+		
+		LDrawInstanceBVHDepthTest(bvh, bounds, transform, bestDepth, DepthTestDirective, &context);
+		return;
+	}
 
 	// Draw all the steps in the model
 	for(counter = 0; counter < commandCount; counter++)
@@ -699,12 +823,19 @@
 #pragma mark -
 
 //========== boundingBox3 ======================================================
+//
+// Purpose:		Returns the box which contains everything in the step.
+//
+// Notes:		The bounds are kept up to date incrementally; see 
+//				updateBoundsCache. 
+//
 //==============================================================================
 - (Box3) boundingBox3
 {
 	if ([self revalCache:CacheFlagBounds] == CacheFlagBounds)
 	{
-		cachedBounds = [LDrawUtilities boundingBox3ForDirectives:[self subdirectives]];
+		if(self->boundsByDirective == NULL || [self updateBoundsCache] == NO)
+			[self rebuildBoundsCache];
 	}
 	return cachedBounds;
 	
@@ -930,6 +1061,13 @@
 - (void) insertDirective:(LDrawDirective *)directive atIndex:(NSInteger)index
 {
 	[self invalCache:CacheFlagBounds|DisplayList];
+	[self removePickingBVH];
+	[self removePartTable];
+	
+	// A new directive can only grow the bounds.
+	if(self->boundsByDirective != NULL)
+		CFSetAddValue(self->staleBoundsDirectives, directive);
+	
 	[super insertDirective:directive atIndex:index];
 	
 	[[self enclosingModel] didAddDirective:directive];
@@ -945,7 +1083,24 @@
 - (void) removeDirectiveAtIndex:(NSInteger)index
 {
 	[self invalCache:CacheFlagBounds|DisplayList];
+	[self removePickingBVH];
+	[self removePartTable];
 	LDrawDirective *directive = [[[self subdirectives] objectAtIndex:index] retain];
+	
+	// Taking away a directive only shrinks the bounds if it was holding out 
+	// one of their sides. 
+	if(self->boundsByDirective != NULL)
+	{
+		NSValue *oldValue = (NSValue *)CFDictionaryGetValue(self->boundsByDirective, directive);
+		Box3    oldBounds = InvalidBox;
+		
+		[oldValue getValue:&oldBounds];
+		CFDictionaryRemoveValue(self->boundsByDirective, directive);
+		CFSetRemoveValue(self->staleBoundsDirectives, directive);
+		
+		if(BoxIsOnBoundary(oldBounds, self->cachedBounds))
+			[self removeBoundsCache];
+	}
 
 	[super removeDirectiveAtIndex:index];
 	
@@ -956,6 +1111,394 @@
 }//end removeDirectiveAtIndex:
 
 
+#pragma mark -
+#pragma mark PICKING
+#pragma mark -
+
+//========== pickingBVH ========================================================
+//
+// Purpose:		Returns the BVH over our directives' bounding boxes, or NULL if 
+//				we are too small to bother. Builds it if it's been thrown out, 
+//				and refits it around any directives that have moved since the 
+//				last pick. 
+//
+// Notes:		Each directive's ID is its index in pickingDirectives; we don't 
+//				retain them there, since our subdirectives do, and adding or 
+//				removing one throws the BVH out. 
+//
+//				Asking a directive for its bounding box revalidates it, so 
+//				from then on it tells us (statusInvalidated:who:) the next time 
+//				its bounds change. That's how we know which boxes are stale. 
+//
+//				Building is not thread-safe; picking happens on the main thread. 
+//
+//==============================================================================
+- (struct LDrawInstanceBVH *) pickingBVH
+{
+	NSArray     *commandsInStep = [self subdirectives];
+	NSUInteger  commandCount    = [commandsInStep count];
+	NSUInteger  counter         = 0;
+	
+	if(self->pickingBVH == NULL && commandCount >= PICKING_BVH_MIN_DIRECTIVES)
+	{
+		float   *boxes  = malloc(sizeof(float) * 6 * commandCount);
+		
+		self->pickingDirectives = malloc(sizeof(id) * commandCount);
+		self->pickingIDs        = CFDictionaryCreateMutable(NULL, commandCount, NULL, NULL);
+		self->pickingStaleIDs   = [[NSMutableIndexSet alloc] init];
+		
+		for(counter = 0; counter < commandCount; counter++)
+		{
+			LDrawDirective  *directive  = [commandsInStep objectAtIndex:counter];
+			Box3            bounds      = [directive boundingBox3];
+			
+			memcpy(boxes + 6 * counter, &bounds, sizeof(float) * 6);
+			self->pickingDirectives[counter] = directive;
+			CFDictionarySetValue(self->pickingIDs, directive, (const void *)counter);
+		}
+		
+		self->pickingBVH = LDrawInstanceBVHCreate((int)commandCount, boxes);
+		free(boxes);
+	}
+	else if(self->pickingBVH != NULL && [self->pickingStaleIDs count] > 0)
+	{
+		counter = [self->pickingStaleIDs firstIndex];
+		while(counter != NSNotFound)
+		{
+			Box3 bounds = [self->pickingDirectives[counter] boundingBox3];
+			
+			// A directive which had no bounds when we built can't be fitted 
+			// in; start over. 
+			if(LDrawInstanceBVHUpdate(self->pickingBVH, (int)counter, (float *)&bounds) == 0)
+			{
+				[self removePickingBVH];
+				return [self pickingBVH];
+			}
+			counter = [self->pickingStaleIDs indexGreaterThanIndex:counter];
+		}
+		[self->pickingStaleIDs removeAllIndexes];
+	}
+	return self->pickingBVH;
+	
+}//end pickingBVH
+
+
+//========== removePickingBVH ==================================================
+//
+// Purpose:		Throws out the BVH; our directives have changed.
+//
+//==============================================================================
+- (void) removePickingBVH
+{
+	if(self->pickingBVH)
+	{
+		LDrawInstanceBVHDestroy(self->pickingBVH);
+		self->pickingBVH = NULL;
+		
+		CFRelease(self->pickingIDs);
+		self->pickingIDs = NULL;
+	}
+	free(self->pickingDirectives);
+	self->pickingDirectives = NULL;
+	
+	[self->pickingStaleIDs release];
+	self->pickingStaleIDs = nil;
+	
+}//end removePickingBVH
+
+
+#pragma mark -
+#pragma mark BOUNDS
+#pragma mark -
+
+//========== rebuildBoundsCache ================================================
+//
+// Purpose:		Recomputes our bounds from every directive, remembering what 
+//				each one contributed. 
+//
+//==============================================================================
+- (void) rebuildBoundsCache
+{
+	Box3	bounds	= InvalidBox;
+	
+	if(self->boundsByDirective == NULL)
+	{
+		self->boundsByDirective     = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+		self->staleBoundsDirectives = CFSetCreateMutable(NULL, 0, NULL);
+	}
+	else
+	{
+		CFDictionaryRemoveAllValues(self->boundsByDirective);
+		CFSetRemoveAllValues(self->staleBoundsDirectives);
+	}
+	
+	self->cachedBounds = InvalidBox;
+	
+	for(LDrawDirective *currentDirective in [self subdirectives])
+	{
+		bounds = [currentDirective boundingBox3];
+		self->cachedBounds = V3UnionBox(self->cachedBounds, bounds);
+		
+		CFDictionarySetValue(self->boundsByDirective, currentDirective, [NSValue valueWithBytes:&bounds objCType:@encode(Box3)]);
+	}
+	
+}//end rebuildBoundsCache
+
+
+//========== updateBoundsCache =================================================
+//
+// Purpose:		Folds the new bounds of the directives that changed into our 
+//				bounds, without looking at the ones that didn't. 
+//
+//				Growing is always cheap. Returns NO if a directive that was 
+//				holding out a side of our bounds moved in from it, because 
+//				then only a rescan can tell how far the side comes in. 
+//
+//==============================================================================
+- (BOOL) updateBoundsCache
+{
+	CFIndex         count       = CFSetGetCount(self->staleBoundsDirectives);
+	const void      **stale     = NULL;
+	NSValue         *oldValue   = nil;
+	Box3            oldBounds   = InvalidBox;
+	Box3            newBounds   = InvalidBox;
+	CFIndex         counter     = 0;
+	BOOL            updated     = YES;
+	
+	if(count == 0)
+		return YES;
+	
+	stale = malloc(sizeof(void *) * count);
+	CFSetGetValues(self->staleBoundsDirectives, stale);
+	
+	for(counter = 0; counter < count && updated == YES; counter++)
+	{
+		LDrawDirective *currentDirective = (LDrawDirective *)stale[counter];
+		
+		newBounds   = [currentDirective boundingBox3];
+		oldValue    = (NSValue *)CFDictionaryGetValue(self->boundsByDirective, currentDirective);
+		oldBounds   = InvalidBox;
+		[oldValue getValue:&oldBounds];
+		
+		if(		BoxIsOnBoundary(oldBounds, self->cachedBounds)
+		   &&	BoxContainsBox(newBounds, oldBounds) == NO )
+		{
+			updated = NO;
+		}
+		else
+		{
+			self->cachedBounds = V3UnionBox(self->cachedBounds, newBounds);
+			CFDictionarySetValue(self->boundsByDirective, currentDirective, [NSValue valueWithBytes:&newBounds objCType:@encode(Box3)]);
+		}
+	}
+	free(stale);
+	
+	CFSetRemoveAllValues(self->staleBoundsDirectives);
+	
+	return updated;
+	
+}//end updateBoundsCache
+
+
+//========== removeBoundsCache =================================================
+//
+// Purpose:		Forgets what each directive contributed to our bounds, so that 
+//				the next request recomputes them from scratch. 
+//
+//==============================================================================
+- (void) removeBoundsCache
+{
+	if(self->boundsByDirective != NULL)
+	{
+		CFRelease(self->boundsByDirective);
+		self->boundsByDirective = NULL;
+	}
+	if(self->staleBoundsDirectives != NULL)
+	{
+		CFRelease(self->staleBoundsDirectives);
+		self->staleBoundsDirectives = NULL;
+	}
+	
+}//end removeBoundsCache
+
+
+#pragma mark -
+#pragma mark PART TABLE
+#pragma mark -
+
+//========== partTable =========================================================
+//
+// Purpose:		Returns the flat copy of our parts, building it if it's been 
+//				thrown out and rereading any rows whose parts have changed.
+//
+// Notes:		Adding or removing anything throws the table out. Each part's 
+//				row goes stale when the part tells us its bounds changed - 
+//				which moving, recoloring, hiding or re-resolving it all do. 
+//				Selection doesn't, so it is not in the table. 
+//
+//				Building is not thread-safe; drawing and reports happen on the 
+//				main thread. 
+//
+//==============================================================================
+- (struct LDrawPartTable *) partTable
+{
+	NSArray     *commandsInStep = [self subdirectives];
+	int         count           = 0;
+	int         row             = 0;
+	
+	if(self->partTable == NULL)
+	{
+		self->partTable         = LDrawPartTableCreate();
+		self->partTableRows     = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+		self->partTableOthers   = [[NSMutableArray alloc] init];
+		
+		for(LDrawDirective *currentDirective in commandsInStep)
+		{
+			if([currentDirective isKindOfClass:[LDrawPart class]])
+				++count;
+		}
+		LDrawPartTableResize(self->partTable, count);
+		
+		for(LDrawDirective *currentDirective in commandsInStep)
+		{
+			if([currentDirective isKindOfClass:[LDrawPart class]])
+			{
+				self->partTable->parts[row] = currentDirective;
+				CFDictionarySetValue(self->partTableRows, currentDirective, (const void *)(intptr_t)row);
+				[self readPartTableRow:row];
+				++row;
+			}
+			else
+				[self->partTableOthers addObject:currentDirective];
+		}
+	}
+	else
+	{
+		for(row = 0; row < self->partTable->count && self->partTable->stale_count > 0; ++row)
+		{
+			if(self->partTable->flags[row] & part_row_stale)
+				[self readPartTableRow:row];
+		}
+	}
+	
+	return self->partTable;
+	
+}//end partTable
+
+
+//========== otherDirectives ===================================================
+//
+// Purpose:		Returns the directives in this step which aren't parts, in 
+//				order.
+//
+//==============================================================================
+- (NSArray *) otherDirectives
+{
+	[self partTable];
+	return self->partTableOthers;
+	
+}//end otherDirectives
+
+
+//========== readPartTableRow: =================================================
+//
+// Purpose:		Copies everything we draw and count from a part into its row.
+//
+//==============================================================================
+- (void) readPartTableRow:(int)row
+{
+	struct LDrawPartTable   *table      = self->partTable;
+	LDrawPart               *part       = table->parts[row];
+	LDrawColor              *color      = [part LDrawColor];
+	Box3                    bounds      = [part boundingBox3];
+	PartTypeT               partType    = [part resolvedPartType];
+	unsigned char           flags       = 0;
+	
+	if(table->flags[row] & part_row_stale)
+		--table->stale_count;
+	
+	if([part isHidden])
+		flags |= part_row_hidden;
+	if(partType == PartTypeLibrary)
+		flags |= part_row_library;
+	else if(partType == PartTypeSubmodel || partType == PartTypePeerFile)
+		flags |= part_row_reference;
+	
+	table->models[row]      = [part resolvedModel];
+	table->colors[row]      = color;
+	table->flags[row]       = flags;
+	
+	Matrix4GetGLMatrix4([part transformationMatrix], table->transforms + row * 16);
+	
+	table->bounds[row * 6 + 0] = bounds.min.x;
+	table->bounds[row * 6 + 1] = bounds.min.y;
+	table->bounds[row * 6 + 2] = bounds.min.z;
+	table->bounds[row * 6 + 3] = bounds.max.x;
+	table->bounds[row * 6 + 4] = bounds.max.y;
+	table->bounds[row * 6 + 5] = bounds.max.z;
+	
+}//end readPartTableRow:
+
+
+//========== removePartTable ===================================================
+//
+// Purpose:		Throws out the part table; the next draw rebuilds it.
+//
+//==============================================================================
+- (void) removePartTable
+{
+	if(self->partTable != NULL)
+	{
+		LDrawPartTableDestroy(self->partTable);
+		self->partTable = NULL;
+	}
+	if(self->partTableRows != NULL)
+	{
+		CFRelease(self->partTableRows);
+		self->partTableRows = NULL;
+	}
+	[self->partTableOthers release];
+	self->partTableOthers = nil;
+	
+}//end removePartTable
+
+
+#pragma mark -
+#pragma mark OBSERVER
+#pragma mark -
+
+//========== statusInvalidated:who: ============================================
+//
+// Purpose:		One of our directives' cached state is no longer valid. If it 
+//				is its bounds, its box in the picking BVH is stale; we refit it 
+//				on the next pick. Likewise its share of our own bounds. 
+//
+//==============================================================================
+- (void) statusInvalidated:(CacheFlagsT) flags who:(id<LDrawObservable>) observable
+{
+	const void *directiveID = NULL;
+	
+	if((flags & CacheFlagBounds) && self->boundsByDirective != NULL)
+		CFSetAddValue(self->staleBoundsDirectives, observable);
+	
+	if(		(flags & CacheFlagBounds)
+	   &&	self->partTable != NULL
+	   &&	CFDictionaryGetValueIfPresent(self->partTableRows, observable, &directiveID) )
+	{
+		LDrawPartTableMarkStale(self->partTable, (int)(intptr_t)directiveID);
+	}
+	
+	if(		(flags & CacheFlagBounds)
+	   &&	self->pickingBVH != NULL
+	   &&	CFDictionaryGetValueIfPresent(self->pickingIDs, observable, &directiveID) )
+	{
+		[self->pickingStaleIDs addIndex:(NSUInteger)directiveID];
+	}
+	[super statusInvalidated:flags who:observable];
+	
+}//end statusInvalidated:who:
+
+
 #pragma mark -
 #pragma mark UTILITIES
 #pragma mark -
@@ -1145,8 +1688,121 @@
 //==============================================================================
 - (void) dealloc
 {
+	[self removePickingBVH];
+	[self removeBoundsCache];
+	[self removePartTable];
+	
 	[super dealloc];
 	
 }//end dealloc
 
 @end
+
+
+//========== DepthTestDirective ================================================
+//
+// Purpose:		Instance BVH callback: runs the depth test of a directive whose 
+//				bounds might be under the point.
+//
+//==============================================================================
+void DepthTestDirective(int directiveID, void *ref)
+{
+	struct DepthTestContext *context = ref;
+	
+	[context->directives[directiveID] depthTest:context->pt
+										  inBox:context->bounds
+									  transform:context->transform
+								   creditObject:context->creditObject
+									 bestObject:context->bestObject
+									  bestDepth:context->bestDepth];
+}
+
+
+//========== BoxIsOnBoundary ===================================================
+//
+// Purpose:		Returns whether box (which is inside bounds) touches any side of 
+//				bounds - i.e., whether bounds could shrink without it. 
+//
+//==============================================================================
+static BOOL BoxIsOnBoundary(Box3 box, Box3 bounds)
+{
+	// An empty box never added anything.
+	if(box.min.x > box.max.x)
+		return NO;
+	
+	return		box.min.x <= bounds.min.x || box.max.x >= bounds.max.x
+			||	box.min.y <= bounds.min.y || box.max.y >= bounds.max.y
+			||	box.min.z <= bounds.min.z || box.max.z >= bounds.max.z;
+	
+}//end BoxIsOnBoundary
+
+
+//========== BoxContainsBox ====================================================
+//
+// Purpose:		Returns whether outer contains all of inner.
+//
+//==============================================================================
+static BOOL BoxContainsBox(Box3 outer, Box3 inner)
+{
+	if(inner.min.x > inner.max.x)
+		return YES;
+	
+	return		outer.min.x <= inner.min.x && outer.max.x >= inner.max.x
+			&&	outer.min.y <= inner.min.y && outer.max.y >= inner.max.y
+			&&	outer.min.z <= inner.min.z && outer.max.z >= inner.max.z;
+	
+}//end BoxContainsBox
+
+
+//========== DrawPartTableRow ==================================================
+//
+// Purpose:		Draws the part in the given row of a step's part table. Parts 
+//				whose box is off screen are skipped before we push anything 
+//				for them.
+//
+//==============================================================================
+static void DrawPartTableRow(struct LDrawPartTable *table, int row, id<LDrawRenderer> renderer)
+{
+	GLfloat         *bounds     = table->bounds + row * 6;
+	LDrawModel      *model      = table->models[row];
+	LDrawColor      *color      = nil;
+	LDrawColorT     colorCode   = LDrawCurrentColor;
+	GLfloat         rgba[4];
+	BOOL            selected    = NO;
+	
+	if(model == nil || (table->flags[row] & part_row_hidden))
+		return;
+	
+	if([renderer checkCull:bounds to:bounds + 3] == cull_skip)
+		return;
+	
+	selected = [(LDrawPart *)table->parts[row] isSelected];
+	
+	// Colors are looked up now, not when the row was read - a color 
+	// definition may have been edited since. 
+	color       = table->colors[row];
+	colorCode   = [color colorCode];
+	
+	if(colorCode == LDrawEdgeColor)
+		[renderer pushColor:LDrawRenderComplimentColor];
+	else if(colorCode != LDrawCurrentColor)
+	{
+		[color getColorRGBA:rgba];
+		[renderer pushColor:rgba];
+	}
+	if(selected)
+		[renderer pushWireFrame];
+	
+	[renderer pushMatrix:table->transforms + row * 16];
+	if(table->flags[row] & part_row_reference)
+		[model drawFlattened:renderer];
+	else
+		[model drawSelf:renderer];
+	[renderer popMatrix];
+	
+	if(colorCode != LDrawCurrentColor)
+		[renderer popColor];
+	if(selected)
+		[renderer popWireFrame];
+	
+}//end DrawPartTableRow
@@ -0,0 +1,65 @@
+//
+//  LDrawDLArena.h
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/*
+
+	LDrawDLArena - THEORY OF OPERATION
+
+	An arena is one large vertex VBO plus one large index VBO that many display
+	lists share.  Instead of every DL owning two tiny VBOs, each DL owns a range
+	of an arena.  This matters for drawing: consecutive DLs in the same arena
+	can be drawn without rebinding buffers or re-pointing vertex attributes,
+	which is what lets the session batch draws (see LDrawDLCommandList.h).
+
+	Each arena keeps a free list of vertex ranges and one of index ranges,
+	sorted by offset.  A released range goes back on the lists and is merged
+	with any free neighbors, so space freed by one DL is reused by the next -
+	a single long-lived DL does not pin the rest of its arena.  New ranges are
+	taken first-fit, trying the arena being filled before the others; only
+	when no arena has room do we make a new one.
+
+	A mesh too big to fit an empty arena gets an arena of its own, sized to
+	fit; that arena is deleted when its mesh goes away.
+
+	Indices in an arena are absolute - the mesh writer is given the range's
+	first vertex as its index base - so ranges never need a base vertex.
+
+	Arenas are referred to by a small integer ID (stable for the life of the
+	arena) so that the GL-free command list can name them.  All arena calls
+	must be made on the thread that owns the GL context.
+
+ */
+
+// A range of an arena owned by one DL.
+struct LDrawDLArenaRange {
+	int			arena;			// Arena ID.
+	GLuint		vert_off;		// First vertex in the arena's vertex VBO.
+	GLuint		vert_count;
+	GLuint		idx_off;		// First index in the arena's index VBO.
+	GLuint		idx_count;
+};
+
+// Allocate a range big enough for the given mesh.
+void		LDrawDLArenaAllocate(int vert_count, int idx_count, struct LDrawDLArenaRange * out_range);
+
+// Copy mesh data into a range.  verts is 10 floats per vertex (XYZ, normal, RGBA),
+// the same layout the display list uses.
+void		LDrawDLArenaUpload(const struct LDrawDLArenaRange * range, const GLfloat * verts, const GLuint * indices);
+
+// Give a range back.
+void		LDrawDLArenaRelease(const struct LDrawDLArenaRange * range);
+
+// Look up an arena's VBOs by ID.
+void		LDrawDLArenaGetBuffers(int arena, GLuint * out_geo_vbo, GLuint * out_idx_vbo);
+
+// Number of arena IDs handed out so far, and the end of the last index in
+// use in each (for command list validation).
+int			LDrawDLArenaGetCount(void);
+GLuint		LDrawDLArenaGetIndexLimit(int arena);
@@ -0,0 +1,395 @@
+//
+//  LDrawDLArena.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "LDrawDLArena.h"
+#import OPEN_GL_HEADER
+
+#define VERT_STRIDE			10					// Must match the display list's vertex format: XYZ, normal, RGBA.
+#define ARENA_VERT_COUNT	(1024 * 128)		// Standard arena: 128K vertices...
+#define ARENA_IDX_COUNT		(1024 * 512)		// ...and 512K indices.  At 10 floats per vertex that's 5 MB + 2 MB of VRAM.
+
+// A run of free vertices or indices in an arena.
+struct LDrawDLFreeRange {
+	GLuint		off;
+	GLuint		count;
+};
+
+// Free ranges sorted by offset.  Neighbors are always merged, so no two
+// ranges touch.
+struct LDrawDLFreeList {
+	struct LDrawDLFreeRange *	ranges;
+	int							count;
+	int							capacity;
+};
+
+struct LDrawDLArena {
+	GLuint					geo_vbo;			// Zero means this arena slot is free.
+	GLuint					idx_vbo;
+	int						vert_capacity;
+	int						idx_capacity;
+	struct LDrawDLFreeList	free_verts;
+	struct LDrawDLFreeList	free_idx;
+	int						live_count;			// Number of ranges handed out and not yet released.
+	int						dedicated;			// Sized for one over-sized mesh; deleted when it is released.
+};
+
+static struct LDrawDLArena *	arenas = NULL;
+static int						arena_count = 0;		// Slots in use or free - IDs are indices into this array.
+static int						arena_capacity = 0;
+static int						arena_cur = -1;			// Standard arena allocated from last, or -1.
+
+
+//========== free_list_reset =====================================================
+//
+// Purpose:	Make the whole of an arena's buffer one free range.
+//
+//================================================================================
+static void free_list_reset(struct LDrawDLFreeList * list, GLuint capacity)
+{
+	if(list->capacity == 0)
+	{
+		list->capacity = 16;
+		list->ranges = (struct LDrawDLFreeRange *) malloc(sizeof(struct LDrawDLFreeRange) * list->capacity);
+	}
+	list->ranges[0].off = 0;
+	list->ranges[0].count = capacity;
+	list->count = 1;
+
+}//end free_list_reset
+
+
+//========== free_list_destroy ===================================================
+//
+// Purpose:	Free the storage behind a free list.
+//
+//================================================================================
+static void free_list_destroy(struct LDrawDLFreeList * list)
+{
+	free(list->ranges);
+	list->ranges = NULL;
+	list->count = 0;
+	list->capacity = 0;
+
+}//end free_list_destroy
+
+
+//========== free_list_take ======================================================
+//
+// Purpose:	Take count items from the first free range big enough to hold
+//			them.  Returns 0 if no range is big enough.
+//
+//================================================================================
+static int free_list_take(struct LDrawDLFreeList * list, GLuint count, GLuint * out_off)
+{
+	int i;
+
+	if(count == 0)
+	{
+		*out_off = 0;
+		return 1;
+	}
+
+	for(i = 0; i < list->count; ++i)
+	{
+		struct LDrawDLFreeRange * r = list->ranges + i;
+		if(r->count >= count)
+		{
+			*out_off = r->off;
+			r->off += count;
+			r->count -= count;
+			if(r->count == 0)
+			{
+				memmove(r, r + 1, sizeof(struct LDrawDLFreeRange) * (list->count - i - 1));
+				--list->count;
+			}
+			return 1;
+		}
+	}
+	return 0;
+
+}//end free_list_take
+
+
+//========== free_list_give ======================================================
+//
+// Purpose:	Put a range back on the free list, merging it with the free
+//			ranges on either side if it touches them.
+//
+//================================================================================
+static void free_list_give(struct LDrawDLFreeList * list, GLuint off, GLuint count)
+{
+	int lo = 0;
+	int hi = list->count;
+	int merge_prev, merge_next;
+
+	if(count == 0)
+		return;
+
+	// Find the first free range after this one.
+	while(lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(list->ranges[mid].off < off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	merge_prev = lo > 0 && list->ranges[lo - 1].off + list->ranges[lo - 1].count == off;
+	merge_next = lo < list->count && off + count == list->ranges[lo].off;
+
+	if(merge_prev && merge_next)
+	{
+		list->ranges[lo - 1].count += count + list->ranges[lo].count;
+		memmove(list->ranges + lo, list->ranges + lo + 1, sizeof(struct LDrawDLFreeRange) * (list->count - lo - 1));
+		--list->count;
+	}
+	else if(merge_prev)
+	{
+		list->ranges[lo - 1].count += count;
+	}
+	else if(merge_next)
+	{
+		list->ranges[lo].off = off;
+		list->ranges[lo].count += count;
+	}
+	else
+	{
+		if(list->count == list->capacity)
+		{
+			list->capacity *= 2;
+			list->ranges = (struct LDrawDLFreeRange *) realloc(list->ranges, sizeof(struct LDrawDLFreeRange) * list->capacity);
+		}
+		memmove(list->ranges + lo + 1, list->ranges + lo, sizeof(struct LDrawDLFreeRange) * (list->count - lo));
+		list->ranges[lo].off = off;
+		list->ranges[lo].count = count;
+		++list->count;
+	}
+
+}//end free_list_give
+
+
+//========== create_arena ========================================================
+//
+// Purpose:	Build the VBOs for a new arena and return its ID.  Free slots are
+//			reused so the arena table does not grow without bound.
+//
+//================================================================================
+static int create_arena(int vert_capacity, int idx_capacity, int dedicated)
+{
+	int id;
+	for(id = 0; id < arena_count; ++id)
+		if(arenas[id].geo_vbo == 0)
+			break;
+
+	if(id == arena_count)
+	{
+		if(arena_count == arena_capacity)
+		{
+			arena_capacity = arena_capacity ? arena_capacity * 2 : 16;
+			arenas = (struct LDrawDLArena *) realloc(arenas, sizeof(struct LDrawDLArena) * arena_capacity);
+		}
+		memset(arenas + arena_count, 0, sizeof(struct LDrawDLArena));
+		++arena_count;
+	}
+
+	struct LDrawDLArena * a = arenas + id;
+	a->vert_capacity	= vert_capacity;
+	a->idx_capacity		= idx_capacity;
+	a->live_count		= 0;
+	a->dedicated		= dedicated;
+	free_list_reset(&a->free_verts, vert_capacity);
+	free_list_reset(&a->free_idx, idx_capacity);
+
+	glGenBuffers(1, &a->geo_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, a->geo_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vert_capacity * sizeof(GLfloat) * VERT_STRIDE, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &a->idx_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, a->idx_vbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_capacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return id;
+
+}//end create_arena
+
+
+//========== arena_take ==========================================================
+//
+// Purpose:	Take room for a mesh from one arena, filling in the range.  Returns
+//			0 (taking nothing) if the arena can't fit both the vertices and
+//			the indices.
+//
+//================================================================================
+static int arena_take(int id, int vert_count, int idx_count, struct LDrawDLArenaRange * out_range)
+{
+	struct LDrawDLArena * a = arenas + id;
+	GLuint vert_off, idx_off;
+
+	if(!free_list_take(&a->free_verts, vert_count, &vert_off))
+		return 0;
+	if(!free_list_take(&a->free_idx, idx_count, &idx_off))
+	{
+		free_list_give(&a->free_verts, vert_off, vert_count);
+		return 0;
+	}
+
+	out_range->arena		= id;
+	out_range->vert_off		= vert_off;
+	out_range->vert_count	= vert_count;
+	out_range->idx_off		= idx_off;
+	out_range->idx_count	= idx_count;
+	++a->live_count;
+	return 1;
+
+}//end arena_take
+
+
+//========== LDrawDLArenaAllocate ================================================
+//
+// Purpose:	Find room for a mesh of the given size.
+//
+// Notes:	We try the arena we allocated from last, then every other standard
+//			arena, and only then make a new one.
+//
+//================================================================================
+void LDrawDLArenaAllocate(int vert_count, int idx_count, struct LDrawDLArenaRange * out_range)
+{
+	int i;
+
+	if(vert_count > ARENA_VERT_COUNT || idx_count > ARENA_IDX_COUNT)
+	{
+		arena_take(create_arena(vert_count, idx_count, 1), vert_count, idx_count, out_range);
+		return;
+	}
+
+	if(arena_cur != -1 && arena_take(arena_cur, vert_count, idx_count, out_range))
+		return;
+
+	for(i = 0; i < arena_count; ++i)
+	{
+		if(i != arena_cur && arenas[i].geo_vbo != 0 && !arenas[i].dedicated &&
+		   arena_take(i, vert_count, idx_count, out_range))
+		{
+			arena_cur = i;
+			return;
+		}
+	}
+
+	arena_cur = create_arena(ARENA_VERT_COUNT, ARENA_IDX_COUNT, 0);
+	arena_take(arena_cur, vert_count, idx_count, out_range);
+
+}//end LDrawDLArenaAllocate
+
+
+//========== LDrawDLArenaUpload ==================================================
+//
+// Purpose:	Copy a finished mesh into its range.
+//
+// Notes:	We use glBufferSubData rather than mapping: mapping a 5 MB buffer
+//			to write a few KB into it can stall on whatever is drawing from
+//			the rest of the arena.
+//
+//================================================================================
+void LDrawDLArenaUpload(const struct LDrawDLArenaRange * range, const GLfloat * verts, const GLuint * indices)
+{
+	struct LDrawDLArena * a = arenas + range->arena;
+
+	glBindBuffer(GL_ARRAY_BUFFER, a->geo_vbo);
+	glBufferSubData(GL_ARRAY_BUFFER,
+					range->vert_off * VERT_STRIDE * sizeof(GLfloat),
+					range->vert_count * VERT_STRIDE * sizeof(GLfloat),
+					verts);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, a->idx_vbo);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+					range->idx_off * sizeof(GLuint),
+					range->idx_count * sizeof(GLuint),
+					indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+}//end LDrawDLArenaUpload
+
+
+//========== LDrawDLArenaRelease =================================================
+//
+// Purpose:	Give a range back to its arena's free lists, where the next mesh
+//			that fits can reuse it.  An arena made for one big mesh is deleted
+//			instead.
+//
+//================================================================================
+void LDrawDLArenaRelease(const struct LDrawDLArenaRange * range)
+{
+	struct LDrawDLArena * a = arenas + range->arena;
+
+	assert(a->live_count > 0);
+	--a->live_count;
+
+	if(a->dedicated)
+	{
+		glDeleteBuffers(1, &a->geo_vbo);
+		glDeleteBuffers(1, &a->idx_vbo);
+		a->geo_vbo = 0;
+		a->idx_vbo = 0;
+		free_list_destroy(&a->free_verts);
+		free_list_destroy(&a->free_idx);
+	}
+	else
+	{
+		free_list_give(&a->free_verts, range->vert_off, range->vert_count);
+		free_list_give(&a->free_idx, range->idx_off, range->idx_count);
+	}
+
+}//end LDrawDLArenaRelease
+
+
+//========== LDrawDLArenaGetBuffers ==============================================
+//
+// Purpose:	Return the VBOs behind an arena ID.
+//
+//================================================================================
+void LDrawDLArenaGetBuffers(int arena, GLuint * out_geo_vbo, GLuint * out_idx_vbo)
+{
+	*out_geo_vbo = arenas[arena].geo_vbo;
+	*out_idx_vbo = arenas[arena].idx_vbo;
+
+}//end LDrawDLArenaGetBuffers
+
+
+//========== LDrawDLArenaGetCount ================================================
+//
+// Purpose:	Return the number of arena IDs - valid IDs are 0..count-1.
+//
+//================================================================================
+int LDrawDLArenaGetCount(void)
+{
+	return arena_count;
+
+}//end LDrawDLArenaGetCount
+
+
+//========== LDrawDLArenaGetIndexLimit ===========================================
+//
+// Purpose:	Return the end of the last index range in use in an arena.  Nothing
+//			past this holds real data.
+//
+//================================================================================
+GLuint LDrawDLArenaGetIndexLimit(int arena)
+{
+	const struct LDrawDLArena *		a		= arenas + arena;
+	const struct LDrawDLFreeList *	list	= &a->free_idx;
+
+	// Free ranges never touch, so only the last one can run to the end.
+	if(list->count > 0 && list->ranges[list->count - 1].off + list->ranges[list->count - 1].count == (GLuint) a->idx_capacity)
+		return list->ranges[list->count - 1].off;
+	return a->idx_capacity;
+
+}//end LDrawDLArenaGetIndexLimit
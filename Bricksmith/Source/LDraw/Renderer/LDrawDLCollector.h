@@ -0,0 +1,42 @@
+//
+//  LDrawDLCollector.h
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#import "LDrawRenderer.h"
+
+/*
+
+	LDrawDLCollector - an implementation of the LDrawCollector API that builds one display list.
+
+	Each collector owns its own DL builder and its own texture stack, so it shares no state with
+	the renderer that handed it out or with any other collector.  That means any number of
+	collectors can be filled at once, and a collector can be filled and finished on any thread -
+	building a DL makes no GL calls (see the THREADING notes in LDrawDisplayList.h).
+
+	A collector is used once: fill it via collectSelf:, then call finish to get the DL.
+
+*/
+
+#define COLLECTOR_TEXTURE_STACK_DEPTH 128
+
+struct	LDrawDLBuilder;
+
+@interface LDrawDLCollector : NSObject<LDrawCollector> {
+
+	struct LDrawDLBuilder *			builder;										// The DL we are building - NULL once finished.
+
+	struct LDrawTextureSpec			tex_stack[COLLECTOR_TEXTURE_STACK_DEPTH];		// Texture stack from push/pop texture.
+	int								texture_stack_top;
+	struct LDrawTextureSpec			tex_now;
+
+}
+
+- (void) finish:(LDrawDLHandle *) outHandle cleanupFunc:(LDrawDLCleanup_f *)func;
+
+@end
@@ -0,0 +1,209 @@
+//
+//  LDrawDLCollector.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "LDrawDLCollector.h"
+#import "LDrawDisplayList.h"
+
+
+//========== set_color4fv ========================================================
+//
+// Purpose:	Copies an RGBA color, but handles the special ptrs 0L and -1L by
+//			converting them into the 'magic' colors 0,0,0,0 and 1,1,1,0 that
+//			the shader wants.
+//
+// Notes:	The shader, when it sees alpha = 0, mixes between the attribute-set
+//			current and compliment by blending with the red channel: red = 0 is
+//			current, red = 1 is compliment.
+//
+//================================================================================
+static void set_color4fv(GLfloat * c, GLfloat storage[4])
+{
+	if(c == LDrawRenderCurrentColor)
+	{
+		storage[0] = 0;
+		storage[1] = 0;
+		storage[2] = 0;
+		storage[3] = 0;
+	}
+	else if(c == LDrawRenderComplimentColor)
+	{
+		storage[0] = 1;
+		storage[1] = 1;
+		storage[2] = 1;
+		storage[3] = 0;
+	}
+	else
+	{
+		memcpy(storage,c,sizeof(GLfloat)*4);
+	}
+}//end set_color4fv
+
+
+
+//================================================================================
+@implementation LDrawDLCollector
+//================================================================================
+
+
+//========== init ================================================================
+//
+// Purpose: start a new, empty, untextured display list.
+//
+//================================================================================
+- (id) init
+{
+	self = [super init];
+
+	builder = LDrawDLBuilderCreate();
+	texture_stack_top = 0;
+	memset(&tex_now,0,sizeof(tex_now));
+
+	return self;
+
+}//end init
+
+
+//========== dealloc =============================================================
+//
+// Purpose: throw out a collector.
+//
+// Notes:	A collector that was never finished still has its builder; finishing
+//			it is the only way to release a builder, so we do that and toss the
+//			result.
+//
+//================================================================================
+- (void) dealloc
+{
+	if(builder)
+	{
+		struct LDrawDL * dl = LDrawDLBuilderFinish(builder);
+		if(dl)
+			LDrawDLDestroy(dl);
+	}
+
+	[super dealloc];
+
+}//end dealloc
+
+
+#pragma mark -
+#pragma mark COLLECTOR
+#pragma mark -
+
+//========== pushTexture: ========================================================
+//
+// Purpose: change the current texture to a new one, specified by a spec with
+//			textures and projection.
+//
+//================================================================================
+- (void) pushTexture:(struct LDrawTextureSpec *) spec;
+{
+	assert(texture_stack_top < COLLECTOR_TEXTURE_STACK_DEPTH);
+	memcpy(tex_stack+texture_stack_top,&tex_now,sizeof(tex_now));
+	++texture_stack_top;
+	memcpy(&tex_now,spec,sizeof(tex_now));
+
+	LDrawDLBuilderSetTex(builder,&tex_now);
+
+}//end pushTexture:
+
+
+//========== popTexture: =========================================================
+//
+// Purpose: pop a texture off the stack that was previously pushed.  When the
+//			last texture is popped, we go back to being untextured.
+//
+//================================================================================
+- (void) popTexture
+{
+	assert(texture_stack_top > 0);
+	--texture_stack_top;
+	memcpy(&tex_now,tex_stack+texture_stack_top,sizeof(tex_now));
+
+	LDrawDLBuilderSetTex(builder,&tex_now);
+
+}//end popTexture:
+
+
+//========== drawQuad:normal:color: ==============================================
+//
+// Purpose: Adds one quad to the display list.
+//
+//================================================================================
+- (void) drawQuad:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
+{
+	assert(builder);
+	GLfloat c[4];
+
+	set_color4fv(color,c);
+
+	LDrawDLBuilderAddQuad(builder,vertices,normal,c);
+
+}//end drawQuad:normal:color:
+
+
+//========== drawTri:normal:color: ===============================================
+//
+// Purpose: Adds one triangle to the display list.
+//
+//================================================================================
+- (void) drawTri:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
+{
+	assert(builder);
+	GLfloat c[4];
+
+	set_color4fv(color,c);
+
+	LDrawDLBuilderAddTri(builder,vertices,normal,c);
+
+}//end drawTri:normal:color:
+
+
+//========== drawLine:normal:color: ==============================================
+//
+// Purpose: Adds one line to the display list.
+//
+//================================================================================
+- (void) drawLine:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
+{
+	assert(builder);
+	GLfloat c[4];
+
+	set_color4fv(color,c);
+
+	LDrawDLBuilderAddLine(builder,vertices,normal,c);
+
+}//end drawLine:normal:color:
+
+
+#pragma mark -
+#pragma mark FINISHING
+#pragma mark -
+
+//========== finish:cleanupFunc: =================================================
+//
+// Purpose: close off the DL, returning the display list if there is one.
+//
+// Notes:	This does the expensive part of DL building (smoothing and
+//			indexing) but no GL work, so it is safe on a worker thread.
+//
+//================================================================================
+- (void) finish:(LDrawDLHandle *) outHandle cleanupFunc:(LDrawDLCleanup_f *)func
+{
+	assert(builder);
+	assert(texture_stack_top == 0);
+
+	struct LDrawDL * dl = LDrawDLBuilderFinish(builder);
+	builder = NULL;
+
+	*outHandle = (LDrawDLHandle)dl;
+	*func =  (LDrawDLCleanup_f) LDrawDLDestroy;
+
+}//end finish:cleanupFunc:
+
+@end
@@ -0,0 +1,316 @@
+/*
+ *  LDrawDLCommandList.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawDLCommandList.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define INITIAL_CAPACITY 256
+
+// While a list is open we keep the arena and primitive type next to each
+// command, plus its sequence number so that the sort is stable.  Once the
+// list is finished the keys move to the batches and the command table is
+// a flat array of GL-layout commands.
+struct LDrawDLCommandKey {
+	int							arena;
+	int							prim;
+	int							seq;
+	struct LDrawDLDrawCommand	cmd;
+};
+
+struct LDrawDLCommandList {
+	struct LDrawDLCommandKey *	keys;
+	int							key_count;
+	int							key_capacity;
+
+	struct LDrawDLDrawCommand *	commands;
+	int							command_count;
+
+	struct LDrawDLBatch *		batches;
+	int							batch_count;
+
+	int							finished;
+	int							group_by_prim;
+};
+
+
+//========== LDrawDLCommandListCreate ============================================
+//
+// Purpose:	Create a new, empty command list.
+//
+//================================================================================
+struct LDrawDLCommandList * LDrawDLCommandListCreate(void)
+{
+	struct LDrawDLCommandList * list = (struct LDrawDLCommandList *) malloc(sizeof(struct LDrawDLCommandList));
+	memset(list, 0, sizeof(struct LDrawDLCommandList));
+
+	list->key_capacity = INITIAL_CAPACITY;
+	list->keys = (struct LDrawDLCommandKey *) malloc(sizeof(struct LDrawDLCommandKey) * list->key_capacity);
+
+	return list;
+
+}//end LDrawDLCommandListCreate
+
+
+//========== LDrawDLCommandListDestroy ===========================================
+//
+// Purpose:	Free a command list and everything it built.
+//
+//================================================================================
+void LDrawDLCommandListDestroy(struct LDrawDLCommandList * list)
+{
+	free(list->keys);
+	free(list->commands);
+	free(list->batches);
+	free(list);
+
+}//end LDrawDLCommandListDestroy
+
+
+//========== LDrawDLCommandListAdd ===============================================
+//
+// Purpose:	Queue one draw command.
+//
+// Notes:	Empty draws are dropped here so that the rest of the pipeline never
+//			has to think about them.
+//
+//================================================================================
+void LDrawDLCommandListAdd(
+					struct LDrawDLCommandList *	list,
+					int							arena,
+					int							prim,
+					unsigned int				first_index,
+					unsigned int				index_count,
+					unsigned int				base_instance,
+					unsigned int				instance_count)
+{
+	assert(!list->finished);
+
+	if(index_count == 0 || instance_count == 0)
+		return;
+
+	if(list->key_count == list->key_capacity)
+	{
+		list->key_capacity *= 2;
+		list->keys = (struct LDrawDLCommandKey *) realloc(list->keys, sizeof(struct LDrawDLCommandKey) * list->key_capacity);
+	}
+
+	struct LDrawDLCommandKey * k = list->keys + list->key_count;
+
+	k->arena				= arena;
+	k->prim					= prim;
+	k->seq					= list->key_count;
+	k->cmd.index_count		= index_count;
+	k->cmd.instance_count	= instance_count;
+	k->cmd.first_index		= first_index;
+	k->cmd.base_vertex		= 0;
+	k->cmd.base_instance	= base_instance;
+
+	++list->key_count;
+
+}//end LDrawDLCommandListAdd
+
+
+//========== compare_by_prim =====================================================
+//
+// Purpose:	Sort order for multi-draw: arena, primitive, then instance range.
+//
+//================================================================================
+static int compare_by_prim(const void * lhs, const void * rhs)
+{
+	const struct LDrawDLCommandKey * a = (const struct LDrawDLCommandKey *) lhs;
+	const struct LDrawDLCommandKey * b = (const struct LDrawDLCommandKey *) rhs;
+
+	if(a->arena != b->arena)								return a->arena < b->arena ? -1 : 1;
+	if(a->prim != b->prim)									return a->prim < b->prim ? -1 : 1;
+	if(a->cmd.base_instance != b->cmd.base_instance)		return a->cmd.base_instance < b->cmd.base_instance ? -1 : 1;
+	if(a->seq != b->seq)									return a->seq < b->seq ? -1 : 1;
+	return 0;
+
+}//end compare_by_prim
+
+
+//========== compare_by_instance =================================================
+//
+// Purpose:	Sort order for one-at-a-time drawing: arena, instance range, then
+//			primitive, so that each segment's draws stay together.
+//
+//================================================================================
+static int compare_by_instance(const void * lhs, const void * rhs)
+{
+	const struct LDrawDLCommandKey * a = (const struct LDrawDLCommandKey *) lhs;
+	const struct LDrawDLCommandKey * b = (const struct LDrawDLCommandKey *) rhs;
+
+	if(a->arena != b->arena)								return a->arena < b->arena ? -1 : 1;
+	if(a->cmd.base_instance != b->cmd.base_instance)		return a->cmd.base_instance < b->cmd.base_instance ? -1 : 1;
+	if(a->prim != b->prim)									return a->prim < b->prim ? -1 : 1;
+	if(a->seq != b->seq)									return a->seq < b->seq ? -1 : 1;
+	return 0;
+
+}//end compare_by_instance
+
+
+//========== LDrawDLCommandListFinish ============================================
+//
+// Purpose:	Bake the queued commands down into a sorted command table and a
+//			set of batches.
+//
+// Notes:	Two adjacent commands that draw the same instances with the same
+//			primitive from back-to-back index ranges are merged into one
+//			command - this happens when a segment's geometry was written as
+//			several index runs.
+//
+//================================================================================
+void LDrawDLCommandListFinish(struct LDrawDLCommandList * list, int group_by_prim)
+{
+	assert(!list->finished);
+
+	int i;
+
+	list->finished = 1;
+	list->group_by_prim = group_by_prim;
+
+	qsort(list->keys, list->key_count, sizeof(struct LDrawDLCommandKey), group_by_prim ? compare_by_prim : compare_by_instance);
+
+	// Worst case is one command and one batch per key.
+	list->commands = (struct LDrawDLDrawCommand *) malloc(sizeof(struct LDrawDLDrawCommand) * (list->key_count ? list->key_count : 1));
+	list->batches = (struct LDrawDLBatch *) malloc(sizeof(struct LDrawDLBatch) * (list->key_count ? list->key_count : 1));
+	list->command_count = 0;
+	list->batch_count = 0;
+
+	struct LDrawDLBatch *		cur_batch = NULL;
+	struct LDrawDLDrawCommand *	last_cmd = NULL;
+
+	for(i = 0; i < list->key_count; ++i)
+	{
+		struct LDrawDLCommandKey * k = list->keys + i;
+
+		if(cur_batch == NULL || cur_batch->arena != k->arena || cur_batch->prim != k->prim)
+		{
+			cur_batch = list->batches + list->batch_count++;
+			cur_batch->arena = k->arena;
+			cur_batch->prim = k->prim;
+			cur_batch->first_command = list->command_count;
+			cur_batch->command_count = 0;
+			last_cmd = NULL;
+		}
+
+		if(last_cmd &&
+		   last_cmd->base_instance == k->cmd.base_instance &&
+		   last_cmd->instance_count == k->cmd.instance_count &&
+		   last_cmd->first_index + last_cmd->index_count == k->cmd.first_index)
+		{
+			last_cmd->index_count += k->cmd.index_count;
+		}
+		else
+		{
+			last_cmd = list->commands + list->command_count++;
+			*last_cmd = k->cmd;
+			++cur_batch->command_count;
+		}
+	}
+
+}//end LDrawDLCommandListFinish
+
+
+//========== LDrawDLCommandListGetCommands =======================================
+//
+// Purpose:	Return the finished command table.
+//
+//================================================================================
+int LDrawDLCommandListGetCommands(struct LDrawDLCommandList * list, const struct LDrawDLDrawCommand ** out_commands)
+{
+	assert(list->finished);
+	*out_commands = list->commands;
+	return list->command_count;
+
+}//end LDrawDLCommandListGetCommands
+
+
+//========== LDrawDLCommandListGetBatches ========================================
+//
+// Purpose:	Return the finished batches.
+//
+//================================================================================
+int LDrawDLCommandListGetBatches(struct LDrawDLCommandList * list, const struct LDrawDLBatch ** out_batches)
+{
+	assert(list->finished);
+	*out_batches = list->batches;
+	return list->batch_count;
+
+}//end LDrawDLCommandListGetBatches
+
+
+//========== LDrawDLCommandListValidate ==========================================
+//
+// Purpose:	Check every invariant the GL submission code relies on.
+//
+// Notes:	- Every command draws something, with a legal primitive, from a
+//			  legal arena, inside that arena's index buffer.
+//			- The batches tile the command table in order with no gaps or
+//			  overlap.
+//			- Batches are maximal: no two adjacent batches share a key, and
+//			  when grouping by primitive no key appears twice at all (the
+//			  batches are strictly sorted).
+//
+//================================================================================
+int LDrawDLCommandListValidate(
+					struct LDrawDLCommandList *	list,
+					const unsigned int *		arena_index_limits,
+					int							arena_count)
+{
+	int b, c;
+	int next_command = 0;
+
+	if(!list->finished)
+		return dl_cmd_err_not_finished;
+
+	for(b = 0; b < list->batch_count; ++b)
+	{
+		const struct LDrawDLBatch * batch = list->batches + b;
+
+		if(batch->prim < 0 || batch->prim >= dl_prim_count)
+			return dl_cmd_err_bad_prim;
+		if(batch->arena < 0 || (arena_index_limits && batch->arena >= arena_count))
+			return dl_cmd_err_bad_arena;
+		if(batch->first_command != next_command || batch->command_count <= 0)
+			return dl_cmd_err_batch_coverage;
+
+		if(b > 0)
+		{
+			const struct LDrawDLBatch * prev = batch - 1;
+			if(prev->arena == batch->arena && prev->prim == batch->prim)
+				return dl_cmd_err_batch_split;
+			if(list->group_by_prim &&
+			   (prev->arena > batch->arena || (prev->arena == batch->arena && prev->prim > batch->prim)))
+				return dl_cmd_err_batch_split;
+		}
+
+		for(c = batch->first_command; c < batch->first_command + batch->command_count; ++c)
+		{
+			const struct LDrawDLDrawCommand * cmd = list->commands + c;
+
+			if(cmd->index_count == 0 || cmd->instance_count == 0)
+				return dl_cmd_err_empty_draw;
+			if(arena_index_limits &&
+			   (cmd->first_index > arena_index_limits[batch->arena] ||
+				cmd->index_count > arena_index_limits[batch->arena] - cmd->first_index))
+				return dl_cmd_err_index_range;
+		}
+
+		next_command += batch->command_count;
+	}
+
+	if(next_command != list->command_count)
+		return dl_cmd_err_batch_coverage;
+
+	return dl_cmd_ok;
+
+}//end LDrawDLCommandListValidate
@@ -0,0 +1,118 @@
+/*
+ *  LDrawDLCommandList.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawDLCommandList_H
+#define LDrawDLCommandList_H
+
+//==============================================================================
+//
+// File: LDrawDLCommandList
+//
+// The command list is the CPU half of batched ("multi-draw-indirect style")
+// drawing for the display list session.  It contains no GL calls at all, so
+// the command stream it generates can be built and checked without a GPU.
+//
+// Usage:
+//
+// When the display list code draws with batching, every DL's geometry lives
+// in a sub-range of a shared vertex/index "arena" (see LDrawDLArena.h).  For
+// each instanced segment, the session adds one command per primitive type
+// (lines, tris, quads), naming the arena, the index range within the arena
+// and the instance range within the instance buffer.
+//
+// When all commands are in, LDrawDLCommandListFinish sorts them so that
+// commands sharing an arena and primitive type are adjacent, merges commands
+// that can be drawn as one, and cuts the result into "batches".  A batch is a
+// run of commands that share one arena and one primitive type - that is, a
+// run that the GL can draw with one multi-draw call, or that a GL without
+// multi-draw can at least draw without rebinding any vertex state.
+//
+// The command records are laid out exactly like the GL's
+// DrawElementsIndirectCommand, so the table can be uploaded as-is to an
+// indirect draw buffer.
+//
+// LDrawDLCommandListValidate checks the invariants of a finished list; it
+// is cheap enough to run as a debug-build assert on every frame.
+//
+//==============================================================================
+
+// Primitive types in a command.  The display list always draws lines, then
+// tris, then quads; we keep that order here.
+enum {
+	dl_prim_lines = 0,
+	dl_prim_tris = 1,
+	dl_prim_quads = 2,
+	dl_prim_count = 3
+};
+
+// Result codes from validation.
+enum {
+	dl_cmd_ok = 0,
+	dl_cmd_err_not_finished,		// Validate was called on an open list.
+	dl_cmd_err_empty_draw,			// A command with no indices or no instances.
+	dl_cmd_err_bad_prim,			// Primitive type out of range.
+	dl_cmd_err_bad_arena,			// Arena index out of range.
+	dl_cmd_err_index_range,			// Command reads past the end of its arena's indices.
+	dl_cmd_err_batch_coverage,		// Batches do not cover the command table exactly once, in order.
+	dl_cmd_err_batch_split			// Two batches could have been one multi-draw.
+};
+
+// One draw command.  This is the GL's DrawElementsIndirectCommand layout -
+// do not reorder the fields.
+struct LDrawDLDrawCommand {
+	unsigned int		index_count;		// Number of indices to draw.
+	unsigned int		instance_count;		// Number of instances to draw.
+	unsigned int		first_index;		// Offset (in indices) into the arena's index buffer.
+	int					base_vertex;		// Always 0 - arena indices are absolute.
+	unsigned int		base_instance;		// First instance in the instance buffer.
+};
+
+// One batch: a run of commands drawn from one arena with one primitive type.
+struct LDrawDLBatch {
+	int					arena;
+	int					prim;
+	int					first_command;
+	int					command_count;
+};
+
+// Command lists are opaque.
+struct LDrawDLCommandList;
+
+struct LDrawDLCommandList *	LDrawDLCommandListCreate(void);
+void						LDrawDLCommandListDestroy(struct LDrawDLCommandList * list);
+
+// Queue one draw.  Empty draws (no indices or no instances) are dropped.
+void						LDrawDLCommandListAdd(
+									struct LDrawDLCommandList *	list,
+									int							arena,
+									int							prim,
+									unsigned int				first_index,
+									unsigned int				index_count,
+									unsigned int				base_instance,
+									unsigned int				instance_count);
+
+// Sort, merge and cut the list into batches.  Pass group_by_prim = 1 when
+// the batches will be drawn with real multi-draw calls: every arena/primitive
+// pair then lands in exactly one batch.  Pass 0 when each command will be
+// drawn on its own: commands are then kept together by instance range so
+// the instance attribute pointers change as rarely as possible.
+void						LDrawDLCommandListFinish(struct LDrawDLCommandList * list, int group_by_prim);
+
+// Accessors for a finished list.  Both return the number of records.
+int							LDrawDLCommandListGetCommands(struct LDrawDLCommandList * list, const struct LDrawDLDrawCommand ** out_commands);
+int							LDrawDLCommandListGetBatches(struct LDrawDLCommandList * list, const struct LDrawDLBatch ** out_batches);
+
+// Check a finished list.  If arena_index_limits is not NULL it holds, for
+// each of arena_count arenas, the number of valid indices in that arena.
+int							LDrawDLCommandListValidate(
+									struct LDrawDLCommandList *	list,
+									const unsigned int *		arena_index_limits,
+									int							arena_count);
+
+#endif /* LDrawDLCommandList_H */
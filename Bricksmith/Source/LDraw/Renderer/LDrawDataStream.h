@@ -9,20 +9,30 @@
 #import <Cocoa/Cocoa.h>
 
 /*
-	The LDrawDataStream is an experimental implementation of Rob Barris'
-	ideas on OpenGL vertex streaming: unlike a standard "orphan" VBO
-	(where we buffer null to get a new buffer, map it, write data, unmap,
-	use it) the stream works by windowing one large buffer: we map
-	asynchronously, write part, flush part, use part, and then move down
-	the buffer.  
-	
+	The LDrawDataStream is an implementation of Rob Barris' ideas on OpenGL
+	vertex streaming: unlike a standard "orphan" VBO (where we buffer null to
+	get a new buffer, map it, write data, unmap, use it) the stream works by
+	windowing one large buffer: we map asynchronously, write part, flush part,
+	use part, and then move down the buffer.
+
 	For many very small draw calls, this saves us the overhead
 	of orphaning very small buffers (which the VBO doesn't cope with well).
-	
+
+	The windowing itself is done by an LDrawStreamRing (see LDrawStreamRing.h);
+	this file is the GL backend for it.  Whatever the GL offers is used:
+	ARB_map_buffer_range or APPLE_flush_buffer_range to map without syncing,
+	and ARB_sync or APPLE_fence to know when the GPU is done with a frame.
+	Without fences the ring orphans the buffer each time it fills.
+
 	When the stream is mapped, we get a base ptr to write data into.
 	When it is umapped, we get a base ptr relative to the VBO, and the VBO is
 	made current for setting up glVertexAttribPointer.
 
+	Call LDrawDataStreamEndFrame after issuing the draws that use the frame's
+	data; that is what lets the stream reuse the space later.  The stream
+	must be created, used and destroyed on the thread that owns the GL
+	context.
+
 */
 
 struct	LDrawDataStream;
@@ -32,5 +42,7 @@ void						LDrawDataStreamDestroy(struct LDrawDataStream * str);
 
 void *						LDrawDataStreamMap(struct LDrawDataStream * str,int size_desired);
 void *						LDrawDataStreamUnmap(struct LDrawDataStream * str);
+void						LDrawDataStreamEndFrame(struct LDrawDataStream * str);
 
-
+GLuint						LDrawDataStreamGetVBO(struct LDrawDataStream * str);
+int							LDrawDataStreamGetSize(struct LDrawDataStream * str);
@@ -7,137 +7,309 @@
 //
 
 #import "LDrawDataStream.h"
-#import <OpenGL/glext.h>
+#import "LDrawStreamRing.h"
+#import OPEN_GL_HEADER
+#import OPEN_GL_EXT_HEADER
 
+// Set this to 0 to ignore fences and orphan every time the buffer fills - regress to
+// this to test for bugs in the fence path.
 #define WINDOWED_STREAM 1
 
-
-#if WINDOWED_STREAM
+enum {
+	stream_map_plain = 0,			// glMapBuffer - the GL syncs with the GPU for us.  Correct but slow.
+	stream_map_arb,					// ARB_map_buffer_range, unsynchronized with explicit flush.
+	stream_map_apple				// APPLE_flush_buffer_range with serialized modify turned off.
+};
 
 struct LDrawDataStream {
-	GLuint			vbo;
-	int				total_size;
-	int				cur_base;
-	int				cur_size;
+	GLuint						vbo;
+	int							total_size;
+	int							map_mode;
+	struct LDrawStreamRing *	ring;
+	int							cur_base;			// Offset and size of the open mapping.
+	int							cur_size;
 };
 
-//========== LDrawDataStreamCreate ===============================================
+
+//========== has_extension =======================================================
 //
-// Purpose:		Create a new data stream.
+// Purpose:	Check the current context's extension string.
 //
-// Notes:		Buffer size is the size of the entire VBO allocation that
-//				we will window.
+//================================================================================
+static int has_extension(const char * name)
+{
+	const GLubyte * ext_str = glGetString(GL_EXTENSIONS);
+	return ext_str != NULL && strstr((const char *) ext_str, name) != NULL;
+
+}//end has_extension
+
+
+#pragma mark -
+#pragma mark BUFFER BACKEND
+#pragma mark -
+
+//========== stream_map ==========================================================
+//
+// Purpose:	Map one range of the VBO without waiting for the GPU - the ring
+//			has already made sure the GPU is done with it.
 //
 //================================================================================
-struct LDrawDataStream *	LDrawDataStreamCreate(int buffer_size)
+static void * stream_map(void * ref, int offset, int size)
 {
-	struct LDrawDataStream * r = (struct LDrawDataStream *) malloc(sizeof(struct LDrawDataStream));
-	glGenBuffers(1,&r->vbo);
-	glBindBuffer(GL_ARRAY_BUFFER,r->vbo);
-	glBufferData(GL_ARRAY_BUFFER, buffer_size, NULL, GL_DYNAMIC_DRAW);
-	// Disable auto-flush and auto-sync.  It would be nice to use the gl 2.0 API but it's not on
-	// 10.6.8.
-	glBufferParameteriAPPLE(GL_ARRAY_BUFFER, GL_BUFFER_FLUSHING_UNMAP_APPLE, GL_FALSE);
-	glBufferParameteriAPPLE(GL_ARRAY_BUFFER, GL_BUFFER_SERIALIZED_MODIFY_APPLE, GL_FALSE);	
+	struct LDrawDataStream * str = (struct LDrawDataStream *) ref;
+	glBindBuffer(GL_ARRAY_BUFFER, str->vbo);
 
- 	glBindBuffer(GL_ARRAY_BUFFER,0);
-	r->cur_base = 0;
-	r->cur_size = 0;
-	r->total_size = buffer_size;
-	return r;
-}//end LDrawDataStreamCreate
+	#if defined(GL_ARB_map_buffer_range)
+	if(str->map_mode == stream_map_arb)
+		return glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+								GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+	#endif
 
+	char * r = (char *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	return r + offset;
 
-//========== LDrawDataStreamDestroy ==============================================
+}//end stream_map
+
+
+//========== stream_unmap ========================================================
 //
-// Purpose:		Deallocate a data stream, clean up VBO.
+// Purpose:	Flush the range we wrote and unmap.
+//
+// Notes:	The explicit flush has to happen while the buffer is still mapped.
 //
 //================================================================================
-void LDrawDataStreamDestroy(struct LDrawDataStream * str)
+static void stream_unmap(void * ref, int offset, int size)
 {
-	glDeleteBuffers(1,&str->vbo);
-	free(str);
-}//end LDrawDataStreamDestroy
+	struct LDrawDataStream * str = (struct LDrawDataStream *) ref;
+	glBindBuffer(GL_ARRAY_BUFFER, str->vbo);
 
+	#if defined(GL_ARB_map_buffer_range)
+	if(str->map_mode == stream_map_arb)
+		glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, size);
+	#endif
+	#if defined(GL_APPLE_flush_buffer_range)
+	if(str->map_mode == stream_map_apple)
+		glFlushMappedBufferRangeAPPLE(GL_ARRAY_BUFFER, offset, size);
+	#endif
 
-//========== LDrawDataStreamMap ==================================================
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+
+}//end stream_unmap
+
+
+//========== stream_orphan =======================================================
 //
-// Purpose:		Maps a sub-section of the VBO into memory so that we can write
-//				data to it.
+// Purpose:	Get new storage for the VBO; draws already issued keep the old.
 //
-// Notes:		The ptr returned is the start of our data, with size_desired
-//				bytes available.
+// Notes:	Buffer parameters (the APPLE flush/serialize settings) belong to
+//			the buffer object, so they survive this.
 //
-//				Data should always be written in consecutively in ascending order
-//				and should never be read back or used for other calculations.
-//				The memory we get may be write-combined memory and/or may be in
-//				VRAM, so we will get maximum data throughput with consecutive
-//				asecnding writes.
+//================================================================================
+static void stream_orphan(void * ref)
+{
+	struct LDrawDataStream * str = (struct LDrawDataStream *) ref;
+	glBindBuffer(GL_ARRAY_BUFFER, str->vbo);
+	glBufferData(GL_ARRAY_BUFFER, str->total_size, NULL, GL_STREAM_DRAW);
+
+}//end stream_orphan
+
+
+#pragma mark -
+#pragma mark FENCES
+#pragma mark -
+
+#if defined(GL_ARB_sync)
+
+//========== sync_insert =========================================================
+//
+// Purpose:	Drop an ARB_sync fence behind everything issued so far.
 //
 //================================================================================
-void *	LDrawDataStreamMap(struct LDrawDataStream * str,int size_desired)
+static void * sync_insert(void * ref)
 {
-	assert(size_desired <= str->total_size);
-	glBindBuffer(GL_ARRAY_BUFFER,str->vbo);
-	
-	int remaining = str->total_size - str->cur_base;
-	if(remaining < size_desired)
-	{
-		glBufferData(GL_ARRAY_BUFFER, str->total_size, NULL, GL_DYNAMIC_DRAW);
-		str->cur_base = 0;
-		str->cur_size = 0;		
-	}
-	
-	str->cur_size = size_desired;	
-	char * r = (char *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-	glBindBuffer(GL_ARRAY_BUFFER,0);
-	return r + str->cur_base;
-}//end LDrawDataStreamMap
+	return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
+}//end sync_insert
 
-//========== LDrawDataStreamUnmap ================================================
+
+//========== sync_test ===========================================================
 //
-// Purpose:		Commit data written to a mapping for use by the GPU.
+// Purpose:	Check an ARB_sync fence without blocking.
 //
-// Notes:		This routine returns a ptr relative to the VBO that can be used
-//				for OpenGL routines.  The underlying VBO is left 'current' for
-//				use by glVertexAttribPointer.
+//================================================================================
+static int sync_test(void * ref, void * fence)
+{
+	GLint status = GL_UNSIGNALED;
+	glGetSynciv((GLsync) fence, GL_SYNC_STATUS, sizeof(status), NULL, &status);
+	return status == GL_SIGNALED;
+
+}//end sync_test
+
+
+//========== sync_wait ===========================================================
+//
+// Purpose:	Block until an ARB_sync fence signals.
 //
 //================================================================================
-void *	LDrawDataStreamUnmap(struct LDrawDataStream * str)
+static void sync_wait(void * ref, void * fence)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, str->vbo);
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glFlushMappedBufferRangeAPPLE(GL_ARRAY_BUFFER,str->cur_base,str->cur_size);
-	char * p = NULL;
-	p += str->cur_base;
-	str->cur_base += str->cur_size;
-	str->cur_size = 0;
-	return p;	
-}//end LDrawDataStreamUnmap
+	while(glClientWaitSync((GLsync) fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+		;
 
+}//end sync_wait
 
-#else
 
-// Fallback: simply redo the VBO every time we remap it.  Regress to this to test
-// for bugs in the streaming implementatin.
+//========== sync_delete =========================================================
+//
+// Purpose:	Free an ARB_sync fence.
+//
+//================================================================================
+static void sync_delete(void * ref, void * fence)
+{
+	glDeleteSync((GLsync) fence);
 
-struct LDrawDataStream {
-	GLuint			vbo;
+}//end sync_delete
+
+
+static const struct LDrawStreamBackend sync_backend = {
+	stream_map, stream_unmap, stream_orphan,
+	sync_insert, sync_test, sync_wait, sync_delete
 };
 
+#endif
+
+
+#if defined(GL_APPLE_fence)
+
+//========== apple_fence_insert ==================================================
+//
+// Purpose:	Drop an APPLE_fence fence, for older Mac contexts without ARB_sync.
+//
+// Notes:	Fence names are never 0, so they fit in the ring's void * handles.
+//
+//================================================================================
+static void * apple_fence_insert(void * ref)
+{
+	GLuint fence;
+	glGenFencesAPPLE(1, &fence);
+	glSetFenceAPPLE(fence);
+	return (void *) (uintptr_t) fence;
+
+}//end apple_fence_insert
+
+
+//========== apple_fence_test ====================================================
+//
+// Purpose:	Check an APPLE_fence fence without blocking.
+//
+//================================================================================
+static int apple_fence_test(void * ref, void * fence)
+{
+	return glTestFenceAPPLE((GLuint) (uintptr_t) fence);
+
+}//end apple_fence_test
+
+
+//========== apple_fence_wait ====================================================
+//
+// Purpose:	Block until an APPLE_fence fence signals.
+//
+//================================================================================
+static void apple_fence_wait(void * ref, void * fence)
+{
+	glFinishFenceAPPLE((GLuint) (uintptr_t) fence);
+
+}//end apple_fence_wait
+
+
+//========== apple_fence_delete ==================================================
+//
+// Purpose:	Free an APPLE_fence fence.
+//
+//================================================================================
+static void apple_fence_delete(void * ref, void * fence)
+{
+	GLuint name = (GLuint) (uintptr_t) fence;
+	glDeleteFencesAPPLE(1, &name);
+
+}//end apple_fence_delete
+
+
+static const struct LDrawStreamBackend apple_fence_backend = {
+	stream_map, stream_unmap, stream_orphan,
+	apple_fence_insert, apple_fence_test, apple_fence_wait, apple_fence_delete
+};
+
+#endif
+
+
+// No fences at all: the ring orphans whenever it fills.
+static const struct LDrawStreamBackend orphan_backend = {
+	stream_map, stream_unmap, stream_orphan,
+	NULL, NULL, NULL, NULL
+};
+
+
+#pragma mark -
+#pragma mark STREAM API
+#pragma mark -
+
 //========== LDrawDataStreamCreate ===============================================
 //
 // Purpose:		Create a new data stream.
 //
 // Notes:		Buffer size is the size of the entire VBO allocation that
-//				we will window.
+//				we will window - and so the most that can be mapped at once.
+//
+//				We pick the best mapping and fencing the context has; this
+//				has to be called with the GL context current.
 //
 //================================================================================
 struct LDrawDataStream *	LDrawDataStreamCreate(int buffer_size)
 {
 	struct LDrawDataStream * r = (struct LDrawDataStream *) malloc(sizeof(struct LDrawDataStream));
+	const struct LDrawStreamBackend * backend = &orphan_backend;
+
 	glGenBuffers(1,&r->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER,r->vbo);
+	glBufferData(GL_ARRAY_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+
+	r->map_mode = stream_map_plain;
+	#if defined(GL_ARB_map_buffer_range)
+	if(r->map_mode == stream_map_plain && has_extension("GL_ARB_map_buffer_range"))
+		r->map_mode = stream_map_arb;
+	#endif
+	#if defined(GL_APPLE_flush_buffer_range)
+	if(r->map_mode == stream_map_plain && has_extension("GL_APPLE_flush_buffer_range"))
+	{
+		// Disable auto-flush and auto-sync.
+		glBufferParameteriAPPLE(GL_ARRAY_BUFFER, GL_BUFFER_FLUSHING_UNMAP_APPLE, GL_FALSE);
+		glBufferParameteriAPPLE(GL_ARRAY_BUFFER, GL_BUFFER_SERIALIZED_MODIFY_APPLE, GL_FALSE);
+		r->map_mode = stream_map_apple;
+	}
+	#endif
+
+	// Without an unsynchronized map, every map waits for the GPU anyway, so fences
+	// would buy us nothing.
+	#if WINDOWED_STREAM
+	if(r->map_mode != stream_map_plain)
+	{
+		#if defined(GL_ARB_sync)
+		if(backend == &orphan_backend && has_extension("GL_ARB_sync"))
+			backend = &sync_backend;
+		#endif
+		#if defined(GL_APPLE_fence)
+		if(backend == &orphan_backend && has_extension("GL_APPLE_fence"))
+			backend = &apple_fence_backend;
+		#endif
+	}
+	#endif
+
+ 	glBindBuffer(GL_ARRAY_BUFFER,0);
+	r->cur_base = 0;
+	r->cur_size = 0;
+	r->total_size = buffer_size;
+	r->ring = LDrawStreamRingCreate(buffer_size, backend, r);
 	return r;
 }//end LDrawDataStreamCreate
 
@@ -146,9 +318,13 @@ struct LDrawDataStream *	LDrawDataStreamCreate(int buffer_size)
 //
 // Purpose:		Deallocate a data stream, clean up VBO.
 //
+// Notes:		The GL defers the actual delete until draws in flight are
+//				done with the buffer.
+//
 //================================================================================
-void						LDrawDataStreamDestroy(struct LDrawDataStream * str)
+void LDrawDataStreamDestroy(struct LDrawDataStream * str)
 {
+	LDrawStreamRingDestroy(str->ring);
 	glDeleteBuffers(1,&str->vbo);
 	free(str);
 }//end LDrawDataStreamDestroy
@@ -168,12 +344,19 @@ void						LDrawDataStreamDestroy(struct LDrawDataStream * str)
 //				VRAM, so we will get maximum data throughput with consecutive
 //				asecnding writes.
 //
+//				If the map has to orphan the buffer, data from earlier maps in
+//				this frame is gone; draw from each mapping before making the
+//				next one.
+//
 //================================================================================
 void *	LDrawDataStreamMap(struct LDrawDataStream * str,int size_desired)
 {
-	glBindBuffer(GL_ARRAY_BUFFER,str->vbo);
-	glBufferData(GL_ARRAY_BUFFER, size_desired, NULL, GL_DYNAMIC_DRAW);
-	return glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	assert(size_desired <= str->total_size);
+
+	void * r = LDrawStreamRingMap(str->ring, size_desired, &str->cur_base);
+	str->cur_size = size_desired;
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	return r;
 }//end LDrawDataStreamMap
 
 
@@ -188,9 +371,45 @@ void *	LDrawDataStreamMap(struct LDrawDataStream * str,int size_desired)
 //================================================================================
 void *	LDrawDataStreamUnmap(struct LDrawDataStream * str)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, str->vbo);
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	return NULL;	
+	LDrawStreamRingUnmap(str->ring);
+	char * p = NULL;
+	p += str->cur_base;
+	str->cur_size = 0;
+	return p;
 }//end LDrawDataStreamUnmap
 
-#endif
+
+//========== LDrawDataStreamEndFrame =============================================
+//
+// Purpose:		Mark that every draw using this frame's data has been issued.
+//
+// Notes:		The space is recycled once the GPU gets past this point.
+//
+//================================================================================
+void LDrawDataStreamEndFrame(struct LDrawDataStream * str)
+{
+	LDrawStreamRingEndFrame(str->ring);
+}//end LDrawDataStreamEndFrame
+
+
+//========== LDrawDataStreamGetVBO ===============================================
+//
+// Purpose:		Return the stream's buffer, for binding to targets other than
+//				GL_ARRAY_BUFFER.
+//
+//================================================================================
+GLuint LDrawDataStreamGetVBO(struct LDrawDataStream * str)
+{
+	return str->vbo;
+}//end LDrawDataStreamGetVBO
+
+
+//========== LDrawDataStreamGetSize ==============================================
+//
+// Purpose:		Return the most that can be mapped at once.
+//
+//================================================================================
+int LDrawDataStreamGetSize(struct LDrawDataStream * str)
+{
+	return str->total_size;
+}//end LDrawDataStreamGetSize
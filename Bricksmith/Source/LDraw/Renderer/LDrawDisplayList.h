@@ -39,7 +39,21 @@
 	
 	The API will draw non-textured, non-translucent geometry via instancing, either 
 	attribute-instancing for small count or hardware instancing with attrib-array-divisor for large
-	numbers of bricks.	
+	numbers of bricks.
+
+	THREADING
+
+	Building a DL does not touch the GL: a builder, from create through finish, can be used on any
+	thread, as long as each builder is used by one thread at a time.  The finished DL holds its mesh
+	in system memory; it is moved into VRAM the first time it is drawn.  So many DLs can be built in
+	parallel and the GL work is still serialized on the GL thread.
+
+	Sessions, LDrawDLDraw and destroying a DL that has been drawn must happen on the thread that
+	owns the GL context.  A session shares nothing with builders or with other sessions, except
+	the data stream it is created with: hardware instance data (and, with multi-draw, the indirect
+	command table) is streamed through it, and the session ends the stream's frame when it draws.
+	Give each GL context its own stream and keep it across sessions, so that it can recycle its
+	buffer instead of allocating a new one per frame.
 
  */
 
@@ -50,6 +64,7 @@ struct LDrawTextureSpec;
 struct	LDrawDL;
 struct	LDrawDLBuilder;
 struct	LDrawDLSession;
+struct	LDrawDataStream;
 
 // Display list creation API.
 struct LDrawDLBuilder *		LDrawDLBuilderCreate();
@@ -63,7 +78,7 @@ void						LDrawDLBuilderAddQuad(struct LDrawDLBuilder * ctx, const GLfloat v[12]
 void						LDrawDLBuilderAddLine(struct LDrawDLBuilder * ctx, const GLfloat v[6], GLfloat n[3], GLfloat c[4]);
 
 // Session/drawing APIs
-struct LDrawDLSession *		LDrawDLSessionCreate(const GLfloat model_view[16]);
+struct LDrawDLSession *		LDrawDLSessionCreate(const GLfloat model_view[16], struct LDrawDataStream * stream);
 void						LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session);
 void						LDrawDLDraw(
 									struct LDrawDLSession *			session,
@@ -11,6 +11,9 @@
 #import "LDrawBDPAllocator.h"
 #import "LDrawShaderRenderer.h"
 #import "MeshSmooth.h"
+#import "LDrawDLArena.h"
+#import "LDrawDLCommandList.h"
+#import "LDrawDataStream.h"
 #import "GLMatrixMath.h"
 #import OPEN_GL_HEADER
 #import OPEN_GL_EXT_HEADER
@@ -27,6 +30,10 @@
 // This times smoothing of parts.
 #define TIME_SMOOTHING 0
 
+// This packs DL meshes into shared arenas and draws hw-instanced segments
+// from a sorted command list.  Requires indexed (smoothed) meshes.
+#define WANT_BATCHING WANT_SMOOTH
+
 #if WANT_SMOOTH
 static const GLuint * idx_null = NULL;
 #endif
@@ -60,6 +67,18 @@ static const GLuint * idx_null = NULL;
 	
 	During that deferred draw-out we either build a hw instance list or simply draw.
 	
+	BATCHING
+	
+	With WANT_BATCHING on, DLs do not own their VBOs - each DL's mesh is a range of a big shared arena VBO
+	(see LDrawDLArena.h).  The DL's index offsets are arena-relative and its indices are absolute, so every
+	draw path below works unchanged; it just finds many DLs bound to the same buffers.
+	
+	For hw instancing we then no longer draw segment by segment.  Instead every segment becomes up to three
+	commands (lines, tris, quads) in a command list (LDrawDLCommandList.h), which sorts them by arena and
+	primitive and cuts them into batches.  If the GL has multi-draw-indirect with base instance, each batch
+	is ONE draw call.  Otherwise we still draw command by command, but only rebind vertex state when the
+	arena changes rather than for every brick.
+	
 	DEFERRED DARWING FOR Z SORTING
 	
 	When a DL does not have to be drawn immediately and has translucency, we always try to save it to the sorted list.
@@ -74,7 +93,6 @@ static const GLuint * idx_null = NULL;
 #define VERT_STRIDE 10								// Stride of our vertices - we always write X Y Z	NX NY NZ		R G B A
 #define INST_CUTOFF 5								// Minimum instances to use hw case, which has higher overhead to set up.  
 #define INST_MAX_COUNT (1024 * 128)					// Maximum instances to write per draw before going to immediate mode - avoids unbounded VRAM use.
-#define INST_RING_BUFFER_COUNT 4					// Number of VBOs to rotate for hw instancing - doesn't actually help, it turns out.
 #define MODE_FOR_INST_STREAM GL_DYNAMIC_STATIC		// VBO mode for instancing.
 
 enum {
@@ -116,8 +134,33 @@ static int	get_instance_cutoff()
 static void copy_vec3(GLfloat d[3], const GLfloat s[3]) { d[0] = s[0]; d[1] = s[1]; d[2] = s[2];			  }
 static void copy_vec4(GLfloat d[4], const GLfloat s[4]) { d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3]; }
 
-static GLuint inst_vbo_ring[INST_RING_BUFFER_COUNT] = { 0 };
-static int inst_ring_last = 0;
+#if WANT_BATCHING
+//========== get_multi_draw_indirect =============================================
+//
+// Purpose:	Determine whether we can draw a whole batch with one call.
+//
+// Notes:	We need both multi-draw-indirect and base instance - without base
+//			instance every command would read instance 0.  Legacy 2.1 contexts
+//			on the Mac have neither, so this is compiled in only if the headers
+//			know about it.
+//
+//================================================================================
+static int	get_multi_draw_indirect()
+{
+	static int has_mdi = -1;
+	if(has_mdi == -1)
+	{
+		has_mdi = 0;
+		#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+		const GLubyte * ext_str = glGetString(GL_EXTENSIONS);
+		if(strstr((const char *) ext_str,"GL_ARB_multi_draw_indirect") != NULL &&
+		   strstr((const char *) ext_str,"GL_ARB_base_instance") != NULL)
+			has_mdi = 1;
+		#endif
+	}
+	return has_mdi;
+}
+#endif
 
 
 
@@ -158,6 +201,15 @@ struct LDrawDL {
 	GLuint					geo_vbo;				// Single VBO containing all geometry in the DL.
 #if WANT_SMOOTH
 	GLuint					idx_vbo;				// Single VBO containing all mesh indices.
+#endif
+#if WANT_BATCHING
+	struct LDrawDLArenaRange range;					// Where our mesh lives - geo_vbo and idx_vbo belong to the arena.
+#endif
+	GLfloat *				pending_verts;			// Finished mesh in system memory, waiting for the GL thread to upload it.  NULL once uploaded.
+	int						pending_vert_count;
+#if WANT_SMOOTH
+	GLuint *				pending_idx;			// Indices of the pending mesh - zero-based until upload.
+	int						pending_idx_count;
 #endif
 	int						tex_count;				// Number of per-textures; untex case is always first if present.
 	#if WANT_STATS
@@ -183,7 +235,7 @@ struct LDrawDLSegment {
 	GLuint					idx_vbo;
 #endif
 	struct LDrawDLPerTex *	dl;					// Ptr to the per-tex info for that brick - only untexed bricks get instanced, so we only have one "per tex", by definition.
-	float *					inst_base;			// VBO-relative ptr to the instance data base in the instance VBO.
+	int						inst_first;			// Index of the first instance in this frame's instance data.
 	int						inst_count;			// Number of instances startingat that offset.
 };
 	
@@ -230,7 +282,10 @@ struct LDrawDLSession {
 	int									sort_count;
 
 	GLfloat								model_view[16];			// Model-view matrix, used to Z sort translucent objects.
-	GLuint								inst_ring;				// If using more than one instancing buffer, this tells which one we use.
+	struct LDrawDataStream *			stream;					// Stream for instance data and indirect commands - owned by whoever made the session.
+	GLuint								inst_vbo;				// The stream's VBO, once this frame's data is in it.
+	char *								inst_ptr;				// VBO-relative ptr to this frame's instance data.
+	char *								cmd_ptr;				// VBO-relative ptr to this frame's indirect commands, for multi-draw.
 };
 
 
@@ -507,6 +562,9 @@ void LDrawDLBuilderAddLine(struct LDrawDLBuilder * ctx, const GLfloat v[6], GLfl
 //			fit the DL perfectly, and one VBO.  So this routine does the counting,
 //			final allocations, and copying.
 //
+//			No GL calls are made here, so a builder can be finished on any
+//			thread.  The mesh stays in system memory until upload_dl.
+//
 //================================================================================
 struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 {
@@ -636,16 +694,15 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	int total_vertices, total_indices;
 	get_final_mesh_counts(M,&total_vertices,&total_indices);
 
-	glGenBuffers(1,&dl->geo_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
-	glGenBuffers(1,&dl->idx_vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dl->idx_vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(GLfloat) * VERT_STRIDE, NULL, GL_STATIC_DRAW);
-	volatile GLfloat * vertex_ptr = (volatile GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, total_indices * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-	volatile GLuint * index_ptr = (volatile GLuint *) glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
+	// We do not touch the GL here - the builder may be running on a worker
+	// thread.  The mesh is written to system memory with zero-based indices;
+	// upload_dl moves it to VRAM (and rebases it) the first time it is drawn.
+	dl->geo_vbo = 0;
+	dl->idx_vbo = 0;
+	dl->pending_vert_count = total_vertices;
+	dl->pending_idx_count = total_indices;
+	dl->pending_verts = (GLfloat *) malloc(total_vertices * sizeof(GLfloat) * VERT_STRIDE);
+	dl->pending_idx = (GLuint *) malloc(total_indices * sizeof(GLuint));
 	
 	// Grab variable size arrays for the start/offsets of each sub-part of our big pile-o-mesh...
 	// the mesher will give us back our tris sorted by texture.
@@ -660,9 +717,9 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	write_indexed_mesh(
 		M,
 		total_vertices,
-		vertex_ptr,
+		dl->pending_verts,
 		total_indices,
-		index_ptr,
+		dl->pending_idx,
 		0,
 		line_start,
 		line_count,
@@ -695,11 +752,6 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	dl->idx_count = total_indices;
 	#endif	
 	
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-	glBindBuffer(GL_ARRAY_BUFFER,0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
-
 	// Release the BDP that contains all of the build-related junk.
 	LDrawBDPDestroy(ctx->alloc);
 
@@ -758,11 +810,12 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	dl->vrt_count = total_vertices;
 	#endif	
 	
-	// Generate and map a VBO for our mesh data.
-	glGenBuffers(1,&dl->geo_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
-	glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(GLfloat) * VERT_STRIDE, NULL, GL_STATIC_DRAW);
-	GLfloat * buf_ptr = (GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	// Copy our mesh into system memory - upload_dl sends it to a VBO on
+	// the GL thread the first time the DL is drawn.
+	dl->geo_vbo = 0;
+	dl->pending_vert_count = total_vertices;
+	dl->pending_verts = (GLfloat *) malloc(total_vertices * sizeof(GLfloat) * VERT_STRIDE);
+	GLfloat * buf_ptr = dl->pending_verts;
 	int cur_v = 0;
 	struct LDrawDLPerTex * cur_tex = dl->texes;	
 	dl->flags = ctx->flags;
@@ -815,9 +868,6 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		++cur_tex;
 	}
 	
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glBindBuffer(GL_ARRAY_BUFFER,0);
-
 	// Release the BDP that contains all of the build-related junk.
 	LDrawBDPDestroy(ctx->alloc);
 	
@@ -864,8 +914,13 @@ static void setup_tex_spec(struct LDrawTextureSpec * spec)
 // Purpose:	Create a new drawing session.  Drawing sessions sit entirely in a BDP
 //			for speed - most of our linked lists are just NULL.
 //
+// Notes:	Hardware instancing data is written into the stream; the stream
+//			must outlive the session, and is best kept for the life of the
+//			GL context so that it can cycle through its buffer frame after
+//			frame.
+//
 //================================================================================
-struct LDrawDLSession * LDrawDLSessionCreate(const GLfloat model_view[16])
+struct LDrawDLSession * LDrawDLSessionCreate(const GLfloat model_view[16], struct LDrawDataStream * stream)
 {
 	struct LDrawBDP * alloc = LDrawBDPCreate();
 	struct LDrawDLSession * session = (struct LDrawDLSession *) LDrawBDPAllocate(alloc,sizeof(struct LDrawDLSession));
@@ -878,9 +933,10 @@ struct LDrawDLSession * LDrawDLSessionCreate(const GLfloat model_view[16])
 	memset(&session->stats,0,sizeof(session->stats));
 	#endif
 	memcpy(session->model_view,model_view,sizeof(GLfloat)*16);
-	session->inst_ring = inst_ring_last;
-	// each session picks up a new buffer in the ring of instance buffers.
-	inst_ring_last = (inst_ring_last+1)%INST_RING_BUFFER_COUNT;
+	session->stream = stream;
+	session->inst_vbo = 0;
+	session->inst_ptr = NULL;
+	session->cmd_ptr = NULL;
 	return session;
 }//end LDrawDLSessionCreate
 
@@ -899,6 +955,129 @@ static int compare_sorted_link(const void * lhs, const void * rhs)
 }//end compare_sorted_link
 
 
+#if WANT_BATCHING
+
+//========== set_instance_pointers ===============================================
+//
+// Purpose:	Point the per-instance attributes at one spot in this frame's
+//			instance data.  The stream's VBO must be bound.
+//
+//================================================================================
+static void set_instance_pointers(struct LDrawDLSession * session, GLuint base_instance)
+{
+	float * p = (float *) session->inst_ptr;
+	p += base_instance * 24;
+	glVertexAttribPointer(attr_color_current, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p  );
+	glVertexAttribPointer(attr_color_compliment, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+4);
+	glVertexAttribPointer(attr_transform_x, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+8);
+	glVertexAttribPointer(attr_transform_y, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+12);
+	glVertexAttribPointer(attr_transform_z, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+16);
+	glVertexAttribPointer(attr_transform_w, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+20);
+
+}//end set_instance_pointers
+
+
+//========== draw_command_list ===================================================
+//
+// Purpose:	Send a finished command list of hardware-instanced draws to the GL.
+//
+// Notes:	Instancing must already be set up (attribute arrays enabled, with
+//			divisors).
+//
+//			Vertex attribute pointers remember the buffer that was bound when
+//			they were set, so the mesh and instance pointers can be set
+//			independently: mesh pointers change only when the arena changes,
+//			instance pointers only when the base instance does.
+//
+//			With multi-draw-indirect, the whole command table has already gone
+//			into the stream next to the instance data and each batch is one
+//			call, with the instance pointers left at instance 0 so
+//			base_instance does the work.
+//
+//================================================================================
+static void draw_command_list(struct LDrawDLSession * session, struct LDrawDLCommandList * commands, int multi_draw)
+{
+	static const GLenum prim_modes[dl_prim_count] = { GL_LINES, GL_TRIANGLES, GL_QUADS };
+
+	const struct LDrawDLBatch *			batches;
+	const struct LDrawDLDrawCommand *	cmds;
+	const struct LDrawDLBatch *			b;
+	const struct LDrawDLDrawCommand *	c;
+
+	int batch_count = LDrawDLCommandListGetBatches(commands, &batches);
+	LDrawDLCommandListGetCommands(commands, &cmds);
+
+	#if DEBUG
+	{
+		int arena_count = LDrawDLArenaGetCount();
+		GLuint * limits = (GLuint *) malloc(sizeof(GLuint) * (arena_count ? arena_count : 1));
+		int a;
+		for(a = 0; a < arena_count; ++a)
+			limits[a] = LDrawDLArenaGetIndexLimit(a);
+		assert(LDrawDLCommandListValidate(commands, limits, arena_count) == dl_cmd_ok);
+		free(limits);
+	}
+	#endif
+
+	#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+	if(multi_draw)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, session->inst_vbo);
+	#endif
+
+	int		cur_arena = -1;
+	GLuint	cur_base = (GLuint) -1;
+	GLuint	geo_vbo, idx_vbo;
+
+	for(b = batches; b < batches + batch_count; ++b)
+	{
+		if(b->arena != cur_arena)
+		{
+			LDrawDLArenaGetBuffers(b->arena, &geo_vbo, &idx_vbo);
+			glBindBuffer(GL_ARRAY_BUFFER,geo_vbo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,idx_vbo);
+			float * p = NULL;
+			glVertexAttribPointer(attr_position, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p);
+			glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
+			glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
+			glBindBuffer(GL_ARRAY_BUFFER,session->inst_vbo);
+			cur_arena = b->arena;
+		}
+
+		#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+		if(multi_draw)
+		{
+			if(cur_base != 0)
+			{
+				set_instance_pointers(session, 0);
+				cur_base = 0;
+			}
+			const struct LDrawDLDrawCommand * first = (const struct LDrawDLDrawCommand *) session->cmd_ptr;
+			glMultiDrawElementsIndirect(prim_modes[b->prim], GL_UNSIGNED_INT, first + b->first_command, b->command_count, 0);
+			continue;
+		}
+		#endif
+
+		for(c = cmds + b->first_command; c < cmds + b->first_command + b->command_count; ++c)
+		{
+			if(c->base_instance != cur_base)
+			{
+				set_instance_pointers(session, c->base_instance);
+				cur_base = c->base_instance;
+			}
+			glDrawElementsInstancedARB(prim_modes[b->prim], c->index_count, GL_UNSIGNED_INT, idx_null + c->first_index, c->instance_count);
+		}
+	}
+
+	#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+	if(multi_draw)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	#endif
+
+}//end draw_command_list
+
+#endif
+
+
 //========== LDrawDLSessionDrawAndDestroy ========================================
 //
 // Purpose:	Draw any DLs that were deferred during drawing, then nuke the
@@ -914,21 +1093,59 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 
 	if(session->dl_head)
 	{
+		struct LDrawDL * doomed = NULL;		// DLs to destroy once everything is drawn, linked by next_dl.
+		
+		#if WANT_BATCHING
+		// Hardware instances are recorded as draw commands, to be sorted and batched once we have them all.
+		struct LDrawDLCommandList * commands = LDrawDLCommandListCreate();
+		int any_hw_instances = 0;
+		GLuint last_geo_vbo = 0;
+		#else
 		// Build a var-sized array of segments to record our instances for hardware instancing.  We may not need it for every DL but that's okay.
 		struct LDrawDLSegment * segments = (struct LDrawDLSegment *) LDrawBDPAllocate(session->alloc, sizeof(struct LDrawDLSegment) * session->dl_count);
 		struct LDrawDLSegment * cur_segment = segments;
+		#endif
+
+		// Count up front how many instances will go to the hardware, so we take exactly that much
+		// from the stream.  This must pick the same DLs as main loop 1 below: greedily, in list order.
+		int stream_size = LDrawDataStreamGetSize(session->stream);
+		int inst_cap = stream_size / (int) (sizeof(GLfloat) * 24);
+		if(inst_cap > INST_MAX_COUNT)
+			inst_cap = INST_MAX_COUNT;
+		int inst_total = 0;
+		int hw_dl_count = 0;
+		for(dl = session->dl_head; dl; dl = dl->next_dl)
+		{
+			if(dl->instance_count >= get_instance_cutoff() && inst_total + dl->instance_count <= inst_cap)
+			{
+				inst_total += dl->instance_count;
+				++hw_dl_count;
+			}
+		}
 
-		// If we do not yet have a VBO for instancing, build one now.
-		if(inst_vbo_ring[session->inst_ring] == 0)
-			glGenBuffers(1,&inst_vbo_ring[session->inst_ring]);
-			
-			
-		// Map our instance buffer so we can write instancing data.
-		glBindBuffer(GL_ARRAY_BUFFER, inst_vbo_ring[session->inst_ring]);
-		glBufferData(GL_ARRAY_BUFFER,INST_MAX_COUNT * sizeof(GLfloat)*24, NULL, GL_DYNAMIC_DRAW);
-		GLfloat * inst_base = (GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+		int inst_bytes = inst_total * sizeof(GLfloat) * 24;
+		int cmd_bytes = 0;
+		#if WANT_BATCHING
+		// For multi-draw, the command table rides along right after the instance data.  Merging can only
+		// shrink it from three commands per DL.
+		int multi_draw = get_multi_draw_indirect();
+		if(multi_draw)
+		{
+			cmd_bytes = hw_dl_count * dl_prim_count * sizeof(struct LDrawDLDrawCommand);
+			if(inst_bytes + cmd_bytes > stream_size)
+			{
+				multi_draw = 0;
+				cmd_bytes = 0;
+			}
+		}
+		#endif
+
+		// Map our piece of the stream so we can write instancing data.
+		GLfloat * inst_base = NULL;
+		if(inst_total > 0)
+			inst_base = (GLfloat *) LDrawDataStreamMap(session->stream, inst_bytes + cmd_bytes);
 		GLfloat * inst_data = inst_base;
-		int		  inst_remain = INST_MAX_COUNT;
+		int		  inst_remain = inst_total;
 
 		// Main loop 1: we will walk every instanced DL and either accumulate its instances (for hardware instancing) or just draw now
 		// (For attribute instancing).
@@ -938,15 +1155,24 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 
 			if(dl->instance_count >= get_instance_cutoff() && inst_remain >= dl->instance_count)
 			{
+				#if WANT_BATCHING
+				// If we have capacity for hw instancing and this DL is used enough, queue one command per primitive type.
+				unsigned int base_instance = (unsigned int) ((inst_data - inst_base) / 24);
+				struct LDrawDLPerTex * tptr = &dl->texes[0];
+				LDrawDLCommandListAdd(commands, dl->range.arena, dl_prim_lines, tptr->line_off, tptr->line_count, base_instance, dl->instance_count);
+				LDrawDLCommandListAdd(commands, dl->range.arena, dl_prim_tris, tptr->tri_off, tptr->tri_count, base_instance, dl->instance_count);
+				LDrawDLCommandListAdd(commands, dl->range.arena, dl_prim_quads, tptr->quad_off, tptr->quad_count, base_instance, dl->instance_count);
+				any_hw_instances = 1;
+				#else
 				// If we have capacity for hw instancing and this DL is used enough, create a segment record and fill it out.
 				cur_segment->geo_vbo = dl->geo_vbo;
 				#if WANT_SMOOTH
 				cur_segment->idx_vbo = dl->idx_vbo;
 				#endif
 				cur_segment->dl = &dl->texes[0];
-				cur_segment->inst_base = NULL; 
-				cur_segment->inst_base += (inst_data - inst_base);
+				cur_segment->inst_first = (int) ((inst_data - inst_base) / 24);
 				cur_segment->inst_count = dl->instance_count;
+				#endif
 				
 				#if WANT_STATS
 					session->stats.num_btch_ins++;
@@ -980,7 +1206,9 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					inst_data += 24;
 					--inst_remain;
 				}
+				#if !WANT_BATCHING
 				++cur_segment;
+				#endif
 			}
 			else
 			{
@@ -992,14 +1220,23 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 				#endif
 			
 				// Immediate mode instancing - we draw now!  So bind up the mesh of this DL.
-				glBindBuffer(GL_ARRAY_BUFFER,dl->geo_vbo);
-				#if WANT_SMOOTH
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,dl->idx_vbo);
+				#if WANT_BATCHING
+				// Arenas are shared - only rebind if this DL lives somewhere else than the last one.
+				if(dl->geo_vbo != last_geo_vbo)
 				#endif
-				float * p = NULL;
-				glVertexAttribPointer(attr_position, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p);
-				glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
-				glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
+				{
+					glBindBuffer(GL_ARRAY_BUFFER,dl->geo_vbo);
+					#if WANT_SMOOTH
+					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,dl->idx_vbo);
+					#endif
+					float * p = NULL;
+					glVertexAttribPointer(attr_position, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p);
+					glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
+					glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
+					#if WANT_BATCHING
+					last_geo_vbo = dl->geo_vbo;
+					#endif
+				}
 
 				// Now walk the instance list...push instance data into attributes in immediate mode and draw.
 				for(inst = dl->instance_head; inst; inst = inst->next)
@@ -1033,22 +1270,46 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			
 			dl->instance_head = dl->instance_tail = NULL;			
 			dl->instance_count = 0;
+			session->dl_head = dl->next_dl;
+			dl->next_dl = NULL;		
+			
+			// A DL destroyed while it was queued can't go yet - its hardware instances
+			// only draw in main loop 2.  Keep it on the doomed list until then.
 			if(dl->flags & dl_needs_destroy)
 			{
-				LDrawDLDestroy(dl);
+				dl->next_dl = doomed;
+				doomed = dl;
 			}
-			session->dl_head = dl->next_dl;
-			dl->next_dl = NULL;		
 		}
 		
 		// Hardware instancing: unmap our hardware instance buffer and if we got data,
 		// set up the GPU for hardware instancing.
 
-		glBindBuffer(GL_ARRAY_BUFFER, inst_vbo_ring[session->inst_ring]);
-		glUnmapBuffer(GL_ARRAY_BUFFER);
+		if(inst_base)
+		{
+			assert(inst_remain == 0);
+			#if WANT_BATCHING
+			// Sort and batch the commands; for multi-draw the table has to go into the stream before we unmap.
+			LDrawDLCommandListFinish(commands, multi_draw);
+			if(multi_draw)
+			{
+				const struct LDrawDLDrawCommand * cmds;
+				int cmd_count = LDrawDLCommandListGetCommands(commands, &cmds);
+				assert(cmd_count * (int) sizeof(struct LDrawDLDrawCommand) <= cmd_bytes);
+				memcpy((char *) inst_base + inst_bytes, cmds, cmd_count * sizeof(struct LDrawDLDrawCommand));
+			}
+			#endif
+			session->inst_ptr = (char *) LDrawDataStreamUnmap(session->stream);
+			session->cmd_ptr = session->inst_ptr + inst_bytes;
+			session->inst_vbo = LDrawDataStreamGetVBO(session->stream);
+		}
 
 
+		#if WANT_BATCHING
+		if(any_hw_instances)
+		#else
 		if(segments != cur_segment)
+		#endif
 		{
 			glEnableVertexAttribArray(attr_transform_x);
 			glEnableVertexAttribArray(attr_transform_y);
@@ -1063,6 +1324,12 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			glVertexAttribDivisorARB(attr_color_current,1);
 			glVertexAttribDivisorARB(attr_color_compliment,1);
 
+			#if WANT_BATCHING
+			
+			// Main loop 2: draw each batch.
+			draw_command_list(session, commands, multi_draw);
+			
+			#else
 			// Main loop 2 over DLs - for each DL that had hw-instances we built a segment
 			// in our array.  Bind the DL itself, as well as the instance pointers, and do an instanced-draw.
 
@@ -1079,9 +1346,9 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 				glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
 				glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
 
-				glBindBuffer(GL_ARRAY_BUFFER,inst_vbo_ring[session->inst_ring]);
+				glBindBuffer(GL_ARRAY_BUFFER,session->inst_vbo);
 
-				p = s->inst_base;
+				p = (float *) session->inst_ptr + s->inst_first * 24;
 				glVertexAttribPointer(attr_color_current, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p  );
 				glVertexAttribPointer(attr_color_compliment, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+4);
 				glVertexAttribPointer(attr_transform_x, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+8);
@@ -1105,6 +1372,7 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					glDrawArraysInstancedARB(GL_QUADS,s->dl->quad_off,s->dl->quad_count, s->inst_count);
 				#endif
 			}
+			#endif
 
 			glDisableVertexAttribArray(attr_transform_x);
 			glDisableVertexAttribArray(attr_transform_y);
@@ -1121,6 +1389,18 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 
 		}
 
+		#if WANT_BATCHING
+		LDrawDLCommandListDestroy(commands);
+		#endif
+		
+		// Every instance is drawn, so the doomed DLs can finally go.
+		while(doomed)
+		{
+			dl = doomed;
+			doomed = dl->next_dl;
+			dl->next_dl = NULL;
+			LDrawDLDestroy(dl);
+		}
 	}
 
 	// MAIN LOOP 3: sorted deferred drawing (!)
@@ -1220,14 +1500,72 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					 session->stats.num_work_att) * VERT_STRIDE * sizeof(GLfloat) / (1024 * 1024));
 	#endif
 	
+	// All of this frame's draws are in - the stream can fence off what we wrote.
+	LDrawDataStreamEndFrame(session->stream);
+
 	// Finally done - all allocations for session (including our own obj) come from a BDP, so cleanup is quick.  
-	// Instance VBO remains to be reused.
 	// DLs themselves live on beyond session.
 	LDrawBDPDestroy(session->alloc);
 	
 }//end LDrawDLSessionDrawAndDestroy
 
 
+//========== upload_dl ===========================================================
+//
+// Purpose:	Move a freshly built DL's mesh from system memory into VRAM.
+//
+// Notes:	This is the half of building a DL that needs the GL, so it runs on
+//			the GL thread, lazily, the first time the DL is drawn.  With
+//			batching, the mesh is rebased into its arena range here: indices
+//			get the range's first vertex added, and the per-tex offsets get the
+//			range's first index.
+//
+//================================================================================
+static void upload_dl(struct LDrawDL * dl)
+{
+	#if WANT_BATCHING
+	int i;
+	LDrawDLArenaAllocate(dl->pending_vert_count, dl->pending_idx_count, &dl->range);
+	LDrawDLArenaGetBuffers(dl->range.arena, &dl->geo_vbo, &dl->idx_vbo);
+
+	if(dl->range.vert_off)
+	{
+		for(i = 0; i < dl->pending_idx_count; ++i)
+			dl->pending_idx[i] += dl->range.vert_off;
+	}
+
+	struct LDrawDLPerTex * tptr = dl->texes;
+	for(i = 0; i < dl->tex_count; ++i, ++tptr)
+	{
+		tptr->line_off += dl->range.idx_off;
+		tptr->tri_off += dl->range.idx_off;
+		tptr->quad_off += dl->range.idx_off;
+	}
+
+	LDrawDLArenaUpload(&dl->range, dl->pending_verts, dl->pending_idx);
+	#else
+	glGenBuffers(1,&dl->geo_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
+	glBufferData(GL_ARRAY_BUFFER, dl->pending_vert_count * sizeof(GLfloat) * VERT_STRIDE, dl->pending_verts, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	#if WANT_SMOOTH
+	glGenBuffers(1,&dl->idx_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dl->idx_vbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, dl->pending_idx_count * sizeof(GLuint), dl->pending_idx, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+	#endif
+	#endif
+
+	free(dl->pending_verts);
+	dl->pending_verts = NULL;
+	#if WANT_SMOOTH
+	free(dl->pending_idx);
+	dl->pending_idx = NULL;
+	#endif
+
+}//end upload_dl
+
+
 //========== LDrawDLDraw =========================================================
 //
 // Purpose:	Draw a DL, or save it for later drawing.
@@ -1250,6 +1588,10 @@ void LDrawDLDraw(
 									const GLfloat					transform[16],
 									int								draw_now)
 {
+	// First draw of a DL built off-thread (or just built): get it into VRAM.
+	if(dl->pending_verts)
+		upload_dl(dl);
+
 	if(!draw_now)
 	{
 		// Sort case.  We want sort if:
@@ -1427,10 +1769,25 @@ void LDrawDLDestroy(struct LDrawDL * dl)
 	// reason inval a DL mid-draw, which is usually a sign of coding error.
 	assert(dl->instance_head == NULL);
 
+	if(dl->pending_verts)
+	{
+		// Never drawn - it never got any VRAM, so there is no GL work to do.
+		free(dl->pending_verts);
+		#if WANT_SMOOTH
+		free(dl->pending_idx);
+		#endif
+		free(dl);
+		return;
+	}
+
+	#if WANT_BATCHING
+	LDrawDLArenaRelease(&dl->range);
+	#else
 	#if WANT_SMOOTH
 	glDeleteBuffers(1,&dl->idx_vbo);
 	#endif
 	glDeleteBuffers(1,&dl->geo_vbo);
+	#endif
 	free(dl);
 
 }//end LDrawDLDestroy
@@ -0,0 +1,60 @@
+//
+//  LDrawPickingBuffer.h
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#import "MatrixMath.h"
+
+@class LDrawDirective;
+@class LDrawSoftRenderer;
+
+/*
+
+	LDrawPickingBuffer - selection by ID buffer instead of by hit testing.
+
+	The picking buffer draws a model once, on the CPU, into a low resolution ID and depth buffer:
+	each pixel records which selectable directive is frontmost there.  After that, point and
+	rectangle queries only read pixels - no matter how big the model, or how big the rectangle.
+
+	The selectable directives are the ones a box test would return: the directives in the active
+	model's visible steps, except that textures are looked into and their contents selected one
+	by one.  Each is credited with everything drawn inside it, as box testing credits a part with
+	its primitives.
+
+	Unlike box testing, the buffer only knows about what can be seen: a rectangle query returns
+	the directives with at least one visible pixel in the rectangle.  That is what "visible only"
+	marquee selection wants; it is also all a buffer this coarse can promise.  Directives smaller
+	than a pixel may be missed.
+
+	Usage: build a buffer for the current camera, and keep it until the camera or the model
+	changes - matchesWidth:height:modelView:projection: tells you whether it is still good for a
+	camera, but the client must throw it out when the model changes.  Queries take boxes in
+	normalized device coordinates, as the hit tests do.
+
+*/
+
+@interface LDrawPickingBuffer : NSObject {
+
+	LDrawSoftRenderer *		renderer;
+
+	NSMutableArray *		pickableDirectives;		// Indexed by picking ID.  Retained, so a stale buffer can't crash.
+
+	int						width;
+	int						height;
+	GLfloat					model_view[16];
+	GLfloat					projection[16];
+}
+
+- (id) initWithDirective:(LDrawDirective *)directive width:(int)width height:(int)height modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix;
+
+- (BOOL) matchesWidth:(int)width height:(int)height modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix;
+
+- (LDrawDirective *) nearestDirectiveInBox:(Box2)box_ndc depth:(float *)depth;
+- (NSArray *) directivesInBox:(Box2)box_ndc;
+
+@end
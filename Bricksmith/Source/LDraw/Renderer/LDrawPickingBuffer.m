@@ -0,0 +1,251 @@
+//
+//  LDrawPickingBuffer.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "LDrawPickingBuffer.h"
+
+#import "LDrawFile.h"
+#import "LDrawModel.h"
+#import "LDrawSoftRenderer.h"
+#import "LDrawStep.h"
+#import "LDrawTexture.h"
+
+
+@interface LDrawPickingBuffer ()
+
+- (void) drawPickableDirective:(LDrawDirective *)directive;
+- (BOOL) getPixelsInBox:(Box2)box_ndc x0:(int *)x0 y0:(int *)y0 x1:(int *)x1 y1:(int *)y1;
+
+@end
+
+
+//================================================================================
+@implementation LDrawPickingBuffer
+//================================================================================
+
+
+//========== initWithDirective:width:height:modelView:projection: ================
+//
+// Purpose: draw the selectable contents of a file or model into a new buffer
+//			of the given size, seen through the given camera.
+//
+//================================================================================
+- (id) initWithDirective:(LDrawDirective *)directive width:(int)width_in height:(int)height_in modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix
+{
+	GLfloat		background[4]	= { 0, 0, 0, 0 };
+	LDrawModel	*model			= nil;
+
+	self = [super init];
+
+	width = width_in;
+	height = height_in;
+	memcpy(model_view, mv_matrix, sizeof(model_view));
+	memcpy(projection, proj_matrix, sizeof(projection));
+
+	pickableDirectives = [[NSMutableArray alloc] init];
+	renderer = [[LDrawSoftRenderer alloc] initWithWidth:width height:height scale:1.0 modelView:mv_matrix projection:proj_matrix background:background];
+
+	if([directive isKindOfClass:[LDrawFile class]])
+		model = [(LDrawFile *)directive activeModel];
+	else if([directive isKindOfClass:[LDrawModel class]])
+		model = (LDrawModel *)directive;
+
+	if(model != nil)
+	{
+		NSArray     *steps      = [model subdirectives];
+		NSUInteger  maxIndex    = [model maxStepIndexToOutput];
+		NSUInteger  counter     = 0;
+
+		for(counter = 0; counter <= maxIndex && counter < [steps count]; counter++)
+		{
+			for(LDrawDirective *currentDirective in [[steps objectAtIndex:counter] subdirectives])
+				[self drawPickableDirective:currentDirective];
+		}
+	}
+
+	// Rasterizes the tiles on all cores.
+	[renderer finish];
+
+	return self;
+
+}//end initWithDirective:width:height:modelView:projection:
+
+
+//========== dealloc =============================================================
+//
+// Purpose: throw out the buffers.
+//
+//================================================================================
+- (void) dealloc
+{
+	[renderer release];
+	[pickableDirectives release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+//========== drawPickableDirective: ==============================================
+//
+// Purpose: give a directive the next picking ID and draw it.
+//
+// Notes:	Primitives draw their geometry when collected; parts and other
+//			containers draw it when drawn.  Either way everything comes to our
+//			renderer and gets the current ID.
+//
+//================================================================================
+- (void) drawPickableDirective:(LDrawDirective *)directive
+{
+	// The box test looks inside textures and credits what it finds there.
+	if([directive isKindOfClass:[LDrawTexture class]])
+	{
+		for(LDrawDirective *currentDirective in [(LDrawTexture *)directive subdirectives])
+			[self drawPickableDirective:currentDirective];
+		return;
+	}
+
+	[renderer setPickingID:(int)[pickableDirectives count]];
+	[pickableDirectives addObject:directive];
+
+	[directive collectSelf:[renderer immediateCollector]];
+	[directive drawSelf:renderer];
+
+}//end drawPickableDirective:
+
+
+//========== matchesWidth:height:modelView:projection: ===========================
+//
+// Purpose: whether this buffer was drawn with exactly this camera.
+//
+//================================================================================
+- (BOOL) matchesWidth:(int)width_in height:(int)height_in modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix
+{
+	return	width == width_in
+		&&	height == height_in
+		&&	memcmp(model_view, mv_matrix, sizeof(model_view)) == 0
+		&&	memcmp(projection, proj_matrix, sizeof(projection)) == 0;
+
+}//end matchesWidth:height:modelView:projection:
+
+
+//========== getPixelsInBox:x0:y0:x1:y1: =========================================
+//
+// Purpose: find the inclusive range of pixels a box in normalized device
+//			coordinates covers.  Returns NO if it is entirely off the buffer.
+//
+// Notes:	A pixel is in the box if its center is.  A box too small to contain
+//			any center gets the one pixel its center is in, so that a small
+//			box around the mouse always looks at something.
+//
+//================================================================================
+- (BOOL) getPixelsInBox:(Box2)box_ndc x0:(int *)x0 y0:(int *)y0 x1:(int *)x1 y1:(int *)y1
+{
+	// Rows go top down, like the image.
+	float	lo_x	= (V2BoxMinX(box_ndc) * 0.5f + 0.5f) * width;
+	float	hi_x	= (V2BoxMaxX(box_ndc) * 0.5f + 0.5f) * width;
+	float	lo_y	= (0.5f - V2BoxMaxY(box_ndc) * 0.5f) * height;
+	float	hi_y	= (0.5f - V2BoxMinY(box_ndc) * 0.5f) * height;
+
+	*x0 = (int) ceilf(lo_x - 0.5f);
+	*y0 = (int) ceilf(lo_y - 0.5f);
+	*x1 = (int) floorf(hi_x - 0.5f);
+	*y1 = (int) floorf(hi_y - 0.5f);
+
+	if(*x0 > *x1)
+		*x0 = *x1 = (int) floorf((lo_x + hi_x) * 0.5f);
+	if(*y0 > *y1)
+		*y0 = *y1 = (int) floorf((lo_y + hi_y) * 0.5f);
+
+	*x0 = MAX(*x0, 0);
+	*y0 = MAX(*y0, 0);
+	*x1 = MIN(*x1, width - 1);
+	*y1 = MIN(*y1, height - 1);
+
+	return *x0 <= *x1 && *y0 <= *y1;
+
+}//end getPixelsInBox:x0:y0:x1:y1:
+
+
+#pragma mark -
+#pragma mark QUERIES
+#pragma mark -
+
+//========== nearestDirectiveInBox:depth: ========================================
+//
+// Purpose: return the directive nearest the viewer anywhere in the box, or nil
+//			if there is nothing there.
+//
+// Notes:	Depth is returned as window depth, from 0 (near) to 1 (far), and is
+//			1 if nothing was found.
+//
+//================================================================================
+- (LDrawDirective *) nearestDirectiveInBox:(Box2)box_ndc depth:(float *)depth
+{
+	const int	*ids		= [renderer pickingIDs];
+	const float	*depths		= [renderer depths];
+	int			best_id		= -1;
+	float		best_depth	= 1.0f;
+	int			x0, y0, x1, y1, x, y;
+
+	if([self getPixelsInBox:box_ndc x0:&x0 y0:&y0 x1:&x1 y1:&y1])
+	{
+		for(y = y0; y <= y1; ++y)
+		for(x = x0; x <= x1; ++x)
+		{
+			int i = y * width + x;
+			if(ids[i] != -1 && depths[i] < best_depth)
+			{
+				best_depth = depths[i];
+				best_id = ids[i];
+			}
+		}
+	}
+
+	if(depth)
+		*depth = best_depth;
+
+	return best_id == -1 ? nil : [pickableDirectives objectAtIndex:best_id];
+
+}//end nearestDirectiveInBox:depth:
+
+
+//========== directivesInBox: ====================================================
+//
+// Purpose: return every directive with a visible pixel in the box.
+//
+//================================================================================
+- (NSArray *) directivesInBox:(Box2)box_ndc
+{
+	const int		*ids		= [renderer pickingIDs];
+	NSUInteger		count		= [pickableDirectives count];
+	unsigned char	*seen		= calloc(count ? count : 1, 1);
+	NSMutableArray	*found		= [NSMutableArray array];
+	int				x0, y0, x1, y1, x, y;
+
+	if([self getPixelsInBox:box_ndc x0:&x0 y0:&y0 x1:&x1 y1:&y1])
+	{
+		for(y = y0; y <= y1; ++y)
+		{
+			const int *row = ids + y * width;
+			for(x = x0; x <= x1; ++x)
+			{
+				if(row[x] != -1 && seen[row[x]] == 0)
+				{
+					seen[row[x]] = 1;
+					[found addObject:[pickableDirectives objectAtIndex:row[x]]];
+				}
+			}
+		}
+	}
+	free(seen);
+
+	return found;
+
+}//end directivesInBox:
+
+@end
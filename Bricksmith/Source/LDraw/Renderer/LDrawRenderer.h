@@ -131,13 +131,19 @@ typedef void (* LDrawDLCleanup_f)(LDrawDLHandle  who);			// Cleanup function ass
 - (void) drawDragHandle:(GLfloat *)xyz withSize:(GLfloat)size;
 
 // Begin/end for a display list.  Multiple display lists can be "open" for recording at one time;
-// each one returns its own collector object.  However, only the most recently (innermost)
-// display list can be accumulated into at one time.  (This is a bit of a defect of the API that we
-// should consider some day fixing.)
+// each one returns its own collector object, and the collectors are independent - any open one can
+// be accumulated into.  End closes the most recently begun display list.
 - (id<LDrawCollector>) beginDL;	
 - (void) endDL:(LDrawDLHandle *) outHandle cleanupFunc:(LDrawDLCleanup_f *)func;		// Returns NULL if the display list is empty (e.g. no calls between begin/end)
 
 - (void) drawDL:(LDrawDLHandle)dl;
 
+@optional
+
+// A renderer that cannot draw cached display lists (e.g. one that does not use the GL) returns a
+// collector that draws whatever it receives right away.  Models collect into it directly instead
+// of building and drawing a DL.
+- (id<LDrawCollector>) immediateCollector;
+
 @end
 
@@ -17,6 +17,9 @@
 	The renderer maintains a stack view of OpenGL state; as directives push their
 	info to the renderer, containing LDraw parts push and pop state to affect the
 	child parts that are drawn via the depth-first traversal.
+
+	The renderer is not itself a collector: beginDL hands out an LDrawDLCollector,
+	which builds its mesh without touching the renderer's state.
 	
 
 */
@@ -42,11 +45,12 @@ enum {
 #define TRANSFORM_STACK_DEPTH 64
 #define DL_STACK_DEPTH 64
 
-struct	LDrawDLBuilder;
+@class	LDrawDLCollector;
 struct	LDrawBDP;
+struct	LDrawDataStream;
 struct	LDrawDragHandleInstance;
 
-@interface LDrawShaderRenderer : NSObject<LDrawRenderer,LDrawCollector> {
+@interface LDrawShaderRenderer : NSObject<LDrawRenderer> {
 
 	struct LDrawDLSession *			session;										// DL session - this accumulates draw calls and sorts them.
 	struct LDrawBDP *				pool;
@@ -68,9 +72,8 @@ struct	LDrawDragHandleInstance;
 	GLfloat							transform_now[16];
 	GLfloat							cull_now[16];
 	
-	struct LDrawDLBuilder*			dl_stack[DL_STACK_DEPTH];						// DL stack from begin/end DL builds.
+	LDrawDLCollector *				dl_stack[DL_STACK_DEPTH];						// Collectors from begin/end DL builds - the top one is ended next.
 	int								dl_stack_top;
-	struct LDrawDLBuilder*			dl_now;											// This is the DL being built "right now".
 	
 	GLfloat							mvp[16];										// Cached MVP from when shader is built.
 
@@ -79,7 +82,7 @@ struct	LDrawDragHandleInstance;
 	
 }
 
-- (id) initWithScale:(float)scale modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix;
+- (id) initWithScale:(float)scale modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix stream:(struct LDrawDataStream *)stream;
 
 - (void) drawDragHandleImm:(GLfloat*)xyz withSize:(GLfloat)size;
 
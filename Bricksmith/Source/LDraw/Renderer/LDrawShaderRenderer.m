@@ -9,6 +9,7 @@
 #import "LDrawShaderRenderer.h"
 #import "LDrawShaderLoader.h"
 #import "LDrawDisplayList.h"
+#import "LDrawDLCollector.h"
 #import "LDrawBDPAllocator.h"
 #import "ColorLibrary.h"
 #import "GLMatrixMath.h"
@@ -35,40 +36,6 @@ struct	LDrawDragHandleInstance {
 	float	size;
 };
 
-//========== set_color4fv ========================================================
-//
-// Purpose:	Copies an RGBA color, but handles the special ptrs 0L and -1L by 
-//			converting them into the 'magic' colors 0,0,0,0 and 1,1,1,0 that 
-//			the shader wants.
-//
-// Notes:	The shader, when it sees alpha = 0, mixes between the attribute-set
-//			current and compliment by blending with the red channel: red = 0 is
-//			current, red = 1 is compliment.
-//
-//================================================================================
-static void set_color4fv(GLfloat * c, GLfloat storage[4])
-{
-	if(c == LDrawRenderCurrentColor)
-	{
-		storage[0] = 0;
-		storage[1] = 0;
-		storage[2] = 0;
-		storage[3] = 0;
-	}
-	else if(c == LDrawRenderComplimentColor)
-	{
-		storage[0] = 1;
-		storage[1] = 1;
-		storage[2] = 1;
-		storage[3] = 0;
-	}
-	else 
-	{
-		memcpy(storage,c,sizeof(GLfloat)*4);
-	}
-}//end set_color4fv
-
-
 
 //================================================================================
 @implementation LDrawShaderRenderer
@@ -83,6 +50,7 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 - (id) initWithScale:(float)initial_scale
 		   modelView:(GLfloat *)mv_matrix
 		  projection:(GLfloat *)proj_matrix
+			  stream:(struct LDrawDataStream *)stream
 {	
 	pool = LDrawBDPCreate();
 	// Build our shader if it doesn't exist yet.  For now, just stash the GL 
@@ -117,8 +85,9 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 	multMatrices(mvp,proj_matrix,mv_matrix);
 	memcpy(cull_now,mvp,sizeof(mvp));
 
-	// Create a DL session to match our lifetime.
-	session = LDrawDLSessionCreate(mv_matrix);
+	// Create a DL session to match our lifetime.  The stream belongs to our
+	// caller, who keeps it from frame to frame.
+	session = LDrawDLSessionCreate(mv_matrix, stream);
 	
 	// Set up GL state for attribute drawing, not the fixed function drawing we used to do.
 	glEnableVertexAttribArray(attr_position);
@@ -398,9 +367,6 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 	memcpy(tex_stack+texture_stack_top,&tex_now,sizeof(tex_now));
 	++texture_stack_top;
 	memcpy(&tex_now,spec,sizeof(tex_now));
-	
-	if(dl_stack_top)
-		LDrawDLBuilderSetTex(dl_now,&tex_now);
 		
 }//end pushTexture:
 
@@ -416,9 +382,6 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 	assert(texture_stack_top > 0);
 	--texture_stack_top;
 	memcpy(&tex_now,tex_stack+texture_stack_top,sizeof(tex_now));
-
-	if(dl_stack_top)
-		LDrawDLBuilderSetTex(dl_now,&tex_now);
 		
 }//end popTexture:
 
@@ -451,62 +414,6 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 }//end popWireFrame:
 
 
-//========== drawQuad:normal:color: ==============================================
-//
-// Purpose: Adds one quad to the current display list.
-//
-// Notes:	This should only be called after a dlBegin has been called; client 
-//			code only gets a protocol interface to this API by calling beginDL
-//			first.
-//
-//================================================================================
-- (void) drawQuad:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
-{
-	assert(dl_stack_top);
-	GLfloat c[4];
-
-	set_color4fv(color,c);
-	
-	LDrawDLBuilderAddQuad(dl_now,vertices,normal,c);
-
-}//end drawQuad:normal:color:
-
-
-//========== drawTri:normal:color: ===============================================
-//
-// Purpose: Adds one triangle to the current display list.
-//
-//================================================================================
-- (void) drawTri:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
-{
-	assert(dl_stack_top);
-
-	GLfloat c[4];
-
-	set_color4fv(color,c);
-	
-	LDrawDLBuilderAddTri(dl_now,vertices,normal,c);
-
-}//end drawTri:normal:color:
-
-
-//========== drawLine:normal:color: ==============================================
-//
-// Purpose: Adds one line to the current display list.
-//
-//================================================================================
-- (void) drawLine:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color;
-{
-	assert(dl_stack_top);
-
-	GLfloat c[4];
-
-	set_color4fv(color,c);
-	
-	LDrawDLBuilderAddLine(dl_now,vertices,normal,c);
-}//end drawLine:normal:color:
-
-
 //========== drawDragHandle:withSize: ============================================
 //
 // Purpose:	This draws one drag handle using the current transform.
@@ -661,16 +568,18 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 //
 // Purpose:	This begins accumulating a display list.
 //
+// Notes:	Each DL gets its own collector, so nested DLs no longer share (and
+//			fight over) one builder; the renderer only remembers the order in
+//			which to end them.
+//
 //================================================================================
 - (id<LDrawCollector>) beginDL
 {
 	assert(dl_stack_top < DL_STACK_DEPTH);
 	
-	dl_stack[dl_stack_top] = dl_now;
-	++dl_stack_top;
-	dl_now = LDrawDLBuilderCreate();
+	dl_stack[dl_stack_top] = [[LDrawDLCollector alloc] init];
 	
-	return self;
+	return dl_stack[dl_stack_top++];
 
 }//end beginDL:
 
@@ -683,12 +592,9 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 - (void) endDL:(LDrawDLHandle *) outHandle cleanupFunc:(LDrawDLCleanup_f *)func
 {
 	assert(dl_stack_top > 0);
-	struct LDrawDL * dl = dl_now ? LDrawDLBuilderFinish(dl_now) : NULL;
 	--dl_stack_top;
-	dl_now = dl_stack[dl_stack_top];
-	
-	*outHandle = (LDrawDLHandle)dl;
-	*func =  (LDrawDLCleanup_f) LDrawDLDestroy;
+	[dl_stack[dl_stack_top] finish:outHandle cleanupFunc:func];
+	[dl_stack[dl_stack_top] release];
 
 }//end endDL:cleanupFunc:
 
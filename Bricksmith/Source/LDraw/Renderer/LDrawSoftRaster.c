@@ -0,0 +1,598 @@
+/*
+ *  LDrawSoftRaster.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawSoftRaster.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#define TILE_SIZE 64					// Tiles are square, this many pixels on a side.
+#define INITIAL_CAPACITY 256
+#define LINE_DEPTH_BIAS 0.00005f		// How far lines are pulled toward the viewer, in window depth.
+
+// A triangle in window coordinates: x and y in pixels (y down), z from 0 (near) to 1 (far).
+struct LDrawSoftTri {
+	float						x[3];
+	float						y[3];
+	float						z[3];
+	float						c[3][4];
+	int							id;
+	int							min_x, min_y;		// Pixels whose centers might be inside, inclusive.
+	int							max_x, max_y;
+};
+
+// The triangles touching one tile, by index, in the order they were added.
+struct LDrawSoftBin {
+	int *						tris;
+	int							count;
+	int							capacity;
+};
+
+struct LDrawSoftRaster {
+	int							width;
+	int							height;
+	int							tiles_x;
+	int							tiles_y;
+
+	unsigned char *				pixels;
+	float *						depth;
+	int *						ids;
+	unsigned char				clear_color[4];
+	int							current_id;			// Tags primitives as they are added.
+
+	struct LDrawSoftTri *		tris;
+	int							tri_count;
+	int							tri_capacity;
+
+	struct LDrawSoftBin *		bins;
+};
+
+// A vertex on its way through clipping.
+struct LDrawSoftClipVert {
+	float						p[4];
+	float						c[4];
+};
+
+
+//========== to_byte =============================================================
+//
+// Purpose:	Convert a color channel to 8 bits, rounding to nearest.
+//
+//================================================================================
+static unsigned char to_byte(float v)
+{
+	if(v <= 0.0f)
+		return 0;
+	if(v >= 1.0f)
+		return 255;
+	return (unsigned char) (v * 255.0f + 0.5f);
+
+}//end to_byte
+
+
+//========== add_screen_tri ======================================================
+//
+// Purpose:	Store one triangle in window coordinates and file it in the bin of
+//			every tile its bounds touch.
+//
+// Notes:	Pixel (i,j) is covered if its center (i + 0.5, j + 0.5) is, so the
+//			bounds are rounded inward from the triangle's extent.  Triangles
+//			that cover no pixel center, or are degenerate, are dropped here.
+//
+//================================================================================
+static void add_screen_tri(
+						struct LDrawSoftRaster *	raster,
+						const float					x[3],
+						const float					y[3],
+						const float					z[3],
+						const float *				c[3])
+{
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if(area == 0.0f || area != area)
+		return;
+
+	float lo_x = fminf(x[0], fminf(x[1], x[2]));
+	float hi_x = fmaxf(x[0], fmaxf(x[1], x[2]));
+	float lo_y = fminf(y[0], fminf(y[1], y[2]));
+	float hi_y = fmaxf(y[0], fmaxf(y[1], y[2]));
+
+	// Clamp in float before converting - a vertex near the eye can be far off screen.
+	lo_x = fmaxf(lo_x, 0.0f);
+	lo_y = fmaxf(lo_y, 0.0f);
+	hi_x = fminf(hi_x, (float) raster->width);
+	hi_y = fminf(hi_y, (float) raster->height);
+
+	int min_x = (int) ceilf(lo_x - 0.5f);
+	int min_y = (int) ceilf(lo_y - 0.5f);
+	int max_x = (int) floorf(hi_x - 0.5f);
+	int max_y = (int) floorf(hi_y - 0.5f);
+
+	if(max_x >= raster->width)	max_x = raster->width - 1;
+	if(max_y >= raster->height)	max_y = raster->height - 1;
+	if(min_x > max_x || min_y > max_y)
+		return;
+
+	if(raster->tri_count == raster->tri_capacity)
+	{
+		raster->tri_capacity *= 2;
+		raster->tris = (struct LDrawSoftTri *) realloc(raster->tris, sizeof(struct LDrawSoftTri) * raster->tri_capacity);
+	}
+
+	int idx = raster->tri_count++;
+	struct LDrawSoftTri * t = raster->tris + idx;
+	int v;
+	for(v = 0; v < 3; ++v)
+	{
+		t->x[v] = x[v];
+		t->y[v] = y[v];
+		t->z[v] = z[v];
+		memcpy(t->c[v], c[v], sizeof(float) * 4);
+	}
+	t->id = raster->current_id;
+	t->min_x = min_x;
+	t->min_y = min_y;
+	t->max_x = max_x;
+	t->max_y = max_y;
+
+	int tx, ty;
+	for(ty = min_y / TILE_SIZE; ty <= max_y / TILE_SIZE; ++ty)
+	for(tx = min_x / TILE_SIZE; tx <= max_x / TILE_SIZE; ++tx)
+	{
+		struct LDrawSoftBin * bin = raster->bins + ty * raster->tiles_x + tx;
+		if(bin->count == bin->capacity)
+		{
+			bin->capacity = bin->capacity ? bin->capacity * 2 : INITIAL_CAPACITY;
+			bin->tris = (int *) realloc(bin->tris, sizeof(int) * bin->capacity);
+		}
+		bin->tris[bin->count++] = idx;
+	}
+
+}//end add_screen_tri
+
+
+//========== project =============================================================
+//
+// Purpose:	Take a clip-space point to window coordinates.
+//
+//================================================================================
+static void project(const struct LDrawSoftRaster * raster, const float p[4], float * x, float * y, float * z)
+{
+	float inv_w = 1.0f / p[3];
+	*x = (p[0] * inv_w * 0.5f + 0.5f) * (float) raster->width;
+	*y = (0.5f - p[1] * inv_w * 0.5f) * (float) raster->height;
+	*z = p[2] * inv_w * 0.5f + 0.5f;
+
+}//end project
+
+
+//========== clip_lerp ===========================================================
+//
+// Purpose:	Find the point between two vertices where it crosses the near
+//			plane, given each vertex's distance d from it.
+//
+//================================================================================
+static void clip_lerp(struct LDrawSoftClipVert * out, const struct LDrawSoftClipVert * a, const struct LDrawSoftClipVert * b, float da, float db)
+{
+	float t = da / (da - db);
+	int i;
+	for(i = 0; i < 4; ++i)
+	{
+		out->p[i] = a->p[i] + t * (b->p[i] - a->p[i]);
+		out->c[i] = a->c[i] + t * (b->c[i] - a->c[i]);
+	}
+
+}//end clip_lerp
+
+
+//========== LDrawSoftRasterCreate ===============================================
+//
+// Purpose:	Create a raster for an image of the given size.
+//
+//================================================================================
+struct LDrawSoftRaster * LDrawSoftRasterCreate(int width, int height)
+{
+	assert(width > 0 && height > 0);
+
+	struct LDrawSoftRaster * raster = (struct LDrawSoftRaster *) malloc(sizeof(struct LDrawSoftRaster));
+	memset(raster, 0, sizeof(struct LDrawSoftRaster));
+
+	raster->width = width;
+	raster->height = height;
+	raster->tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	raster->tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	raster->pixels = (unsigned char *) malloc(width * height * 4);
+	raster->depth = (float *) malloc(sizeof(float) * width * height);
+	raster->ids = (int *) malloc(sizeof(int) * width * height);
+	raster->current_id = -1;
+
+	raster->tri_capacity = INITIAL_CAPACITY;
+	raster->tris = (struct LDrawSoftTri *) malloc(sizeof(struct LDrawSoftTri) * raster->tri_capacity);
+
+	raster->bins = (struct LDrawSoftBin *) malloc(sizeof(struct LDrawSoftBin) * raster->tiles_x * raster->tiles_y);
+	memset(raster->bins, 0, sizeof(struct LDrawSoftBin) * raster->tiles_x * raster->tiles_y);
+
+	return raster;
+
+}//end LDrawSoftRasterCreate
+
+
+//========== LDrawSoftRasterDestroy ==============================================
+//
+// Purpose:	Free the raster, its image and its bins.
+//
+//================================================================================
+void LDrawSoftRasterDestroy(struct LDrawSoftRaster * raster)
+{
+	int b;
+	for(b = 0; b < raster->tiles_x * raster->tiles_y; ++b)
+		free(raster->bins[b].tris);
+	free(raster->bins);
+	free(raster->tris);
+	free(raster->ids);
+	free(raster->depth);
+	free(raster->pixels);
+	free(raster);
+
+}//end LDrawSoftRasterDestroy
+
+
+//========== LDrawSoftRasterClear ===============================================
+//
+// Purpose:	Throw out all primitives and set the color the tiles clear to.
+//
+// Notes:	The image itself is cleared tile by tile as the tiles are drawn.
+//
+//================================================================================
+void LDrawSoftRasterClear(struct LDrawSoftRaster * raster, const float rgba[4])
+{
+	int b;
+	for(b = 0; b < 4; ++b)
+		raster->clear_color[b] = to_byte(rgba[b]);
+
+	raster->tri_count = 0;
+	for(b = 0; b < raster->tiles_x * raster->tiles_y; ++b)
+		raster->bins[b].count = 0;
+
+}//end LDrawSoftRasterClear
+
+
+//========== LDrawSoftRasterSetID ================================================
+//
+// Purpose:	Set the ID that primitives added from now on write to the ID
+//			buffer.
+//
+//================================================================================
+void LDrawSoftRasterSetID(struct LDrawSoftRaster * raster, int id)
+{
+	raster->current_id = id;
+
+}//end LDrawSoftRasterSetID
+
+
+//========== LDrawSoftRasterAddTri ===============================================
+//
+// Purpose:	Add one triangle: three clip-space XYZW vertices and three RGBA
+//			colors.
+//
+// Notes:	We clip only against the near plane.  The sides of the screen are
+//			handled by clamping the triangle's bounds, and the far plane by
+//			the depth test.
+//
+//================================================================================
+void LDrawSoftRasterAddTri(struct LDrawSoftRaster * raster, const float clip[12], const float rgba[12])
+{
+	struct LDrawSoftClipVert	in[3];
+	struct LDrawSoftClipVert	out[4];
+	float						d[3];
+	int							n = 0;
+	int							v;
+
+	for(v = 0; v < 3; ++v)
+	{
+		memcpy(in[v].p, clip + 4 * v, sizeof(float) * 4);
+		memcpy(in[v].c, rgba + 4 * v, sizeof(float) * 4);
+		d[v] = in[v].p[2] + in[v].p[3];
+	}
+
+	if(d[0] < 0.0f && d[1] < 0.0f && d[2] < 0.0f)
+		return;
+
+	// Sutherland-Hodgman against one plane: a triangle becomes at most a quad.
+	for(v = 0; v < 3; ++v)
+	{
+		int w = (v + 1) % 3;
+		if(d[v] >= 0.0f)
+			out[n++] = in[v];
+		if((d[v] >= 0.0f) != (d[w] >= 0.0f))
+			clip_lerp(out + n++, in + v, in + w, d[v], d[w]);
+	}
+
+	float x[4], y[4], z[4];
+	for(v = 0; v < n; ++v)
+		project(raster, out[v].p, x + v, y + v, z + v);
+
+	for(v = 2; v < n; ++v)
+	{
+		float			tx[3] = { x[0], x[v-1], x[v] };
+		float			ty[3] = { y[0], y[v-1], y[v] };
+		float			tz[3] = { z[0], z[v-1], z[v] };
+		const float *	tc[3] = { out[0].c, out[v-1].c, out[v].c };
+		add_screen_tri(raster, tx, ty, tz, tc);
+	}
+
+}//end LDrawSoftRasterAddTri
+
+
+//========== LDrawSoftRasterAddLine ==============================================
+//
+// Purpose:	Add one line: two clip-space XYZW vertices and two RGBA colors.
+//
+// Notes:	The line becomes a one-pixel-wide quad in window space.  That is
+//			wide enough to cover at least one pixel center in every row (or
+//			column) the line crosses, so lines never have gaps.
+//
+//================================================================================
+void LDrawSoftRasterAddLine(struct LDrawSoftRaster * raster, const float clip[8], const float rgba[8])
+{
+	struct LDrawSoftClipVert	a, b, m;
+	float						ax, ay, az, bx, by, bz;
+
+	memcpy(a.p, clip, sizeof(float) * 4);
+	memcpy(a.c, rgba, sizeof(float) * 4);
+	memcpy(b.p, clip + 4, sizeof(float) * 4);
+	memcpy(b.c, rgba + 4, sizeof(float) * 4);
+
+	float da = a.p[2] + a.p[3];
+	float db = b.p[2] + b.p[3];
+	if(da < 0.0f && db < 0.0f)
+		return;
+	if(da < 0.0f)
+	{
+		clip_lerp(&m, &a, &b, da, db);
+		a = m;
+	}
+	else if(db < 0.0f)
+	{
+		clip_lerp(&m, &a, &b, da, db);
+		b = m;
+	}
+
+	project(raster, a.p, &ax, &ay, &az);
+	project(raster, b.p, &bx, &by, &bz);
+
+	float dx = bx - ax;
+	float dy = by - ay;
+	float len = sqrtf(dx * dx + dy * dy);
+	if(len < 1.0e-6f)
+	{
+		dx = 1.0f;
+		dy = 0.0f;
+		len = 1.0f;
+	}
+	float nx = -dy / len * 0.5f;
+	float ny =  dx / len * 0.5f;
+
+	az -= LINE_DEPTH_BIAS;
+	bz -= LINE_DEPTH_BIAS;
+
+	float			x1[3] = { ax + nx, ax - nx, bx - nx };
+	float			y1[3] = { ay + ny, ay - ny, by - ny };
+	float			z1[3] = { az, az, bz };
+	const float *	c1[3] = { a.c, a.c, b.c };
+	add_screen_tri(raster, x1, y1, z1, c1);
+
+	float			x2[3] = { ax + nx, bx - nx, bx + nx };
+	float			y2[3] = { ay + ny, by - ny, by + ny };
+	float			z2[3] = { az, bz, bz };
+	const float *	c2[3] = { a.c, b.c, b.c };
+	add_screen_tri(raster, x2, y2, z2, c2);
+
+}//end LDrawSoftRasterAddLine
+
+
+//========== LDrawSoftRasterGetTileCount =========================================
+//
+// Purpose:	Return how many tiles the image is cut into.
+//
+//================================================================================
+int LDrawSoftRasterGetTileCount(const struct LDrawSoftRaster * raster)
+{
+	return raster->tiles_x * raster->tiles_y;
+
+}//end LDrawSoftRasterGetTileCount
+
+
+//========== LDrawSoftRasterDrawTile =============================================
+//
+// Purpose:	Clear one tile, then draw every primitive in its bin.
+//
+// Notes:	Coverage and interpolation use barycentric weights, stepped one
+//			pixel at a time across each row.  The weights are normalized by
+//			the signed area, so both windings come out positive inside.
+//
+//			This only touches the tile's own pixels, so different tiles may
+//			be drawn at the same time.
+//
+//================================================================================
+void LDrawSoftRasterDrawTile(struct LDrawSoftRaster * raster, int tile)
+{
+	assert(tile >= 0 && tile < raster->tiles_x * raster->tiles_y);
+
+	int			tile_x0 = (tile % raster->tiles_x) * TILE_SIZE;
+	int			tile_y0 = (tile / raster->tiles_x) * TILE_SIZE;
+	int			tile_x1 = tile_x0 + TILE_SIZE - 1;
+	int			tile_y1 = tile_y0 + TILE_SIZE - 1;
+	int			px, py, i;
+
+	if(tile_x1 >= raster->width)	tile_x1 = raster->width - 1;
+	if(tile_y1 >= raster->height)	tile_y1 = raster->height - 1;
+
+	for(py = tile_y0; py <= tile_y1; ++py)
+	for(px = tile_x0; px <= tile_x1; ++px)
+	{
+		memcpy(raster->pixels + 4 * (py * raster->width + px), raster->clear_color, 4);
+		raster->depth[py * raster->width + px] = 1.0f;
+		raster->ids[py * raster->width + px] = -1;
+	}
+
+	const struct LDrawSoftBin * bin = raster->bins + tile;
+
+	for(i = 0; i < bin->count; ++i)
+	{
+		const struct LDrawSoftTri * t = raster->tris + bin->tris[i];
+
+		int x0 = t->min_x > tile_x0 ? t->min_x : tile_x0;
+		int y0 = t->min_y > tile_y0 ? t->min_y : tile_y0;
+		int x1 = t->max_x < tile_x1 ? t->max_x : tile_x1;
+		int y1 = t->max_y < tile_y1 ? t->max_y : tile_y1;
+		if(x0 > x1 || y0 > y1)
+			continue;
+
+		float inv_area = 1.0f / ((t->x[1] - t->x[0]) * (t->y[2] - t->y[0]) - (t->x[2] - t->x[0]) * (t->y[1] - t->y[0]));
+
+		// Weight of vertex v is the edge function of the opposite edge, over the area.
+		float	dx[3], dy[3], w_start[3];
+		int		v;
+		float	sx = (float) x0 + 0.5f;
+		float	sy = (float) y0 + 0.5f;
+		for(v = 0; v < 3; ++v)
+		{
+			int a = (v + 1) % 3;
+			int b = (v + 2) % 3;
+			dx[v] = -(t->y[b] - t->y[a]) * inv_area;
+			dy[v] =  (t->x[b] - t->x[a]) * inv_area;
+			w_start[v] = ((t->x[b] - t->x[a]) * (sy - t->y[a]) - (t->y[b] - t->y[a]) * (sx - t->x[a])) * inv_area;
+		}
+
+		for(py = y0; py <= y1; ++py)
+		{
+			float w0 = w_start[0];
+			float w1 = w_start[1];
+			float w2 = w_start[2];
+
+			unsigned char *	dst = raster->pixels + 4 * (py * raster->width + x0);
+			float *			dep = raster->depth + py * raster->width + x0;
+			int *			ids = raster->ids + py * raster->width + x0;
+
+			for(px = x0; px <= x1; ++px, dst += 4, ++dep, ++ids, w0 += dx[0], w1 += dx[1], w2 += dx[2])
+			{
+				if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+
+				float z = w0 * t->z[0] + w1 * t->z[1] + w2 * t->z[2];
+				if(z < 0.0f || z >= *dep)
+					continue;
+				*dep = z;
+				*ids = t->id;
+
+				float r = w0 * t->c[0][0] + w1 * t->c[1][0] + w2 * t->c[2][0];
+				float g = w0 * t->c[0][1] + w1 * t->c[1][1] + w2 * t->c[2][1];
+				float b = w0 * t->c[0][2] + w1 * t->c[1][2] + w2 * t->c[2][2];
+				float a = w0 * t->c[0][3] + w1 * t->c[1][3] + w2 * t->c[2][3];
+
+				if(a < 1.0f)
+				{
+					float keep = 1.0f - a;
+					r = r * a + keep * (dst[0] / 255.0f);
+					g = g * a + keep * (dst[1] / 255.0f);
+					b = b * a + keep * (dst[2] / 255.0f);
+					a = a * a + keep * (dst[3] / 255.0f);
+				}
+
+				dst[0] = to_byte(r);
+				dst[1] = to_byte(g);
+				dst[2] = to_byte(b);
+				dst[3] = to_byte(a);
+			}
+
+			for(v = 0; v < 3; ++v)
+				w_start[v] += dy[v];
+		}
+	}
+
+}//end LDrawSoftRasterDrawTile
+
+
+//========== LDrawSoftRasterDrawAllTiles =========================================
+//
+// Purpose:	Draw every tile on this thread.
+//
+//================================================================================
+void LDrawSoftRasterDrawAllTiles(struct LDrawSoftRaster * raster)
+{
+	int t;
+	for(t = 0; t < raster->tiles_x * raster->tiles_y; ++t)
+		LDrawSoftRasterDrawTile(raster, t);
+
+}//end LDrawSoftRasterDrawAllTiles
+
+
+//========== LDrawSoftRasterGetWidth =============================================
+//
+// Purpose:	Return the image width in pixels.
+//
+//================================================================================
+int LDrawSoftRasterGetWidth(const struct LDrawSoftRaster * raster)
+{
+	return raster->width;
+
+}//end LDrawSoftRasterGetWidth
+
+
+//========== LDrawSoftRasterGetHeight ============================================
+//
+// Purpose:	Return the image height in pixels.
+//
+//================================================================================
+int LDrawSoftRasterGetHeight(const struct LDrawSoftRaster * raster)
+{
+	return raster->height;
+
+}//end LDrawSoftRasterGetHeight
+
+
+//========== LDrawSoftRasterGetPixels ============================================
+//
+// Purpose:	Return the image: 8-bit RGBA, width * 4 bytes per row, top row
+//			first.  Only valid once every tile has been drawn.
+//
+//================================================================================
+const unsigned char * LDrawSoftRasterGetPixels(const struct LDrawSoftRaster * raster)
+{
+	return raster->pixels;
+
+}//end LDrawSoftRasterGetPixels
+
+
+//========== LDrawSoftRasterGetIDs ===============================================
+//
+// Purpose:	Return the ID buffer: one int per pixel, top row first, -1 where
+//			nothing was drawn.  Only valid once every tile has been drawn.
+//
+//================================================================================
+const int * LDrawSoftRasterGetIDs(const struct LDrawSoftRaster * raster)
+{
+	return raster->ids;
+
+}//end LDrawSoftRasterGetIDs
+
+
+//========== LDrawSoftRasterGetDepths ============================================
+//
+// Purpose:	Return the depth buffer: one window depth (0 near, 1 far) per
+//			pixel, top row first.  Only valid once every tile has been drawn.
+//
+//================================================================================
+const float * LDrawSoftRasterGetDepths(const struct LDrawSoftRaster * raster)
+{
+	return raster->depth;
+
+}//end LDrawSoftRasterGetDepths
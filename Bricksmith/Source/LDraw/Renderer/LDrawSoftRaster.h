@@ -0,0 +1,75 @@
+/*
+ *  LDrawSoftRaster.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawSoftRaster_H
+#define LDrawSoftRaster_H
+
+//==============================================================================
+//
+// File: LDrawSoftRaster
+//
+// The soft raster is a CPU triangle rasterizer with a depth buffer - the
+// back end of LDrawSoftRenderer, for drawing models into an image in memory
+// without a GPU.  It contains no GL or Cocoa calls at all.
+//
+// Usage:
+//
+// Clear the raster, then add triangles and lines in clip coordinates (that
+// is, already multiplied by the projection and model-view matrices), each
+// vertex with its own final RGBA color - lighting is the caller's business.
+// The raster clips them against the near plane, projects them to the image
+// and sorts them into square tiles.
+//
+// Nothing is drawn until the tiles are drawn: LDrawSoftRasterDrawTile
+// clears one tile and draws every primitive that touches it, in the order
+// they were added.  Tiles share nothing, so they can be drawn on as many
+// threads as you like, but every tile must be drawn, once, before reading
+// the pixels.  LDrawSoftRasterDrawAllTiles does that on the calling thread.
+//
+// Semantics follow the GL renderer's defaults: no face culling, a "less"
+// depth test with depth writes, and source-alpha blending in drawing order.
+// So, like the GL renderer, the caller must add translucent primitives last,
+// sorted back to front.  Colors are interpolated linearly in screen space.
+//
+// Lines are drawn one pixel wide and pulled slightly toward the viewer, so
+// that edges win against the faces they lie on.
+//
+// The output is 8-bit RGBA, top row first.  The same input always produces
+// the same pixels, regardless of how many threads drew the tiles.
+//
+// The raster also keeps an ID buffer for picking: each primitive carries the
+// integer ID that was current (LDrawSoftRasterSetID) when it was added, and
+// each pixel ends up with the ID of the primitive that won its depth test, or
+// -1 if nothing was drawn there.  The window depth of each pixel can be read
+// back as well.
+//
+//==============================================================================
+
+struct	LDrawSoftRaster;
+
+struct LDrawSoftRaster *	LDrawSoftRasterCreate(int width, int height);
+void						LDrawSoftRasterDestroy(struct LDrawSoftRaster * raster);
+
+void						LDrawSoftRasterClear(struct LDrawSoftRaster * raster, const float rgba[4]);
+
+void						LDrawSoftRasterSetID(struct LDrawSoftRaster * raster, int id);
+void						LDrawSoftRasterAddTri(struct LDrawSoftRaster * raster, const float clip[12], const float rgba[12]);
+void						LDrawSoftRasterAddLine(struct LDrawSoftRaster * raster, const float clip[8], const float rgba[8]);
+
+int							LDrawSoftRasterGetTileCount(const struct LDrawSoftRaster * raster);
+void						LDrawSoftRasterDrawTile(struct LDrawSoftRaster * raster, int tile);
+void						LDrawSoftRasterDrawAllTiles(struct LDrawSoftRaster * raster);
+
+int							LDrawSoftRasterGetWidth(const struct LDrawSoftRaster * raster);
+int							LDrawSoftRasterGetHeight(const struct LDrawSoftRaster * raster);
+const unsigned char *		LDrawSoftRasterGetPixels(const struct LDrawSoftRaster * raster);
+const int *					LDrawSoftRasterGetIDs(const struct LDrawSoftRaster * raster);
+const float *				LDrawSoftRasterGetDepths(const struct LDrawSoftRaster * raster);
+
+#endif /* LDrawSoftRaster_H */
@@ -0,0 +1,91 @@
+//
+//  LDrawSoftRenderer.h
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#import "LDrawRenderer.h"
+
+/*
+
+	LDrawSoftRenderer - an implementation of the LDrawRenderer API on the CPU.
+
+	The soft renderer draws a model into an image in memory without touching the GL, so it can
+	run with no GPU and no window - e.g. to make thumbnails or instruction images in bulk, or to
+	get a reference image for testing.  It keeps the same color, compliment, transform and texture
+	stacks as LDrawShaderRenderer, and shades with the same lights.
+
+	There is no GL to draw a cached display list with, so the soft renderer is its own collector:
+	its immediateCollector is itself, and directives collect their meshes straight into it.  Every
+	primitive is transformed, lit and handed to an LDrawSoftRaster as it comes in.  Translucent
+	primitives are held back and drawn last, back to front.
+
+	Textures are GL objects, so textured meshes are drawn untextured, in their base colors.
+
+	For picking, the renderer also fills an ID buffer: set a picking ID before drawing each
+	pickable object and every pixel it wins ends up holding that ID.  Once any picking ID is
+	set, the selection feedback that doesn't belong to the model - wire frame for selected
+	parts and drag handles - is skipped, so that what is selected doesn't change what can be hit.
+
+	Usage: create the renderer with the image size and camera, draw the model into it, then call
+	finish; the image is then in pixels (8-bit RGBA, top row first) until the renderer is
+	released.  Unlike the GL renderer, nothing here cares what thread it is on.
+
+*/
+
+// Stack depths for renderer.
+#define SOFT_COLOR_STACK_DEPTH 64
+#define SOFT_TEXTURE_STACK_DEPTH 128
+#define SOFT_TRANSFORM_STACK_DEPTH 64
+
+struct	LDrawSoftRaster;
+struct	LDrawSoftDeferredPrim;
+
+@interface LDrawSoftRenderer : NSObject<LDrawRenderer, LDrawCollector> {
+
+	struct LDrawSoftRaster *		raster;
+
+	GLfloat							color_now[4];									// Color stack.
+	GLfloat							compl_now[4];
+	GLfloat							color_stack[SOFT_COLOR_STACK_DEPTH*4];
+	int								color_stack_top;
+
+	int								wire_frame_count;								// wire frame stack is just a count.
+
+	struct LDrawTextureSpec			tex_stack[SOFT_TEXTURE_STACK_DEPTH];			// Texture stack from push/pop texture.
+	int								texture_stack_top;
+	struct LDrawTextureSpec			tex_now;
+
+	GLfloat							transform_stack[SOFT_TRANSFORM_STACK_DEPTH*16];	// Transform stack from push/pop matrix.
+	int								transform_stack_top;
+	GLfloat							transform_now[16];
+	GLfloat							cull_now[16];									// MVP * transform: takes vertices to clip space.
+	GLfloat							eye_now[16];									// MV * transform: takes vertices and normals to eye space.
+
+	GLfloat							mvp[16];
+	GLfloat							model_view[16];
+	GLfloat							scale;
+
+	struct LDrawSoftDeferredPrim *	deferred;										// Translucent primitives, drawn sorted in finish.
+	int								deferred_count;
+	int								deferred_capacity;
+
+	int								picking_id;										// Tags primitives in the ID buffer; -1 until picking.
+
+	BOOL							finished;
+}
+
+- (id) initWithWidth:(int)width height:(int)height scale:(float)scale modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix background:(GLfloat *)rgba;
+
+- (void) setPickingID:(int)pickingID;
+
+- (void) finish;
+- (const unsigned char *) pixels;
+- (const int *) pickingIDs;
+- (const float *) depths;
+
+@end
@@ -0,0 +1,795 @@
+//
+//  LDrawSoftRenderer.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "LDrawSoftRenderer.h"
+
+#if USE_BLOCKS
+#import <dispatch/dispatch.h>
+#endif
+
+#import "LDrawSoftRaster.h"
+#import "ColorLibrary.h"
+#import "GLMatrixMath.h"
+
+// These match the lights LDrawGLRenderer sets up: two opposing diffuse lights along the
+// eye-space Z axis plus ambient, so every surface is lit by |N.z|.
+#define SOFT_LIGHT_DIFFUSE 0.8f
+#define SOFT_LIGHT_AMBIENT 0.3f
+
+// A translucent triangle or line, held back until finish so that it can be drawn back to
+// front.  Eval is the eye-space Z of its center; seq keeps the sort stable.
+struct LDrawSoftDeferredPrim {
+	GLfloat		clip[12];
+	GLfloat		rgba[12];
+	GLfloat		eval;
+	int			seq;
+	int			is_line;
+	int			picking_id;
+};
+
+
+//========== resolve_color =======================================================
+//
+// Purpose:	Turn a primitive's color, which may be one of the meta-color ptrs,
+//			into real RGBA.
+//
+//================================================================================
+static void resolve_color(const GLfloat * c, const GLfloat color_now[4], const GLfloat compl_now[4], GLfloat out[4])
+{
+	if(c == LDrawRenderCurrentColor)
+		c = color_now;
+	else if(c == LDrawRenderComplimentColor)
+		c = compl_now;
+	memcpy(out, c, sizeof(GLfloat) * 4);
+
+}//end resolve_color
+
+
+//========== shade ===============================================================
+//
+// Purpose:	Light one vertex color the way the shader does.
+//
+// Notes:	A zero normal means "don't light."
+//
+//================================================================================
+static void shade(const GLfloat eye[16], const GLfloat n[3], const GLfloat in[4], GLfloat out[4])
+{
+	GLfloat nx = eye[0] * n[0] + eye[4] * n[1] + eye[8] * n[2];
+	GLfloat ny = eye[1] * n[0] + eye[5] * n[1] + eye[9] * n[2];
+	GLfloat nz = eye[2] * n[0] + eye[6] * n[1] + eye[10] * n[2];
+	GLfloat len = sqrtf(nx * nx + ny * ny + nz * nz);
+
+	GLfloat f = 1.0f;
+	if(len > 0.0f)
+		f = SOFT_LIGHT_DIFFUSE * fabsf(nz / len) + SOFT_LIGHT_AMBIENT;
+
+	out[0] = in[0] * f;
+	out[1] = in[1] * f;
+	out[2] = in[2] * f;
+	out[3] = in[3];
+
+}//end shade
+
+
+//========== compare_deferred ====================================================
+//
+// Purpose:	Sort translucent primitives far to near (ascending eye-space Z),
+//			in drawing order when tied.  API fits C qsort.
+//
+//================================================================================
+static int compare_deferred(const void * lhs, const void * rhs)
+{
+	const struct LDrawSoftDeferredPrim * a = (const struct LDrawSoftDeferredPrim *) lhs;
+	const struct LDrawSoftDeferredPrim * b = (const struct LDrawSoftDeferredPrim *) rhs;
+
+	if(a->eval < b->eval)	return -1;
+	if(a->eval > b->eval)	return 1;
+	return a->seq - b->seq;
+
+}//end compare_deferred
+
+
+@interface LDrawSoftRenderer ()
+
+- (void) updateTransforms;
+- (void) addTri:(const GLfloat *)vertices normal:(const GLfloat *)normal color:(const GLfloat *)color;
+- (void) addLine:(const GLfloat *)vertices normal:(const GLfloat *)normal color:(const GLfloat *)color;
+- (void) deferPrim:(const GLfloat *)clip rgba:(const GLfloat *)rgba eyeZ:(GLfloat)eye_z isLine:(int)is_line;
+
+@end
+
+
+//================================================================================
+@implementation LDrawSoftRenderer
+//================================================================================
+
+
+//========== initWithWidth:height:scale:modelView:projection:background: =========
+//
+// Purpose: start an image of the given size, cleared to the background color,
+//			seen through the given camera.
+//
+//================================================================================
+- (id) initWithWidth:(int)width height:(int)height scale:(float)initial_scale modelView:(GLfloat *)mv_matrix projection:(GLfloat *)proj_matrix background:(GLfloat *)rgba
+{
+	self = [super init];
+
+	raster = LDrawSoftRasterCreate(width, height);
+	LDrawSoftRasterClear(raster, rgba);
+
+	self->scale = initial_scale;
+	self->picking_id = -1;
+
+	[[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor] getColorRGBA:color_now];
+	complimentColor(color_now, compl_now);
+
+	memset(transform_now,0,sizeof(transform_now));
+	transform_now[0] = transform_now[5] = transform_now[10] = transform_now[15] = 1.0f;
+
+	memcpy(model_view,mv_matrix,sizeof(model_view));
+	multMatrices(mvp,proj_matrix,mv_matrix);
+	[self updateTransforms];
+
+	return self;
+
+}//end initWithWidth:height:scale:modelView:projection:background:
+
+
+//========== dealloc =============================================================
+//
+// Purpose: throw out the image and anything not yet drawn.
+//
+//================================================================================
+- (void) dealloc
+{
+	LDrawSoftRasterDestroy(raster);
+	free(deferred);
+
+	[super dealloc];
+
+}//end dealloc
+
+
+//========== updateTransforms ====================================================
+//
+// Purpose: recompute the matrices that take the current coordinate system to
+//			clip and eye space.
+//
+//================================================================================
+- (void) updateTransforms
+{
+	multMatrices(cull_now,mvp,transform_now);
+	multMatrices(eye_now,model_view,transform_now);
+
+}//end updateTransforms
+
+
+#pragma mark -
+#pragma mark RENDERER STATE
+#pragma mark -
+
+//========== pushMatrix: =========================================================
+//
+// Purpose: accumulate a transform temporarily.
+//
+// Notes:	Like the shader renderer, we push a texture frame with every matrix
+//			frame and re-project the current texture into the new coordinates,
+//			so the texture stack reads the same in both renderers.
+//
+//================================================================================
+- (void) pushMatrix:(GLfloat *)matrix
+{
+	assert(transform_stack_top < SOFT_TRANSFORM_STACK_DEPTH);
+	memcpy(transform_stack + 16 * transform_stack_top, transform_now, sizeof(transform_now));
+	multMatrices(transform_now, transform_stack + 16 * transform_stack_top, matrix);
+	++transform_stack_top;
+
+	[self pushTexture:&tex_now];
+	if(tex_now.tex_obj)
+	{
+		GLfloat	s[4], t[4];
+		applyMatrixTranspose(s,matrix,tex_now.plane_s);
+		applyMatrixTranspose(t,matrix,tex_now.plane_t);
+		memcpy(tex_now.plane_s,s,sizeof(s));
+		memcpy(tex_now.plane_t,t,sizeof(t));
+	}
+	[self updateTransforms];
+
+}//end pushMatrix:
+
+
+//========== popMatrix ===========================================================
+//
+// Purpose: reset one level of the matrix stack.
+//
+//================================================================================
+- (void) popMatrix
+{
+	[self popTexture];
+
+	assert(transform_stack_top > 0);
+	--transform_stack_top;
+	memcpy(transform_now, transform_stack + 16 * transform_stack_top, sizeof(transform_now));
+	[self updateTransforms];
+
+}//end popMatrix
+
+
+//========== checkCull:to: =======================================================
+//
+// Purpose: cull out bounding boxes that are off-screen or too small to see.
+//
+// Notes:	Same test as the shader renderer, except that we know the real size
+//			of our image in pixels.
+//
+//================================================================================
+- (int) checkCull:(GLfloat *)minXYZ to:(GLfloat *)maxXYZ
+{
+	if (minXYZ[0] > maxXYZ[0] ||
+		minXYZ[1] > maxXYZ[1] ||
+		minXYZ[2] > maxXYZ[2])		return cull_skip;
+
+	GLfloat aabb_model[6] = { minXYZ[0], minXYZ[1], minXYZ[2], maxXYZ[0], maxXYZ[1], maxXYZ[2] };
+	GLfloat aabb_ndc[6];
+
+	aabbToClipbox(aabb_model, cull_now, aabb_ndc);
+
+	if(aabb_ndc[3] < -1.0f ||
+	   aabb_ndc[4] < -1.0f ||
+	   aabb_ndc[0] > 1.0f ||
+	   aabb_ndc[1] > 1.0f)
+	{
+		return cull_skip;
+	}
+
+	int x_pix = (aabb_ndc[3] - aabb_ndc[0]) * 0.5f * LDrawSoftRasterGetWidth(raster);
+	int y_pix = (aabb_ndc[4] - aabb_ndc[1]) * 0.5f * LDrawSoftRasterGetHeight(raster);
+	int dim = MAX(x_pix,y_pix);
+
+	if(dim < 1)
+		return cull_skip;
+	if(dim < 10)
+		return cull_box;
+
+	return cull_draw;
+
+}//end checkCull:to:
+
+
+//========== drawBoxFrom:to: =====================================================
+//
+// Purpose: draw an axis-aligned box in the current color.
+//
+// Notes:	Faces all get the same normal, as in the shader renderer's cube.
+//
+//================================================================================
+- (void) drawBoxFrom:(GLfloat *)minXyz to:(GLfloat *)maxXyz
+{
+	#define LBR 0,0,0
+	#define RBR 1,0,0
+	#define LTR 0,1,0
+	#define RTR 1,1,0
+	#define LBF 0,0,1
+	#define RBF 1,0,1
+	#define LTF 0,1,1
+	#define RTF 1,1,1
+
+	GLfloat faces[6][12] = {
+		{ LTF,RTF,RTR,LTR },
+		{ LBF,LBR,RBR,RBF },
+		{ LBR,LBF,LTF,LTR },
+		{ RBF,RBR,RTR,RTF },
+		{ LBF,RBF,RTF,LTF },
+		{ RBR,LBR,LTR,RTR } };
+	GLfloat n[3] = { 0, 1, 0 };
+
+	GLfloat rescale[16] = { maxXyz[0] - minXyz[0], 0, 0, 0,
+							0, maxXyz[1] - minXyz[1], 0, 0,
+							0, 0, maxXyz[2] - minXyz[2], 0,
+							minXyz[0], minXyz[1], minXyz[2], 1 };
+	int f;
+
+	[self pushMatrix:rescale];
+	for(f = 0; f < 6; ++f)
+		[self drawQuad:faces[f] normal:n color:LDrawRenderCurrentColor];
+	[self popMatrix];
+
+}//end drawBoxFrom:to:
+
+
+//========== pushColor: ==========================================================
+//
+// Purpose: push a color change onto the stack.  This sets the RGBA for the
+//			current and compliment color.
+//
+//================================================================================
+- (void) pushColor:(GLfloat *)color
+{
+	assert(color_stack_top < SOFT_COLOR_STACK_DEPTH);
+	memcpy(color_stack + color_stack_top * 4, color_now, sizeof(color_now));
+	++color_stack_top;
+	if(color != LDrawRenderCurrentColor)
+	{
+		if(color == LDrawRenderComplimentColor)
+			color = compl_now;
+		memmove(color_now, color, sizeof(color_now));
+		complimentColor(color_now, compl_now);
+	}
+
+}//end pushColor:
+
+
+//========== popColor ============================================================
+//
+// Purpose: pop the stack of current colors that has previously been pushed.
+//
+//================================================================================
+- (void) popColor
+{
+	assert(color_stack_top > 0);
+	--color_stack_top;
+	memcpy(color_now, color_stack + color_stack_top * 4, sizeof(color_now));
+	complimentColor(color_now, compl_now);
+
+}//end popColor
+
+
+//========== pushTexture: ========================================================
+//
+// Purpose: change the current texture to a new one.
+//
+// Notes:	We keep the stack so that it nests exactly as the GL renderer's
+//			does, but we have no way to sample a GL texture, so it does not
+//			change what we draw.
+//
+//================================================================================
+- (void) pushTexture:(struct LDrawTextureSpec *) spec
+{
+	assert(texture_stack_top < SOFT_TEXTURE_STACK_DEPTH);
+	memcpy(tex_stack+texture_stack_top,&tex_now,sizeof(tex_now));
+	++texture_stack_top;
+	memcpy(&tex_now,spec,sizeof(tex_now));
+
+}//end pushTexture:
+
+
+//========== popTexture ==========================================================
+//
+// Purpose: pop a texture off the stack that was previously pushed.
+//
+//================================================================================
+- (void) popTexture
+{
+	assert(texture_stack_top > 0);
+	--texture_stack_top;
+	memcpy(&tex_now,tex_stack+texture_stack_top,sizeof(tex_now));
+
+}//end popTexture
+
+
+//========== pushWireFrame =======================================================
+//
+// Purpose: push a change to wire frame mode.  While any wire frame request is
+//			outstanding, triangles are drawn as their outlines.
+//
+//================================================================================
+- (void) pushWireFrame
+{
+	if(picking_id != -1)
+		return;
+	++wire_frame_count;
+
+}//end pushWireFrame
+
+
+//========== popWireFrame ========================================================
+//
+// Purpose: undo a previous wire frame command.
+//
+//================================================================================
+- (void) popWireFrame
+{
+	if(picking_id != -1)
+		return;
+	assert(wire_frame_count > 0);
+	--wire_frame_count;
+
+}//end popWireFrame
+
+
+//========== drawDragHandle:withSize: ============================================
+//
+// Purpose:	Draw one drag handle at a point in the current transform: a sphere
+//			whose size is in screen pixels.
+//
+// Notes:	Like the shader renderer, we size the sphere in "global model
+//			space", without the local part transform, so that local scaling
+//			cannot deform it.
+//
+//================================================================================
+- (void) drawDragHandle:(GLfloat *)xyz withSize:(GLfloat)size
+{
+	static const int	latitudeSections	= 8;
+	static const int	longitudeSections	= 8;
+	GLfloat				lavender[4]			= { 0.50, 0.53, 1.00, 1.00 };
+
+	if(picking_id != -1)
+		return;
+
+	GLfloat handle_local[4] = { xyz[0], xyz[1], xyz[2], 1.0f };
+	GLfloat handle_world[4];
+	applyMatrix(handle_world,transform_now, handle_local);
+
+	GLfloat s = size / self->scale;
+	GLfloat m[16] = { s, 0, 0, 0, 0, s, 0, 0, 0, 0, s, 0, handle_world[0], handle_world[1], handle_world[2], 1.0 };
+	GLfloat saved[16];
+
+	memcpy(saved, transform_now, sizeof(saved));
+	memcpy(transform_now, m, sizeof(transform_now));
+	[self updateTransforms];
+
+	int lat, lon;
+	for(lat = 0; lat < latitudeSections; ++lat)
+	for(lon = 0; lon < longitudeSections; ++lon)
+	{
+		float	la[2]	= { lat * M_PI / latitudeSections, (lat + 1) * M_PI / latitudeSections };
+		float	lo[2]	= { lon * 2 * M_PI / longitudeSections, (lon + 1) * 2 * M_PI / longitudeSections };
+		GLfloat	v[12]	= {
+			cos(lo[0])*sin(la[0]), sin(lo[0])*sin(la[0]), cos(la[0]),
+			cos(lo[0])*sin(la[1]), sin(lo[0])*sin(la[1]), cos(la[1]),
+			cos(lo[1])*sin(la[1]), sin(lo[1])*sin(la[1]), cos(la[1]),
+			cos(lo[1])*sin(la[0]), sin(lo[1])*sin(la[0]), cos(la[0]) };
+		GLfloat	n[3]	= { v[0] + v[6], v[1] + v[7], v[2] + v[8] };	// In a unit sphere the normals are the vertices.
+
+		GLfloat	second[9] = { v[0], v[1], v[2], v[6], v[7], v[8], v[9], v[10], v[11] };
+
+		[self addTri:v normal:n color:lavender];
+		[self addTri:second normal:n color:lavender];
+	}
+
+	memcpy(transform_now, saved, sizeof(transform_now));
+	[self updateTransforms];
+
+}//end drawDragHandle:withSize:
+
+
+#pragma mark -
+#pragma mark DISPLAY LISTS
+#pragma mark -
+
+//========== immediateCollector ==================================================
+//
+// Purpose:	We have nothing to cache display lists in, so meshes come straight
+//			to us.
+//
+//================================================================================
+- (id<LDrawCollector>) immediateCollector
+{
+	return self;
+
+}//end immediateCollector
+
+
+//========== beginDL =============================================================
+//
+// Purpose:	"Begin" a display list - we draw whatever is collected right away.
+//
+//================================================================================
+- (id<LDrawCollector>) beginDL
+{
+	return self;
+
+}//end beginDL
+
+
+//========== endDL:cleanupFunc: ==================================================
+//
+// Purpose: close off a DL.  Since everything was drawn as it was collected,
+//			there is never a DL to hand back.
+//
+//================================================================================
+- (void) endDL:(LDrawDLHandle *) outHandle cleanupFunc:(LDrawDLCleanup_f *)func
+{
+	*outHandle = NULL;
+	*func = NULL;
+
+}//end endDL:cleanupFunc:
+
+
+//========== drawDL: =============================================================
+//
+// Purpose:	Display lists belong to the GL; we can't draw them.
+//
+// Notes:	Directives collect into our immediateCollector instead, so this is
+//			never called with anything we made.
+//
+//================================================================================
+- (void) drawDL:(LDrawDLHandle)dl
+{
+}//end drawDL:
+
+
+#pragma mark -
+#pragma mark COLLECTOR
+#pragma mark -
+
+//========== drawQuad:normal:color: ==============================================
+//
+// Purpose: Draws one quad as two triangles.
+//
+//================================================================================
+- (void) drawQuad:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	if(wire_frame_count > 0)
+	{
+		int e;
+		for(e = 0; e < 4; ++e)
+		{
+			GLfloat v[6] = {
+				vertices[3 * e], vertices[3 * e + 1], vertices[3 * e + 2],
+				vertices[3 * ((e + 1) % 4)], vertices[3 * ((e + 1) % 4) + 1], vertices[3 * ((e + 1) % 4) + 2] };
+			[self addLine:v normal:normal color:color];
+		}
+		return;
+	}
+
+	GLfloat second[9] = {
+		vertices[0], vertices[1], vertices[2],
+		vertices[6], vertices[7], vertices[8],
+		vertices[9], vertices[10], vertices[11] };
+
+	[self addTri:vertices normal:normal color:color];
+	[self addTri:second normal:normal color:color];
+
+}//end drawQuad:normal:color:
+
+
+//========== drawTri:normal:color: ===============================================
+//
+// Purpose: Draws one triangle.
+//
+//================================================================================
+- (void) drawTri:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	if(wire_frame_count > 0)
+	{
+		int e;
+		for(e = 0; e < 3; ++e)
+		{
+			GLfloat v[6] = {
+				vertices[3 * e], vertices[3 * e + 1], vertices[3 * e + 2],
+				vertices[3 * ((e + 1) % 3)], vertices[3 * ((e + 1) % 3) + 1], vertices[3 * ((e + 1) % 3) + 2] };
+			[self addLine:v normal:normal color:color];
+		}
+		return;
+	}
+
+	[self addTri:vertices normal:normal color:color];
+
+}//end drawTri:normal:color:
+
+
+//========== drawLine:normal:color: ==============================================
+//
+// Purpose: Draws one line.
+//
+//================================================================================
+- (void) drawLine:(GLfloat *) vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	[self addLine:vertices normal:normal color:color];
+
+}//end drawLine:normal:color:
+
+
+//========== addTri:normal:color: ================================================
+//
+// Purpose:	Transform and light a triangle, then draw it or hold it back if it
+//			is translucent.
+//
+//================================================================================
+- (void) addTri:(const GLfloat *)vertices normal:(const GLfloat *)normal color:(const GLfloat *)color
+{
+	GLfloat	base[4], lit[4];
+	GLfloat	clip[12];
+	GLfloat	rgba[12];
+	GLfloat	eye_z = 0.0f;
+	int		v;
+
+	resolve_color(color, color_now, compl_now, base);
+	shade(eye_now, normal, base, lit);
+
+	for(v = 0; v < 3; ++v)
+	{
+		GLfloat p[4] = { vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2], 1.0f };
+		GLfloat e[4];
+		applyMatrix(clip + 4 * v, cull_now, p);
+		applyMatrix(e, eye_now, p);
+		eye_z += e[2] / 3.0f;
+		memcpy(rgba + 4 * v, lit, sizeof(lit));
+	}
+
+	if(lit[3] < 1.0f)
+		[self deferPrim:clip rgba:rgba eyeZ:eye_z isLine:0];
+	else
+		LDrawSoftRasterAddTri(raster, clip, rgba);
+
+}//end addTri:normal:color:
+
+
+//========== addLine:normal:color: ===============================================
+//
+// Purpose:	Transform and light a line, then draw it or hold it back if it is
+//			translucent.
+//
+//================================================================================
+- (void) addLine:(const GLfloat *)vertices normal:(const GLfloat *)normal color:(const GLfloat *)color
+{
+	GLfloat	base[4], lit[4];
+	GLfloat	clip[8];
+	GLfloat	rgba[8];
+	GLfloat	eye_z = 0.0f;
+	int		v;
+
+	resolve_color(color, color_now, compl_now, base);
+	shade(eye_now, normal, base, lit);
+
+	for(v = 0; v < 2; ++v)
+	{
+		GLfloat p[4] = { vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2], 1.0f };
+		GLfloat e[4];
+		applyMatrix(clip + 4 * v, cull_now, p);
+		applyMatrix(e, eye_now, p);
+		eye_z += e[2] / 2.0f;
+		memcpy(rgba + 4 * v, lit, sizeof(lit));
+	}
+
+	if(lit[3] < 1.0f)
+		[self deferPrim:clip rgba:rgba eyeZ:eye_z isLine:1];
+	else
+		LDrawSoftRasterAddLine(raster, clip, rgba);
+
+}//end addLine:normal:color:
+
+
+//========== deferPrim:rgba:eyeZ:isLine: =========================================
+//
+// Purpose:	Save a translucent primitive for finish.
+//
+//================================================================================
+- (void) deferPrim:(const GLfloat *)clip rgba:(const GLfloat *)rgba eyeZ:(GLfloat)eye_z isLine:(int)is_line
+{
+	if(deferred_count == deferred_capacity)
+	{
+		deferred_capacity = deferred_capacity ? deferred_capacity * 2 : 256;
+		deferred = (struct LDrawSoftDeferredPrim *) realloc(deferred, sizeof(struct LDrawSoftDeferredPrim) * deferred_capacity);
+	}
+
+	struct LDrawSoftDeferredPrim * d = deferred + deferred_count;
+	int floats = is_line ? 8 : 12;
+
+	memcpy(d->clip, clip, sizeof(GLfloat) * floats);
+	memcpy(d->rgba, rgba, sizeof(GLfloat) * floats);
+	d->eval = eye_z;
+	d->seq = deferred_count;
+	d->is_line = is_line;
+	d->picking_id = picking_id;
+	++deferred_count;
+
+}//end deferPrim:rgba:eyeZ:isLine:
+
+
+#pragma mark -
+#pragma mark PICKING
+#pragma mark -
+
+//========== setPickingID: =======================================================
+//
+// Purpose:	Tag everything drawn from now on with pickingID in the ID buffer.
+//
+// Notes:	Picking IDs are not a stack; objects drawn inside a picked object
+//			(e.g. a part's sub-parts) are credited to it.
+//
+//================================================================================
+- (void) setPickingID:(int)pickingID
+{
+	assert(pickingID >= 0);
+	assert(wire_frame_count == 0);
+
+	picking_id = pickingID;
+	LDrawSoftRasterSetID(raster, pickingID);
+
+}//end setPickingID:
+
+
+#pragma mark -
+#pragma mark OUTPUT
+#pragma mark -
+
+//========== finish ==============================================================
+//
+// Purpose:	Draw the held-back translucent primitives, far to near, then
+//			rasterize the image.
+//
+// Notes:	Tiles are independent, so they are rasterized on all cores.
+//
+//================================================================================
+- (void) finish
+{
+	int i;
+
+	assert(!finished);
+
+	qsort(deferred, deferred_count, sizeof(struct LDrawSoftDeferredPrim), compare_deferred);
+	for(i = 0; i < deferred_count; ++i)
+	{
+		LDrawSoftRasterSetID(raster, deferred[i].picking_id);
+		if(deferred[i].is_line)
+			LDrawSoftRasterAddLine(raster, deferred[i].clip, deferred[i].rgba);
+		else
+			LDrawSoftRasterAddTri(raster, deferred[i].clip, deferred[i].rgba);
+	}
+	deferred_count = 0;
+
+#if USE_BLOCKS
+	struct LDrawSoftRaster * r = raster;
+	dispatch_apply(LDrawSoftRasterGetTileCount(r), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+	^(size_t tile)
+	{
+		LDrawSoftRasterDrawTile(r, (int) tile);
+	});
+#else
+	LDrawSoftRasterDrawAllTiles(raster);
+#endif
+
+	finished = YES;
+
+}//end finish
+
+
+//========== pixels ==============================================================
+//
+// Purpose:	Return the finished image: 8-bit RGBA, top row first.
+//
+//================================================================================
+- (const unsigned char *) pixels
+{
+	assert(finished);
+	return LDrawSoftRasterGetPixels(raster);
+
+}//end pixels
+
+
+
+//========== pickingIDs ==========================================================
+//
+// Purpose:	Return the finished ID buffer: one int per pixel, top row first,
+//			-1 where nothing was drawn.
+//
+//================================================================================
+- (const int *) pickingIDs
+{
+	assert(finished);
+	return LDrawSoftRasterGetIDs(raster);
+
+}//end pickingIDs
+
+
+//========== depths ==============================================================
+//
+// Purpose:	Return the finished depth buffer: one window depth (0 near, 1 far)
+//			per pixel, top row first.
+//
+//================================================================================
+- (const float *) depths
+{
+	assert(finished);
+	return LDrawSoftRasterGetDepths(raster);
+
+}//end depths
+
+@end
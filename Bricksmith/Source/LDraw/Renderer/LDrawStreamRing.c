@@ -0,0 +1,583 @@
+/*
+ *  LDrawStreamRing.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawStreamRing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define MAX_FRAMES 8				// Frames in flight before we wait on the oldest one anyway.
+#define RING_ALIGN 64				// Every allocation starts on this many bytes, so the GL can use it for anything.
+
+// A frame that has been ended but whose fence may not have signaled.  Its
+// data runs from the previous frame's end (or the tail) to its own end.
+struct LDrawStreamFrame {
+	int							end;
+	void *						fence;
+};
+
+// The reserved part of the buffer runs circularly from tail to head.  Since
+// head == tail could mean empty or full, 'live' says which.
+struct LDrawStreamRing {
+	const struct LDrawStreamBackend *	backend;
+	void *								ref;
+	int									size;
+
+	int									head;
+	int									tail;
+	int									live;
+	int									frame_open;		// Something was mapped since the last EndFrame.
+
+	struct LDrawStreamFrame				frames[MAX_FRAMES];
+	int									frame_count;
+
+	int									map_offset;
+	int									map_size;		// 0 when nothing is mapped.
+
+	int									orphan_count;
+};
+
+
+//========== try_alloc ===========================================================
+//
+// Purpose:	Find room for size bytes between head and tail, without retiring
+//			or waiting on anything.
+//
+// Notes:	Returns the offset, or -1 if there is no room.  Running off the
+//			end of the buffer wraps to zero; the bytes skipped at the end are
+//			simply reserved along with the rest of the frame.
+//
+//================================================================================
+static int try_alloc(struct LDrawStreamRing * ring, int size)
+{
+	if(!ring->live)
+	{
+		ring->head = ring->tail = 0;
+		return size <= ring->size ? 0 : -1;
+	}
+
+	if(ring->head > ring->tail)
+	{
+		if(size <= ring->size - ring->head)
+			return ring->head;
+		if(size <= ring->tail)
+			return 0;
+		return -1;
+	}
+
+	if(ring->head < ring->tail && size <= ring->tail - ring->head)
+		return ring->head;
+
+	return -1;
+
+}//end try_alloc
+
+
+//========== retire_oldest =======================================================
+//
+// Purpose:	Release the oldest ended frame, whose fence is known to have
+//			signaled.
+//
+//================================================================================
+static void retire_oldest(struct LDrawStreamRing * ring)
+{
+	assert(ring->frame_count > 0);
+
+	ring->tail = ring->frames[0].end;
+	ring->backend->fence_delete(ring->ref, ring->frames[0].fence);
+
+	--ring->frame_count;
+	memmove(ring->frames, ring->frames + 1, sizeof(struct LDrawStreamFrame) * ring->frame_count);
+
+	if(ring->frame_count == 0 && !ring->frame_open)
+	{
+		assert(ring->head == ring->tail || ring->tail == ring->size);
+		ring->live = 0;
+	}
+
+}//end retire_oldest
+
+
+//========== retire_signaled =====================================================
+//
+// Purpose:	Release every ended frame that the GPU is done with.
+//
+// Notes:	Fences signal in order, so we stop at the first one that has not.
+//
+//================================================================================
+static void retire_signaled(struct LDrawStreamRing * ring)
+{
+	while(ring->frame_count > 0 && ring->backend->fence_test(ring->ref, ring->frames[0].fence))
+		retire_oldest(ring);
+
+}//end retire_signaled
+
+
+//========== wait_oldest =========================================================
+//
+// Purpose:	Block until the oldest ended frame is done, then release it.
+//
+//================================================================================
+static void wait_oldest(struct LDrawStreamRing * ring)
+{
+	ring->backend->fence_wait(ring->ref, ring->frames[0].fence);
+	retire_oldest(ring);
+
+}//end wait_oldest
+
+
+//========== orphan_all ==========================================================
+//
+// Purpose:	Give up on the current storage: the backend swaps in a new
+//			buffer and everything in the ring is free again.
+//
+// Notes:	Fences for frames in the old storage no longer guard anything we
+//			will write, so they go too.
+//
+//================================================================================
+static void orphan_all(struct LDrawStreamRing * ring)
+{
+	int f;
+	for(f = 0; f < ring->frame_count; ++f)
+		ring->backend->fence_delete(ring->ref, ring->frames[f].fence);
+	ring->frame_count = 0;
+
+	ring->backend->orphan(ring->ref);
+
+	ring->head = ring->tail = 0;
+	ring->live = 0;
+	ring->frame_open = 0;
+	++ring->orphan_count;
+
+}//end orphan_all
+
+
+//========== LDrawStreamRingCreate ===============================================
+//
+// Purpose:	Create a ring over a buffer of 'size' bytes that the backend has
+//			already allocated.
+//
+//================================================================================
+struct LDrawStreamRing * LDrawStreamRingCreate(int size, const struct LDrawStreamBackend * backend, void * ref)
+{
+	assert(size > 0);
+	assert(backend->map && backend->unmap && backend->orphan);
+	assert(backend->fence_insert == NULL || (backend->fence_test && backend->fence_wait && backend->fence_delete));
+
+	struct LDrawStreamRing * ring = (struct LDrawStreamRing *) malloc(sizeof(struct LDrawStreamRing));
+	memset(ring, 0, sizeof(struct LDrawStreamRing));
+
+	ring->backend = backend;
+	ring->ref = ref;
+	ring->size = size;
+
+	return ring;
+
+}//end LDrawStreamRingCreate
+
+
+//========== LDrawStreamRingDestroy ==============================================
+//
+// Purpose:	Free the ring and its fences.
+//
+// Notes:	We do not wait for anything - the backend's buffer belongs to the
+//			caller, and deleting a GL buffer is safe with draws in flight.
+//
+//================================================================================
+void LDrawStreamRingDestroy(struct LDrawStreamRing * ring)
+{
+	int f;
+
+	assert(ring->map_size == 0);
+
+	for(f = 0; f < ring->frame_count; ++f)
+		ring->backend->fence_delete(ring->ref, ring->frames[f].fence);
+	free(ring);
+
+}//end LDrawStreamRingDestroy
+
+
+//========== LDrawStreamRingMap ==================================================
+//
+// Purpose:	Reserve size bytes for this frame and map them for writing.
+//
+// Notes:	Returns the write pointer; the offset of the range within the
+//			buffer comes back in out_offset.
+//
+//			In order of preference we take free space, space freed by frames
+//			the GPU has finished, space freed by waiting on the GPU, and
+//			finally a fresh buffer.
+//
+//================================================================================
+void * LDrawStreamRingMap(struct LDrawStreamRing * ring, int size, int * out_offset)
+{
+	assert(ring->map_size == 0);
+	assert(size > 0 && size <= ring->size);
+
+	int offset = try_alloc(ring, size);
+
+	if(offset < 0)
+	{
+		retire_signaled(ring);
+		offset = try_alloc(ring, size);
+	}
+
+	while(offset < 0 && ring->frame_count > 0)
+	{
+		wait_oldest(ring);
+		offset = try_alloc(ring, size);
+	}
+
+	if(offset < 0)
+	{
+		orphan_all(ring);
+		offset = try_alloc(ring, size);
+	}
+
+	assert(offset >= 0);
+
+	ring->head = offset + size;
+	ring->head = (ring->head + RING_ALIGN - 1) & ~(RING_ALIGN - 1);
+	if(ring->head > ring->size)
+		ring->head = ring->size;
+	ring->live = 1;
+	ring->frame_open = 1;
+
+	ring->map_offset = offset;
+	ring->map_size = size;
+
+	*out_offset = offset;
+	return ring->backend->map(ring->ref, offset, size);
+
+}//end LDrawStreamRingMap
+
+
+//========== LDrawStreamRingUnmap ================================================
+//
+// Purpose:	Finish writing the range from the last map.
+//
+//================================================================================
+void LDrawStreamRingUnmap(struct LDrawStreamRing * ring)
+{
+	assert(ring->map_size > 0);
+
+	ring->backend->unmap(ring->ref, ring->map_offset, ring->map_size);
+	ring->map_size = 0;
+
+}//end LDrawStreamRingUnmap
+
+
+//========== LDrawStreamRingEndFrame =============================================
+//
+// Purpose:	Mark the end of the draws that read this frame's ranges.
+//
+// Notes:	Without fences there is nothing to record: the frame's data stays
+//			reserved until the ring fills up and orphans the buffer.
+//
+//================================================================================
+void LDrawStreamRingEndFrame(struct LDrawStreamRing * ring)
+{
+	assert(ring->map_size == 0);
+
+	if(!ring->frame_open)
+		return;
+
+	if(ring->backend->fence_insert)
+	{
+		if(ring->frame_count == MAX_FRAMES)
+			wait_oldest(ring);
+
+		ring->frames[ring->frame_count].end = ring->head;
+		ring->frames[ring->frame_count].fence = ring->backend->fence_insert(ring->ref);
+		++ring->frame_count;
+	}
+
+	ring->frame_open = 0;
+
+}//end LDrawStreamRingEndFrame
+
+
+//========== LDrawStreamRingGetSize ==============================================
+//
+// Purpose:	Return the size of the buffer - the most that can be mapped at once.
+//
+//================================================================================
+int LDrawStreamRingGetSize(const struct LDrawStreamRing * ring)
+{
+	return ring->size;
+
+}//end LDrawStreamRingGetSize
+
+
+//========== LDrawStreamRingGetOrphanCount =======================================
+//
+// Purpose:	Return how many times the ring has fallen back to orphaning.
+//
+// Notes:	With working fences and a buffer big enough for a few frames of
+//			data, this should stay at zero.
+//
+//================================================================================
+int LDrawStreamRingGetOrphanCount(const struct LDrawStreamRing * ring)
+{
+	return ring->orphan_count;
+
+}//end LDrawStreamRingGetOrphanCount
+
+
+#pragma mark -
+#pragma mark MOCK BACKEND
+#pragma mark -
+
+// A range the mock has handed out.  Fence is the id of the fence dropped
+// after it, or 0 while its frame is still open.
+struct LDrawStreamMockRegion {
+	int							begin;
+	int							end;
+	int							fence;
+};
+
+struct LDrawStreamMock {
+	char *							mem;
+	int								size;
+
+	struct LDrawStreamMockRegion *	regions;
+	int								region_count;
+	int								region_capacity;
+
+	int								last_fence;			// Id of the newest fence handed out.
+	int								retired_fence;		// Every fence up to this one has signaled.
+
+	int								error_count;
+};
+
+
+//========== mock_map ============================================================
+//
+// Purpose:	Hand out a range of the mock's memory, checking that nothing the
+//			"GPU" may still read overlaps it.
+//
+//================================================================================
+static void * mock_map(void * ref, int offset, int size)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) ref;
+	int r, w;
+
+	if(offset < 0 || size <= 0 || offset + size > mock->size)
+	{
+		++mock->error_count;
+		return mock->mem;
+	}
+
+	// Forget ranges whose fences have signaled, and check the rest.
+	for(r = 0, w = 0; r < mock->region_count; ++r)
+	{
+		struct LDrawStreamMockRegion * reg = mock->regions + r;
+		if(reg->fence != 0 && reg->fence <= mock->retired_fence)
+			continue;
+		if(offset < reg->end && reg->begin < offset + size)
+			++mock->error_count;
+		mock->regions[w++] = *reg;
+	}
+	mock->region_count = w;
+
+	if(mock->region_count == mock->region_capacity)
+	{
+		mock->region_capacity = mock->region_capacity ? mock->region_capacity * 2 : 64;
+		mock->regions = (struct LDrawStreamMockRegion *) realloc(mock->regions, sizeof(struct LDrawStreamMockRegion) * mock->region_capacity);
+	}
+	mock->regions[mock->region_count].begin = offset;
+	mock->regions[mock->region_count].end = offset + size;
+	mock->regions[mock->region_count].fence = 0;
+	++mock->region_count;
+
+	return mock->mem + offset;
+
+}//end mock_map
+
+
+//========== mock_unmap ==========================================================
+//
+// Purpose:	Nothing to flush in system memory.
+//
+//================================================================================
+static void mock_unmap(void * ref, int offset, int size)
+{
+}//end mock_unmap
+
+
+//========== mock_orphan =========================================================
+//
+// Purpose:	New storage: no range handed out so far can conflict with what
+//			comes next.
+//
+//================================================================================
+static void mock_orphan(void * ref)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) ref;
+	mock->region_count = 0;
+
+}//end mock_orphan
+
+
+//========== mock_fence_insert ===================================================
+//
+// Purpose:	Put a fence behind every range handed out since the last one.
+//
+//================================================================================
+static void * mock_fence_insert(void * ref)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) ref;
+	int r;
+
+	++mock->last_fence;
+	for(r = 0; r < mock->region_count; ++r)
+		if(mock->regions[r].fence == 0)
+			mock->regions[r].fence = mock->last_fence;
+
+	return (void *) (intptr_t) mock->last_fence;
+
+}//end mock_fence_insert
+
+
+//========== mock_fence_test =====================================================
+//
+// Purpose:	A fence has signaled once the mock has been retired past it.
+//
+//================================================================================
+static int mock_fence_test(void * ref, void * fence)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) ref;
+	return (int) (intptr_t) fence <= mock->retired_fence;
+
+}//end mock_fence_test
+
+
+//========== mock_fence_wait =====================================================
+//
+// Purpose:	Waiting on a fence lets the "GPU" catch up to it.
+//
+//================================================================================
+static void mock_fence_wait(void * ref, void * fence)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) ref;
+	int id = (int) (intptr_t) fence;
+
+	if(id > mock->retired_fence)
+		mock->retired_fence = id;
+
+}//end mock_fence_wait
+
+
+//========== mock_fence_delete ===================================================
+//
+// Purpose:	Deleting a fence frees nothing - if its ranges are reused before
+//			it signals, the next map will catch that.
+//
+//================================================================================
+static void mock_fence_delete(void * ref, void * fence)
+{
+}//end mock_fence_delete
+
+
+static const struct LDrawStreamBackend mock_backend = {
+	mock_map,
+	mock_unmap,
+	mock_orphan,
+	mock_fence_insert,
+	mock_fence_test,
+	mock_fence_wait,
+	mock_fence_delete
+};
+
+
+//========== LDrawStreamMockCreate ===============================================
+//
+// Purpose:	Create a mock buffer of size bytes, with no fences outstanding.
+//
+//================================================================================
+struct LDrawStreamMock * LDrawStreamMockCreate(int size)
+{
+	struct LDrawStreamMock * mock = (struct LDrawStreamMock *) malloc(sizeof(struct LDrawStreamMock));
+	memset(mock, 0, sizeof(struct LDrawStreamMock));
+
+	mock->mem = (char *) malloc(size);
+	mock->size = size;
+
+	return mock;
+
+}//end LDrawStreamMockCreate
+
+
+//========== LDrawStreamMockDestroy ==============================================
+//
+// Purpose:	Free the mock and its memory.
+//
+//================================================================================
+void LDrawStreamMockDestroy(struct LDrawStreamMock * mock)
+{
+	free(mock->regions);
+	free(mock->mem);
+	free(mock);
+
+}//end LDrawStreamMockDestroy
+
+
+//========== LDrawStreamMockGetBackend ===========================================
+//
+// Purpose:	Return the backend table; pass the mock itself as the ring's ref.
+//
+//================================================================================
+const struct LDrawStreamBackend * LDrawStreamMockGetBackend(void)
+{
+	return &mock_backend;
+
+}//end LDrawStreamMockGetBackend
+
+
+//========== LDrawStreamMockRetire ===============================================
+//
+// Purpose:	Signal the next fence_count fences, as if the GPU had finished
+//			that many more frames.
+//
+//================================================================================
+void LDrawStreamMockRetire(struct LDrawStreamMock * mock, int fence_count)
+{
+	mock->retired_fence += fence_count;
+	if(mock->retired_fence > mock->last_fence)
+		mock->retired_fence = mock->last_fence;
+
+}//end LDrawStreamMockRetire
+
+
+//========== LDrawStreamMockGetPendingFences =====================================
+//
+// Purpose:	Return how many fences have been handed out but not signaled.
+//
+//================================================================================
+int LDrawStreamMockGetPendingFences(const struct LDrawStreamMock * mock)
+{
+	return mock->last_fence - mock->retired_fence;
+
+}//end LDrawStreamMockGetPendingFences
+
+
+//========== LDrawStreamMockGetErrorCount ========================================
+//
+// Purpose:	Return how many times a range was mapped while it, or part of it,
+//			might still be in use - or was out of bounds.
+//
+// Notes:	Anything but zero is a bug in the ring.
+//
+//================================================================================
+int LDrawStreamMockGetErrorCount(const struct LDrawStreamMock * mock)
+{
+	return mock->error_count;
+
+}//end LDrawStreamMockGetErrorCount
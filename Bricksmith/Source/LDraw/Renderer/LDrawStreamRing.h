@@ -0,0 +1,97 @@
+/*
+ *  LDrawStreamRing.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawStreamRing_H
+#define LDrawStreamRing_H
+
+//==============================================================================
+//
+// File: LDrawStreamRing
+//
+// The stream ring is the bookkeeping half of streaming vertex data to the
+// GPU: it hands out sub-ranges of one big buffer, in order, wrapping around
+// at the end, and makes sure that no range is written again while the GPU
+// might still be reading it.  It contains no GL calls at all - the buffer
+// itself is reached through a small backend of function pointers, so the
+// same ring drives a GL buffer (see LDrawDataStream.m) or plain memory (the
+// mock backend below).
+//
+// Usage:
+//
+// Each frame, the client maps any number of ranges (map, write, unmap - one
+// mapping open at a time), issues the draws that read them, and then calls
+// LDrawStreamRingEndFrame.  Ending a frame drops a fence from the backend
+// behind that frame's draws; the frame's ranges stay reserved until the
+// fence signals.
+//
+// When the space ahead of the write head runs out, the ring wraps to the
+// start of the buffer, retiring any frames whose fences have signaled.  If
+// the space it needs is still held by an older frame, it waits on that
+// frame's fence.
+//
+// Orphaning fallback: a backend with no fences (fence_insert is NULL) never
+// retires a frame, so the first time the ring fills up it asks the backend
+// to orphan the buffer - replace its storage, letting draws already issued
+// keep the old storage - and starts over at zero.  The same happens if the
+// current frame alone needs more than the whole buffer.  Either way, an
+// orphan throws away everything mapped so far, so allocations made earlier
+// in the same frame must already have been drawn from.  Clients that make
+// one allocation per frame never have to think about this.
+//
+// Mock backend:
+//
+// LDrawStreamMock is a backend over malloc'd memory whose fences signal
+// only when told to (LDrawStreamMockRetire), standing in for a GPU that is
+// some number of frames behind.  It remembers every range mapped under a
+// fence that has not signaled, and counts an error if the ring ever maps a
+// range overlapping one of them - that is the invariant the ring exists to
+// keep, checked independently of the ring's own bookkeeping.
+//
+//==============================================================================
+
+// Backend for a ring.  Ref is the backend's own object, passed back on every
+// call.  All offsets and sizes are in bytes.
+struct LDrawStreamBackend {
+
+	void *	(* map)(void * ref, int offset, int size);		// Map a range for writing, without waiting on the GPU.
+	void	(* unmap)(void * ref, int offset, int size);	// Flush and unmap the range last mapped.
+	void	(* orphan)(void * ref);							// Replace the buffer's storage; draws in flight keep the old.
+
+	void *	(* fence_insert)(void * ref);					// Fence behind all work so far.  NULL means no fences: orphan on wrap.
+	int		(* fence_test)(void * ref, void * fence);		// Non-zero if the fence has signaled.
+	void	(* fence_wait)(void * ref, void * fence);		// Block until the fence signals.
+	void	(* fence_delete)(void * ref, void * fence);		// Free a fence, signaled or not.
+
+};
+
+struct	LDrawStreamRing;
+
+struct LDrawStreamRing *	LDrawStreamRingCreate(int size, const struct LDrawStreamBackend * backend, void * ref);
+void						LDrawStreamRingDestroy(struct LDrawStreamRing * ring);
+
+void *						LDrawStreamRingMap(struct LDrawStreamRing * ring, int size, int * out_offset);
+void						LDrawStreamRingUnmap(struct LDrawStreamRing * ring);
+void						LDrawStreamRingEndFrame(struct LDrawStreamRing * ring);
+
+int							LDrawStreamRingGetSize(const struct LDrawStreamRing * ring);
+int							LDrawStreamRingGetOrphanCount(const struct LDrawStreamRing * ring);
+
+
+// CPU-only mock backend.
+struct	LDrawStreamMock;
+
+struct LDrawStreamMock *			LDrawStreamMockCreate(int size);
+void								LDrawStreamMockDestroy(struct LDrawStreamMock * mock);
+const struct LDrawStreamBackend *	LDrawStreamMockGetBackend(void);
+
+void								LDrawStreamMockRetire(struct LDrawStreamMock * mock, int fence_count);
+int									LDrawStreamMockGetPendingFences(const struct LDrawStreamMock * mock);
+int									LDrawStreamMockGetErrorCount(const struct LDrawStreamMock * mock);
+
+#endif /* LDrawStreamRing_H */
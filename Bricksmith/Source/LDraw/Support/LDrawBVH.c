@@ -0,0 +1,1161 @@
+/*
+ *  LDrawBVH.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawBVH.h"
+#include "GLMatrixMath.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#define BIN_COUNT 12				// SAH bins per axis.
+#define MAX_LEAF 4					// Leaves bigger than this are always split if they can be.
+#define MAX_DEPTH 48				// Past this depth we make a leaf no matter what, so the query stacks can't overflow.
+#define STACK_DEPTH (MAX_DEPTH + 2)
+#define COST_TRAVERSE 1.0f			// SAH cost of visiting a node, relative to testing one primitive.
+
+#if !defined(MIN)
+    #define MIN(A,B)	({ __typeof__(A) __a = (A); __typeof__(B) __b = (B); __a < __b ? __a : __b; })
+#endif
+
+#if !defined(MAX)
+    #define MAX(A,B)	({ __typeof__(A) __a = (A); __typeof__(B) __b = (B); __a < __b ? __b : __a; })
+#endif
+
+struct BVHNode {
+	float		aabb[6];			// min xyz, max xyz - the layout aabbToClipbox takes.
+	int			first;				// Leaf: first primitive.  Interior: index of the right child; the left is the next node.
+	int			count;				// Leaf: primitive count.  Interior: 0.
+};
+
+struct BVHTree {
+	struct BVHNode *	nodes;
+	int					node_count;
+	int					prim_count;
+	int					vert_count;		// Vertices per primitive: 3 or 2.
+	float *				coords[9];		// coords[3 * vertex + axis][primitive]
+	int *				ids;
+};
+
+struct LDrawBVH {
+	struct BVHTree		tris;
+	struct BVHTree		lines;
+};
+
+struct LDrawInstanceBVH {
+	struct BVHNode *	nodes;
+	int					node_count;
+	int					count;			// Instances, including the ones left out.
+	int *				ids;			// Instance IDs in leaf order.
+	float *				aabbs;			// 6 per instance, by ID.
+	int *				leaf_of;		// Leaf holding each ID, or -1 if left out.
+	int *				parent;			// Parent of each node, -1 for the root.
+};
+
+// Scratch for building one tree.
+struct BVHBuilder {
+	struct BVHTree *	tree;
+	const float *		verts;			// Caller's primitives, interleaved.
+	int *				order;			// Primitive indices, permuted as we partition.
+	float *				prim_aabb;		// 6 per primitive
+	float *				centroid;		// 3 per primitive
+};
+
+#pragma mark -
+
+static float half_area(const float aabb[6])
+{
+	float dx = aabb[3] - aabb[0];
+	float dy = aabb[4] - aabb[1];
+	float dz = aabb[5] - aabb[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static void aabb_empty(float aabb[6])
+{
+	aabb[0] = aabb[1] = aabb[2] = INFINITY;
+	aabb[3] = aabb[4] = aabb[5] = -INFINITY;
+}
+
+static void aabb_union(float aabb[6], const float other[6])
+{
+	int i;
+	for(i = 0; i < 3; ++i)
+	{
+		if(other[i] < aabb[i])			aabb[i] = other[i];
+		if(other[i + 3] > aabb[i + 3])	aabb[i + 3] = other[i + 3];
+	}
+}
+
+static void aabb_add_point(float aabb[6], const float p[3])
+{
+	int i;
+	for(i = 0; i < 3; ++i)
+	{
+		if(p[i] < aabb[i])			aabb[i] = p[i];
+		if(p[i] > aabb[i + 3])		aabb[i + 3] = p[i];
+	}
+}
+
+static int aabb_is_empty(const float aabb[6])
+{
+	return !(aabb[0] <= aabb[3] && aabb[1] <= aabb[4] && aabb[2] <= aabb[5]);
+}
+
+static Point3 tree_vertex(const struct BVHTree * tree, int v, int prim)
+{
+	Point3 p = { tree->coords[3 * v][prim], tree->coords[3 * v + 1][prim], tree->coords[3 * v + 2][prim] };
+	return p;
+}
+
+
+#pragma mark -
+#pragma mark BUILDING
+#pragma mark -
+
+//========== bin_of ==============================================================
+//
+// Purpose:	Which of the BIN_COUNT bins along an axis a centroid falls in.
+//
+//================================================================================
+static int bin_of(float c, float cmin, float scale)
+{
+	int b = (int) ((c - cmin) * scale);
+	if(b < 0)			b = 0;
+	if(b >= BIN_COUNT)	b = BIN_COUNT - 1;
+	return b;
+
+}//end bin_of
+
+
+//========== build_node ==========================================================
+//
+// Purpose:	Build the subtree for order[first..first+count), appending its
+//			nodes in depth-first order.  Returns the subtree's root index.
+//
+// Notes:	Binned SAH: we sort centroids into bins along each axis and take
+//			the bin boundary with the lowest estimated cost, or make a leaf if
+//			no split beats testing everything in the node.
+//
+//================================================================================
+static int build_node(struct BVHBuilder * b, int first, int count, int depth)
+{
+	struct BVHTree *	tree		= b->tree;
+	int					me			= tree->node_count++;
+	float				bounds[6];
+	float				cbounds[6];
+	int					i, axis;
+
+	aabb_empty(bounds);
+	aabb_empty(cbounds);
+	for(i = first; i < first + count; ++i)
+	{
+		aabb_union(bounds, b->prim_aabb + 6 * b->order[i]);
+		aabb_add_point(cbounds, b->centroid + 3 * b->order[i]);
+	}
+	memcpy(tree->nodes[me].aabb, bounds, sizeof(bounds));
+	tree->nodes[me].first = first;
+	tree->nodes[me].count = count;
+
+	if(count == 1 || depth >= MAX_DEPTH)
+		return me;
+
+	float	leaf_cost	= (float) count;
+	float	best_cost	= INFINITY;
+	int		best_axis	= -1;
+	int		best_bin	= 0;
+	float	parent_area	= half_area(bounds);
+
+	for(axis = 0; axis < 3; ++axis)
+	{
+		float extent = cbounds[axis + 3] - cbounds[axis];
+		if(extent <= 0.0f)
+			continue;
+
+		float	scale = BIN_COUNT / extent;
+		int		bin_count[BIN_COUNT] = { 0 };
+		float	bin_aabb[BIN_COUNT][6];
+		float	right_area[BIN_COUNT];
+		int		right_count[BIN_COUNT];
+		float	acc[6];
+		int		n;
+
+		for(n = 0; n < BIN_COUNT; ++n)
+			aabb_empty(bin_aabb[n]);
+		for(i = first; i < first + count; ++i)
+		{
+			int p = b->order[i];
+			int bin = bin_of(b->centroid[3 * p + axis], cbounds[axis], scale);
+			++bin_count[bin];
+			aabb_union(bin_aabb[bin], b->prim_aabb + 6 * p);
+		}
+
+		// Sweep from the right to get the cost of everything past each split,
+		// then from the left to price each split.
+		aabb_empty(acc);
+		n = 0;
+		for(i = BIN_COUNT - 1; i > 0; --i)
+		{
+			n += bin_count[i];
+			if(bin_count[i])
+				aabb_union(acc, bin_aabb[i]);
+			right_count[i] = n;
+			right_area[i] = n ? half_area(acc) : 0.0f;
+		}
+
+		aabb_empty(acc);
+		n = 0;
+		for(i = 0; i < BIN_COUNT - 1; ++i)
+		{
+			n += bin_count[i];
+			if(bin_count[i])
+				aabb_union(acc, bin_aabb[i]);
+			if(n == 0 || right_count[i + 1] == 0)
+				continue;
+
+			float cost = COST_TRAVERSE;
+			if(parent_area > 0.0f)
+				cost += (half_area(acc) * n + right_area[i + 1] * right_count[i + 1]) / parent_area;
+			else
+				cost += (float) count;
+			if(cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = i;
+			}
+		}
+	}
+
+	// All centroids in one spot: nothing to split on.
+	if(best_axis < 0)
+		return me;
+	if(best_cost >= leaf_cost && count <= MAX_LEAF)
+		return me;
+
+	// Partition in place: bins up to best_bin go left.
+	{
+		float	cmin	= cbounds[best_axis];
+		float	scale	= BIN_COUNT / (cbounds[best_axis + 3] - cmin);
+		int		lo		= first;
+		int		hi		= first + count - 1;
+
+		while(lo <= hi)
+		{
+			if(bin_of(b->centroid[3 * b->order[lo] + best_axis], cmin, scale) <= best_bin)
+				++lo;
+			else
+			{
+				int t = b->order[lo];
+				b->order[lo] = b->order[hi];
+				b->order[hi] = t;
+				--hi;
+			}
+		}
+
+		int left_count = lo - first;
+		assert(left_count > 0 && left_count < count);
+
+		build_node(b, first, left_count, depth + 1);
+		int right = build_node(b, lo, count - left_count, depth + 1);
+
+		tree->nodes[me].first = right;
+		tree->nodes[me].count = 0;
+	}
+
+	return me;
+
+}//end build_node
+
+
+//========== build_tree ==========================================================
+//
+// Purpose:	Build one tree over count primitives of vert_count vertices each,
+//			then copy them into the tree in leaf order, as SoA.
+//
+//================================================================================
+static void build_tree(struct BVHTree * tree, int count, int vert_count, const float * verts, const int * ids)
+{
+	struct BVHBuilder	b;
+	int					i, v, a;
+
+	memset(tree, 0, sizeof(*tree));
+	tree->prim_count = count;
+	tree->vert_count = vert_count;
+	if(count == 0)
+		return;
+
+	b.tree		= tree;
+	b.verts		= verts;
+	b.order		= (int *) malloc(sizeof(int) * count);
+	b.prim_aabb	= (float *) malloc(sizeof(float) * 6 * count);
+	b.centroid	= (float *) malloc(sizeof(float) * 3 * count);
+
+	for(i = 0; i < count; ++i)
+	{
+		const float * p = verts + 3 * vert_count * i;
+		b.order[i] = i;
+		aabb_empty(b.prim_aabb + 6 * i);
+		for(v = 0; v < vert_count; ++v)
+			aabb_add_point(b.prim_aabb + 6 * i, p + 3 * v);
+		for(a = 0; a < 3; ++a)
+			b.centroid[3 * i + a] = (b.prim_aabb[6 * i + a] + b.prim_aabb[6 * i + a + 3]) * 0.5f;
+	}
+
+	// A binary tree with at most one primitive per leaf has 2n-1 nodes.
+	tree->nodes = (struct BVHNode *) malloc(sizeof(struct BVHNode) * (2 * count - 1));
+	build_node(&b, 0, count, 0);
+	tree->nodes = (struct BVHNode *) realloc(tree->nodes, sizeof(struct BVHNode) * tree->node_count);
+
+	tree->ids = (int *) malloc(sizeof(int) * count);
+	tree->coords[0] = (float *) malloc(sizeof(float) * 3 * vert_count * count);
+	for(i = 1; i < 3 * vert_count; ++i)
+		tree->coords[i] = tree->coords[0] + i * count;
+
+	for(i = 0; i < count; ++i)
+	{
+		int src = b.order[i];
+		tree->ids[i] = ids[src];
+		for(a = 0; a < 3 * vert_count; ++a)
+			tree->coords[a][i] = verts[3 * vert_count * src + a];
+	}
+
+	free(b.order);
+	free(b.prim_aabb);
+	free(b.centroid);
+
+}//end build_tree
+
+
+//========== LDrawBVHCreate ======================================================
+//
+// Purpose:	Build a BVH over the given triangles and lines.
+//
+//================================================================================
+struct LDrawBVH * LDrawBVHCreate(
+						int				tri_count,
+						const float *	tri_vertices,
+						const int *		tri_ids,
+						int				line_count,
+						const float *	line_vertices,
+						const int *		line_ids)
+{
+	struct LDrawBVH * bvh = (struct LDrawBVH *) malloc(sizeof(struct LDrawBVH));
+
+	build_tree(&bvh->tris, tri_count, 3, tri_vertices, tri_ids);
+	build_tree(&bvh->lines, line_count, 2, line_vertices, line_ids);
+
+	return bvh;
+
+}//end LDrawBVHCreate
+
+
+//========== LDrawBVHDestroy =====================================================
+//
+// Purpose:	Free a BVH and everything in it.
+//
+//================================================================================
+void LDrawBVHDestroy(struct LDrawBVH * bvh)
+{
+	free(bvh->tris.nodes);
+	free(bvh->tris.ids);
+	free(bvh->tris.coords[0]);
+	free(bvh->lines.nodes);
+	free(bvh->lines.ids);
+	free(bvh->lines.coords[0]);
+	free(bvh);
+
+}//end LDrawBVHDestroy
+
+
+#pragma mark -
+#pragma mark RAY TEST
+#pragma mark -
+
+// Everything a ray query needs to carry down the tree.
+struct RayQuery {
+	Ray3			ray;				// World-space ray, for the exact tests.
+	Matrix4			transform;
+	float			tolerance;
+	int				cull;				// False if the transform can't be inverted - we test everything.
+	float			origin[3];			// Local-space ray, for the node tests.
+	float			inv_dir[3];
+	float			local_pad;			// line tolerance, in local units (at most)
+	int				nearest_only;
+	float			best_depth;
+	int				best_id;
+	LDrawBVHHit_f	hit_func;
+	void *			ref;
+};
+
+
+//========== ray_enters_node =====================================================
+//
+// Purpose:	Slab test of the local-space ray against a node's box, grown by
+//			pad.  On a hit, returns where the ray enters it.
+//
+// Notes:	Like the triangle test, this treats the ray as an infinite line;
+//			the directives report hits behind the ray origin too.
+//
+//================================================================================
+static int ray_enters_node(const struct RayQuery * q, const struct BVHNode * node, float pad, float * t_enter)
+{
+	float	t_min	= -INFINITY;
+	float	t_max	= INFINITY;
+	int		a;
+
+	for(a = 0; a < 3; ++a)
+	{
+		float t1 = (node->aabb[a] - pad - q->origin[a]) * q->inv_dir[a];
+		float t2 = (node->aabb[a + 3] + pad - q->origin[a]) * q->inv_dir[a];
+		if(t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+		if(t1 > t_min) t_min = t1;
+		if(t2 < t_max) t_max = t2;
+	}
+	*t_enter = t_min;
+	return t_min <= t_max;
+
+}//end ray_enters_node
+
+
+//========== ray_report ==========================================================
+//
+// Purpose:	Record one primitive hit, or just keep it if we want the nearest.
+//
+//================================================================================
+static void ray_report(struct RayQuery * q, int id, float depth)
+{
+	if(q->nearest_only)
+	{
+		if(depth < q->best_depth)
+		{
+			q->best_depth = depth;
+			q->best_id = id;
+		}
+	}
+	else
+		q->hit_func(id, depth, q->ref);
+
+}//end ray_report
+
+
+//========== ray_leaf ============================================================
+//
+// Purpose:	Run the directives' own ray tests on one leaf's primitives.
+//
+//================================================================================
+static void ray_leaf(struct RayQuery * q, const struct BVHTree * tree, int first, int count)
+{
+	int		i;
+	float	depth;
+
+	for(i = first; i < first + count; ++i)
+	{
+		if(tree->vert_count == 3)
+		{
+			Point3 v0 = V3MulPointByProjMatrix(tree_vertex(tree, 0, i), q->transform);
+			Point3 v1 = V3MulPointByProjMatrix(tree_vertex(tree, 1, i), q->transform);
+			Point3 v2 = V3MulPointByProjMatrix(tree_vertex(tree, 2, i), q->transform);
+
+			if(V3RayIntersectsTriangle(q->ray, v0, v1, v2, &depth, NULL))
+				ray_report(q, tree->ids[i], depth);
+		}
+		else
+		{
+			Segment3 segment = {
+				V3MulPointByProjMatrix(tree_vertex(tree, 0, i), q->transform),
+				V3MulPointByProjMatrix(tree_vertex(tree, 1, i), q->transform) };
+
+			if(V3RayIntersectsSegment(q->ray, segment, q->tolerance, &depth))
+				ray_report(q, tree->ids[i], depth);
+		}
+	}
+
+}//end ray_leaf
+
+
+//========== ray_tree ============================================================
+//
+// Purpose:	Walk one tree, nearer child first.
+//
+// Notes:	When we only want the nearest hit, any node the ray enters past
+//			the best hit so far can't contain a better one.
+//
+//================================================================================
+static void ray_tree(struct RayQuery * q, const struct BVHTree * tree, float pad)
+{
+	int		stack[STACK_DEPTH];
+	int		sp = 0;
+	float	t;
+
+	if(tree->node_count == 0)
+		return;
+
+	if(!q->cull)
+	{
+		ray_leaf(q, tree, 0, tree->prim_count);
+		return;
+	}
+
+	if(!ray_enters_node(q, tree->nodes, pad, &t))
+		return;
+	stack[sp++] = 0;
+
+	while(sp > 0)
+	{
+		int						n		= stack[--sp];
+		const struct BVHNode *	node	= tree->nodes + n;
+
+		if(q->nearest_only && ray_enters_node(q, node, pad, &t) && t > q->best_depth)
+			continue;
+
+		if(node->count)
+		{
+			ray_leaf(q, tree, node->first, node->count);
+			continue;
+		}
+
+		float	t_left, t_right;
+		int		hit_left	= ray_enters_node(q, tree->nodes + n + 1, pad, &t_left);
+		int		hit_right	= ray_enters_node(q, tree->nodes + node->first, pad, &t_right);
+
+		// Push the farther child first so the nearer one comes off next.
+		if(hit_left && hit_right)
+		{
+			if(t_left <= t_right)
+			{
+				stack[sp++] = node->first;
+				stack[sp++] = n + 1;
+			}
+			else
+			{
+				stack[sp++] = n + 1;
+				stack[sp++] = node->first;
+			}
+		}
+		else if(hit_left)
+			stack[sp++] = n + 1;
+		else if(hit_right)
+			stack[sp++] = node->first;
+		assert(sp <= STACK_DEPTH);
+	}
+
+}//end ray_tree
+
+
+//========== LDrawBVHRayTest =====================================================
+//
+// Purpose:	Report the primitives the pick ray hits.
+//
+// Notes:	The nodes are in the mesh's space, so we bring the ray into it
+//			with the inverse transform.  We don't normalize the direction, so
+//			distances along the local ray are the same as along the real one.
+//			The line tolerance is a distance from the ray; in local space it
+//			can be stretched by at most the inverse's largest singular value,
+//			and the Frobenius norm is a cheap bound on that.
+//
+//================================================================================
+void LDrawBVHRayTest(
+						const struct LDrawBVH *	bvh,
+						Ray3					ray,
+						Matrix4					transform,
+						float					line_tolerance,
+						int						nearest_only,
+						LDrawBVHHit_f			hit_func,
+						void *					ref)
+{
+	struct RayQuery		q;
+	int					a, r, c;
+
+	q.ray			= ray;
+	q.transform		= transform;
+	q.tolerance		= line_tolerance;
+	q.nearest_only	= nearest_only;
+	q.best_depth	= INFINITY;
+	q.best_id		= -1;
+	q.hit_func		= hit_func;
+	q.ref			= ref;
+	q.local_pad		= 0.0f;
+
+	// Only an invertible, non-projective transform keeps the ray a ray.
+	q.cull = transform.element[0][3] == 0.0f &&
+			 transform.element[1][3] == 0.0f &&
+			 transform.element[2][3] == 0.0f &&
+			 transform.element[3][3] == 1.0f &&
+			 fabsf(Matrix4x4Determinant(&transform)) > 1e-12f;
+
+	if(q.cull)
+	{
+		Matrix4	inverse		= Matrix4Invert(transform);
+		Point3	origin		= V3MulPointByProjMatrix(ray.origin, inverse);
+		Point3	ahead		= V3MulPointByProjMatrix(V3Add(ray.origin, ray.direction), inverse);
+		Vector3	dir			= V3Sub(ahead, origin);
+		float	local_dir[3] = { dir.x, dir.y, dir.z };
+		float	norm2		= 0.0f;
+
+		q.origin[0] = origin.x;
+		q.origin[1] = origin.y;
+		q.origin[2] = origin.z;
+		for(a = 0; a < 3; ++a)
+			q.inv_dir[a] = local_dir[a] != 0.0f ? 1.0f / local_dir[a] : copysignf(1e30f, local_dir[a]);
+
+		for(r = 0; r < 3; ++r)
+		for(c = 0; c < 3; ++c)
+			norm2 += inverse.element[r][c] * inverse.element[r][c];
+		q.local_pad = line_tolerance * sqrtf(norm2);
+	}
+
+	ray_tree(&q, &bvh->tris, 0.0f);
+	ray_tree(&q, &bvh->lines, q.local_pad);
+
+	if(nearest_only && q.best_id != -1)
+		hit_func(q.best_id, q.best_depth, ref);
+
+}//end LDrawBVHRayTest
+
+
+#pragma mark -
+#pragma mark SCREEN TESTS
+#pragma mark -
+
+//========== node_in_box =========================================================
+//
+// Purpose:	Conservative test of a node against a screen-space box, as
+//			VolumeCanIntersectBox does it.  Also returns the node's nearest
+//			depth.
+//
+//================================================================================
+static int node_in_box(const struct BVHNode * node, const GLfloat m[16], Box2 box, float * near_z)
+{
+	GLfloat ndc[6];
+
+	aabbToClipbox(node->aabb, m, ndc);
+	*near_z = ndc[2];
+
+	return !(V2BoxMinX(box) > ndc[3] ||
+			 V2BoxMaxX(box) < ndc[0] ||
+			 V2BoxMinY(box) > ndc[4] ||
+			 V2BoxMaxY(box) < ndc[1]);
+
+}//end node_in_box
+
+
+//========== clip_tri ============================================================
+//
+// Purpose:	Take a triangle to clip space and clip it, as the triangle
+//			directives do.  Returns the number of NDC triangles (9 floats each)
+//			written to ndc_tris.
+//
+//================================================================================
+static int clip_tri(const struct BVHTree * tree, int i, Matrix4 transform, float ndc_tris[18])
+{
+	Point4 c0 = V4MulPointByMatrix(V4FromPoint3(tree_vertex(tree, 0, i)), transform);
+	Point4 c1 = V4MulPointByMatrix(V4FromPoint3(tree_vertex(tree, 1, i)), transform);
+	Point4 c2 = V4MulPointByMatrix(V4FromPoint3(tree_vertex(tree, 2, i)), transform);
+
+	float h_tri[12] = {
+					c0.x, c0.y, c0.z, c0.w,
+					c1.x, c1.y, c1.z, c1.w,
+					c2.x, c2.y, c2.z, c2.w };
+
+	return clipTriangle(h_tri, ndc_tris);
+
+}//end clip_tri
+
+
+//========== box_leaf ============================================================
+//
+// Purpose:	Run the directives' own box tests on one leaf.  Returns true if we
+//			should stop.
+//
+//================================================================================
+static int box_leaf(const struct BVHTree * tree, int first, int count, Box2 bounds, Matrix4 transform,
+					int first_only, int * any_hit, LDrawBVHHit_f hit_func, void * ref)
+{
+	int i, t;
+
+	for(i = first; i < first + count; ++i)
+	{
+		int hit = 0;
+
+		if(tree->vert_count == 3)
+		{
+			float	ndc_tris[18];
+			int		tri_count = clip_tri(tree, i, transform, ndc_tris);
+
+			for(t = 0; t < tri_count && !hit; ++t)
+			{
+				Point2 tri[3] = {
+					V2Make(ndc_tris[t*9+0],ndc_tris[t*9+1]),
+					V2Make(ndc_tris[t*9+3],ndc_tris[t*9+4]),
+					V2Make(ndc_tris[t*9+6],ndc_tris[t*9+7]) };
+
+				hit = V2BoxIntersectsPolygon(bounds, tri, 3);
+			}
+		}
+		else
+		{
+			Point3 v0 = V3MulPointByProjMatrix(tree_vertex(tree, 0, i), transform);
+			Point3 v1 = V3MulPointByProjMatrix(tree_vertex(tree, 1, i), transform);
+			Point2 line[2] = { V2Make(v0.x, v0.y), V2Make(v1.x, v1.y) };
+
+			hit = V2BoxIntersectsPolygon(bounds, line, 2);
+		}
+
+		if(hit)
+		{
+			*any_hit = 1;
+			hit_func(tree->ids[i], 0.0f, ref);
+			if(first_only)
+				return 1;
+		}
+	}
+	return 0;
+
+}//end box_leaf
+
+
+//========== LDrawBVHBoxTest =====================================================
+//
+// Purpose:	Report the primitives that overlap a screen-space box.
+//
+//================================================================================
+int LDrawBVHBoxTest(
+						const struct LDrawBVH *	bvh,
+						Box2					bounds,
+						Matrix4					transform,
+						int						first_only,
+						LDrawBVHHit_f			hit_func,
+						void *					ref)
+{
+	const struct BVHTree *	trees[2]	= { &bvh->tris, &bvh->lines };
+	GLfloat					m[16];
+	int						any_hit		= 0;
+	int						stack[STACK_DEPTH];
+	int						k;
+	float					z;
+
+	Matrix4GetGLMatrix4(transform, m);
+
+	for(k = 0; k < 2; ++k)
+	{
+		const struct BVHTree *	tree	= trees[k];
+		int						sp		= 0;
+
+		if(tree->node_count == 0 || !node_in_box(tree->nodes, m, bounds, &z))
+			continue;
+		stack[sp++] = 0;
+
+		while(sp > 0)
+		{
+			int						n		= stack[--sp];
+			const struct BVHNode *	node	= tree->nodes + n;
+
+			if(node->count)
+			{
+				if(box_leaf(tree, node->first, node->count, bounds, transform, first_only, &any_hit, hit_func, ref))
+					return 1;
+				continue;
+			}
+
+			if(node_in_box(tree->nodes + node->first, m, bounds, &z))
+				stack[sp++] = node->first;
+			if(node_in_box(tree->nodes + n + 1, m, bounds, &z))
+				stack[sp++] = n + 1;
+			assert(sp <= STACK_DEPTH);
+		}
+	}
+
+	return any_hit;
+
+}//end LDrawBVHBoxTest
+
+
+//========== depth_leaf ==========================================================
+//
+// Purpose:	Run the directives' own depth tests on one leaf.
+//
+//================================================================================
+static void depth_leaf(const struct BVHTree * tree, int first, int count, Point2 pt, Box2 bounds, Matrix4 transform,
+					   float * best_depth, int * best_id)
+{
+	int i, t;
+
+	for(i = first; i < first + count; ++i)
+	{
+		Point3 probe = { pt.x, pt.y, *best_depth };
+
+		if(tree->vert_count == 3)
+		{
+			float	ndc_tris[18];
+			int		tri_count = clip_tri(tree, i, transform, ndc_tris);
+
+			for(t = 0; t < tri_count; ++t)
+			{
+				Point3 v0 = V3Make(ndc_tris[t*9+0],ndc_tris[t*9+1],ndc_tris[t*9+2]);
+				Point3 v1 = V3Make(ndc_tris[t*9+3],ndc_tris[t*9+4],ndc_tris[t*9+5]);
+				Point3 v2 = V3Make(ndc_tris[t*9+6],ndc_tris[t*9+7],ndc_tris[t*9+8]);
+
+				if(DepthOnTriangle(v0, v1, v2, &probe) && probe.z <= *best_depth)
+				{
+					*best_depth = probe.z;
+					*best_id = tree->ids[i];
+				}
+			}
+		}
+		else
+		{
+			Point3	v0			= V3MulPointByProjMatrix(tree_vertex(tree, 0, i), transform);
+			Point3	v1			= V3MulPointByProjMatrix(tree_vertex(tree, 1, i), transform);
+			float	tolerance2	= (bounds.size.width*bounds.size.width+bounds.size.height*bounds.size.height)*0.25;
+
+			if(DepthOnLineSegment(v0, v1, tolerance2, &probe) && probe.z <= *best_depth)
+			{
+				*best_depth = probe.z;
+				*best_id = tree->ids[i];
+			}
+		}
+	}
+
+}//end depth_leaf
+
+
+//========== LDrawBVHDepthTest ===================================================
+//
+// Purpose:	Find the nearest primitive under a screen-space point.
+//
+// Notes:	We visit nearer nodes first; once something is hit, any node
+//			whose nearest depth is behind it is skipped, exactly as
+//			VolumeCanIntersectPoint skips whole models.
+//
+//================================================================================
+int LDrawBVHDepthTest(
+						const struct LDrawBVH *	bvh,
+						Point2					pt,
+						Box2					bounds,
+						Matrix4					transform,
+						float *					best_depth)
+{
+	const struct BVHTree *	trees[2]	= { &bvh->tris, &bvh->lines };
+	Box2					cull[2]		= { bounds, bounds };
+	GLfloat					m[16];
+	int						best_id		= -1;
+	int						stack[STACK_DEPTH];
+	int						k;
+	float					z;
+
+	Matrix4GetGLMatrix4(transform, m);
+
+	// Lines hit within a circle around pt as wide as the box's diagonal, which
+	// reaches outside the box; cull line nodes against a square around it.
+	{
+		float radius = 0.5f * sqrtf(bounds.size.width * bounds.size.width + bounds.size.height * bounds.size.height);
+		cull[1].origin.x = MIN(V2BoxMinX(bounds), pt.x - radius);
+		cull[1].origin.y = MIN(V2BoxMinY(bounds), pt.y - radius);
+		cull[1].size.width = MAX(V2BoxMaxX(bounds), pt.x + radius) - cull[1].origin.x;
+		cull[1].size.height = MAX(V2BoxMaxY(bounds), pt.y + radius) - cull[1].origin.y;
+	}
+
+	for(k = 0; k < 2; ++k)
+	{
+		const struct BVHTree *	tree	= trees[k];
+		int						sp		= 0;
+
+		if(tree->node_count == 0 || !node_in_box(tree->nodes, m, cull[k], &z) || *best_depth < z)
+			continue;
+		stack[sp++] = 0;
+
+		while(sp > 0)
+		{
+			int						n		= stack[--sp];
+			const struct BVHNode *	node	= tree->nodes + n;
+
+			if(node->count)
+			{
+				depth_leaf(tree, node->first, node->count, pt, bounds, transform, best_depth, &best_id);
+				continue;
+			}
+
+			float	z_left, z_right;
+			int		in_left		= node_in_box(tree->nodes + n + 1, m, cull[k], &z_left) && z_left <= *best_depth;
+			int		in_right	= node_in_box(tree->nodes + node->first, m, cull[k], &z_right) && z_right <= *best_depth;
+
+			// Push the farther child first so the nearer one comes off next.
+			if(in_left && in_right)
+			{
+				if(z_left <= z_right)
+				{
+					stack[sp++] = node->first;
+					stack[sp++] = n + 1;
+				}
+				else
+				{
+					stack[sp++] = n + 1;
+					stack[sp++] = node->first;
+				}
+			}
+			else if(in_left)
+				stack[sp++] = n + 1;
+			else if(in_right)
+				stack[sp++] = node->first;
+			assert(sp <= STACK_DEPTH);
+		}
+	}
+
+	return best_id;
+
+}//end LDrawBVHDepthTest
+
+
+#pragma mark -
+#pragma mark INSTANCE TREE
+#pragma mark -
+
+//========== find_parents ========================================================
+//
+// Purpose:	Fill in the parent links and the leaf of each instance, which the
+//			depth-first layout doesn't need but refitting does.
+//
+//================================================================================
+static void find_parents(struct LDrawInstanceBVH * bvh)
+{
+	int n, i;
+
+	if(bvh->node_count)
+		bvh->parent[0] = -1;
+
+	for(n = 0; n < bvh->node_count; ++n)
+	{
+		const struct BVHNode * node = bvh->nodes + n;
+
+		if(node->count)
+		{
+			for(i = node->first; i < node->first + node->count; ++i)
+				bvh->leaf_of[bvh->ids[i]] = n;
+		}
+		else
+		{
+			bvh->parent[n + 1] = n;
+			bvh->parent[node->first] = n;
+		}
+	}
+
+}//end find_parents
+
+
+//========== LDrawInstanceBVHCreate ==============================================
+//
+// Purpose:	Build an instance BVH over count boxes.
+//
+// Notes:	This is the same binned SAH build as the mesh trees, with the
+//			instance boxes standing in for the primitives' boxes.
+//
+//================================================================================
+struct LDrawInstanceBVH * LDrawInstanceBVHCreate(
+								int				count,
+								const float *	aabbs)
+{
+	struct LDrawInstanceBVH *	bvh		= (struct LDrawInstanceBVH *) malloc(sizeof(struct LDrawInstanceBVH));
+	struct BVHTree				tree;
+	struct BVHBuilder			b;
+	int							used	= 0;
+	int							i, a;
+
+	memset(&tree, 0, sizeof(tree));
+
+	bvh->count		= count;
+	bvh->aabbs		= (float *) malloc(sizeof(float) * 6 * (count ? count : 1));
+	bvh->leaf_of	= (int *) malloc(sizeof(int) * (count ? count : 1));
+	bvh->ids		= (int *) malloc(sizeof(int) * (count ? count : 1));
+	memcpy(bvh->aabbs, aabbs, sizeof(float) * 6 * count);
+
+	b.tree		= &tree;
+	b.verts		= NULL;
+	b.order		= bvh->ids;
+	b.prim_aabb	= bvh->aabbs;
+	b.centroid	= (float *) malloc(sizeof(float) * 3 * (count ? count : 1));
+
+	for(i = 0; i < count; ++i)
+	{
+		bvh->leaf_of[i] = -1;
+		if(aabb_is_empty(aabbs + 6 * i))
+			continue;
+		b.order[used++] = i;
+		for(a = 0; a < 3; ++a)
+			b.centroid[3 * i + a] = (aabbs[6 * i + a] + aabbs[6 * i + a + 3]) * 0.5f;
+	}
+
+	if(used)
+	{
+		tree.nodes = (struct BVHNode *) malloc(sizeof(struct BVHNode) * (2 * used - 1));
+		build_node(&b, 0, used, 0);
+	}
+	free(b.centroid);
+
+	bvh->nodes		= tree.nodes;
+	bvh->node_count	= tree.node_count;
+	bvh->parent		= (int *) malloc(sizeof(int) * (tree.node_count ? tree.node_count : 1));
+	find_parents(bvh);
+
+	return bvh;
+
+}//end LDrawInstanceBVHCreate
+
+
+//========== LDrawInstanceBVHDestroy =============================================
+//
+// Purpose:	Free an instance BVH.
+//
+//================================================================================
+void LDrawInstanceBVHDestroy(struct LDrawInstanceBVH * bvh)
+{
+	free(bvh->nodes);
+	free(bvh->ids);
+	free(bvh->aabbs);
+	free(bvh->leaf_of);
+	free(bvh->parent);
+	free(bvh);
+
+}//end LDrawInstanceBVHDestroy
+
+
+//========== LDrawInstanceBVHUpdate ==============================================
+//
+// Purpose:	Give one instance a new box and refit every node above it.
+//
+// Notes:	Each node is rebuilt from its children rather than grown, so boxes
+//			shrink when an instance moves away as well as grow.
+//
+//================================================================================
+int LDrawInstanceBVHUpdate(
+								struct LDrawInstanceBVH *	bvh,
+								int							id,
+								const float					aabb[6])
+{
+	int n, i;
+
+	assert(id >= 0 && id < bvh->count);
+
+	memcpy(bvh->aabbs + 6 * id, aabb, sizeof(float) * 6);
+
+	n = bvh->leaf_of[id];
+	if(n == -1)
+		return aabb_is_empty(aabb);
+
+	{
+		struct BVHNode * leaf = bvh->nodes + n;
+
+		aabb_empty(leaf->aabb);
+		for(i = leaf->first; i < leaf->first + leaf->count; ++i)
+			if(!aabb_is_empty(bvh->aabbs + 6 * bvh->ids[i]))
+				aabb_union(leaf->aabb, bvh->aabbs + 6 * bvh->ids[i]);
+	}
+
+	for(n = bvh->parent[n]; n != -1; n = bvh->parent[n])
+	{
+		struct BVHNode * node = bvh->nodes + n;
+
+		aabb_empty(node->aabb);
+		if(!aabb_is_empty(bvh->nodes[n + 1].aabb))
+			aabb_union(node->aabb, bvh->nodes[n + 1].aabb);
+		if(!aabb_is_empty(bvh->nodes[node->first].aabb))
+			aabb_union(node->aabb, bvh->nodes[node->first].aabb);
+	}
+
+	return 1;
+
+}//end LDrawInstanceBVHUpdate
+
+
+//========== instance_node_in ===================================================
+//
+// Purpose:	Whether a node might hold anything under the box no farther than
+//			best_depth, as VolumeCanIntersectPoint tests it.  Also returns the
+//			node's nearest depth.
+//
+//================================================================================
+static int instance_node_in(const struct BVHNode * node, const GLfloat m[16], Box2 bounds, float best_depth, float * near_z)
+{
+	if(aabb_is_empty(node->aabb))
+		return 0;
+	return node_in_box(node, m, bounds, near_z) && *near_z <= best_depth;
+
+}//end instance_node_in
+
+
+//========== LDrawInstanceBVHDepthTest ===========================================
+//
+// Purpose:	Visit every instance that might be under a screen-space point,
+//			nearest first.
+//
+// Notes:	The visitor can only bring *best_depth closer, so we check each
+//			node's depth again when it comes off the stack: a node that was
+//			worth pushing may be entirely behind what its sibling found.
+//
+//================================================================================
+void LDrawInstanceBVHDepthTest(
+								const struct LDrawInstanceBVH *	bvh,
+								Box2							bounds,
+								Matrix4							transform,
+								float *							best_depth,
+								LDrawInstanceBVHVisit_f			visit_func,
+								void *							ref)
+{
+	GLfloat		m[16];
+	int			stack[STACK_DEPTH];
+	float		stack_z[STACK_DEPTH];
+	int			sp = 0;
+	float		z;
+	int			i;
+
+	if(bvh->node_count == 0)
+		return;
+
+	Matrix4GetGLMatrix4(transform, m);
+
+	if(!instance_node_in(bvh->nodes, m, bounds, *best_depth, &z))
+		return;
+	stack[sp] = 0;
+	stack_z[sp++] = z;
+
+	while(sp > 0)
+	{
+		int						n		= stack[--sp];
+		const struct BVHNode *	node	= bvh->nodes + n;
+
+		if(stack_z[sp] > *best_depth)
+			continue;
+
+		if(node->count)
+		{
+			for(i = node->first; i < node->first + node->count; ++i)
+				if(!aabb_is_empty(bvh->aabbs + 6 * bvh->ids[i]))
+					visit_func(bvh->ids[i], ref);
+			continue;
+		}
+
+		float	z_left, z_right;
+		int		in_left		= instance_node_in(bvh->nodes + n + 1, m, bounds, *best_depth, &z_left);
+		int		in_right	= instance_node_in(bvh->nodes + node->first, m, bounds, *best_depth, &z_right);
+
+		// Push the farther child first so the nearer one comes off next.
+		if(in_left && in_right && z_left > z_right)
+		{
+			stack[sp] = n + 1;			stack_z[sp++] = z_left;
+			stack[sp] = node->first;	stack_z[sp++] = z_right;
+		}
+		else
+		{
+			if(in_right)	{ stack[sp] = node->first;	stack_z[sp++] = z_right; }
+			if(in_left)		{ stack[sp] = n + 1;		stack_z[sp++] = z_left; }
+		}
+		assert(sp <= STACK_DEPTH);
+	}
+
+}//end LDrawInstanceBVHDepthTest
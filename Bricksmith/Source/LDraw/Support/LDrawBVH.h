@@ -0,0 +1,155 @@
+/*
+ *  LDrawBVH.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawBVH_H
+#define LDrawBVH_H
+
+#include "MatrixMath.h"
+
+//==============================================================================
+//
+// File: LDrawBVH
+//
+// The BVH is a bounding volume hierarchy over the triangles and lines of one
+// mesh (in practice, a flattened library part), so that picking can find the
+// primitives under the mouse without visiting every one of them.
+//
+// Usage:
+//
+// Create the BVH from a flat list of triangles (9 floats each) and a flat
+// list of lines (6 floats each), in the mesh's own coordinates.  Each
+// primitive carries an integer ID of the client's choosing; the queries
+// report hits by ID.  (A quad goes in as two triangles with the same ID.)
+// The BVH is immutable - if the mesh changes, throw it out and make a new
+// one.
+//
+// The three queries mirror the directives' hitTest, boxTest and depthTest:
+// they take the same transform the directives would, and the per-primitive
+// tests at the leaves are exactly the ones the directives run, so the
+// answers are the same - only the primitives that cannot possibly hit are
+// skipped.  Queries do not allocate and do not modify the BVH, so any number
+// of threads may query one BVH at once.
+//
+// Implementation:
+//
+// The tree is built top-down with a binned surface area heuristic, and
+// stored as a flat array of nodes in depth-first order: an interior node's
+// left child immediately follows it, and it stores the index of its right
+// child.  Triangle and line vertexes are stored as separate arrays per
+// coordinate (structure of arrays), sorted so that each leaf's primitives
+// are contiguous.  Triangles and lines get separate trees, since lines are
+// picked with a tolerance and triangles are not.
+//
+//==============================================================================
+//
+// File: LDrawInstanceBVH
+//
+// The instance BVH is the top level above the mesh BVHs: it is built over the
+// bounding boxes of a container's directives (in practice, mostly placed
+// parts, each box already run through the part's transform), so that a depth
+// query only descends into the directives that might be under the mouse.
+//
+// Usage:
+//
+// Create it from one box (min xyz, max xyz) per instance; the instance IDs
+// are the indices into that list.  Empty boxes (min > max, e.g. InvalidBox
+// for a hidden part) can't be hit and are left out of the tree.
+//
+// Unlike the mesh BVH, this one can be edited: when an instance's box changes,
+// LDrawInstanceBVHUpdate refits the tree around it in time proportional to
+// the tree's depth.  Refitting never changes the tree's shape, so after a lot
+// of big moves the tree gets worse (but never wrong); and an instance that was
+// left out because it was empty can't be put back.  Update returns false in
+// that case and the client must rebuild.
+//
+// The depth query visits candidate instances nearest first, calling back to
+// the client, which runs the instance's own depth test and so may lower
+// *best_depth, pruning the rest of the walk.
+//
+//==============================================================================
+
+struct	LDrawBVH;
+struct	LDrawInstanceBVH;
+
+// Called for each primitive hit.  Depth is the distance along the ray for
+// ray tests and 0 for box tests.
+typedef void (* LDrawBVHHit_f)(int id, float depth, void * ref);
+
+struct LDrawBVH *	LDrawBVHCreate(
+						int				tri_count,
+						const float *	tri_vertices,
+						const int *		tri_ids,
+						int				line_count,
+						const float *	line_vertices,
+						const int *		line_ids);
+void				LDrawBVHDestroy(struct LDrawBVH * bvh);
+
+// Ray test: like hitTest, "transform" takes the mesh into the ray's space and
+// lines are hit within line_tolerance of the ray.  If nearest_only is set,
+// only the nearest hit is reported, since that's all a hit record keeps per
+// credit object.
+void				LDrawBVHRayTest(
+						const struct LDrawBVH *	bvh,
+						Ray3					ray,
+						Matrix4					transform,
+						float					line_tolerance,
+						int						nearest_only,
+						LDrawBVHHit_f			hit_func,
+						void *					ref);
+
+// Box test: like boxTest, "transform" takes the mesh to clip space.  If
+// first_only is set, we stop at the first hit.  Returns true if anything hit.
+int					LDrawBVHBoxTest(
+						const struct LDrawBVH *	bvh,
+						Box2					bounds,
+						Matrix4					transform,
+						int						first_only,
+						LDrawBVHHit_f			hit_func,
+						void *					ref);
+
+// Depth test: like depthTest, finds the nearest primitive under pt (lines
+// within bounds).  Only hits no farther than *best_depth count; the ID of
+// the best one is returned, and *best_depth updated, or -1 if none.
+int					LDrawBVHDepthTest(
+						const struct LDrawBVH *	bvh,
+						Point2					pt,
+						Box2					bounds,
+						Matrix4					transform,
+						float *					best_depth);
+
+
+// Called for each instance that might be hit.  The callback should run the
+// real depth test, updating *best_depth (which the query also watches).
+typedef void (* LDrawInstanceBVHVisit_f)(int id, void * ref);
+
+struct LDrawInstanceBVH *	LDrawInstanceBVHCreate(
+								int				count,
+								const float *	aabbs);
+void						LDrawInstanceBVHDestroy(struct LDrawInstanceBVH * bvh);
+
+// Set a new box for one instance and refit the tree.  Returns false if the
+// instance is not in the tree and now has to be, meaning the tree must be
+// rebuilt.
+int							LDrawInstanceBVHUpdate(
+								struct LDrawInstanceBVH *	bvh,
+								int							id,
+								const float					aabb[6]);
+
+// Depth test: "transform" takes the instances to clip space; every instance
+// whose box might contain a point in bounds no farther than *best_depth is
+// visited, nearest box first.
+void						LDrawInstanceBVHDepthTest(
+								const struct LDrawInstanceBVH *	bvh,
+								Box2							bounds,
+								Matrix4							transform,
+								float *							best_depth,
+								LDrawInstanceBVHVisit_f			visit_func,
+								void *							ref);
+
+#endif /* LDrawBVH_H */
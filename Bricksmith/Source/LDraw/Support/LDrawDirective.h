@@ -87,6 +87,17 @@
 // Thus if the position of an object is changed 8 times between any external
 // code reading the object, an inval message is sent to observers only once.
 // See invalCache and revalCache for more details.
+//
+// BATCHING
+//
+// Bulk edits (pasting or rotating hundreds of parts) can still produce a storm
+// of messages, e.g. when a cache is read back between edits.  Wrap them in
+// beginObserverBatch/endObserverBatch: inside a batch, an observable only
+// records which flags and messages it owes its observers, and each observable
+// delivers them once, all together, when the outermost batch ends.  Until
+// then, observers don't know about the changes - don't trust their caches
+// inside a batch.  Batches are for the main thread; notifications from other
+// threads are always sent right away.
 
 @protocol LDrawObserver;
 @protocol LDrawObservable;
@@ -104,6 +115,15 @@ typedef enum CacheFlags {
     ContainerInvalid     = 4  // Subdirectives have changed in a way that may invalidate the cache
 } CacheFlagsT;
 
+// Counts of observer messages asked for and sent by batches; the difference
+// is what batching saved.
+typedef struct
+{
+	NSUInteger	requested;		// messages to observers asked for inside batches
+	NSUInteger	delivered;		// messages actually sent when the batches ended
+	
+} LDrawObserverBatchStatsT;
+
 typedef enum Message {
 
 	// The reference name of the MPD model has changed and observers should 
@@ -171,6 +191,8 @@ typedef enum Message {
 		NSMutableSet   *observers;			//Any observers watching us.  This is an array of NSValues of pointers to create WEAK references.
 	#endif
 	CacheFlagsT		invalFlags;
+	CacheFlagsT		batchedFlags;		// invalidations owed to observers at the end of the batch
+	NSUInteger		batchedMessages;	// bit (1 << MessageT) for each message owed likewise
 	BOOL			isSelected;
     NSString       *iconName;
 	
@@ -178,6 +200,9 @@ typedef enum Message {
 
 // Class methods
 +(NSString *)defaultIconName;
++ (void) beginObserverBatch;
++ (void) endObserverBatch;
++ (LDrawObserverBatchStatsT) observerBatchStats;
 
 // Initialization
 - (id) initWithLines:(NSArray *)lines inRange:(NSRange)range;
@@ -241,5 +266,6 @@ typedef enum Message {
 - (void) sendMessageToObservers:(MessageT) msg;					// Send a specific message to all observers.
 - (void) invalCache:(CacheFlagsT) flags;						// Invalidate cache bits - this notifies observers as needed.  Flags are the bits to invalidate, not the net effect.
 - (CacheFlagsT) revalCache:(CacheFlagsT) flags;						// Revalidate flags - no notifications are sent, but internals are updated.  Returns which flags _were_ dirty.
+- (CacheFlagsT) dirtyCacheFlags:(CacheFlagsT) flags;				// Which of the flags are dirty, without revalidating them.
 
 @end
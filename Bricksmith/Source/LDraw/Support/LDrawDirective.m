@@ -13,6 +13,23 @@
 #import "LDrawFile.h"
 #import "LDrawModel.h"
 #import "LDrawStep.h"
+
+// Observer batches: see beginObserverBatch.  Main thread only.
+static NSInteger				observerBatchDepth	= 0;
+static NSMutableArray			*observerBatchQueue	= nil;	// observables owing notifications, retained until delivered
+static LDrawObserverBatchStatsT	observerBatchStats	= {0, 0};
+
+
+@interface LDrawDirective ()
+
+- (NSUInteger) observerCount;
+- (BOOL) batchNotification:(CacheFlagsT)flags message:(NSUInteger)messageBit;
+- (void) deliverBatchedNotifications;
+- (void) notifyStatusInvalidated:(CacheFlagsT)flags;
+- (void) notifyMessage:(MessageT)msg;
+
+@end
+
 	
 @implementation LDrawDirective
 
@@ -999,19 +1016,8 @@
 //==============================================================================
 - (void) sendMessageToObservers:(MessageT) msg
 {
-	#if NEW_SET
-		MESSAGE_FOR_SET(observers,LDrawObserver,receiveMessage:msg who:self);
-	#else
-		NSSet * orig = [NSSet setWithSet:observers];
-		for (NSValue * o in orig)
-		{
-			if([observers containsObject:o])
-			{
-				id<LDrawObserver> oo = [o pointerValue];		
-				[oo receiveMessage:msg who:self];
-			}
-		}
-	#endif
+	if([self batchNotification:0 message:(1 << msg)] == NO)
+		[self notifyMessage:msg];
 }
 
 
@@ -1034,19 +1040,8 @@
 	{
 		invalFlags |= newFlags;
 		
-		#if NEW_SET
-			MESSAGE_FOR_SET(observers,LDrawObserver,statusInvalidated:newFlags who:self);
-		#else		
-			NSSet * orig = [NSSet setWithSet:observers];
-			for (NSValue * o in orig)
-			{
-				if([observers containsObject:o])
-				{
-					id<LDrawObserver> oo = [o pointerValue];			
-					[oo statusInvalidated:newFlags who:self];
-				}
-			}
-		#endif			
+		if([self batchNotification:newFlags message:0] == NO)
+			[self notifyStatusInvalidated:newFlags];
 	}
 }
 
@@ -1082,4 +1077,219 @@
 	return were_dirty;
 }
 
+
+//============== dirtyCacheFlags: ==============================================
+//
+// Purpose:		Returns which of the flags are dirty, leaving them dirty.
+//
+// Notes:		For a client that wants to know whether a cache needs
+//				rebuilding before committing to revalidate it.
+//
+//==============================================================================
+- (CacheFlagsT) dirtyCacheFlags:(CacheFlagsT) flags
+{
+	return flags & invalFlags;
+}
+
+
+#pragma mark -
+#pragma mark OBSERVER BATCHES
+#pragma mark -
+
+//---------- beginObserverBatch --------------------------------------[static]--
+//
+// Purpose:		Starts holding back observer notifications from all directives 
+//				until the matching endObserverBatch. Batches nest; only the 
+//				outermost one delivers. 
+//
+// Notes:		While a batch is open, an invalidation or message only marks 
+//				what the observable owes its observers, so no matter how many 
+//				times it happens each observer hears about it once. 
+//
+//------------------------------------------------------------------------------
++ (void) beginObserverBatch
+{
+	assert([NSThread isMainThread]);
+	
+	if(observerBatchQueue == nil)
+		observerBatchQueue = [[NSMutableArray alloc] init];
+	
+	++observerBatchDepth;
+	
+}//end beginObserverBatch
+
+
+//---------- endObserverBatch ----------------------------------------[static]--
+//
+// Purpose:		Closes a batch. When the outermost batch closes, every 
+//				observable that changed during it notifies its observers.
+//
+// Notes:		The batch is closed before delivering, so the cascade of 
+//				invalidations the deliveries set off up the tree goes out 
+//				immediately - it is already stopped at each level by the cache 
+//				flags. 
+//
+//------------------------------------------------------------------------------
++ (void) endObserverBatch
+{
+	NSArray *owing = nil;
+	
+	assert([NSThread isMainThread]);
+	assert(observerBatchDepth > 0);
+	
+	--observerBatchDepth;
+	if(observerBatchDepth == 0 && [observerBatchQueue count] > 0)
+	{
+		owing = observerBatchQueue;
+		observerBatchQueue = [[NSMutableArray alloc] init];
+		
+		[owing makeObjectsPerformSelector:@selector(deliverBatchedNotifications)];
+		[owing release];
+	}
+	
+}//end endObserverBatch
+
+
+//---------- observerBatchStats --------------------------------------[static]--
+//
+// Purpose:		Returns how many observer messages batches have been asked for 
+//				and how many they actually sent, since launch.
+//
+//------------------------------------------------------------------------------
++ (LDrawObserverBatchStatsT) observerBatchStats
+{
+	return observerBatchStats;
+	
+}//end observerBatchStats
+
+
+//========== observerCount =====================================================
+//
+// Purpose:		Returns how many observers are watching us.
+//
+//==============================================================================
+- (NSUInteger) observerCount
+{
+	#if NEW_SET
+		return LDrawFastSetCount(observers);
+	#else
+		return [observers count];
+	#endif
+	
+}//end observerCount
+
+
+//========== batchNotification:message: ========================================
+//
+// Purpose:		If a batch is open, records that we owe our observers these 
+//				flags and message, and returns YES. Otherwise returns NO and the 
+//				caller should notify right away. 
+//
+//==============================================================================
+- (BOOL) batchNotification:(CacheFlagsT)flags message:(NSUInteger)messageBit
+{
+	NSUInteger observerCount = 0;
+	
+	if(observerBatchDepth == 0 || [NSThread isMainThread] == NO)
+		return NO;
+	
+	observerCount = [self observerCount];
+	if(observerCount > 0)
+	{
+		observerBatchStats.requested += observerCount;
+		
+		if(self->batchedFlags == 0 && self->batchedMessages == 0)
+			[observerBatchQueue addObject:self];
+		
+		self->batchedFlags		|= flags;
+		self->batchedMessages	|= messageBit;
+	}
+	
+	return YES;
+	
+}//end batchNotification:message:
+
+
+//========== deliverBatchedNotifications =======================================
+//
+// Purpose:		Sends our observers everything we owe them from the batch that 
+//				just ended: one invalidation with all the flags, then each 
+//				message once. 
+//
+//==============================================================================
+- (void) deliverBatchedNotifications
+{
+	CacheFlagsT flags       = self->batchedFlags;
+	NSUInteger  messages    = self->batchedMessages;
+	MessageT    msg         = 0;
+	
+	self->batchedFlags		= 0;
+	self->batchedMessages	= 0;
+	
+	if(flags != 0)
+	{
+		observerBatchStats.delivered += [self observerCount];
+		[self notifyStatusInvalidated:flags];
+	}
+	
+	for(msg = MessageNameChanged; messages != 0; msg++)
+	{
+		if(messages & (1 << msg))
+		{
+			observerBatchStats.delivered += [self observerCount];
+			[self notifyMessage:msg];
+			messages &= ~(1 << msg);
+		}
+	}
+	
+}//end deliverBatchedNotifications
+
+
+//========== notifyStatusInvalidated: ==========================================
+//
+// Purpose:		Tells every observer that these cache flags are now invalid.
+//
+//==============================================================================
+- (void) notifyStatusInvalidated:(CacheFlagsT)flags
+{
+	#if NEW_SET
+		MESSAGE_FOR_SET(observers,LDrawObserver,statusInvalidated:flags who:self);
+	#else		
+		NSSet * orig = [NSSet setWithSet:observers];
+		for (NSValue * o in orig)
+		{
+			if([observers containsObject:o])
+			{
+				id<LDrawObserver> oo = [o pointerValue];			
+				[oo statusInvalidated:flags who:self];
+			}
+		}
+	#endif			
+	
+}//end notifyStatusInvalidated:
+
+
+//========== notifyMessage: ====================================================
+//
+// Purpose:		Sends a message to every observer.
+//
+//==============================================================================
+- (void) notifyMessage:(MessageT)msg
+{
+	#if NEW_SET
+		MESSAGE_FOR_SET(observers,LDrawObserver,receiveMessage:msg who:self);
+	#else
+		NSSet * orig = [NSSet setWithSet:observers];
+		for (NSValue * o in orig)
+		{
+			if([observers containsObject:o])
+			{
+				id<LDrawObserver> oo = [o pointerValue];		
+				[oo receiveMessage:msg who:self];
+			}
+		}
+	#endif
+	
+}//end notifyMessage:
+
 @end
@@ -0,0 +1,464 @@
+/*
+ *  LDrawDirectiveCodec.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawDirectiveCodec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define HEADER_SIZE			16
+#define PART_SIZE			(1 + 1 + 4 + 16 * 4 + 4 + 4)	// kind, flags, color, transform, name, icon
+#define STEP_SIZE			(1 + 1 + 1 + 3 * 4)			// kind, rotation type, flavor, rotation
+
+static const unsigned char codec_magic[4] = { 'L', 'D', 'C', 'D' };
+
+struct LDrawCodecWriter {
+	unsigned char *		records;
+	size_t				records_length;
+	size_t				records_capacity;
+	unsigned int		record_count;
+
+	char **				strings;
+	unsigned int		string_count;
+	unsigned int		string_capacity;
+	unsigned int *		string_slots;		// open hash: string index + 1, or 0
+	unsigned int		slot_count;			// power of 2
+
+	unsigned char *		output;
+	size_t				output_length;
+};
+
+
+#pragma mark -
+#pragma mark Bytes
+#pragma mark -
+
+//========== put_u32 / get_u32 ===================================================
+//
+// Purpose:	Little-endian integers and floats, whatever the host.
+//
+//================================================================================
+static void put_u32(unsigned char * p, uint32_t v)
+{
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char * p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put_f32(unsigned char * p, float f)
+{
+	uint32_t v;
+	memcpy(&v, &f, 4);
+	put_u32(p, v);
+}
+
+static float get_f32(const unsigned char * p)
+{
+	uint32_t	v = get_u32(p);
+	float		f;
+	memcpy(&f, &v, 4);
+	return f;
+}
+
+
+//========== reserve_records =====================================================
+//
+// Purpose:	Make room for count more bytes of records; returns where they go.
+//
+//================================================================================
+static unsigned char * reserve_records(struct LDrawCodecWriter * writer, size_t count)
+{
+	unsigned char * p;
+
+	if(writer->records_length + count > writer->records_capacity)
+	{
+		size_t new_capacity = writer->records_capacity ? writer->records_capacity : 1024;
+		while(new_capacity < writer->records_length + count)
+			new_capacity *= 2;
+		writer->records = (unsigned char *) realloc(writer->records, new_capacity);
+		writer->records_capacity = new_capacity;
+	}
+	p = writer->records + writer->records_length;
+	writer->records_length += count;
+	return p;
+
+}//end reserve_records
+
+
+#pragma mark -
+#pragma mark String Table
+#pragma mark -
+
+//========== hash_string =========================================================
+//
+// Purpose:	FNV-1a; names are short and only need to spread over the slots.
+//
+//================================================================================
+static unsigned int hash_string(const char * s)
+{
+	uint32_t h = 2166136261u;
+	while(*s)
+	{
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return h;
+
+}//end hash_string
+
+
+//========== intern_string =======================================================
+//
+// Purpose:	Returns the string's index in the table, adding it if it's new.
+//
+//================================================================================
+static uint32_t intern_string(struct LDrawCodecWriter * writer, const char * s)
+{
+	unsigned int	mask	= 0;
+	unsigned int	slot	= 0;
+	unsigned int	i		= 0;
+
+	if(s == NULL)
+		return LDRAW_CODEC_NO_STRING;
+
+	// Keep the slots under half full.
+	if((writer->string_count + 1) * 2 > writer->slot_count)
+	{
+		unsigned int new_count = writer->slot_count ? writer->slot_count * 2 : 64;
+		free(writer->string_slots);
+		writer->string_slots = (unsigned int *) calloc(new_count, sizeof(unsigned int));
+		writer->slot_count = new_count;
+		for(i = 0; i < writer->string_count; ++i)
+		{
+			slot = hash_string(writer->strings[i]) & (new_count - 1);
+			while(writer->string_slots[slot])
+				slot = (slot + 1) & (new_count - 1);
+			writer->string_slots[slot] = i + 1;
+		}
+	}
+
+	mask = writer->slot_count - 1;
+	slot = hash_string(s) & mask;
+	while(writer->string_slots[slot])
+	{
+		i = writer->string_slots[slot] - 1;
+		if(strcmp(writer->strings[i], s) == 0)
+			return i;
+		slot = (slot + 1) & mask;
+	}
+
+	if(writer->string_count == writer->string_capacity)
+	{
+		writer->string_capacity = writer->string_capacity ? writer->string_capacity * 2 : 32;
+		writer->strings = (char **) realloc(writer->strings, writer->string_capacity * sizeof(char *));
+	}
+	writer->strings[writer->string_count] = strdup(s);
+	writer->string_slots[slot] = ++writer->string_count;
+
+	return writer->string_count - 1;
+
+}//end intern_string
+
+
+#pragma mark -
+#pragma mark Writer
+#pragma mark -
+
+//========== LDrawCodecWriterCreate ==============================================
+//
+// Purpose:	Create a writer with no records.
+//
+//================================================================================
+struct LDrawCodecWriter * LDrawCodecWriterCreate(void)
+{
+	struct LDrawCodecWriter * writer = (struct LDrawCodecWriter *) malloc(sizeof(struct LDrawCodecWriter));
+	memset(writer, 0, sizeof(struct LDrawCodecWriter));
+	return writer;
+
+}//end LDrawCodecWriterCreate
+
+
+//========== LDrawCodecWriterDestroy =============================================
+//
+// Purpose:	Free the writer and the bytes it finished with.
+//
+//================================================================================
+void LDrawCodecWriterDestroy(struct LDrawCodecWriter * writer)
+{
+	unsigned int i;
+
+	for(i = 0; i < writer->string_count; ++i)
+		free(writer->strings[i]);
+	free(writer->strings);
+	free(writer->string_slots);
+	free(writer->records);
+	free(writer->output);
+	free(writer);
+
+}//end LDrawCodecWriterDestroy
+
+
+//========== LDrawCodecWriteRecord ===============================================
+//
+// Purpose:	Append one record.  Only the fields for its kind are read.
+//
+//================================================================================
+void LDrawCodecWriteRecord(struct LDrawCodecWriter * writer, const struct LDrawCodecRecord * record)
+{
+	unsigned char *	p = NULL;
+	int				i = 0;
+
+	assert(writer->output == NULL);
+
+	switch(record->kind)
+	{
+		case codec_record_part:
+			p = reserve_records(writer, PART_SIZE);
+			p[0] = codec_record_part;
+			p[1] = (unsigned char) record->flags;
+			put_u32(p + 2, (uint32_t) record->color_code);
+			for(i = 0; i < 16; ++i)
+				put_f32(p + 6 + 4 * i, record->transform[i]);
+			put_u32(p + 70, intern_string(writer, record->name ? record->name : ""));
+			put_u32(p + 74, intern_string(writer, record->icon_name));
+			break;
+
+		case codec_record_step:
+			p = reserve_records(writer, STEP_SIZE);
+			p[0] = codec_record_step;
+			p[1] = (unsigned char) record->rotation_type;
+			p[2] = (unsigned char) record->flavor;
+			for(i = 0; i < 3; ++i)
+				put_f32(p + 3 + 4 * i, record->rotation[i]);
+			break;
+
+		case codec_record_step_end:
+			p = reserve_records(writer, 1);
+			p[0] = codec_record_step_end;
+			break;
+
+		case codec_record_archived:
+			p = reserve_records(writer, 5 + record->length);
+			p[0] = codec_record_archived;
+			put_u32(p + 1, (uint32_t) record->length);
+			memcpy(p + 5, record->bytes, record->length);
+			break;
+
+		default:
+			assert(!"unknown codec record");
+			return;
+	}
+	writer->record_count++;
+
+}//end LDrawCodecWriteRecord
+
+
+//========== LDrawCodecWriterFinish ==============================================
+//
+// Purpose:	Put the header, records and string table together.
+//
+//================================================================================
+const void * LDrawCodecWriterFinish(struct LDrawCodecWriter * writer, size_t * length)
+{
+	size_t			strings_length	= 4;
+	size_t			string_length	= 0;
+	unsigned char *	p				= NULL;
+	unsigned int	i				= 0;
+
+	if(writer->output == NULL)
+	{
+		for(i = 0; i < writer->string_count; ++i)
+			strings_length += 4 + strlen(writer->strings[i]) + 1;
+
+		writer->output_length = HEADER_SIZE + writer->records_length + strings_length;
+		writer->output = (unsigned char *) malloc(writer->output_length);
+
+		p = writer->output;
+		memcpy(p, codec_magic, 4);
+		put_u32(p + 4, LDRAW_CODEC_VERSION);
+		put_u32(p + 8, writer->record_count);
+		put_u32(p + 12, (uint32_t)(HEADER_SIZE + writer->records_length));
+		p += HEADER_SIZE;
+
+		if(writer->records_length)
+			memcpy(p, writer->records, writer->records_length);
+		p += writer->records_length;
+
+		put_u32(p, writer->string_count);
+		p += 4;
+		for(i = 0; i < writer->string_count; ++i)
+		{
+			string_length = strlen(writer->strings[i]);
+			put_u32(p, (uint32_t) string_length);
+			memcpy(p + 4, writer->strings[i], string_length + 1);
+			p += 4 + string_length + 1;
+		}
+	}
+
+	*length = writer->output_length;
+	return writer->output;
+
+}//end LDrawCodecWriterFinish
+
+
+#pragma mark -
+#pragma mark Reader
+#pragma mark -
+
+//========== LDrawCodecReaderOpen ================================================
+//
+// Purpose:	Check the header and index the string table.
+//
+//================================================================================
+int LDrawCodecReaderOpen(struct LDrawCodecReader * reader, const void * bytes, size_t length)
+{
+	const unsigned char *	p				= (const unsigned char *) bytes;
+	size_t					position		= 0;
+	uint32_t				strings_offset	= 0;
+	uint32_t				string_length	= 0;
+	unsigned int			i				= 0;
+
+	memset(reader, 0, sizeof(struct LDrawCodecReader));
+
+	if(length < HEADER_SIZE || memcmp(p, codec_magic, 4) != 0 || get_u32(p + 4) != LDRAW_CODEC_VERSION)
+		return -1;
+
+	strings_offset = get_u32(p + 12);
+	if(strings_offset < HEADER_SIZE || strings_offset > length - 4)
+		return -1;
+
+	reader->bytes			= p;
+	reader->length			= length;
+	reader->position		= HEADER_SIZE;
+	reader->records_end		= strings_offset;
+	reader->records_left	= get_u32(p + 8);
+	reader->string_count	= get_u32(p + strings_offset);
+
+	// Each string takes at least 5 bytes, which bounds the count before we
+	// allocate for it.
+	position = strings_offset + 4;
+	if(reader->string_count > (length - position) / 5)
+		return -1;
+
+	reader->strings = (const char **) malloc((reader->string_count ? reader->string_count : 1) * sizeof(char *));
+	for(i = 0; i < reader->string_count; ++i)
+	{
+		if(length - position < 5)
+			break;
+		string_length = get_u32(p + position);
+		if(string_length > length - position - 5 || p[position + 4 + string_length] != 0)
+			break;
+		reader->strings[i] = (const char *)(p + position + 4);
+		position += 4 + string_length + 1;
+	}
+	if(i < reader->string_count)
+	{
+		LDrawCodecReaderClose(reader);
+		return -1;
+	}
+
+	return 0;
+
+}//end LDrawCodecReaderOpen
+
+
+//========== LDrawCodecReaderClose ===============================================
+//
+// Purpose:	Free the string index.  The bytes are the caller's.
+//
+//================================================================================
+void LDrawCodecReaderClose(struct LDrawCodecReader * reader)
+{
+	free(reader->strings);
+	reader->strings = NULL;
+	reader->string_count = 0;
+
+}//end LDrawCodecReaderClose
+
+
+//========== LDrawCodecReadRecord ================================================
+//
+// Purpose:	Read the next record.
+//
+//================================================================================
+int LDrawCodecReadRecord(struct LDrawCodecReader * reader, struct LDrawCodecRecord * record)
+{
+	const unsigned char *	p			= reader->bytes + reader->position;
+	size_t					available	= reader->records_end - reader->position;
+	uint32_t				name		= 0;
+	uint32_t				icon		= 0;
+	int						i			= 0;
+
+	if(reader->records_left == 0)
+		return (available == 0 && reader->step_depth == 0) ? 0 : -1;
+	if(available < 1)
+		return -1;
+
+	memset(record, 0, sizeof(struct LDrawCodecRecord));
+	record->kind = p[0];
+
+	switch(record->kind)
+	{
+		case codec_record_part:
+			if(available < PART_SIZE)
+				return -1;
+			name = get_u32(p + 70);
+			icon = get_u32(p + 74);
+			if(name >= reader->string_count || (icon != LDRAW_CODEC_NO_STRING && icon >= reader->string_count))
+				return -1;
+			record->flags		= p[1];
+			record->color_code	= (int) get_u32(p + 2);
+			for(i = 0; i < 16; ++i)
+				record->transform[i] = get_f32(p + 6 + 4 * i);
+			record->name		= reader->strings[name];
+			record->icon_name	= icon == LDRAW_CODEC_NO_STRING ? NULL : reader->strings[icon];
+			reader->position += PART_SIZE;
+			break;
+
+		case codec_record_step:
+			if(available < STEP_SIZE || reader->step_depth != 0)
+				return -1;
+			record->rotation_type	= p[1];
+			record->flavor			= p[2];
+			for(i = 0; i < 3; ++i)
+				record->rotation[i] = get_f32(p + 3 + 4 * i);
+			reader->step_depth = 1;
+			reader->position += STEP_SIZE;
+			break;
+
+		case codec_record_step_end:
+			if(reader->step_depth != 1)
+				return -1;
+			reader->step_depth = 0;
+			reader->position += 1;
+			break;
+
+		case codec_record_archived:
+			if(available < 5 || get_u32(p + 1) > available - 5)
+				return -1;
+			record->length	= get_u32(p + 1);
+			record->bytes	= p + 5;
+			reader->position += 5 + record->length;
+			break;
+
+		default:
+			return -1;
+	}
+	reader->records_left--;
+
+	return 1;
+
+}//end LDrawCodecReadRecord
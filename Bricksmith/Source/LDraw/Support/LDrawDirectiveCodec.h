@@ -0,0 +1,112 @@
+/*
+ *  LDrawDirectiveCodec.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawDirectiveCodec_H
+#define LDrawDirectiveCodec_H
+
+#include <stddef.h>
+
+//==============================================================================
+//
+// File: LDrawDirectiveCodec
+//
+// The directive codec is a flat binary encoding of directive trees, used to
+// put directives on the pasteboard for copy, paste, duplicate and drag.  It
+// exists because keyed archiving builds an object graph per part; a codec
+// record for a part is just its color, transform and name.
+//
+// Usage:
+//
+// To encode, create a writer, write records in tree order, then finish to get
+// the bytes (owned by the writer until it is destroyed).  A step is written as
+// a begin record, its children, and an end record; steps may not nest.
+// Directives the codec has no record for are written as "archived" records -
+// opaque bytes the caller made some other way (the app uses a keyed archive).
+//
+// To decode, open a reader on the bytes and call LDrawCodecReadRecord until it
+// returns 0.  Strings and archived bytes in a record point into the encoded
+// bytes, so they must outlive the reader's use of them.  The reader checks
+// everything it reads: corrupt or truncated data, or data from another
+// version, fails with -1 rather than crashing.
+//
+// Implementation:
+//
+// All numbers are little-endian; floats are IEEE single precision.  The data
+// is a header (magic, version, record count, string table offset), the
+// records, then the string table.  Each record is a one-byte kind and a fixed
+// payload for that kind.  Names are stored once in the string table - a copy
+// of a thousand 3001s spells "3001.dat" once - and records refer to them by
+// index.
+//
+//==============================================================================
+
+#define LDRAW_CODEC_VERSION		1
+
+#define LDRAW_CODEC_NO_STRING	0xFFFFFFFFu		// String index for "none".
+
+enum {
+	codec_record_part		= 1,		// An LDrawPart.
+	codec_record_step		= 2,		// An LDrawStep; its children follow.
+	codec_record_step_end	= 3,		// Closes the step.
+	codec_record_archived	= 4			// Any other directive, as opaque bytes.
+};
+
+enum {
+	codec_flag_hidden		= 1
+};
+
+struct LDrawCodecRecord {
+	int					kind;				// codec_record_
+
+	// Parts
+	int					flags;				// codec_flag_ bits
+	int					color_code;			// LDrawColorT
+	float				transform[16];		// GL (column-major) order
+	const char *		name;				// display name
+	const char *		icon_name;			// or NULL
+
+	// Steps
+	int					rotation_type;		// LDrawStepRotationT
+	int					flavor;				// LDrawStepFlavorT
+	float				rotation[3];
+
+	// Archived directives
+	const void *		bytes;
+	size_t				length;
+};
+
+struct LDrawCodecWriter;
+
+struct LDrawCodecWriter *	LDrawCodecWriterCreate(void);
+void						LDrawCodecWriterDestroy(struct LDrawCodecWriter * writer);
+
+void						LDrawCodecWriteRecord(struct LDrawCodecWriter * writer, const struct LDrawCodecRecord * record);
+
+// Returns the encoded bytes and their length.  No more records may be written.
+const void *				LDrawCodecWriterFinish(struct LDrawCodecWriter * writer, size_t * length);
+
+struct LDrawCodecReader {
+	const unsigned char *	bytes;
+	size_t					length;
+	size_t					position;		// next record
+	size_t					records_end;	// start of the string table
+	unsigned int			records_left;
+	unsigned int			string_count;
+	const char **			strings;		// into bytes
+	int						step_depth;
+};
+
+// Returns 0, or -1 if the bytes aren't codec data of this version.
+int							LDrawCodecReaderOpen(struct LDrawCodecReader * reader, const void * bytes, size_t length);
+void						LDrawCodecReaderClose(struct LDrawCodecReader * reader);
+
+// Returns 1 and fills in the record, 0 at the end, or -1 if the data is bad.
+int							LDrawCodecReadRecord(struct LDrawCodecReader * reader, struct LDrawCodecRecord * record);
+
+#endif /* LDrawDirectiveCodec_H */
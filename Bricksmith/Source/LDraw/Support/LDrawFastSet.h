@@ -80,6 +80,11 @@ typedef struct {
 		([this.obj.mutable_set containsObject:[NSValue valueWithPointer:p]] ? 1 : 0) :		\
 		((this.ptr.p1 == p || this.ptr.p2 == p) ? 1 : 0))
 
+#define LDrawFastSetCount(this) \
+	(this.ptr.p1 ?																			\
+		(this.ptr.p2 ? 2 : 1) :																\
+		(this.ptr.p2 ? [this.obj.mutable_set count] : 0))
+
 #define LDrawFastSetInit(this) \
 	do {																					\
 		this.ptr.p1 = this.ptr.p2 = NULL;													\
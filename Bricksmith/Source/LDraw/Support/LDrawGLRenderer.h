@@ -19,6 +19,8 @@
 //Forward declarations
 @class LDrawDirective;
 @class LDrawDragHandle;
+@class LDrawPickingBuffer;
+struct LDrawDataStream;
 @protocol LDrawGLRendererDelegate;
 @protocol LDrawGLCameraScroller;
 
@@ -69,6 +71,8 @@ typedef enum
 	ViewOrientationT        viewOrientation;		// our orientation
 	NSTimeInterval			fpsStartTime;
 	NSInteger				framesSinceStartTime;
+	struct LDrawDataStream	*dataStream;			// streams instance data to the GPU; created on first draw
+	LDrawPickingBuffer		*pickingBuffer;			// what is visible where, drawn on the CPU; nil until needed
 	
 	// Event Tracking
 	float					gridSpacing;
@@ -83,6 +87,7 @@ typedef enum
 	Point3                  initialDragLocation;	// point in model where part was positioned at draggingEntered
 	Vector3					nudgeVector;			// direction of nudge action (valid only in nudgeAction callback)
 	LDrawDragHandle			*activeDragHandle;		// drag handle hit on last mouse-down (or nil)
+	BOOL					marqueeSelectsVisibleOnly;	// marquee picks only what can be seen, not what is behind it
 }
 
 // Initialization
@@ -117,6 +122,7 @@ typedef enum
 - (void) setForwardAction:(SEL)newAction;
 - (void) setGridSpacing:(float)newValue;
 - (void) setLDrawDirective:(LDrawDirective *) newFile;
+- (void) setMarqueeSelectsVisibleOnly:(BOOL)flag;
 - (void) setMaximumVisibleSize:(Size2)size;						// This is how we find out that the visible frame of our window is bigger or smaller
 - (void) setNudgeAction:(SEL)newAction;
 - (void) setProjectionMode:(ProjectionModeT) newProjectionMode;
@@ -165,6 +171,7 @@ typedef enum
 // Utilities
 //- (NSArray *) getDirectivesUnderPoint:(Point2)point_view amongDirectives:(NSArray *)directives fastDraw:(BOOL)fastDraw;
 - (NSArray *) getDirectivesUnderRect:(Box2)rect_view amongDirectives:(NSArray *)directives fastDraw:(BOOL)fastDraw;
+- (LDrawPickingBuffer *) pickingBuffer;
 //- (NSArray *) getPartsFromHits:(NSDictionary *)hits;
 - (void) publishMouseOverPoint:(Point2)viewPoint;
 - (void) setZoomPercentage:(CGFloat)newPercentage preservePoint:(Point2)viewPoint;		// This and setZoomPercentage are how we zoom.
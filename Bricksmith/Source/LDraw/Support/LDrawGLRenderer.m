@@ -27,9 +27,11 @@
 #import "LDrawFile.h"
 #import "LDrawModel.h"
 #import "LDrawPart.h"
+#import "LDrawPickingBuffer.h"
 #import "LDrawStep.h"
 #import "LDrawUtilities.h"
 #import "LDrawShaderRenderer.h"
+#import "LDrawDataStream.h"
 #include "LDrawVertexes.h"
 #include "OpenGLUtilities.h"
 #include "MacLDraw.h"
@@ -40,6 +42,8 @@
 #define DEBUG_BOUNDING_BOX			0	// attempts to draw debug bounding box visualization on the model.
 
 #define NEW_RENDERER				1	// runs Ben's new shader-based renderer, not 2.6-era fixed-function renderer.
+#define DATA_STREAM_SIZE			(16 * 1024 * 1024)	// bytes of per-frame instance data we can have in flight to the GPU.
+#define PICKING_BUFFER_SCALE		0.5	// resolution of the CPU picking buffer relative to the viewport.
 
 
 #define DEBUG_DRAWING				0	// print fps of drawing, and never fall back to bounding boxes no matter how slow.
@@ -254,7 +258,15 @@
 	
 	#else
 
-		LDrawShaderRenderer * ren = [[LDrawShaderRenderer alloc] initWithScale:[self zoomPercentageForGL]/100. modelView:[camera getModelView] projection:[camera getProjection]];	
+		// The stream lives as long as we do, so it can recycle its buffer frame 
+		// after frame instead of reallocating it. 
+		if(self->dataStream == NULL)
+			self->dataStream = LDrawDataStreamCreate(DATA_STREAM_SIZE);
+	
+		LDrawShaderRenderer * ren = [[LDrawShaderRenderer alloc] initWithScale:[self zoomPercentageForGL]/100. 
+																	modelView:[camera getModelView] 
+																   projection:[camera getProjection]
+																	   stream:self->dataStream];	
 		[self->fileBeingDrawn drawSelf:ren];
 		[ren release];
 
@@ -845,11 +857,28 @@
 					 object:self->fileBeingDrawn ];
 	}
 	
+	[self->pickingBuffer release];
+	self->pickingBuffer = nil;
+	
 	[self updateRotationCenter];
 	
 }//end setLDrawDirective:
 
 
+//========== setMarqueeSelectsVisibleOnly: =====================================
+//
+// Purpose:		When set, marquee selection picks only the parts which can 
+//				actually be seen inside the marquee, not the ones hidden behind 
+//				them. 
+//
+//==============================================================================
+- (void) setMarqueeSelectsVisibleOnly:(BOOL)flag
+{
+	self->marqueeSelectsVisibleOnly = flag;
+	
+}//end setMarqueeSelectsVisibleOnly:
+
+
 //========== setMaximumVisibleSize: ============================================
 //
 // Purpose:		Sets the largest size (in frame coordinates) to which the 
@@ -1196,6 +1225,10 @@
 	self->activeDragHandle = nil;
 	self->isTrackingDrag = NO; //not anymore.
 	self->selectionMarquee = ZeroBox2;
+	
+	// The picking buffer was only worth keeping while the marquee was moving.
+	[self->pickingBuffer release];
+	self->pickingBuffer = nil;
 
 	[self->delegate unmarkPreviousSelection:self];
 }
@@ -1856,6 +1889,9 @@
 //==============================================================================
 - (void) activeModelDidChange:(NSNotification *)notification
 {
+	[self->pickingBuffer release];
+	self->pickingBuffer = nil;
+	
 	[self updateRotationCenter];
 	if(fileBeingDrawn != nil)
 		[camera setModelSize:[fileBeingDrawn boundingBox3]];
@@ -1876,6 +1912,15 @@
 //==============================================================================
 - (void) displayNeedsUpdating:(NSNotification *)notification
 {
+	// The picking buffer is stale now - unless we are dragging a marquee, in 
+	// which case the only thing changing is the selection, which the buffer 
+	// doesn't show. 
+	if(V2BoxWidth(self->selectionMarquee) == 0 && V2BoxHeight(self->selectionMarquee) == 0)
+	{
+		[self->pickingBuffer release];
+		self->pickingBuffer = nil;
+	}
+	
 	[camera setModelSize:[fileBeingDrawn boundingBox3]];
 	[self->delegate LDrawGLRendererNeedsRedisplay:self];
 	
@@ -1928,6 +1973,18 @@
 
 		Box2	test_box = V2MakeBox(x1,y1,x2-x1,y2-y1);
 
+	// If we already have a picking buffer for this very camera, the answer is 
+	// sitting in it. 
+	if(		self->pickingBuffer != nil
+	   &&	[self->pickingBuffer matchesWidth:MAX(1, V2BoxWidth(viewport) * PICKING_BUFFER_SCALE)
+									   height:MAX(1, V2BoxHeight(viewport) * PICKING_BUFFER_SCALE)
+									modelView:[camera getModelView]
+								   projection:[camera getProjection]] )
+	{
+		[self->pickingBuffer nearestDirectiveInBox:test_box depth:&depth];
+		return depth;
+	}
+
 	Matrix4	mvp =			Matrix4Multiply(
 									Matrix4CreateFromGLMatrix4([camera getModelView]),
 									Matrix4CreateFromGLMatrix4([camera getProjection]));
@@ -2062,6 +2119,13 @@
 
 		Box2	test_box = V2MakeBox(x1,y1,x2-x1,y2-y1);
 		
+		// Visible-only selection reads what's on screen out of the picking 
+		// buffer, which always covers the whole file. 
+		if(self->marqueeSelectsVisibleOnly == YES && fastDraw == NO)
+		{
+			return [[self pickingBuffer] directivesInBox:test_box];
+		}
+		
 		Matrix4	mvp =			Matrix4Multiply(
 									  Matrix4CreateFromGLMatrix4([camera getModelView]),
 									  Matrix4CreateFromGLMatrix4([camera getProjection]));
@@ -2091,6 +2155,41 @@
 }//end getDirectivesUnderMouse:amongDirectives:fastDraw
 
 
+//========== pickingBuffer =====================================================
+//
+// Purpose:		Returns a picking buffer for the file as it is seen right now, 
+//				drawing a new one if we don't have one or the camera has moved 
+//				since ours was drawn. 
+//
+// Notes:		The buffer is drawn on the CPU, at reduced resolution; that is 
+//				plenty to tell which parts are visible under a marquee. 
+//
+//==============================================================================
+- (LDrawPickingBuffer *) pickingBuffer
+{
+	Box2	viewport	= [self viewport];
+	int		width		= MAX(1, V2BoxWidth(viewport) * PICKING_BUFFER_SCALE);
+	int		height		= MAX(1, V2BoxHeight(viewport) * PICKING_BUFFER_SCALE);
+	
+	if(		self->pickingBuffer == nil
+	   ||	[self->pickingBuffer matchesWidth:width
+									   height:height
+									modelView:[camera getModelView]
+								   projection:[camera getProjection]] == NO )
+	{
+		[self->pickingBuffer release];
+		self->pickingBuffer = [[LDrawPickingBuffer alloc] initWithDirective:self->fileBeingDrawn
+																	  width:width
+																	 height:height
+																  modelView:[camera getModelView]
+																 projection:[camera getProjection]];
+	}
+	
+	return self->pickingBuffer;
+	
+}//end pickingBuffer
+
+
 //========== getPartFromHits:hitCount: =========================================
 //
 // Purpose:		Deduce the parts that were clicked on, given the selection data 
@@ -2556,7 +2655,12 @@
 {
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 	
+	// Our view makes its context current before releasing us.
+	if(dataStream != NULL)
+		LDrawDataStreamDestroy(dataStream);
+	
 	[fileBeingDrawn	release];
+	[pickingBuffer	release];
 
 	[camera release];
 	
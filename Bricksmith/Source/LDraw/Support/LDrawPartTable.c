@@ -0,0 +1,126 @@
+/*
+ *  LDrawPartTable.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawPartTable.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define INITIAL_CAPACITY 16
+
+
+//========== grow_column =========================================================
+//
+// Purpose:	Reallocate one column for a new capacity, zeroing the new rows.
+//
+//================================================================================
+static void * grow_column(void * column, int old_capacity, int new_capacity, size_t row_size)
+{
+	char * grown = (char *) realloc(column, new_capacity * row_size);
+	memset(grown + old_capacity * row_size, 0, (new_capacity - old_capacity) * row_size);
+	return grown;
+
+}//end grow_column
+
+
+//========== LDrawPartTableCreate ================================================
+//
+// Purpose:	Create an empty table.
+//
+//================================================================================
+struct LDrawPartTable * LDrawPartTableCreate(void)
+{
+	struct LDrawPartTable * table = (struct LDrawPartTable *) malloc(sizeof(struct LDrawPartTable));
+	memset(table, 0, sizeof(struct LDrawPartTable));
+	return table;
+
+}//end LDrawPartTableCreate
+
+
+//========== LDrawPartTableDestroy ===============================================
+//
+// Purpose:	Free the table and all of its columns.
+//
+//================================================================================
+void LDrawPartTableDestroy(struct LDrawPartTable * table)
+{
+	free(table->parts);
+	free(table->models);
+	free(table->colors);
+	free(table->transforms);
+	free(table->bounds);
+	free(table->flags);
+	free(table);
+
+}//end LDrawPartTableDestroy
+
+
+//========== LDrawPartTableResize ================================================
+//
+// Purpose:	Set the number of rows, growing the columns if needed.  Rows
+//			past the old count come back zeroed.
+//
+//================================================================================
+void LDrawPartTableResize(struct LDrawPartTable * table, int count)
+{
+	int r;
+	assert(count >= 0);
+
+	if(count > table->capacity)
+	{
+		int new_capacity = table->capacity ? table->capacity : INITIAL_CAPACITY;
+		while(new_capacity < count)
+			new_capacity *= 2;
+
+		table->parts		= grow_column(table->parts,			table->capacity, new_capacity, sizeof(void *));
+		table->models		= grow_column(table->models,		table->capacity, new_capacity, sizeof(void *));
+		table->colors		= grow_column(table->colors,		table->capacity, new_capacity, sizeof(void *));
+		table->transforms	= grow_column(table->transforms,	table->capacity, new_capacity, sizeof(float) * 16);
+		table->bounds		= grow_column(table->bounds,		table->capacity, new_capacity, sizeof(float) * 6);
+		table->flags		= grow_column(table->flags,			table->capacity, new_capacity, sizeof(unsigned char));
+		table->capacity = new_capacity;
+	}
+
+	// Rows we drop may have been stale, and must be zeroed in case they come back.
+	if(count < table->count)
+	{
+		int dropped = table->count - count;
+		for(r = count; r < table->count; ++r)
+		{
+			if(table->flags[r] & part_row_stale)
+				--table->stale_count;
+		}
+		memset(table->parts + count,			0, dropped * sizeof(void *));
+		memset(table->models + count,			0, dropped * sizeof(void *));
+		memset(table->colors + count,			0, dropped * sizeof(void *));
+		memset(table->transforms + count * 16,	0, dropped * sizeof(float) * 16);
+		memset(table->bounds + count * 6,		0, dropped * sizeof(float) * 6);
+		memset(table->flags + count,			0, dropped * sizeof(unsigned char));
+	}
+	table->count = count;
+
+}//end LDrawPartTableResize
+
+
+//========== LDrawPartTableMarkStale =============================================
+//
+// Purpose:	Flag one row as needing to be reread.
+//
+//================================================================================
+void LDrawPartTableMarkStale(struct LDrawPartTable * table, int row)
+{
+	assert(row >= 0 && row < table->count);
+
+	if((table->flags[row] & part_row_stale) == 0)
+	{
+		table->flags[row] |= part_row_stale;
+		++table->stale_count;
+	}
+
+}//end LDrawPartTableMarkStale
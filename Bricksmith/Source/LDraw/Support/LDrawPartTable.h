@@ -0,0 +1,76 @@
+/*
+ *  LDrawPartTable.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef LDrawPartTable_H
+#define LDrawPartTable_H
+
+//==============================================================================
+//
+// File: LDrawPartTable
+//
+// The part table is a flat copy of the parts placed in a step: one row per
+// part, stored as parallel arrays (structure of arrays), so that the loops
+// that visit every part - drawing, culling, counting pieces - walk a few
+// contiguous arrays instead of sending messages through the directive tree.
+//
+// Usage:
+//
+// The table only stores; its owner (LDrawStep) fills it in and keeps it in
+// sync.  Resize the table to the number of rows, then fill in each row's
+// columns directly - the arrays are public so that hot loops can read them
+// without a function call per row.  Parts, models and colors are stored as
+// plain pointers and are not retained; the owner must make sure they outlive
+// their rows.
+//
+// Colors are stored as the part's LDrawColor rather than its RGBA, and read
+// when drawing: a color definition can change in place without the parts
+// using it hearing about it.
+//
+// A row can be flagged stale when its part changes; the owner rereads stale
+// rows before using the table.  stale_count says whether that is
+// needed at all, so that an up-to-date table costs nothing to check.
+//
+// Implementation:
+//
+// Rows are in the order of the parts in the step.  Transforms are in GL
+// (column-major) order; bounds are min xyz then max xyz, in the step's
+// coordinates, and empty (min > max) for hidden or missing parts.
+//
+//==============================================================================
+
+enum {
+	part_row_hidden		= 1,		// Part draws nothing.
+	part_row_library	= 2,		// Model is a part from the library.
+	part_row_reference	= 4,		// Model is a submodel or another file, counted through its own parts.
+	part_row_stale		= 8			// Part has changed since the row was read.
+};
+
+struct LDrawPartTable {
+	int					count;
+	int					capacity;
+	int					stale_count;	// Rows with part_row_stale set.
+
+	void **				parts;			// LDrawPart
+	void **				models;			// LDrawModel the part draws, or NULL if missing
+	void **				colors;			// LDrawColor the part uses
+	float *				transforms;		// 16 per row
+	float *				bounds;			// 6 per row
+	unsigned char *		flags;			// part_row_ bits
+};
+
+struct LDrawPartTable *	LDrawPartTableCreate(void);
+void					LDrawPartTableDestroy(struct LDrawPartTable * table);
+
+// Set the number of rows.  Existing rows up to the new count are kept; new
+// rows are zeroed (and so must be filled in).
+void					LDrawPartTableResize(struct LDrawPartTable * table, int count);
+
+void					LDrawPartTableMarkStale(struct LDrawPartTable * table, int row);
+
+#endif /* LDrawPartTable_H */
@@ -0,0 +1,66 @@
+//==============================================================================
+//
+// File:		LDrawSearchIndex.h
+//
+// Purpose:		Indexes the parts in a file by name, color, and the words in
+//				their descriptions, so that searches don't have to walk the
+//				whole file.
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "LDrawColor.h"
+#import "LDrawDirective.h"
+
+@class LDrawContainer;
+
+// Search index terminology:
+//
+// The index covers the "searchable" directives under its root container:
+// parts (by reference name) and LSynth directives (by LSynth type).  Both are
+// also indexed by color code.  A second, inverted index maps each word of the
+// part library descriptions to the names in use that have it.
+//
+// The index observes every directive it knows about, containers included.  An
+// invalidation or message only marks the sender stale; stale directives are
+// re-read - and stale containers diffed against what they used to contain -
+// the next time someone asks a question.  So editing costs next to nothing,
+// and a search only pays for what changed since the last one.
+//
+// Results are in no particular order.  The index doesn't retain the
+// directives; don't hold on to results past the current event.
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawSearchIndex
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawSearchIndex : NSObject <LDrawObserver>
+{
+	LDrawContainer *		root;				// not retained; it owns us.
+
+	NSMutableSet *			observed;			// NSValue<LDrawDirective*> of everything we observe
+	NSMutableSet *			stale;				// NSValue<LDrawDirective*> changed since last read
+	NSMutableDictionary *	parents;			// NSValue<child> -> NSValue<container>
+	NSMutableDictionary *	children;			// NSValue<container> -> NSMutableSet of NSValue<child>
+
+	NSMutableDictionary *	namesByDirective;	// NSValue<directive> -> NSString name
+	NSMutableDictionary *	colorsByDirective;	// NSValue<directive> -> NSNumber color code
+	NSMutableDictionary *	directivesByName;	// NSString name -> NSMutableSet of NSValue<directive>
+	NSMutableDictionary *	directivesByColor;	// NSNumber color code -> NSMutableSet of NSValue<directive>
+	NSMutableDictionary *	namesByWord;		// NSString word -> NSMutableSet of NSString name
+}
+
+// Initialization
+- (id) initWithContainer:(LDrawContainer *)rootContainer;
+
+// Queries
+- (NSArray *) allDirectives;
+- (NSArray *) directivesNamed:(NSString *)name;
+- (NSArray *) directivesWithColorCode:(LDrawColorT)colorCode;
+- (NSArray *) namesMatchingDescription:(NSString *)searchText;
+
+@end
@@ -0,0 +1,611 @@
+//==============================================================================
+//
+// File:		LDrawSearchIndex.m
+//
+// Purpose:		Indexes the parts in a file by name, color, and the words in
+//				their descriptions, so that searches don't have to walk the
+//				whole file.
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//==============================================================================
+#import "LDrawSearchIndex.h"
+
+#import "LDrawContainer.h"
+#import "LDrawLSynth.h"
+#import "LDrawPart.h"
+#import "PartLibrary.h"
+
+// Search index implementation:
+//
+// Directives are keyed by NSValue-wrapped pointers so that the index never
+// retains them, the same way directives keep track of their observers.  A
+// directive leaves the index when it leaves its container (found when the
+// container is diffed) or when it dies (we get its goodbye).
+//
+// Containers don't have to tell us about what they contain: each container's
+// children are kept in a snapshot set, and a stale container's current
+// subdirectives are compared with the snapshot.  A directive moved from one
+// container to another is simply re-parented, whichever container we look at
+// first.
+//
+// Observation is re-armed by reading each directive's bounds once we are done
+// with it.  The root is re-scanned every time, because files don't invalidate
+// anything when models come and go; a file only has a handful of models.
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// LDrawSearchIndex private API
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawSearchIndex (private)
+
+- (void) updateIndex;
+
+- (void) indexDirective:(LDrawDirective *)directive parent:(NSValue *)parentKey;
+- (void) readDirective:(LDrawDirective *)directive;
+- (void) readChildrenOfContainer:(LDrawContainer *)container;
+- (void) unindexKey:(NSValue *)key stillAlive:(BOOL)stillAlive;
+
+- (void) setName:(NSString *)name colorCode:(NSNumber *)colorCode forKey:(NSValue *)key;
+- (void) addWordsForName:(NSString *)name;
+- (void) removeWordsForName:(NSString *)name;
+
+- (NSSet *) wordsForName:(NSString *)name;
+- (NSSet *) wordsInString:(NSString *)text;
+- (NSArray *) directivesForKeys:(NSSet *)keys;
+
+@end
+
+
+@implementation LDrawSearchIndex
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//========== initWithContainer: ================================================
+//
+// Purpose:		Indexes everything in rootContainer.
+//
+// Notes:		The index does not retain its root; the root (normally an
+//				LDrawFile) is expected to own the index and release it before
+//				it goes away.
+//
+//==============================================================================
+- (id) initWithContainer:(LDrawContainer *)rootContainer
+{
+	self = [super init];
+
+	if(self)
+	{
+		root				= rootContainer;
+
+		observed			= [[NSMutableSet alloc] init];
+		stale				= [[NSMutableSet alloc] init];
+		parents				= [[NSMutableDictionary alloc] init];
+		children			= [[NSMutableDictionary alloc] init];
+
+		namesByDirective	= [[NSMutableDictionary alloc] init];
+		colorsByDirective	= [[NSMutableDictionary alloc] init];
+		directivesByName	= [[NSMutableDictionary alloc] init];
+		directivesByColor	= [[NSMutableDictionary alloc] init];
+		namesByWord			= [[NSMutableDictionary alloc] init];
+
+		[self indexDirective:root parent:nil];
+	}
+
+	return self;
+
+}//end initWithContainer:
+
+
+#pragma mark -
+#pragma mark QUERIES
+#pragma mark -
+
+//========== allDirectives =====================================================
+//
+// Purpose:		Returns every searchable directive in the index: all the parts
+//				and LSynth directives, at any depth.
+//
+//==============================================================================
+- (NSArray *) allDirectives
+{
+	[self updateIndex];
+
+	return [self directivesForKeys:[NSSet setWithArray:[namesByDirective allKeys]]];
+
+}//end allDirectives
+
+
+//========== directivesNamed: ==================================================
+//
+// Purpose:		Returns the parts with the given reference name (lowercase,
+//				e.g. "3001.dat"), or the LSynth directives of the given type.
+//
+//==============================================================================
+- (NSArray *) directivesNamed:(NSString *)name
+{
+	[self updateIndex];
+
+	return [self directivesForKeys:[directivesByName objectForKey:name]];
+
+}//end directivesNamed:
+
+
+//========== directivesWithColorCode: ==========================================
+//
+// Purpose:		Returns the searchable directives drawn in the given color code.
+//
+// Notes:		File-local colors can share a code with library colors; callers
+//				who care which LDrawColor it is should compare the colors too.
+//
+//==============================================================================
+- (NSArray *) directivesWithColorCode:(LDrawColorT)colorCode
+{
+	[self updateIndex];
+
+	return [self directivesForKeys:[directivesByColor objectForKey:[NSNumber numberWithInt:colorCode]]];
+
+}//end directivesWithColorCode:
+
+
+//========== namesMatchingDescription: =========================================
+//
+// Purpose:		Returns the names in use in the file whose part descriptions
+//				(or part numbers) contain every word of searchText. Words are
+//				matched whole and without regard to case, so "brick 2 x 4"
+//				finds "Brick  2 x  4".
+//
+//==============================================================================
+- (NSArray *) namesMatchingDescription:(NSString *)searchText
+{
+	NSSet			*words		= [self wordsInString:searchText];
+	NSMutableSet	*matches	= nil;
+
+	[self updateIndex];
+
+	for(NSString *word in words)
+	{
+		NSSet *names = [namesByWord objectForKey:word];
+
+		if(matches == nil)
+			matches = [NSMutableSet setWithSet:names];
+		else
+			[matches intersectSet:names];
+
+		if([matches count] == 0)
+			break;
+	}
+
+	return [matches allObjects];
+
+}//end namesMatchingDescription:
+
+
+#pragma mark -
+#pragma mark OBSERVER
+#pragma mark -
+
+//========== observableSaysGoodbyeCruelWorld: ==================================
+//
+// Purpose:		A directive we index is dying. Forget it, and stop watching any
+//				of its contents that outlive it.
+//
+//==============================================================================
+- (void) observableSaysGoodbyeCruelWorld:(id<LDrawObservable>) doomedObservable
+{
+	[self unindexKey:[NSValue valueWithPointer:doomedObservable] stillAlive:NO];
+
+}//end observableSaysGoodbyeCruelWorld:
+
+
+//========== statusInvalidated:who: ============================================
+//
+// Purpose:		Something about the directive changed - maybe its name or
+//				color, maybe its contents. Look again before the next query.
+//
+//==============================================================================
+- (void) statusInvalidated:(CacheFlagsT) flags who:(id<LDrawObservable>) observable
+{
+	[stale addObject:[NSValue valueWithPointer:observable]];
+
+}//end statusInvalidated:who:
+
+
+//========== receiveMessage:who: ===============================================
+//
+// Purpose:		Renames and the like; treated the same as an invalidation.
+//
+//==============================================================================
+- (void) receiveMessage:(MessageT) msg who:(id<LDrawObservable>) observable
+{
+	[stale addObject:[NSValue valueWithPointer:observable]];
+
+}//end receiveMessage:who:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Stop observing everything that is still alive.
+//
+//==============================================================================
+- (void) dealloc
+{
+	for(NSValue *key in observed)
+		[(LDrawDirective *)[key pointerValue] removeObserver:self];
+
+	[observed			release];
+	[stale				release];
+	[parents			release];
+	[children			release];
+
+	[namesByDirective	release];
+	[colorsByDirective	release];
+	[directivesByName	release];
+	[directivesByColor	release];
+	[namesByWord		release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+@implementation LDrawSearchIndex (private)
+
+//========== updateIndex =======================================================
+//
+// Purpose:		Re-reads everything that changed since the last query.
+//
+// Notes:		Whatever invalidates while we re-read it (parts resolving, say)
+//				is left stale for next time rather than chased around.
+//
+//==============================================================================
+- (void) updateIndex
+{
+	NSArray *changed = nil;
+
+	[stale addObject:[NSValue valueWithPointer:root]];
+
+	changed = [stale allObjects];
+	[stale removeAllObjects];
+
+	for(NSValue *key in changed)
+	{
+		// Un-indexing a container earlier in the list may already have
+		// dropped this one.
+		if([observed containsObject:key])
+			[self readDirective:[key pointerValue]];
+	}
+
+}//end updateIndex
+
+
+//========== indexDirective:parent: ============================================
+//
+// Purpose:		Starts watching a directive and indexes it and its contents.
+//
+//==============================================================================
+- (void) indexDirective:(LDrawDirective *)directive parent:(NSValue *)parentKey
+{
+	NSValue *key = [NSValue valueWithPointer:directive];
+
+	[observed addObject:key];
+	[directive addObserver:self];
+
+	if(parentKey)
+		[parents setObject:parentKey forKey:key];
+
+	[self readDirective:directive];
+
+}//end indexDirective:parent:
+
+
+//========== readDirective: ====================================================
+//
+// Purpose:		Brings the index up to date with an indexed directive: its name
+//				and color if it is searchable, its contents if it is a
+//				container.
+//
+//==============================================================================
+- (void) readDirective:(LDrawDirective *)directive
+{
+	NSValue		*key		= [NSValue valueWithPointer:directive];
+	NSString	*name		= nil;
+	NSNumber	*colorCode	= nil;
+
+	if([directive isKindOfClass:[LDrawPart class]])
+		name = [(LDrawPart *)directive referenceName];
+	else if([directive isKindOfClass:[LDrawLSynth class]])
+		name = [(LDrawLSynth *)directive lsynthType];
+
+	if(name)
+		colorCode = [NSNumber numberWithInt:[[(id<LDrawColorable>)directive LDrawColor] colorCode]];
+
+	[self setName:name colorCode:colorCode forKey:key];
+
+	if([directive isKindOfClass:[LDrawContainer class]])
+		[self readChildrenOfContainer:(LDrawContainer *)directive];
+
+	// Reading the bounds re-arms invalidation, so we hear about the next
+	// change.
+	[directive boundingBox3];
+
+}//end readDirective:
+
+
+//========== readChildrenOfContainer: ==========================================
+//
+// Purpose:		Compares a container's subdirectives with what we saw last time;
+//				indexes the new ones and drops the ones that left.
+//
+//==============================================================================
+- (void) readChildrenOfContainer:(LDrawContainer *)container
+{
+	NSValue			*containerKey	= [NSValue valueWithPointer:container];
+	NSSet			*oldChildren	= [children objectForKey:containerKey];
+	NSMutableSet	*newChildren	= [NSMutableSet set];
+	NSMutableSet	*departed		= nil;
+	NSValue			*key			= nil;
+
+	for(LDrawDirective *directive in [container subdirectives])
+	{
+		key = [NSValue valueWithPointer:directive];
+		[newChildren addObject:key];
+
+		if([oldChildren containsObject:key] == NO)
+		{
+			if([observed containsObject:key])
+			{
+				// Moved here from another container we know about.
+				NSValue *oldParentKey = [parents objectForKey:key];
+
+				if(oldParentKey)
+					[[children objectForKey:oldParentKey] removeObject:key];
+				[parents setObject:containerKey forKey:key];
+			}
+			else
+				[self indexDirective:directive parent:containerKey];
+		}
+	}
+
+	if(oldChildren)
+	{
+		departed = [[oldChildren mutableCopy] autorelease];
+		[departed minusSet:newChildren];
+
+		for(key in departed)
+		{
+			// It may already have turned up in another container.
+			if([[parents objectForKey:key] isEqual:containerKey])
+				[self unindexKey:key stillAlive:YES];
+		}
+	}
+
+	[children setObject:newChildren forKey:containerKey];
+
+}//end readChildrenOfContainer:
+
+
+//========== unindexKey:stillAlive: ============================================
+//
+// Purpose:		Drops a directive and everything inside it from the index.
+//
+// Notes:		Dying containers release their children first, so the contents
+//				we still know about are alive even if the container isn't.
+//
+//==============================================================================
+- (void) unindexKey:(NSValue *)key stillAlive:(BOOL)stillAlive
+{
+	NSSet	*contents		= nil;
+	NSValue	*parentKey		= nil;
+
+	if([observed containsObject:key] == NO)
+		return;
+
+	[key retain];
+
+	contents = [[children objectForKey:key] retain];
+	[children removeObjectForKey:key];
+	for(NSValue *childKey in contents)
+	{
+		if([[parents objectForKey:childKey] isEqual:key])
+			[self unindexKey:childKey stillAlive:YES];
+	}
+	[contents release];
+
+	[self setName:nil colorCode:nil forKey:key];
+
+	parentKey = [parents objectForKey:key];
+	if(parentKey)
+	{
+		[[children objectForKey:parentKey] removeObject:key];
+		[parents removeObjectForKey:key];
+	}
+
+	[stale		removeObject:key];
+	[observed	removeObject:key];
+
+	if(stillAlive)
+		[(LDrawDirective *)[key pointerValue] removeObserver:self];
+
+	[key release];
+
+}//end unindexKey:stillAlive:
+
+
+//========== setName:colorCode:forKey: =========================================
+//
+// Purpose:		Files a directive under its current name and color, taking it
+//				out from under the old ones. Pass nil for directives that
+//				aren't searchable (any more).
+//
+//==============================================================================
+- (void) setName:(NSString *)name colorCode:(NSNumber *)colorCode forKey:(NSValue *)key
+{
+	NSString		*oldName		= [namesByDirective objectForKey:key];
+	NSNumber		*oldColorCode	= [colorsByDirective objectForKey:key];
+	NSMutableSet	*directives		= nil;
+
+	if([name isEqual:oldName] == NO && name != oldName)
+	{
+		if(oldName)
+		{
+			[oldName retain];
+			directives = [directivesByName objectForKey:oldName];
+			[directives removeObject:key];
+			if([directives count] == 0)
+			{
+				[directivesByName removeObjectForKey:oldName];
+				[self removeWordsForName:oldName];
+			}
+			[namesByDirective removeObjectForKey:key];
+			[oldName release];
+		}
+		if(name)
+		{
+			directives = [directivesByName objectForKey:name];
+			if(directives == nil)
+			{
+				directives = [NSMutableSet set];
+				[directivesByName setObject:directives forKey:name];
+				[self addWordsForName:name];
+			}
+			[directives addObject:key];
+			[namesByDirective setObject:name forKey:key];
+		}
+	}
+
+	if([colorCode isEqual:oldColorCode] == NO && colorCode != oldColorCode)
+	{
+		if(oldColorCode)
+		{
+			directives = [directivesByColor objectForKey:oldColorCode];
+			[directives removeObject:key];
+			if([directives count] == 0)
+				[directivesByColor removeObjectForKey:oldColorCode];
+			[colorsByDirective removeObjectForKey:key];
+		}
+		if(colorCode)
+		{
+			directives = [directivesByColor objectForKey:colorCode];
+			if(directives == nil)
+			{
+				directives = [NSMutableSet set];
+				[directivesByColor setObject:directives forKey:colorCode];
+			}
+			[directives addObject:key];
+			[colorsByDirective setObject:colorCode forKey:key];
+		}
+	}
+
+}//end setName:colorCode:forKey:
+
+
+//========== addWordsForName: ==================================================
+//
+// Purpose:		A name has come into use; file it under its description's words.
+//
+//==============================================================================
+- (void) addWordsForName:(NSString *)name
+{
+	NSMutableSet *names = nil;
+
+	for(NSString *word in [self wordsForName:name])
+	{
+		names = [namesByWord objectForKey:word];
+		if(names == nil)
+		{
+			names = [NSMutableSet set];
+			[namesByWord setObject:names forKey:word];
+		}
+		[names addObject:name];
+	}
+
+}//end addWordsForName:
+
+
+//========== removeWordsForName: ===============================================
+//
+// Purpose:		Nothing uses the name any more; take it out of the word index.
+//
+//==============================================================================
+- (void) removeWordsForName:(NSString *)name
+{
+	NSMutableSet *names = nil;
+
+	for(NSString *word in [self wordsForName:name])
+	{
+		names = [namesByWord objectForKey:word];
+		[names removeObject:name];
+		if([names count] == 0)
+			[namesByWord removeObjectForKey:word];
+	}
+
+}//end removeWordsForName:
+
+
+//========== wordsForName: =====================================================
+//
+// Purpose:		The words a name can be found by: those of its part library
+//				description, plus the part number itself.
+//
+//==============================================================================
+- (NSSet *) wordsForName:(NSString *)name
+{
+	NSString *description = [[PartLibrary sharedPartLibrary] descriptionForPartName:name];
+
+	return [self wordsInString:[NSString stringWithFormat:@"%@ %@", description, [name stringByDeletingPathExtension]]];
+
+}//end wordsForName:
+
+
+//========== wordsInString: ====================================================
+//
+// Purpose:		Splits text into lowercase words at anything that isn't a
+//				letter or digit.
+//
+//==============================================================================
+- (NSSet *) wordsInString:(NSString *)text
+{
+	NSCharacterSet	*separators	= [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+	NSMutableSet	*words		= [NSMutableSet set];
+
+	for(NSString *word in [[text lowercaseString] componentsSeparatedByCharactersInSet:separators])
+	{
+		if([word length] > 0)
+			[words addObject:word];
+	}
+
+	return words;
+
+}//end wordsInString:
+
+
+//========== directivesForKeys: ================================================
+//
+// Purpose:		Unwraps a set of keys into an array of directives.
+//
+//==============================================================================
+- (NSArray *) directivesForKeys:(NSSet *)keys
+{
+	NSMutableArray *directives = [NSMutableArray arrayWithCapacity:[keys count]];
+
+	for(NSValue *key in keys)
+		[directives addObject:[key pointerValue]];
+
+	return directives;
+
+}//end directivesForKeys:
+
+
+@end
@@ -62,6 +62,11 @@ typedef enum
 + (NSString *) outputStringForColor:(LDrawColor *)color;
 + (NSString *) outputStringForFloat:(float)number;
 
+// Pasteboard
++ (NSData *) dataForDirectives:(NSArray *)directives;
++ (NSArray *) directivesFromData:(NSData *)data;
++ (id) firstDirectiveFromData:(NSData *)data;
+
 // Drawing
 + (LDrawVertexes *) boundingCube;
 
@@ -76,6 +81,7 @@ typedef enum
 + (Tuple3) angleForViewOrientation:(ViewOrientationT)orientation;
 + (Box3) boundingBox3ForDirectives:(NSArray *)directives;
 + (BOOL) isLDrawFilenameValid:(NSString *)fileName;
++ (NSArray *) topLevelDirectivesInList:(NSArray *)directives;
 + (void) updateNameForMovedPart:(LDrawPart *)movedPart;
 + (ViewOrientationT) viewOrientationForAngle:(Tuple3)rotationAngle;
 + (void) unresolveLibraryParts:(LDrawDirective *)directive;
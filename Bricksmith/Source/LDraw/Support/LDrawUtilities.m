@@ -13,11 +13,13 @@
 #import "LDrawColor.h"
 #import "LDrawConditionalLine.h"
 #import "LDrawContainer.h"
+#import "LDrawDirectiveCodec.h"
 #import "LDrawKeywords.h"
 #import "LDrawLine.h"
 #import "LDrawMetaCommand.h"
 #import "LDrawPart.h"
 #import "LDrawQuadrilateral.h"
+#import "LDrawStep.h"
 #import "LDrawTexture.h"
 #import "LDrawTriangle.h"
 #import "LDrawVertexes.h"
@@ -28,6 +30,11 @@ static LDrawVertexes        *boundingCube       = nil;
 static BOOL                 ColumnizesOutput    = NO;
 static NSString				*defaultAuthor		= @"anonymous";
 
+static void WriteDirectiveToCodec(struct LDrawCodecWriter *writer, LDrawDirective *directive);
+static void WriteArchivedDirectiveToCodec(struct LDrawCodecWriter *writer, LDrawDirective *directive);
+static BOOL PartColorIsShared(LDrawPart *part);
+static NSArray *DirectivesFromCodecData(NSData *data, NSUInteger maxCount);
+
 @implementation LDrawUtilities
 
 #pragma mark -
@@ -504,6 +511,262 @@ static NSString				*defaultAuthor		= @"anonymous";
 }//end outputStringForFloat:
 
 
+#pragma mark -
+#pragma mark PASTEBOARD
+#pragma mark -
+
+//---------- dataForDirectives: --------------------------------------[static]--
+//
+// Purpose:		Encodes the directives (and everything in them) for the
+//				pasteboard, with the directive codec.
+//
+// Notes:		Parts and steps - nearly everything anyone copies - get codec
+//				records of their own.  Anything else is keyed-archived into an
+//				archived record, as the whole pasteboard used to be.
+//
+//------------------------------------------------------------------------------
++ (NSData *) dataForDirectives:(NSArray *)directives
+{
+	struct LDrawCodecWriter *writer		= LDrawCodecWriterCreate();
+	const void				*bytes		= NULL;
+	size_t					length		= 0;
+	NSData					*data		= nil;
+	
+	for(LDrawDirective *directive in directives)
+	{
+		WriteDirectiveToCodec(writer, directive);
+	}
+	
+	bytes	= LDrawCodecWriterFinish(writer, &length);
+	data	= [NSData dataWithBytes:bytes length:length];
+	LDrawCodecWriterDestroy(writer);
+	
+	return data;
+	
+}//end dataForDirectives:
+
+
+//---------- directivesFromData: -------------------------------------[static]--
+//
+// Purpose:		Returns new directives decoded from data made by
+//				+dataForDirectives:, or nil if the data is damaged or from an
+//				incompatible version of Bricksmith.
+//
+// Notes:		Pasted parts take their colors from the shared color library,
+//				just as keyed-archived ones always have; parts whose color
+//				isn't there were archived with it.  Their models are
+//				loaded together at the end rather than one by one.
+//
+//------------------------------------------------------------------------------
++ (NSArray *) directivesFromData:(NSData *)data
+{
+	return DirectivesFromCodecData(data, NSUIntegerMax);
+	
+}//end directivesFromData:
+
+
+//---------- firstDirectiveFromData: ---------------------------------[static]--
+//
+// Purpose:		Returns just the first directive in data made by
+//				+dataForDirectives:, without decoding the rest; for checking
+//				what is being dragged.
+//
+//------------------------------------------------------------------------------
++ (id) firstDirectiveFromData:(NSData *)data
+{
+	NSArray *directives = DirectivesFromCodecData(data, 1);
+	
+	return [directives count] > 0 ? [directives objectAtIndex:0] : nil;
+	
+}//end firstDirectiveFromData:
+
+
+//========== DirectivesFromCodecData() =========================================
+//
+// Purpose:		Decodes up to maxCount top-level directives from codec data.
+//
+//==============================================================================
+static NSArray *DirectivesFromCodecData(NSData *data, NSUInteger maxCount)
+{
+	struct LDrawCodecReader reader;
+	struct LDrawCodecRecord record;
+	ColorLibrary			*colorLibrary	= [ColorLibrary sharedColorLibrary];
+	NSMutableArray			*directives		= [NSMutableArray array];
+	LDrawStep				*step			= nil;
+	LDrawPart				*part			= nil;
+	id						directive		= nil;
+	NSData					*archived		= nil;
+	Matrix4					transform		= IdentityMatrix4;
+	dispatch_group_t		parseGroup		= NULL;
+	int						result			= 0;
+	
+	if(data == nil || LDrawCodecReaderOpen(&reader, [data bytes], [data length]) != 0)
+		return nil;
+	
+#if USE_BLOCKS
+	parseGroup = dispatch_group_create();
+#endif
+	
+	while(		([directives count] < maxCount || step != nil)
+		  &&	(result = LDrawCodecReadRecord(&reader, &record)) == 1)
+	{
+		directive = nil;
+		
+		switch(record.kind)
+		{
+			case codec_record_part:
+				part		= [[[LDrawPart alloc] init] autorelease];
+				transform	= Matrix4CreateFromGLMatrix4(record.transform);
+				
+				[part setLDrawColor:[colorLibrary colorForCode:record.color_code]];
+				[part setHidden:(record.flags & codec_flag_hidden) != 0];
+				[part setTransformationMatrix:&transform];
+				[part setDisplayName:[NSString stringWithUTF8String:record.name] parse:YES inGroup:parseGroup];
+				if(record.icon_name != NULL)
+					[part setIconName:[NSString stringWithUTF8String:record.icon_name]];
+				directive = part;
+				break;
+				
+			case codec_record_step:
+				step = [LDrawStep emptyStep];
+				[step setStepRotationType:record.rotation_type];
+				[step setRotationAngle:V3Make(record.rotation[0], record.rotation[1], record.rotation[2])];
+				[step setStepFlavor:record.flavor];
+				[directives addObject:step];
+				break;
+				
+			case codec_record_step_end:
+				step = nil;
+				break;
+				
+			case codec_record_archived:
+				archived	= [NSData dataWithBytesNoCopy:(void *)record.bytes length:record.length freeWhenDone:NO];
+				directive	= [NSKeyedUnarchiver unarchiveObjectWithData:archived];
+				break;
+		}
+		
+		if(directive != nil)
+		{
+			if(step != nil)
+				[step addDirective:directive];
+			else
+				[directives addObject:directive];
+		}
+	}
+	LDrawCodecReaderClose(&reader);
+	
+#if USE_BLOCKS
+	dispatch_group_wait(parseGroup, DISPATCH_TIME_FOREVER);
+	dispatch_release(parseGroup);
+#endif
+	
+	if(result < 0)
+		return nil;
+	
+	return directives;
+	
+}//end DirectivesFromCodecData
+
+
+//========== WriteDirectiveToCodec() ===========================================
+//
+// Purpose:		Writes one directive, and a step's children, as codec records.
+//
+//==============================================================================
+static void WriteDirectiveToCodec(struct LDrawCodecWriter *writer, LDrawDirective *directive)
+{
+	struct LDrawCodecRecord record;
+	LDrawPart				*part		= nil;
+	LDrawStep				*step		= nil;
+	Tuple3					rotation	= ZeroPoint3;
+	
+	memset(&record, 0, sizeof(record));
+	
+	// A code only brings back the shared library's color for it. Custom RGB 
+	// and file-local !COLOURs are more than that; the archive keeps them, 
+	// and decoding it falls back to them when the code isn't in the library. 
+	if(		[directive class] == [LDrawPart class]
+	   &&	PartColorIsShared((LDrawPart *)directive) )
+	{
+		part				= (LDrawPart *)directive;
+		record.kind			= codec_record_part;
+		record.flags		= [part isHidden] ? codec_flag_hidden : 0;
+		record.color_code	= [[part LDrawColor] colorCode];
+		record.name			= [[part displayName] UTF8String];
+		record.icon_name	= [[part iconName] UTF8String];
+		Matrix4GetGLMatrix4([part transformationMatrix], record.transform);
+		
+		LDrawCodecWriteRecord(writer, &record);
+	}
+	else if([directive class] == [LDrawStep class])
+	{
+		step					= (LDrawStep *)directive;
+		rotation				= [step rotationAngle];
+		record.kind				= codec_record_step;
+		record.rotation_type	= [step stepRotationType];
+		record.flavor			= [step stepFlavor];
+		record.rotation[0]		= rotation.x;
+		record.rotation[1]		= rotation.y;
+		record.rotation[2]		= rotation.z;
+		LDrawCodecWriteRecord(writer, &record);
+		
+		for(LDrawDirective *child in [step subdirectives])
+		{
+			// Steps don't nest in the codec; a stray one is archived whole.
+			if([child class] == [LDrawStep class])
+				WriteArchivedDirectiveToCodec(writer, child);
+			else
+				WriteDirectiveToCodec(writer, child);
+		}
+		
+		record.kind = codec_record_step_end;
+		LDrawCodecWriteRecord(writer, &record);
+	}
+	else
+	{
+		WriteArchivedDirectiveToCodec(writer, directive);
+	}
+	
+}//end WriteDirectiveToCodec
+
+
+//========== WriteArchivedDirectiveToCodec() ===================================
+//
+// Purpose:		Writes a directive the codec has no record for, keyed-archived.
+//
+//==============================================================================
+static void WriteArchivedDirectiveToCodec(struct LDrawCodecWriter *writer, LDrawDirective *directive)
+{
+	struct LDrawCodecRecord record;
+	NSData					*archived	= [NSKeyedArchiver archivedDataWithRootObject:directive];
+	
+	memset(&record, 0, sizeof(record));
+	record.kind		= codec_record_archived;
+	record.bytes	= [archived bytes];
+	record.length	= [archived length];
+	
+	LDrawCodecWriteRecord(writer, &record);
+	
+}//end WriteArchivedDirectiveToCodec
+
+
+//========== PartColorIsShared() ===============================================
+//
+// Purpose:		Returns whether the part's color is the one the shared color 
+//				library has for its code - and so can be written as just the 
+//				code. 
+//
+//==============================================================================
+static BOOL PartColorIsShared(LDrawPart *part)
+{
+	LDrawColor	*color	= [part LDrawColor];
+	
+	return		[color colorCode] != LDrawColorCustomRGB
+			&&	[[ColorLibrary sharedColorLibrary] colorForCode:[color colorCode]] == color;
+	
+}//end PartColorIsShared
+
+
 #pragma mark -
 #pragma mark DRAWING
 #pragma mark -
@@ -836,6 +1099,55 @@ static NSString				*defaultAuthor		= @"anonymous";
 }//end isLDrawFilenameValid:
 
 
+//---------- topLevelDirectivesInList: -------------------------------[static]--
+//
+// Purpose:		Returns the directives in the list which are not enclosed, at 
+//				any depth, by a container also in the list. This is the set of 
+//				things to copy or delete for a selection: a selected step 
+//				brings its selected parts along with it. The original order is 
+//				kept.
+//
+// Notes:		Containers are matched by identity, not -isEqual:. Each 
+//				directive only walks its own enclosing chain, so this is linear 
+//				in the size of the list rather than checking every directive 
+//				against every selected container.
+//
+//------------------------------------------------------------------------------
++ (NSArray *) topLevelDirectivesInList:(NSArray *)directives
+{
+	NSUInteger			 directiveCount		= [directives count];
+	NSMutableArray		*topLevel			= [NSMutableArray arrayWithCapacity:directiveCount];
+	CFMutableSetRef		 containers			= CFSetCreateMutable(NULL, 0, NULL);
+	LDrawDirective		*currentDirective	= nil;
+	LDrawContainer		*ancestor			= nil;
+	NSUInteger			 counter			= 0;
+	
+	for(counter = 0; counter < directiveCount; counter++)
+	{
+		currentDirective = [directives objectAtIndex:counter];
+		if([currentDirective isKindOfClass:[LDrawContainer class]])
+			CFSetAddValue(containers, currentDirective);
+	}
+	
+	for(counter = 0; counter < directiveCount; counter++)
+	{
+		currentDirective	= [directives objectAtIndex:counter];
+		ancestor			= [currentDirective enclosingDirective];
+		
+		while(ancestor != nil && CFSetContainsValue(containers, ancestor) == NO)
+			ancestor = [ancestor enclosingDirective];
+		
+		if(ancestor == nil)
+			[topLevel addObject:currentDirective];
+	}
+	
+	CFRelease(containers);
+	
+	return topLevel;
+	
+}//end topLevelDirectivesInList:
+
+
 //---------- updateNameForMovedPart: ---------------------------------[static]--
 //
 // Purpose:		If the specified part has been moved to a new number/name by 
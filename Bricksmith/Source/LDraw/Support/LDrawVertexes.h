@@ -17,19 +17,36 @@
 @class LDrawTriangle;
 @class LDrawQuadrilateral;
 
+struct LDrawBVH;
+
 ////////////////////////////////////////////////////////////////////////////////
+// The vertex buffer is shared by every color the vertexes are drawn in. To 
+// make that work, primitives are sorted into runs by how their color is 
+// resolved. Current-color and edge-color runs are drawn with the color array 
+// off and the instance's color (or its compliment) set as the GL current 
+// color; only fixed-color runs read their baked per-vertex color. 
+enum
+{
+	VertexColorCurrent		= 0,	// LDrawCurrentColor (16): takes the parent color
+	VertexColorEdge			= 1,	// LDrawEdgeColor (24): takes the parent's compliment
+	VertexColorFixed		= 2,	// anything else: color is baked into the vertexes
+	VertexColorClassCount	= 3
+};
+
 struct OptimizationTags
 {
 	GLuint          anyVBOTag;
 	GLuint          anyVAOTag;
+	GLsizeiptr		bufferSize;		// bytes uploaded to anyVBOTag
 
-	GLint			lineOffset;
-	GLint			triangleOffset;
-	GLint			quadOffset;
+	// Offsets and counts are in vertexes, one run per color class.
+	GLint			lineOffset[VertexColorClassCount];
+	GLint			triangleOffset[VertexColorClassCount];
+	GLint			quadOffset[VertexColorClassCount];
 
-	GLsizei			lineCount;
-	GLsizei			triangleCount;
-	GLsizei			quadCount;	
+	GLsizei			lineCount[VertexColorClassCount];
+	GLsizei			triangleCount[VertexColorClassCount];
+	GLsizei			quadCount[VertexColorClassCount];
 };
 
 
@@ -47,13 +64,18 @@ struct OptimizationTags
 	NSMutableArray          *everythingElse;
 	BOOL					acceptsNonPrimitives;
 	
-	NSMutableDictionary		*colorOptimizations; // key is @"%f %f %f %f", value is OptimizationTags in NSValue
-	NSMutableDictionary		*colorWireframeOptimizations; // key is @"%f %f %f %f", value is OptimizationTags in NSValue
+	struct OptimizationTags	solidOptimization;		// shared by all colors
+	struct OptimizationTags	wireframeOptimization;
+	BOOL					isOptimized;
 	BOOL					needsRebuilding;
+	
+	struct LDrawBVH			*pickingBVH;			// built on first pick; thrown out when the primitives change
+	id						*pickingDirectives;		// BVH primitive IDs -> the directives they came from
 }
 
 // Accessors
-- (BOOL) isOptimizedForColor:(LDrawColor *)parentColor;
++ (size_t) optimizedBufferBytes;
+- (BOOL) isOptimized;
 - (void) setLines:(NSArray *)linesIn
 		triangles:(NSArray *)trianglesIn
    quadrilaterals:(NSArray *)quadrilateralsIn
@@ -74,9 +96,9 @@ struct OptimizationTags
 - (void) removeOther:(LDrawDirective *)other;
 
 // Optimize
-- (void) optimizeOpenGLWithParentColor:(LDrawColor *)parentColor;
-- (void) optimizeSolidWithParentColor:(LDrawColor *)color;
-- (void) optimizeWireframeWithParentColor:(LDrawColor *)color;
+- (void) optimizeOpenGL;
+- (void) optimizeSolid;
+- (void) optimizeWireframe;
 - (void) rebuildAllOptimizations;
 - (void) removeAllOptimizations;
 
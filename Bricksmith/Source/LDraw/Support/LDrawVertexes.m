@@ -22,11 +22,39 @@
 
 #import OPEN_GL_EXT_HEADER
 
+#import "ColorLibrary.h"
+#import "LDrawBVH.h"
 #import "LDrawLine.h"
 #import "LDrawTriangle.h"
 #import "LDrawQuadrilateral.h"
+#import "LDrawUtilities.h"
+
+static void DeleteOptimizationTags(struct OptimizationTags *tags);
+static void BuildOptimizationVAO(struct OptimizationTags *tags, VBOVertexData *vertexes, size_t vertexCount);
+
+// Bytes in every vertex buffer the optimizations have uploaded and not yet 
+// deleted. Optimization is main-thread only, so this needs no lock.
+static size_t OptimizedBufferBytes = 0;
+
+// What the BVH hit callbacks need to register a hit.
+struct PickingContext
+{
+	id					*directives;
+	id					creditObject;
+	id					hits;
+};
+
+static void RegisterRayHit(int primitiveID, float depth, void *ref);
+static void RegisterBoxHit(int primitiveID, float depth, void *ref);
+
+
+@interface LDrawVertexes ()
+
+- (struct LDrawBVH *) pickingBVH;
+- (void) removePickingBVH;
+
+@end
 
-static void DeleteOptimizationTags(struct OptimizationTags tags);
 
 @implementation LDrawVertexes
 
@@ -45,8 +73,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 		self->quadrilaterals                = [[NSMutableArray alloc] init];
 		self->everythingElse                = [[NSMutableArray alloc] init];
 		
-		self->colorOptimizations            = [[NSMutableDictionary alloc] init];
-		self->colorWireframeOptimizations   = [[NSMutableDictionary alloc] init];
+		self->isOptimized					= NO;
 		self->needsRebuilding				= YES;
     }
     return self;
@@ -70,32 +97,49 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //==============================================================================
 - (void) draw:(NSUInteger)optionsMask viewScale:(float)scaleFactor parentColor:(LDrawColor *)parentColor
 {
-	id                      key     = parentColor;
-	NSValue                 *value  = nil;
-	struct OptimizationTags tags    = {};
+	struct OptimizationTags *tags       = NULL;
+	GLfloat                 current[4]  = {};
+	GLfloat                 edge[4]     = {};
+	int                     colorClass  = 0;
 	
 	if(optionsMask & DRAW_WIREFRAME)
-	{
-		value = [self->colorWireframeOptimizations objectForKey:key];
-	}
+		tags = &self->wireframeOptimization;
 	else
-	{
-		value = [self->colorOptimizations objectForKey:key];
-	}
-
-	[value getValue:&tags];
+		tags = &self->solidOptimization;
+	
+	[parentColor getColorRGBA:current];
+	[[parentColor complimentColor] getColorRGBA:edge];
+	
+	glBindVertexArrayAPPLE(tags->anyVAOTag);
 	
+	for(colorClass = 0; colorClass < VertexColorClassCount; colorClass++)
 	{
-		glBindVertexArrayAPPLE(tags.anyVAOTag);
-
-		// Lines
-		if(tags.lineCount)
-			glDrawArrays(GL_LINES, tags.lineOffset, tags.lineCount * 2);
-		if(tags.triangleCount)
-			glDrawArrays(GL_TRIANGLES, tags.triangleOffset, tags.triangleCount * 3);
-#if (TESSELATE_QUADS == 0)
-		if(tags.quadCount)
-			glDrawArrays(GL_QUADS, tags.quadOffset, tags.quadCount * 4);
+		// Meta-colored runs get the instance color as the GL current color; 
+		// the color array (part of the VAO) is on only for baked colors. 
+		switch(colorClass)
+		{
+			case VertexColorCurrent:
+				glDisableClientState(GL_COLOR_ARRAY);
+				glColor4fv(current);
+				break;
+			case VertexColorEdge:
+				glColor4fv(edge);
+				break;
+			case VertexColorFixed:
+				glEnableClientState(GL_COLOR_ARRAY);
+				break;
+		}
+		
+		if(tags->lineCount[colorClass])
+			glDrawArrays(GL_LINES, tags->lineOffset[colorClass], tags->lineCount[colorClass]);
+		if(tags->triangleCount[colorClass])
+			glDrawArrays(GL_TRIANGLES, tags->triangleOffset[colorClass], tags->triangleCount[colorClass]);
+#if TESSELATE_QUADS
+		if(tags->quadCount[colorClass])
+			glDrawArrays(GL_TRIANGLES, tags->quadOffset[colorClass], tags->quadCount[colorClass]);
+#else
+		if(tags->quadCount[colorClass])
+			glDrawArrays(GL_QUADS, tags->quadOffset[colorClass], tags->quadCount[colorClass]);
 #endif
 	}
 	
@@ -118,6 +162,10 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //				boxes, and it's easier to leverage the existing hit test code in 
 //				the contained directives. 
 //
+//				Library parts are picked through here too, so the primitives 
+//				are tested through a BVH rather than one message each; the BVH 
+//				runs the same tests the directives would. 
+//
 //==============================================================================
 - (void) hitTest:(Ray3)pickRay
 	   transform:(Matrix4)transform
@@ -126,41 +174,19 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	creditObject:(id)creditObject
 			hits:(NSMutableDictionary *)hits
 {
-	NSArray     *commands           = nil;
-	NSUInteger  commandCount        = 0;
-	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	struct LDrawBVH         *bvh                = [self pickingBVH];
+	struct PickingContext   context             = { self->pickingDirectives, creditObject, hits };
+	float                   lineTolerance       = 0;
+	
+	// Triangles, quadrilaterals and lines
+	// Lines are picked within 1.5 pixels, just as LDrawLine does it. A credit 
+	// object only keeps its nearest hit, so that's all we look for. 
+	lineTolerance = 1.5 / scaleFactor;
+	LDrawBVHRayTest(bvh, pickRay, transform, lineTolerance, creditObject != nil, RegisterRayHit, &context);
 	
-	// Triangles
-	commands        = triangles;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
-	}
-	// Quadrilaterals
-	commands        = quadrilaterals;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
-	}
-	// Lines
-	commands        = lines;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
-	}
 	// All else
-	commands        = everythingElse;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
+	for(LDrawDirective *currentDirective in self->everythingElse)
 	{
-		currentDirective = [commands objectAtIndex:counter];
 		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
 	}
 }
@@ -177,47 +203,19 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	   creditObject:(id)creditObject 
 	           hits:(NSMutableSet *)hits
 {
-	NSArray     *commands           = nil;
-	NSUInteger  commandCount        = 0;
-	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	struct LDrawBVH         *bvh                = [self pickingBVH];
+	struct PickingContext   context             = { self->pickingDirectives, creditObject, hits };
+	BOOL                    anyHit              = NO;
+
+	// Triangles, quadrilaterals and lines
+	// With a credit object, one hit says it all.
+	anyHit = LDrawBVHBoxTest(bvh, bounds, transform, creditObject != nil, RegisterBoxHit, &context);
+	if(anyHit && creditObject != nil)
+		return TRUE;
 
-	// Triangles
-	commands        = triangles;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
-			if(creditObject != nil)
-				return TRUE;
-	}
-	// Quadrilaterals
-	commands        = quadrilaterals;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
-			if(creditObject != nil)
-				return TRUE;		
-	}
-	// Lines
-	commands        = lines;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
-			if(creditObject != nil)
-				return TRUE;
-	}
 	// All else
-	commands        = everythingElse;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
+	for(LDrawDirective *currentDirective in self->everythingElse)
 	{
-		currentDirective = [commands objectAtIndex:counter];
 		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
 			if(creditObject != nil)
 				return TRUE;		
@@ -240,61 +238,155 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 		   bestObject:(id *)bestObject 
 			bestDepth:(float *)bestDepth
 {
-	NSArray     *commands           = nil;
-	NSUInteger  commandCount        = 0;
-	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	struct LDrawBVH *bvh            = [self pickingBVH];
+	int             primitiveID     = 0;
 
-	// Triangles
-	commands        = triangles;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
+	// Triangles, quadrilaterals and lines
+	primitiveID = LDrawBVHDepthTest(bvh, testPt, bounds, transform, bestDepth);
+	if(primitiveID != -1)
 	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective depthTest:testPt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+		*bestObject = creditObject ? creditObject : self->pickingDirectives[primitiveID];
 	}
-	// Quadrilaterals
-	commands        = quadrilaterals;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
+	
+	// All else
+	for(LDrawDirective *currentDirective in self->everythingElse)
 	{
-		currentDirective = [commands objectAtIndex:counter];
 		[currentDirective depthTest:testPt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
 	}
-	// Lines
-	commands        = lines;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
-	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective depthTest:testPt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+}//end depthTest:inBox:transform:creditObject:bestObject:bestDepth:
+
+
+#pragma mark -
+#pragma mark PICKING
+#pragma mark -
+
+//========== pickingBVH ========================================================
+//
+// Purpose:		Returns the BVH over our visible primitives, building it if 
+//				it's been thrown out. 
+//
+// Notes:		Quads go in as two triangles, the same two the quad's own hit 
+//				tests use. Each primitive's ID is its index in 
+//				pickingDirectives; we don't retain the directives there, since 
+//				our arrays do, and any change to them throws the BVH out. 
+//
+//				Building is not thread-safe; picking happens on the main thread. 
+//
+//==============================================================================
+- (struct LDrawBVH *) pickingBVH
+{
+	if(self->pickingBVH == NULL)
+	{
+		NSUInteger  maxTriangleCount    = [self->triangles count] + [self->quadrilaterals count] * 2;
+		NSUInteger  maxLineCount        = [self->lines count];
+		NSUInteger  maxDirectiveCount   = [self->triangles count] + [self->quadrilaterals count] + [self->lines count];
+		float       *triangleVertexes   = malloc(sizeof(float) * 9 * maxTriangleCount);
+		int         *triangleIDs        = malloc(sizeof(int) * maxTriangleCount);
+		float       *lineVertexes       = malloc(sizeof(float) * 6 * maxLineCount);
+		int         *lineIDs            = malloc(sizeof(int) * maxLineCount);
+		int         triangleCount       = 0;
+		int         lineCount           = 0;
+		int         directiveCount      = 0;
+		
+		self->pickingDirectives = malloc(sizeof(id) * maxDirectiveCount);
+		
+		for(LDrawTriangle *triangle in self->triangles)
+		{
+			if([triangle isHidden] == NO)
+			{
+				Point3 triangleCorners[3] = { [triangle vertex1], [triangle vertex2], [triangle vertex3] };
+				
+				memcpy(triangleVertexes + 9 * triangleCount, triangleCorners, sizeof(triangleCorners));
+				triangleIDs[triangleCount++] = directiveCount;
+				self->pickingDirectives[directiveCount++] = triangle;
+			}
+		}
+		for(LDrawQuadrilateral *quadrilateral in self->quadrilaterals)
+		{
+			if([quadrilateral isHidden] == NO)
+			{
+				Point3 halves[6] = {	[quadrilateral vertex1], [quadrilateral vertex2], [quadrilateral vertex3],
+										[quadrilateral vertex3], [quadrilateral vertex4], [quadrilateral vertex1] };
+				
+				memcpy(triangleVertexes + 9 * triangleCount, halves, sizeof(halves));
+				triangleIDs[triangleCount++] = directiveCount;
+				triangleIDs[triangleCount++] = directiveCount;
+				self->pickingDirectives[directiveCount++] = quadrilateral;
+			}
+		}
+		for(LDrawLine *line in self->lines)
+		{
+			if([line isHidden] == NO)
+			{
+				Point3 endpoints[2] = { [line vertex1], [line vertex2] };
+				
+				memcpy(lineVertexes + 6 * lineCount, endpoints, sizeof(endpoints));
+				lineIDs[lineCount++] = directiveCount;
+				self->pickingDirectives[directiveCount++] = line;
+			}
+		}
+		
+		self->pickingBVH = LDrawBVHCreate(triangleCount, triangleVertexes, triangleIDs, lineCount, lineVertexes, lineIDs);
+		
+		free(triangleVertexes);
+		free(triangleIDs);
+		free(lineVertexes);
+		free(lineIDs);
 	}
-	// All else
-	commands        = everythingElse;
-	commandCount    = [commands count];
-	for(counter = 0; counter < commandCount; counter++)
+	return self->pickingBVH;
+	
+}//end pickingBVH
+
+
+//========== removePickingBVH ==================================================
+//
+// Purpose:		Throws out the BVH; the primitives have changed.
+//
+//==============================================================================
+- (void) removePickingBVH
+{
+	if(self->pickingBVH)
 	{
-		currentDirective = [commands objectAtIndex:counter];
-		[currentDirective depthTest:testPt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
+		LDrawBVHDestroy(self->pickingBVH);
+		self->pickingBVH = NULL;
 	}
-}//end depthTest:inBox:transform:creditObject:bestObject:bestDepth:
+	free(self->pickingDirectives);
+	self->pickingDirectives = NULL;
+	
+}//end removePickingBVH
 
 
 #pragma mark -
 #pragma mark ACCESSORS
 #pragma mark -
 
-//========== isOptimizedForColor: ==============================================
+//---------- optimizedBufferBytes ------------------------------------[static]--
 //
-// Purpose:		Has a cached optimization for the given color.
+// Purpose:		Returns the bytes handed to glBufferData for the vertex buffers 
+//				of every optimized LDrawVertexes - the number to watch when 
+//				changing how geometry is shared. 
 //
-//==============================================================================
-- (BOOL) isOptimizedForColor:(LDrawColor *)color
+// Notes:		This is an estimate of the VRAM they take, not a measurement: 
+//				the driver may pad buffers, or keep a copy in system memory 
+//				instead. 
+//
+//------------------------------------------------------------------------------
++ (size_t) optimizedBufferBytes
 {
-	id      key     = color;
-	NSValue *value  = [self->colorOptimizations objectForKey:key];
+	return OptimizedBufferBytes;
 	
-	return (value != nil);
+}//end optimizedBufferBytes
+
+
+//========== isOptimized =======================================================
+//
+// Purpose:		Has a cached optimization. The optimization is the same for 
+//				every color, so once we have one we can draw in any color. 
+//
+//==============================================================================
+- (BOOL) isOptimized
+{
+	return self->isOptimized;
 }
 
 
@@ -348,6 +440,8 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	[self->quadrilaterals	addObjectsFromArray:quadrilateralsIn];
 	[self->everythingElse	addObjectsFromArray:everythingElseIn];
 	
+	[self removePickingBVH];
+	
 }//end setLines:triangles:quadrilaterals:other:
 
 
@@ -360,6 +454,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 - (void) setVertexesNeedRebuilding
 {
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -403,6 +498,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->lines addObject:line];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -416,6 +512,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->triangles addObject:triangle];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -429,6 +526,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->quadrilaterals addObject:quadrilateral];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -484,6 +582,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->lines removeObjectIdenticalTo:line];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -497,6 +596,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->triangles removeObjectIdenticalTo:triangle];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -510,6 +610,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 {
 	[self->quadrilaterals removeObjectIdenticalTo:quadrilateral];
 	self->needsRebuilding = YES;
+	[self removePickingBVH];
 }
 
 
@@ -529,7 +630,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 #pragma mark OPTIMIZE
 #pragma mark -
 
-//========== optimizeOpenGLWithParentColor: ====================================
+//========== optimizeOpenGL ====================================================
 //
 // Purpose:		The caller is asking this instance to optimize itself for faster 
 //				drawing. 
@@ -539,13 +640,22 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //				limitation, so you are responsible for calling this method on 
 //				newly-parsed models. 
 //
+// Notes:		One optimization serves every color the vertexes are drawn in 
+//				(see -draw:viewScale:parentColor:), so this does nothing if we 
+//				are already optimized and nothing has changed. 
+//
 //==============================================================================
-- (void) optimizeOpenGLWithParentColor:(LDrawColor *)color
+- (void) optimizeOpenGL
 {
-	[self optimizeSolidWithParentColor:color];
+	if(self->isOptimized == YES && self->needsRebuilding == NO)
+		return;
+	
+	[self removeAllOptimizations];
+	
+	[self optimizeSolid];
 
 #if (USE_AUTOMATIC_WIREFRAMES == 0)
-	[self optimizeWireframeWithParentColor:color];
+	[self optimizeWireframe];
 #endif
 	
 	// Optimize directives we don't directly manage (like textures)
@@ -553,211 +663,148 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	{
 		[directive optimizeOpenGL];
 	}
-}
+	
+	self->isOptimized		= YES;
+	self->needsRebuilding	= NO;
+	
+}//end optimizeOpenGL
 
 
-//========== optimizeSolidWithParentColor: =====================================
+//========== writeDirectives:colorClass:toBuffer:wireframe: ====================
 //
-// Purpose:		Optimizes the filled geometry.
+// Purpose:		Writes the visible primitives of one color class into the 
+//				buffer, returning the end of the written data. 
+//
+// Notes:		Current- and edge-colored primitives are written with a 
+//				placeholder color; it is never read, because those runs are 
+//				drawn with the color array off. 
 //
 //==============================================================================
-- (void) optimizeSolidWithParentColor:(LDrawColor *)color
+- (VBOVertexData *) writeDirectives:(NSArray *)directives
+						 colorClass:(int)colorClass
+						   toBuffer:(VBOVertexData *)buffer
+						  wireframe:(BOOL)wireframe
 {
-	VBOVertexData           *buffer                 = NULL;
-	struct OptimizationTags tags                    = {};
-
-	//---------- Lines VBO -----------------------------------------------------
+	LDrawColor  *placeholderColor   = [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
+	int         directiveClass      = 0;
+	
+	for(LDrawDrawableElement *currentDirective in directives)
 	{
-		glGenBuffers(1, &tags.anyVBOTag);
-		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-		
-		size_t			maxLineCount		= [self->lines count];
-		size_t			maxTriangleCount	= [self->triangles count];
-		size_t			maxQuadCount		= [self->quadrilaterals count];
-#if TESSELATE_QUADS
-		maxTriangleCount += ([self->quadrilaterals count] * 2);
-		maxQuadCount = 0;
-#endif
-		size_t			anyBufferSize = (maxLineCount * 2 + maxTriangleCount * 3 + maxQuadCount * 4) * sizeof(VBOVertexData);
-		VBOVertexData *	anyVertexes = malloc(anyBufferSize);
-		buffer = anyVertexes;
-		GLint			offset = 0;
-		
-		tags.lineOffset = offset;
-		for(LDrawLine *currentDirective in self->lines)
+		if([currentDirective isHidden] == NO)
 		{
-			if([currentDirective isHidden] == NO)
+			switch([[currentDirective LDrawColor] colorCode])
 			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.lineCount++;
-				offset += 2;
+				case LDrawCurrentColor:	directiveClass = VertexColorCurrent;	break;
+				case LDrawEdgeColor:	directiveClass = VertexColorEdge;		break;
+				default:				directiveClass = VertexColorFixed;		break;
 			}
-		}
-		tags.triangleOffset = offset;
-		for(LDrawTriangle *currentDirective in self->triangles)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.triangleCount++;
-				offset += 3;
-			}
-		}
-	#if TESSELATE_QUADS
-		for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.triangleCount += 2;
-				offset += 6;
-			}
-		}
-	#endif
-		tags.quadOffset = offset;
-	#if !TESSELATE_QUADS
-		for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-		{
-			if([currentDirective isHidden] == NO)
+			
+			if(directiveClass == colorClass)
 			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.quadCount++;
-				offset += 4;
+				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:placeholderColor wireframe:wireframe];
 			}
 		}
+	}
+	return buffer;
 	
-	#endif
-			
-		glBufferData(GL_ARRAY_BUFFER, anyBufferSize, anyVertexes, GL_STATIC_DRAW);
-		free(anyVertexes);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// Encapsulate in a VAO
-		glGenVertexArraysAPPLE(1, &tags.anyVAOTag);
-		glBindVertexArrayAPPLE(tags.anyVAOTag);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_NORMAL_ARRAY);
-		glEnableClientState(GL_COLOR_ARRAY);
-		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-		glVertexPointer(3, GL_FLOAT, sizeof(VBOVertexData), NULL);
-		glNormalPointer(GL_FLOAT,    sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3));
-		glColorPointer(4, GL_FLOAT,  sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3 + sizeof(float)*3) );
+}//end writeDirectives:colorClass:toBuffer:wireframe:
+
+
+//========== optimizeSolid =====================================================
+//
+// Purpose:		Optimizes the filled geometry.
+//
+//==============================================================================
+- (void) optimizeSolid
+{
+	struct OptimizationTags *tags       = &self->solidOptimization;
+	VBOVertexData           *vertexes   = NULL;
+	VBOVertexData           *buffer     = NULL;
+	int                     colorClass  = 0;
+	
+	size_t			maxLineCount		= [self->lines count];
+	size_t			maxTriangleCount	= [self->triangles count];
+	size_t			maxQuadCount		= [self->quadrilaterals count];
+#if TESSELATE_QUADS
+	size_t			maxVertexCount		= maxLineCount * 2 + maxTriangleCount * 3 + maxQuadCount * 6;
+#else
+	size_t			maxVertexCount		= maxLineCount * 2 + maxTriangleCount * 3 + maxQuadCount * 4;
+#endif
+	
+	vertexes	= malloc(maxVertexCount * sizeof(VBOVertexData));
+	buffer		= vertexes;
+	
+	for(colorClass = 0; colorClass < VertexColorClassCount; colorClass++)
+	{
+		tags->lineOffset[colorClass]		= buffer - vertexes;
+		buffer								= [self writeDirectives:self->lines colorClass:colorClass toBuffer:buffer wireframe:NO];
+		tags->lineCount[colorClass]			= (buffer - vertexes) - tags->lineOffset[colorClass];
 		
-		glBindVertexArrayAPPLE(0);		
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		tags->triangleOffset[colorClass]	= buffer - vertexes;
+		buffer								= [self writeDirectives:self->triangles colorClass:colorClass toBuffer:buffer wireframe:NO];
+		tags->triangleCount[colorClass]		= (buffer - vertexes) - tags->triangleOffset[colorClass];
+		
+		tags->quadOffset[colorClass]		= buffer - vertexes;
+		buffer								= [self writeDirectives:self->quadrilaterals colorClass:colorClass toBuffer:buffer wireframe:NO];
+		tags->quadCount[colorClass]			= (buffer - vertexes) - tags->quadOffset[colorClass];
 	}
 	
-	// Cache
-	id      key     = color;
-	NSValue *value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
-	[self->colorOptimizations setObject:value forKey:key];
+	BuildOptimizationVAO(tags, vertexes, buffer - vertexes);
+	free(vertexes);
 	
-}//end optimizeOpenGL
+}//end optimizeSolid
 
 
-//========== optimizeWireframeWithParentColor: =================================
+//========== optimizeWireframe =================================================
 //
 // Purpose:		The caller is asking this instance to optimize itself for faster 
 //				drawing as a wireframe. 
 //
+// Notes:		Every primitive turns into lines here, so each color class is a 
+//				single line run. 
+//
 //==============================================================================
-- (void) optimizeWireframeWithParentColor:(LDrawColor *)color
+- (void) optimizeWireframe
 {
-	VBOVertexData           *buffer                 = NULL;
-	struct OptimizationTags tags                    = {};
+	struct OptimizationTags *tags       = &self->wireframeOptimization;
+	VBOVertexData           *vertexes   = NULL;
+	VBOVertexData           *buffer     = NULL;
+	int                     colorClass  = 0;
+	size_t                  maxVertexCount  = 0;
 	
-	//---------- Lines VBO -----------------------------------------------------
+	maxVertexCount += [self->lines count] * 2;
+	maxVertexCount += [self->triangles count] * 6;
+	maxVertexCount += [self->quadrilaterals count] * 8;
+	
+	vertexes	= malloc(maxVertexCount * sizeof(VBOVertexData));
+	buffer		= vertexes;
+	
+	for(colorClass = 0; colorClass < VertexColorClassCount; colorClass++)
 	{
-		glGenBuffers(1, &tags.anyVBOTag);
-		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-
-		size_t          maxVertexCount  = 0;
-		size_t          linesBufferSize = 0;
-		VBOVertexData   *lineVertexes   = 0;
-		
-		maxVertexCount += [self->lines count] * 2;
-		maxVertexCount += [self->triangles count] * 6;
-		maxVertexCount += [self->quadrilaterals count] * 8;
-		
-		if(maxVertexCount)
-		{
-			linesBufferSize = maxVertexCount * sizeof(VBOVertexData);
-			lineVertexes    = malloc(linesBufferSize);
-			buffer          = lineVertexes;
-			
-			for(LDrawLine *currentDirective in self->lines)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			for(LDrawTriangle *currentDirective in self->triangles)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			
-			glBufferData(GL_ARRAY_BUFFER, linesBufferSize, lineVertexes, GL_STATIC_DRAW);
-			free(lineVertexes);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-			// Encapsulate in a VAO
-			glGenVertexArraysAPPLE(1, &tags.anyVAOTag);
-			glBindVertexArrayAPPLE(tags.anyVAOTag);
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glEnableClientState(GL_NORMAL_ARRAY);
-			glEnableClientState(GL_COLOR_ARRAY);
-			glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-			glVertexPointer(3, GL_FLOAT, sizeof(VBOVertexData), NULL);
-			glNormalPointer(GL_FLOAT,    sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3));
-			glColorPointer(4, GL_FLOAT,  sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3 + sizeof(float)*3) );
-
-			glBindVertexArrayAPPLE(0);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-		}
-	}	
-
-	// Cache
-	id      key     = color;
-	NSValue *value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
-	[self->colorWireframeOptimizations setObject:value forKey:key];
+		tags->lineOffset[colorClass]	= buffer - vertexes;
+		buffer							= [self writeDirectives:self->lines colorClass:colorClass toBuffer:buffer wireframe:YES];
+		buffer							= [self writeDirectives:self->triangles colorClass:colorClass toBuffer:buffer wireframe:YES];
+		buffer							= [self writeDirectives:self->quadrilaterals colorClass:colorClass toBuffer:buffer wireframe:YES];
+		tags->lineCount[colorClass]		= (buffer - vertexes) - tags->lineOffset[colorClass];
+	}
 	
-}//end optimizeOpenGL
+	BuildOptimizationVAO(tags, vertexes, buffer - vertexes);
+	free(vertexes);
+	
+}//end optimizeWireframe
 
 
 //========== rebuildAllOptimizations ===========================================
 //
-// Purpose:		Regenerates the optimized OpenGL structures for all existing 
-//				optimized colors. 
+// Purpose:		Regenerates the optimized OpenGL structures if the vertexes 
+//				have changed since they were optimized. 
 //
 //==============================================================================
 - (void) rebuildAllOptimizations
 {
-	if(self->needsRebuilding)
+	if(self->needsRebuilding && self->isOptimized)
 	{
-		NSArray *allColors = [self->colorOptimizations allKeys];
-		
-		[self removeAllOptimizations];
-		
-		// Rebuild all optimizations
-		for(LDrawColor *color in allColors)
-		{
-			[self optimizeOpenGLWithParentColor:color];
-		}
-		self->needsRebuilding = NO;
+		[self optimizeOpenGL];
 	}
 }//end rebuildAllOptimizations
 
@@ -769,28 +816,10 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //==============================================================================
 - (void) removeAllOptimizations
 {
-	// Remove all existing optimizations
-	for(LDrawColor *color in self->colorOptimizations)
-	{
-		NSValue                 *value  = [self->colorOptimizations objectForKey:color];
-		struct OptimizationTags tags    = {};
-		
-		[value getValue:&tags];
-		
-		DeleteOptimizationTags(tags);
-	}
-	
-	for(LDrawColor *color in self->colorWireframeOptimizations)
-	{
-		NSValue                 *value  = [self->colorWireframeOptimizations objectForKey:color];
-		struct OptimizationTags tags    = {};
-		
-		[value getValue:&tags];
-		
-		DeleteOptimizationTags(tags);
-	}
+	DeleteOptimizationTags(&self->solidOptimization);
+	DeleteOptimizationTags(&self->wireframeOptimization);
 	
-	[self->colorOptimizations removeAllObjects];
+	self->isOptimized = NO;
 	
 }//end removeAllOptimizations
 
@@ -807,14 +836,12 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 - (void) dealloc
 {
 	[self removeAllOptimizations];
+	[self removePickingBVH];
 	
 	[lines							release];
 	[triangles						release];
 	[quadrilaterals					release];
 	[everythingElse					release];
-	
-	[colorOptimizations				release];
-	[colorWireframeOptimizations	release];
 
 	[super dealloc];
 	
@@ -831,19 +858,78 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 @end
 
 
+//========== BuildOptimizationVAO ==============================================
+//
+// Purpose:		Uploads the vertexes into a new VBO and encapsulates it in a 
+//				VAO, recording both in the tags. 
+//
+//==============================================================================
+void BuildOptimizationVAO(struct OptimizationTags *tags, VBOVertexData *vertexes, size_t vertexCount)
+{
+	glGenBuffers(1, &tags->anyVBOTag);
+	glBindBuffer(GL_ARRAY_BUFFER, tags->anyVBOTag);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(VBOVertexData), vertexes, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	tags->bufferSize		= vertexCount * sizeof(VBOVertexData);
+	OptimizedBufferBytes	+= tags->bufferSize;
+
+	// Encapsulate in a VAO
+	glGenVertexArraysAPPLE(1, &tags->anyVAOTag);
+	glBindVertexArrayAPPLE(tags->anyVAOTag);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, tags->anyVBOTag);
+	glVertexPointer(3, GL_FLOAT, sizeof(VBOVertexData), NULL);
+	glNormalPointer(GL_FLOAT,    sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3));
+	glColorPointer(4, GL_FLOAT,  sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3 + sizeof(float)*3) );
+	
+	glBindVertexArrayAPPLE(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
 //========== DeleteOptimizationTags ============================================
 //
 // Purpose:		Removes the optimized objects in the tag list.
 //
 //==============================================================================
-void DeleteOptimizationTags(struct OptimizationTags tags)
+void DeleteOptimizationTags(struct OptimizationTags *tags)
 {
-	if(tags.anyVBOTag != 0)
+	if(tags->anyVBOTag != 0)
 	{
-		glDeleteBuffers(1, &tags.anyVBOTag);		
-		glDeleteVertexArraysAPPLE(1, &tags.anyVAOTag);
-		
-		tags.anyVBOTag        = 0;
-		tags.anyVAOTag        = 0;
+		glDeleteBuffers(1, &tags->anyVBOTag);		
+		glDeleteVertexArraysAPPLE(1, &tags->anyVAOTag);
+		OptimizedBufferBytes -= tags->bufferSize;
 	}
+	memset(tags, 0, sizeof(struct OptimizationTags));
+}
+
+
+//========== RegisterRayHit ====================================================
+//
+// Purpose:		BVH callback: records a pick-ray hit just as the directive 
+//				itself would have. 
+//
+//==============================================================================
+void RegisterRayHit(int primitiveID, float depth, void *ref)
+{
+	struct PickingContext *context = ref;
+	
+	[LDrawUtilities registerHitForObject:context->directives[primitiveID] depth:depth creditObject:context->creditObject hits:context->hits];
+}
+
+
+//========== RegisterBoxHit ====================================================
+//
+// Purpose:		BVH callback: records a marquee hit just as the directive 
+//				itself would have. 
+//
+//==============================================================================
+void RegisterBoxHit(int primitiveID, float depth, void *ref)
+{
+	struct PickingContext *context = ref;
+	
+	[LDrawUtilities registerHitForObject:context->directives[primitiveID] creditObject:context->creditObject hits:context->hits];
 }
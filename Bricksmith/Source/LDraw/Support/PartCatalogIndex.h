@@ -0,0 +1,53 @@
+//==============================================================================
+//
+// File:		PartCatalogIndex.h
+//
+// Purpose:		Answers part browser searches against the whole part catalog
+//				without looking at every part record on each keystroke.
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+// Catalog index terminology:
+//
+// A search is a list of words.  A part matches when every word is found
+// somewhere in its part number or its description (ignoring case, and with the
+// description's spaces removed, so "2x4" finds "Brick  2 x  4").  Failing
+// that, a part also matches when the whole search, spaces removed, is found in
+// one of its !KEYWORDS.  This is exactly what the part browser has always
+// matched; the index just finds the matches faster.
+//
+// To do that, the index keeps posting lists: for each pair and triple of
+// characters ("n-grams"), the parts whose text contains it.  A word can only
+// be found in parts that contain all of its n-grams, so we only have to check
+// the parts on the word's shortest list.
+//
+// Results are ranked: parts whose number IS a search word come first, then
+// parts whose number starts with one, then the other matches, then the
+// keyword-only matches.  If nothing matches at all, we fall back to a fuzzy
+// search - parts sharing most of the search's character pairs - so a typo like
+// "brik" still finds bricks.
+//
+// The index is immutable once built and may be queried from any thread.
+
+struct PartCatalogIndexData;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class PartCatalogIndex
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface PartCatalogIndex : NSObject
+{
+	NSArray						*records;	// the part catalog records, by index
+	struct PartCatalogIndexData	*data;		// the posting lists; see the .m
+}
+
+- (id) initWithPartCatalogRecords:(NSArray *)partRecords;
+
+- (NSArray *) recordsMatchingSearch:(NSString *)searchString;
+
+@end
@@ -0,0 +1,693 @@
+//==============================================================================
+//
+// File:		PartCatalogIndex.m
+//
+// Purpose:		Answers part browser searches against the whole part catalog
+//				without looking at every part record on each keystroke.
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//==============================================================================
+#import "PartCatalogIndex.h"
+
+#import <stdint.h>
+#import <stdlib.h>
+#import <string.h>
+
+#import "PartLibrary.h"
+#import "StringCategory.h"
+
+// Catalog index implementation:
+//
+// All text is kept as lower-case UTF-8 C strings, one per part for the number,
+// the description (spaces removed) and the keywords (spaces removed, joined
+// with newlines, which no search can contain).  Checking a candidate is then a
+// strstr.
+//
+// N-grams are packed into 32 bits - the length in the top byte, then the
+// characters - and hashed into an open-addressed table of posting lists.  Each
+// list holds part indexes in increasing order with no repeats, since parts are
+// added in order.  There is one table for numbers and descriptions, and one
+// for keywords.
+
+#define GRAM2(a,b)		((2u << 24) | ((uint32_t)(uint8_t)(a) << 16) | ((uint32_t)(uint8_t)(b) << 8))
+#define GRAM3(a,b,c)	((3u << 24) | ((uint32_t)(uint8_t)(a) << 16) | ((uint32_t)(uint8_t)(b) << 8) | (uint32_t)(uint8_t)(c))
+
+// How much of the search's character pairs a part must share to be a fuzzy
+// match, as a fraction.
+#define FUZZY_MATCH_NUMERATOR	2
+#define FUZZY_MATCH_DENOMINATOR	3
+
+// Result tiers, best first.
+typedef enum
+{
+	MatchTierNumber			= 0,	// a search word is the part number
+	MatchTierNumberPrefix	= 1,	// a search word starts the part number
+	MatchTierText			= 2,	// found in number or description
+	MatchTierKeyword		= 3,	// found only in the keywords
+	MatchTierFuzzy			= 4,	// shares most character pairs
+	MatchTierNone			= 0xFF
+
+} MatchTierT;
+
+typedef struct
+{
+	uint32_t	gram;		// 0 = empty slot
+	uint32_t	count;
+	uint32_t	capacity;
+	uint32_t *	ids;
+
+} GramPosting;
+
+typedef struct
+{
+	GramPosting *	slots;
+	uint32_t		slot_count;	// power of 2
+	uint32_t		used;
+
+} GramTable;
+
+struct PartCatalogIndexData
+{
+	uint32_t		part_count;
+	char **			numbers;		// lower case
+	char **			numbers_sans_extension;
+	char **			descriptions;	// lower case, no whitespace
+	char **			keywords;		// lower case, no whitespace, newline-separated; NULL if none
+
+	GramTable		text_grams;		// numbers and descriptions
+	GramTable		keyword_grams;
+};
+
+typedef struct
+{
+	uint32_t		part;		// index into the records
+	uint32_t		tier;
+	uint32_t		score;		// lower is better, within a tier
+	const char *	number;
+
+} RankedMatch;
+
+static uint32_t			PartCatalogSearch(const struct PartCatalogIndexData *data, const char **words, uint32_t wordCount, const char *searchSansWS, RankedMatch *matches);
+static void				GramTableInit(GramTable *table);
+static void				GramTableFree(GramTable *table);
+static GramPosting *	GramTableFind(const GramTable *table, uint32_t gram);
+static void				GramTableAdd(GramTable *table, uint32_t gram, uint32_t part);
+static void				GramTableAddText(GramTable *table, const char *text, uint32_t part);
+static int				GramTableCandidates(const GramTable *table, const char *word, const uint32_t **parts, uint32_t *count);
+static char *			LowercaseCString(NSString *string);
+static int				CompareRankedMatches(const void *lhs, const void *rhs);
+
+
+@implementation PartCatalogIndex
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//========== initWithPartCatalogRecords: =======================================
+//
+// Purpose:		Indexes the given part catalog records (as returned by
+//				-[PartLibrary allPartCatalogRecords]).
+//
+//==============================================================================
+- (id) initWithPartCatalogRecords:(NSArray *)partRecords
+{
+	NSDictionary	*record			= nil;
+	NSArray			*keywordList	= nil;
+	NSMutableArray	*keywordTexts	= nil;
+	uint32_t		counter			= 0;
+
+	self = [super init];
+
+	if(self)
+	{
+		records			= [partRecords copy];
+		data			= calloc(1, sizeof(struct PartCatalogIndexData));
+
+		data->part_count				= (uint32_t)[records count];
+		data->numbers					= calloc(data->part_count, sizeof(char *));
+		data->numbers_sans_extension	= calloc(data->part_count, sizeof(char *));
+		data->descriptions				= calloc(data->part_count, sizeof(char *));
+		data->keywords					= calloc(data->part_count, sizeof(char *));
+
+		GramTableInit(&data->text_grams);
+		GramTableInit(&data->keyword_grams);
+
+		for(counter = 0; counter < data->part_count; counter++)
+		{
+			record = [records objectAtIndex:counter];
+
+			data->numbers[counter]					= LowercaseCString([record objectForKey:PART_NUMBER_KEY]);
+			data->numbers_sans_extension[counter]	= LowercaseCString([[record objectForKey:PART_NUMBER_KEY] stringByDeletingPathExtension]);
+			data->descriptions[counter]				= LowercaseCString([[record objectForKey:PART_NAME_KEY] ams_stringByRemovingWhitespace]);
+
+			GramTableAddText(&data->text_grams, data->numbers[counter], counter);
+			GramTableAddText(&data->text_grams, data->descriptions[counter], counter);
+
+			keywordList = [record objectForKey:PART_KEYWORDS_KEY];
+			if([keywordList count] > 0)
+			{
+				keywordTexts = [NSMutableArray arrayWithCapacity:[keywordList count]];
+				for(NSString *keyword in keywordList)
+				{
+					[keywordTexts addObject:[keyword ams_stringByRemovingWhitespace]];
+				}
+				data->keywords[counter] = LowercaseCString([keywordTexts componentsJoinedByString:@"\n"]);
+
+				for(NSString *keyword in keywordTexts)
+				{
+					char *keywordText = LowercaseCString(keyword);
+					GramTableAddText(&data->keyword_grams, keywordText, counter);
+					free(keywordText);
+				}
+			}
+		}
+	}
+
+	return self;
+
+}//end initWithPartCatalogRecords:
+
+
+#pragma mark -
+#pragma mark SEARCHING
+#pragma mark -
+
+//========== recordsMatchingSearch: ============================================
+//
+// Purpose:		Returns the part catalog records matching searchString, best
+//				matches first. See the header for what matches.
+//
+//==============================================================================
+- (NSArray *) recordsMatchingSearch:(NSString *)searchString
+{
+	NSMutableArray	*wordList		= [NSMutableArray array];
+	NSMutableArray	*results		= nil;
+	char			**words			= NULL;
+	uint32_t		wordCount		= 0;
+	char			*searchSansWS	= LowercaseCString([searchString ams_stringByRemovingWhitespace]);
+	RankedMatch		*matches		= malloc(sizeof(RankedMatch) * (data->part_count + 1));
+	uint32_t		matchCount		= 0;
+	uint32_t		counter			= 0;
+
+	// Same words as the part browser always used.
+	[searchString enumerateSubstringsInRange:NSMakeRange(0, [searchString length])
+									 options:NSStringEnumerationByWords
+								  usingBlock:^(NSString* word, NSRange wordRange, NSRange enclosingRange, BOOL* stop)
+	 {
+		 [wordList addObject:word];
+	 }];
+
+	wordCount	= (uint32_t)[wordList count];
+	words		= calloc(wordCount + 1, sizeof(char *));
+	for(counter = 0; counter < wordCount; counter++)
+		words[counter] = LowercaseCString([wordList objectAtIndex:counter]);
+
+	matchCount = PartCatalogSearch(data, (const char **)words, wordCount, searchSansWS, matches);
+
+	results = [NSMutableArray arrayWithCapacity:matchCount];
+	for(counter = 0; counter < matchCount; counter++)
+		[results addObject:[records objectAtIndex:matches[counter].part]];
+
+	for(counter = 0; counter < wordCount; counter++)
+		free(words[counter]);
+	free(words);
+	free(searchSansWS);
+	free(matches);
+
+	return results;
+
+}//end recordsMatchingSearch:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Out with the postings.
+//
+//==============================================================================
+- (void) dealloc
+{
+	uint32_t counter = 0;
+
+	for(counter = 0; counter < data->part_count; counter++)
+	{
+		free(data->numbers[counter]);
+		free(data->numbers_sans_extension[counter]);
+		free(data->descriptions[counter]);
+		free(data->keywords[counter]);
+	}
+	free(data->numbers);
+	free(data->numbers_sans_extension);
+	free(data->descriptions);
+	free(data->keywords);
+
+	GramTableFree(&data->text_grams);
+	GramTableFree(&data->keyword_grams);
+	free(data);
+
+	[records release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+#pragma mark SEARCHING
+#pragma mark -
+
+//========== PartCatalogSearch() ===============================================
+//
+// Purpose:		The search proper. words are the lower-case search words;
+//				searchSansWS the lower-case search with whitespace removed.
+//				Fills matches (room for every part) in rank order.
+//
+// Returns:		The number of matches.
+//
+//==============================================================================
+static uint32_t PartCatalogSearch(const struct PartCatalogIndexData *data,
+								  const char **words,
+								  uint32_t wordCount,
+								  const char *searchSansWS,
+								  RankedMatch *matches)
+{
+	uint8_t			*tiers			= malloc(data->part_count + 1);
+	uint32_t		matchCount		= 0;
+	const uint32_t	*candidates		= NULL;
+	uint32_t		candidateCount	= 0;
+	int				haveCandidates	= 0;
+	uint32_t		counter			= 0;
+	uint32_t		wordIndex		= 0;
+	uint32_t		part			= 0;
+
+	memset(tiers, MatchTierNone, data->part_count);
+
+	//---------- Numbers and descriptions --------------------------------------
+	//
+	// Every word has to be found, so we only need to check the parts on the
+	// shortest list any word allows.
+
+	for(wordIndex = 0; wordIndex < wordCount; wordIndex++)
+	{
+		const uint32_t	*wordParts		= NULL;
+		uint32_t		wordPartCount	= 0;
+
+		if(GramTableCandidates(&data->text_grams, words[wordIndex], &wordParts, &wordPartCount))
+		{
+			if(haveCandidates == 0 || wordPartCount < candidateCount)
+			{
+				candidates		= wordParts;
+				candidateCount	= wordPartCount;
+				haveCandidates	= 1;
+			}
+		}
+	}
+	if(haveCandidates == 0)
+		candidateCount = data->part_count;
+
+	for(counter = 0; counter < candidateCount; counter++)
+	{
+		MatchTierT tier = MatchTierText;
+
+		part = haveCandidates ? candidates[counter] : counter;
+
+		for(wordIndex = 0; wordIndex < wordCount; wordIndex++)
+		{
+			const char *word = words[wordIndex];
+
+			if(		strstr(data->numbers[part], word) == NULL
+			   &&	strstr(data->descriptions[part], word) == NULL )
+			{
+				tier = MatchTierNone;
+				break;
+			}
+			if(		strcmp(data->numbers_sans_extension[part], word) == 0
+			   ||	strcmp(data->numbers[part], word) == 0 )
+			{
+				tier = MatchTierNumber;
+			}
+			else if(tier != MatchTierNumber && strncmp(data->numbers[part], word, strlen(word)) == 0)
+				tier = MatchTierNumberPrefix;
+		}
+		tiers[part] = tier;
+	}
+
+	//---------- Keywords ------------------------------------------------------
+
+	if(searchSansWS[0] != '\0')
+	{
+		haveCandidates = GramTableCandidates(&data->keyword_grams, searchSansWS, &candidates, &candidateCount);
+		if(haveCandidates == 0)
+			candidateCount = data->part_count;
+
+		for(counter = 0; counter < candidateCount; counter++)
+		{
+			part = haveCandidates ? candidates[counter] : counter;
+
+			if(		tiers[part] == MatchTierNone
+			   &&	data->keywords[part] != NULL
+			   &&	strstr(data->keywords[part], searchSansWS) != NULL )
+			{
+				tiers[part] = MatchTierKeyword;
+			}
+		}
+	}
+
+	for(part = 0; part < data->part_count; part++)
+	{
+		if(tiers[part] != MatchTierNone)
+		{
+			matches[matchCount].part	= part;
+			matches[matchCount].tier	= tiers[part];
+			matches[matchCount].score	= (uint32_t)strlen(data->numbers[part]);
+			matches[matchCount].number	= data->numbers[part];
+			matchCount++;
+		}
+	}
+	free(tiers);
+
+	//---------- Fuzzy ---------------------------------------------------------
+	//
+	// Nothing at all? Count how many of the search's distinct character pairs
+	// each part has, and take the parts that have most of them.
+
+	if(matchCount == 0 && wordCount > 0)
+	{
+		uint16_t	*shared		= calloc(data->part_count + 1, sizeof(uint16_t));
+		uint32_t	*pairs		= NULL;
+		uint32_t	pairCount	= 0;
+		uint32_t	pairMax		= 0;
+
+		for(wordIndex = 0; wordIndex < wordCount; wordIndex++)
+			pairMax += (uint32_t)strlen(words[wordIndex]);
+		pairs = malloc(sizeof(uint32_t) * (pairMax + 1));
+
+		for(wordIndex = 0; wordIndex < wordCount; wordIndex++)
+		{
+			const char *word = words[wordIndex];
+
+			for(counter = 0; word[counter] && word[counter + 1]; counter++)
+			{
+				uint32_t	gram	= GRAM2(word[counter], word[counter + 1]);
+				uint32_t	seen	= 0;
+
+				for(seen = 0; seen < pairCount; seen++)
+				{
+					if(pairs[seen] == gram)
+						break;
+				}
+				if(seen == pairCount)
+					pairs[pairCount++] = gram;
+			}
+		}
+
+		for(counter = 0; counter < pairCount; counter++)
+		{
+			GramPosting *posting	= GramTableFind(&data->text_grams, pairs[counter]);
+			uint32_t	n			= 0;
+
+			if(posting)
+			{
+				for(n = 0; n < posting->count; n++)
+					shared[posting->ids[n]]++;
+			}
+		}
+
+		// A single pair is too little to go on.
+		if(pairCount >= 2)
+		{
+			for(part = 0; part < data->part_count; part++)
+			{
+				if(shared[part] * FUZZY_MATCH_DENOMINATOR >= pairCount * FUZZY_MATCH_NUMERATOR)
+				{
+					matches[matchCount].part	= part;
+					matches[matchCount].tier	= MatchTierFuzzy;
+					matches[matchCount].score	= pairCount - shared[part];
+					matches[matchCount].number	= data->numbers[part];
+					matchCount++;
+				}
+			}
+		}
+
+		free(pairs);
+		free(shared);
+	}
+
+	qsort(matches, matchCount, sizeof(RankedMatch), CompareRankedMatches);
+
+	return matchCount;
+
+}//end PartCatalogSearch
+
+
+#pragma mark -
+#pragma mark POSTING LISTS
+#pragma mark -
+
+//========== GramTableInit() ===================================================
+//
+// Purpose:		Starts an empty n-gram table.
+//
+//==============================================================================
+static void GramTableInit(GramTable *table)
+{
+	table->slot_count	= 1024;
+	table->used			= 0;
+	table->slots		= calloc(table->slot_count, sizeof(GramPosting));
+
+}//end GramTableInit
+
+
+//========== GramTableFree() ===================================================
+//
+// Purpose:		Frees the table and its posting lists.
+//
+//==============================================================================
+static void GramTableFree(GramTable *table)
+{
+	uint32_t counter = 0;
+
+	for(counter = 0; counter < table->slot_count; counter++)
+		free(table->slots[counter].ids);
+	free(table->slots);
+
+}//end GramTableFree
+
+
+//========== GramSlot() ========================================================
+//
+// Purpose:		Where to start looking for an n-gram in a table of slot_count
+//				slots.
+//
+//==============================================================================
+static uint32_t GramSlot(uint32_t gram, uint32_t slot_count)
+{
+	uint32_t hash = gram * 2654435761u;
+
+	hash ^= hash >> 16;
+
+	return hash & (slot_count - 1);
+
+}//end GramSlot
+
+
+//========== GramTableFind() ===================================================
+//
+// Purpose:		Returns the posting list for an n-gram, or NULL if no part has
+//				it.
+//
+//==============================================================================
+static GramPosting * GramTableFind(const GramTable *table, uint32_t gram)
+{
+	uint32_t slot = GramSlot(gram, table->slot_count);
+
+	while(table->slots[slot].gram != 0)
+	{
+		if(table->slots[slot].gram == gram)
+			return &table->slots[slot];
+		slot = (slot + 1) & (table->slot_count - 1);
+	}
+
+	return NULL;
+
+}//end GramTableFind
+
+
+//========== GramTableAdd() ====================================================
+//
+// Purpose:		Records that the part has the n-gram. Parts must be added in
+//				increasing order; adding the same part twice in a row is
+//				harmless.
+//
+//==============================================================================
+static void GramTableAdd(GramTable *table, uint32_t gram, uint32_t part)
+{
+	GramPosting	*posting	= NULL;
+	uint32_t	slot		= 0;
+	uint32_t	counter		= 0;
+
+	// Keep the table at most half full.
+	if((table->used + 1) * 2 > table->slot_count)
+	{
+		GramTable bigger;
+
+		bigger.slot_count	= table->slot_count * 2;
+		bigger.used			= table->used;
+		bigger.slots		= calloc(bigger.slot_count, sizeof(GramPosting));
+
+		for(counter = 0; counter < table->slot_count; counter++)
+		{
+			if(table->slots[counter].gram != 0)
+			{
+				slot = GramSlot(table->slots[counter].gram, bigger.slot_count);
+				while(bigger.slots[slot].gram != 0)
+					slot = (slot + 1) & (bigger.slot_count - 1);
+				bigger.slots[slot] = table->slots[counter];
+			}
+		}
+		free(table->slots);
+		*table = bigger;
+	}
+
+	slot = GramSlot(gram, table->slot_count);
+	while(table->slots[slot].gram != 0 && table->slots[slot].gram != gram)
+		slot = (slot + 1) & (table->slot_count - 1);
+
+	posting = &table->slots[slot];
+	if(posting->gram == 0)
+	{
+		posting->gram = gram;
+		table->used++;
+	}
+
+	if(posting->count > 0 && posting->ids[posting->count - 1] == part)
+		return;
+
+	if(posting->count == posting->capacity)
+	{
+		posting->capacity	= posting->capacity ? posting->capacity * 2 : 4;
+		posting->ids		= realloc(posting->ids, sizeof(uint32_t) * posting->capacity);
+	}
+	posting->ids[posting->count++] = part;
+
+}//end GramTableAdd
+
+
+//========== GramTableAddText() ================================================
+//
+// Purpose:		Records every character pair and triple of text for the part.
+//
+//==============================================================================
+static void GramTableAddText(GramTable *table, const char *text, uint32_t part)
+{
+	size_t length	= strlen(text);
+	size_t counter	= 0;
+
+	for(counter = 0; counter + 1 < length; counter++)
+	{
+		GramTableAdd(table, GRAM2(text[counter], text[counter + 1]), part);
+		if(counter + 2 < length)
+			GramTableAdd(table, GRAM3(text[counter], text[counter + 1], text[counter + 2]), part);
+	}
+
+}//end GramTableAddText
+
+
+//========== GramTableCandidates() =============================================
+//
+// Purpose:		Finds the shortest posting list among the n-grams of word: the
+//				only parts that can contain the word.
+//
+// Returns:		0 if the word is too short to narrow anything down (every part
+//				is a candidate); otherwise 1, with ids and count set (count may
+//				be 0).
+//
+//==============================================================================
+static int GramTableCandidates(const GramTable *table, const char *word, const uint32_t **ids, uint32_t *count)
+{
+	size_t			length		= strlen(word);
+	size_t			counter		= 0;
+	GramPosting		*posting	= NULL;
+
+	if(length < 2)
+		return 0;
+
+	*ids	= NULL;
+	*count	= 0;
+
+	if(length == 2)
+	{
+		posting = GramTableFind(table, GRAM2(word[0], word[1]));
+		if(posting)
+		{
+			*ids	= posting->ids;
+			*count	= posting->count;
+		}
+		return 1;
+	}
+
+	for(counter = 0; counter + 2 < length; counter++)
+	{
+		posting = GramTableFind(table, GRAM3(word[counter], word[counter + 1], word[counter + 2]));
+		if(posting == NULL)
+		{
+			*ids	= NULL;
+			*count	= 0;
+			return 1;
+		}
+		if(counter == 0 || posting->count < *count)
+		{
+			*ids	= posting->ids;
+			*count	= posting->count;
+		}
+	}
+
+	return 1;
+
+}//end GramTableCandidates
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== LowercaseCString() ================================================
+//
+// Purpose:		Returns a malloced lower-case UTF-8 copy of string ("" for nil).
+//
+//==============================================================================
+static char * LowercaseCString(NSString *string)
+{
+	const char *utf8 = [[string lowercaseString] UTF8String];
+
+	return strdup(utf8 ? utf8 : "");
+
+}//end LowercaseCString
+
+
+//========== CompareRankedMatches() ============================================
+//
+// Purpose:		qsort order for results: by tier, then score, then part number.
+//
+//==============================================================================
+static int CompareRankedMatches(const void *lhs, const void *rhs)
+{
+	const RankedMatch *a = lhs;
+	const RankedMatch *b = rhs;
+
+	if(a->tier != b->tier)
+		return a->tier < b->tier ? -1 : 1;
+	if(a->score != b->score)
+		return a->score < b->score ? -1 : 1;
+
+	return strcmp(a->number, b->number);
+
+}//end CompareRankedMatches
@@ -16,6 +16,7 @@
 @class LDrawModel;
 @class LDrawPart;
 @class LDrawTexture;
+@class PartCatalogIndex;
 @protocol PartLibraryDelegate;
 
 //The part catalog was regenerated from disk.
@@ -49,6 +50,7 @@ extern NSString	*Category_Subparts;
 {
 	id<PartLibraryDelegate> delegate;
 	NSDictionary            *partCatalog;
+	PartCatalogIndex        *catalogIndex;				// searches partCatalog; rebuilt with it
 	NSMutableArray          *favorites;					// parts names in the "Favorites" pseduocategory
 	NSMutableDictionary     *loadedFiles;				// list of LDrawFiles which have been read off disk.
 	NSMutableDictionary		*loadedImages;
@@ -69,6 +71,7 @@ extern NSString	*Category_Subparts;
 - (NSArray *) favoritePartNames;
 - (NSArray *) favoritePartCatalogRecords;
 - (NSArray *) partCatalogRecordsInCategory:(NSString *)category;
+- (NSArray *) partCatalogRecordsMatchingSearch:(NSString *)searchString;
 - (NSString *) categoryForPartName:(NSString *)partName;
 
 - (void) setDelegate:(id<PartLibraryDelegate>)delegateIn;
@@ -93,7 +96,7 @@ extern NSString	*Category_Subparts;
 - (LDrawModel *) modelForName:(NSString *) partName;
 - (LDrawModel *) modelForName_threadSafe:(NSString *) partName;
 
-- (LDrawDirective *) optimizedDrawableForPart:(LDrawPart *) part color:(LDrawColor *)color;
+- (LDrawDirective *) optimizedDrawableForPart:(LDrawPart *) part;
 - (GLuint) textureTagForTexture:(LDrawTexture*)texture;
 
 // Utilites
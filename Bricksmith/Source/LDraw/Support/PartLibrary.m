@@ -26,6 +26,7 @@
 #import "LDrawTexture.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
+#import "PartCatalogIndex.h"
 #import "StringCategory.h"
 
 
@@ -360,6 +361,21 @@ static PartLibrary *SharedPartLibrary = nil;
 }//end partCatalogRecordsInCategory:
 
 
+//========== partCatalogRecordsMatchingSearch: =================================
+//
+// Purpose:		Returns the records of all the parts in the library matching 
+//				the search, best matches first. The search is by words found 
+//				in part numbers or descriptions, or by keyword; see 
+//				PartCatalogIndex for the details. 
+//
+//==============================================================================
+- (NSArray *) partCatalogRecordsMatchingSearch:(NSString *)searchString
+{
+	return [self->catalogIndex recordsMatchingSearch:searchString];
+	
+}//end partCatalogRecordsMatchingSearch:
+
+
 #pragma mark -
 
 //========== setDelegate: ======================================================
@@ -424,6 +440,11 @@ static PartLibrary *SharedPartLibrary = nil;
 	
 	partCatalog = newCatalog;
 	
+	// Searching the catalog goes through an index, built once here rather 
+	// than on every search. 
+	[catalogIndex release];
+	catalogIndex = [[PartCatalogIndex alloc] initWithPartCatalogRecords:[self allPartCatalogRecords]];
+	
 	//Inform any open parts browsers of the change.
 	[[NSNotificationCenter defaultCenter] 
 			postNotificationName: LDrawPartLibraryDidChangeNotification
@@ -1133,22 +1154,21 @@ static PartLibrary *SharedPartLibrary = nil;
 
 #pragma mark -
 
-//========== optimizedDrawableForPart:color: ==================================
+//========== optimizedDrawableForPart: ========================================
 //
 // Purpose:		Returns a vertex container which has been optimized to draw the 
-//				given part. Vertex objects are shared among multiple part 
-//				instances of the same name and color in order to reduce memory 
-//				space. 
+//				given part. Vertex objects are shared among all part instances 
+//				of the same name in order to reduce memory space. 
 //
 // Parameters:	part	- part to get/create a display list for.
-//				color	- RGBA color for the part. We can't just ask the part for 
-//						  its color because it might be LDrawCurrentColor, in 
-//						  which case it is supposed to draw with its parent 
-//						  color. 
+//
+// Notes:		The vertex buffer does not depend on the color the part is 
+//				drawn in - meta-colored geometry picks up the color passed to 
+//				-draw:viewScale:parentColor: - so a part used in a dozen colors 
+//				still has only one copy of its geometry in VRAM. 
 //
 //==============================================================================
 - (LDrawDirective *) optimizedDrawableForPart:(LDrawPart *) part
-										color:(LDrawColor *)color
 {
 	NSString            *referenceName  = [part referenceName];
 	LDrawVertexes       *vertexObject   = nil;
@@ -1201,16 +1221,13 @@ static PartLibrary *SharedPartLibrary = nil;
 		
 		if(vertexObject != nil)
 		{
-			if([vertexObject isOptimizedForColor:color] == NO)
-			{
-				[vertexObject optimizeOpenGLWithParentColor:color];
-			}
+			[vertexObject optimizeOpenGL];
 		}
 	}
 	
 	return vertexObject;
 	
-}//end optimizedDrawableForPart:color:
+}//end optimizedDrawableForPart:
 
 
 //========== textureTagForTexture: =============================================
@@ -1815,6 +1832,7 @@ static PartLibrary *SharedPartLibrary = nil;
 - (void) dealloc
 {
 	[partCatalog				release];
+	[catalogIndex				release];
 	[favorites					release];
 	[loadedFiles				release];
 	[loadedImages				release];
@@ -11,6 +11,7 @@
 //==============================================================================
 #import <Foundation/Foundation.h>
 
+@class LDrawColor;
 @class LDrawPart;
 @class LDrawContainer;
 
@@ -38,11 +39,14 @@ extern NSString *PART_REPORT_PART_QUANTITY;	// NSNumber of how many of this part
 
 //Initialization
 + (PartReport *) partReportForContainer:(LDrawContainer *)container;
++ (PartReport *) partReportForFilesInDirectory:(NSString *)directoryPath;
 
 //Collecting Information
 - (void) setLDrawContainer:(LDrawContainer *)newContainer;
 - (void) getPieceCountReport;
+- (void) getPieceCountReportForContainers:(NSArray *)containers;
 - (void) registerPart:(LDrawPart *)part;
+- (void) registerPartName:(NSString *)partName color:(LDrawColor *)partColor quantity:(NSUInteger)quantity;
 
 //Accessing Information
 - (NSArray *) allParts;
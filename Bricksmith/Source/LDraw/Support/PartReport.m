@@ -24,9 +24,17 @@
 //==============================================================================
 #import "PartReport.h"
 
+#if USE_BLOCKS
+#import <dispatch/dispatch.h>
+#endif
+
 #import "LDrawContainer.h"
+#import "LDrawFile.h"
 #import "LDrawKeywords.h"
+#import "LDrawModel.h"
 #import "LDrawPart.h"
+#import "LDrawPartTable.h"
+#import "LDrawStep.h"
 #import "PartLibrary.h"
 
 NSString    *PART_REPORT_NUMBER_KEY     = @"Part Number";
@@ -35,6 +43,26 @@ NSString    *PART_REPORT_LDRAW_COLOR    = @"LDraw Color";
 NSString    *PART_REPORT_COLOR_NAME     = @"Color Name";
 NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 
+// One container counted for a piece count report: the containers reported on, 
+// and each distinct submodel they place. 
+typedef struct
+{
+	LDrawContainer			*container;
+	CFMutableDictionaryRef	counts;			// part name -> (LDrawColor -> quantity)
+	CFMutableDictionaryRef	references;		// submodel -> number of times placed
+	NSUInteger				multiplicity;	// times the container appears in the report
+	NSInteger				order;			// position in topological order
+} PartReportNode;
+
+static void DiscoverContainer(LDrawContainer *container, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes);
+static void DiscoverDirective(LDrawDirective *directive, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes);
+static void AddNode(LDrawContainer *container, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes);
+static void CountContainer(LDrawContainer *container, PartReportNode *node);
+static void CountDirective(LDrawDirective *directive, PartReportNode *node);
+static void CountPart(NSString *partName, LDrawColor *partColor, PartReportNode *node);
+static void CountReference(LDrawContainer *container, PartReportNode *node);
+static void OrderNodes(PartReportNode *nodes, CFDictionaryRef nodeIndexes, NSInteger index, char *visited, NSInteger *order);
+
 
 @implementation PartReport
 
@@ -59,6 +87,47 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 }//end partReportForContainer
 
 
+//---------- partReportForFilesInDirectory: --------------------------[static]--
+//
+// Purpose:		Returns a piece count report on every LDraw file in the given 
+//				directory, as if they were all one model. Each file contributes 
+//				its main model. 
+//
+// Notes:		This needs no document or window, so it can be used for bulk 
+//				inventories. The files are let go once counted, so the report 
+//				only has piece counts - not missing or moved parts. 
+//
+//------------------------------------------------------------------------------
++ (PartReport *) partReportForFilesInDirectory:(NSString *)directoryPath
+{
+	NSFileManager       *fileManager    = [NSFileManager defaultManager];
+	NSArray             *fileNames      = [fileManager contentsOfDirectoryAtPath:directoryPath error:NULL];
+	NSMutableArray      *models         = [NSMutableArray array];
+	PartReport          *partReport     = [PartReport partReportForContainer:nil];
+	NSString            *extension      = nil;
+	LDrawFile           *file           = nil;
+	
+	for(NSString *fileName in fileNames)
+	{
+		extension = [[fileName pathExtension] lowercaseString];
+		
+		if(		[extension isEqualToString:@"ldr"]
+		   ||	[extension isEqualToString:@"mpd"]
+		   ||	[extension isEqualToString:@"dat"] )
+		{
+			file = [LDrawFile fileFromContentsAtPath:[directoryPath stringByAppendingPathComponent:fileName]];
+			if([file activeModel] != nil)
+				[models addObject:[file activeModel]];
+		}
+	}
+	
+	[partReport getPieceCountReportForContainers:models];
+	
+	return partReport;
+	
+}//end partReportForFilesInDirectory:
+
+
 //========== init ==============================================================
 //
 // Purpose:		Creates a new part report object, ready to be passed to a model 
@@ -103,15 +172,151 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 //==============================================================================
 - (void) getPieceCountReport
 {
-	// Unfortunately, the reporting responsibility falls on the container 
-	// itself. The reason is that the parts we are reporting might wind up being 
-	// MPD references, in which case we need to merge the report for the 
-	// referenced submodel into *this* report. 
-	[reportedObject collectPartReport:self];
+	if(self->reportedObject != nil)
+		[self getPieceCountReportForContainers:[NSArray arrayWithObject:self->reportedObject]];
 	
 }//end getPieceCountReport
 
 
+//========== getPieceCountReportForContainers: =================================
+//
+// Purpose:		Counts the pieces in all the given containers into this report.
+//
+// Notes:		This gives the same answer as having each container 
+//				-collectPartReport: into us, but each submodel is counted only 
+//				once no matter how many times it is placed:
+//
+//				1. Find every distinct submodel placed anywhere underneath, 
+//				   resolving the parts as we go. Resolving isn't thread-safe, 
+//				   so this is done here, on the caller's thread. 
+//				2. Count the library parts and submodel references directly in 
+//				   each container, all at once on every core. Each gets its 
+//				   own tables, so there is nothing to lock. 
+//				3. Work out how many times each container is placed, parents 
+//				   before children, and merge its counts in that many times. 
+//
+//				A submodel that places itself would never have finished 
+//				reporting; here it just isn't counted again. 
+//
+//==============================================================================
+- (void) getPieceCountReportForContainers:(NSArray *)containers
+{
+	NSMutableArray          *nodeContainers = [NSMutableArray array];
+	CFMutableDictionaryRef  nodeIndexes     = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+	PartReportNode          *nodes          = NULL;
+	PartReportNode          *topoNodes      = NULL;
+	char                    *visited        = NULL;
+	NSUInteger              nodeCount       = 0;
+	NSUInteger              rootCount       = 0;
+	NSInteger               order           = 0;
+	NSUInteger              counter         = 0;
+	
+	// Find everything we'll have to count.
+	for(LDrawContainer *container in containers)
+		AddNode(container, nodeContainers, nodeIndexes);
+	rootCount = [nodeContainers count];
+	
+	for(counter = 0; counter < [nodeContainers count]; counter++)
+		DiscoverContainer([nodeContainers objectAtIndex:counter], nodeContainers, nodeIndexes);
+	
+	// Resolving a part for the first time can leave rows in tables we had 
+	// already built stale. Go over them once more, so that the counting 
+	// threads find every table up to date and don't have to touch it. 
+	for(counter = 0; counter < [nodeContainers count]; counter++)
+		DiscoverContainer([nodeContainers objectAtIndex:counter], nodeContainers, nodeIndexes);
+	
+	nodeCount   = [nodeContainers count];
+	nodes       = calloc(MAX(nodeCount, 1), sizeof(PartReportNode));
+	topoNodes   = calloc(MAX(nodeCount, 1), sizeof(PartReportNode));
+	visited     = calloc(MAX(nodeCount, 1), sizeof(char));
+	
+	for(counter = 0; counter < nodeCount; counter++)
+	{
+		nodes[counter].container    = [nodeContainers objectAtIndex:counter];
+		nodes[counter].counts       = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+		nodes[counter].references   = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+	}
+	
+	// Count each container on its own.
+#if USE_BLOCKS
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	dispatch_apply(nodeCount, queue,
+	^(size_t i)
+	{
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		CountContainer(nodes[i].container, nodes + i);
+		[pool drain];
+	});
+#else
+	for(counter = 0; counter < nodeCount; counter++)
+		CountContainer(nodes[counter].container, nodes + counter);
+#endif
+	
+	// Sort parents before children. OrderNodes fills in reverse topological 
+	// order, so turn it around. 
+	for(counter = 0; counter < rootCount; counter++)
+	{
+		nodes[counter].multiplicity = 1;
+		OrderNodes(nodes, nodeIndexes, counter, visited, &order);
+	}
+	for(counter = 0; counter < nodeCount; counter++)
+	{
+		nodes[counter].order = order - 1 - nodes[counter].order;
+		topoNodes[nodes[counter].order] = nodes[counter];
+	}
+	
+	// Hand each container's multiplicity down to the submodels it places, 
+	// then merge in its own counts. 
+	for(counter = 0; counter < nodeCount; counter++)
+	{
+		PartReportNode  *node           = topoNodes + counter;
+		CFIndex         referenceCount  = CFDictionaryGetCount(node->references);
+		const void      **submodels     = malloc(sizeof(void *) * MAX(referenceCount, 1));
+		const void      **quantities    = malloc(sizeof(void *) * MAX(referenceCount, 1));
+		CFIndex         referenceIndex  = 0;
+		
+		CFDictionaryGetKeysAndValues(node->references, submodels, quantities);
+		for(referenceIndex = 0; referenceIndex < referenceCount; referenceIndex++)
+		{
+			NSInteger childIndex = (NSInteger)CFDictionaryGetValue(nodeIndexes, submodels[referenceIndex]);
+			PartReportNode *child = topoNodes + nodes[childIndex].order;
+			
+			// A reference back up the chain is a cycle; drop it.
+			if(child > node)
+				child->multiplicity += node->multiplicity * (NSUInteger)quantities[referenceIndex];
+		}
+		free(submodels);
+		free(quantities);
+		
+		if(node->multiplicity > 0)
+		{
+			for(NSString *partName in (NSDictionary *)node->counts)
+			{
+				NSDictionary *quantitiesForColor = [(NSDictionary *)node->counts objectForKey:partName];
+				
+				for(LDrawColor *partColor in quantitiesForColor)
+				{
+					NSUInteger quantity = [[quantitiesForColor objectForKey:partColor] unsignedIntegerValue];
+					
+					[self registerPartName:partName color:partColor quantity:quantity * node->multiplicity];
+				}
+			}
+		}
+	}
+	
+	for(counter = 0; counter < nodeCount; counter++)
+	{
+		CFRelease(nodes[counter].counts);
+		CFRelease(nodes[counter].references);
+	}
+	free(nodes);
+	free(topoNodes);
+	free(visited);
+	CFRelease(nodeIndexes);
+	
+}//end getPieceCountReportForContainers:
+
+
 //========== getMissingPiecesReport ============================================
 //
 // Purpose:		Collects information about all the parts in the model which 
@@ -125,9 +330,15 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 	id				 currentElement		= nil;
 //	LDrawModel		*partModel			= nil;
 	NSString		*category			= nil;
+	NSString		*partName			= nil;
+	NSNumber		*status				= nil;
 	NSUInteger		 elementCount		= [elements count];
 	NSUInteger		 counter			= 0;
 	
+	// Every part in the file with the same name resolves the same way, so 
+	// look each name up once. Bit 0 is missing, bit 1 is moved. 
+	NSMutableDictionary *statusForName	= [NSMutableDictionary dictionary];
+	
 	//clear out any previous reports.
 	if(self->missingParts != nil)
 		[missingParts release];
@@ -143,13 +354,23 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 		
 		if( [currentElement isKindOfClass:[LDrawPart class]] )
 		{
-			//Missing?  Ask the part - it now knows everything about its own resolution.
-			if ([currentElement partIsMissing])
-				[missingParts addObject:currentElement];
+			partName	= [currentElement referenceName];
+			status		= [statusForName objectForKey:partName];
 			
-			//Moved?
-			category = [partLibrary categoryForPartName:[currentElement referenceName]];
-			if([category isEqualToString:LDRAW_MOVED_CATEGORY]) 
+			if(status == nil)
+			{
+				//Missing?  Ask the part - it now knows everything about its own resolution.
+				//Moved?
+				category	= [partLibrary categoryForPartName:partName];
+				status		= [NSNumber numberWithInteger:
+										([currentElement partIsMissing] ? 1 : 0)
+									|	([category isEqualToString:LDRAW_MOVED_CATEGORY] ? 2 : 0) ];
+				[statusForName setObject:status forKey:partName];
+			}
+			
+			if([status integerValue] & 1)
+				[missingParts addObject:currentElement];
+			if([status integerValue] & 2)
 			   [movedParts addObject:currentElement];
 		}
 	}
@@ -172,9 +393,19 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 //==============================================================================
 - (void) registerPart:(LDrawPart *)part
 {
-	NSString			*partName			= [part referenceName];
-	LDrawColor			*partColor			= [part LDrawColor];
-	
+	[self registerPartName:[part referenceName] color:[part LDrawColor] quantity:1];
+				   
+}//end registerPart:
+
+
+//========== registerPartName:color:quantity: ==================================
+//
+// Purpose:		Adds quantity parts of the given name and color to our report.
+//				See -registerPart: for how they are recorded. 
+//
+//==============================================================================
+- (void) registerPartName:(NSString *)partName color:(LDrawColor *)partColor quantity:(NSUInteger)quantity
+{
 	NSMutableDictionary	*partRecord			= [self->partsReport objectForKey:partName];
 	NSUInteger			 numberColoredParts	= 0;
 
@@ -191,13 +422,13 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 	numberColoredParts = [[partRecord objectForKey:partColor] integerValue];
 	
 	// Update our tallies.
-	self->totalNumberOfParts += 1;
-	numberColoredParts += 1;
+	self->totalNumberOfParts += quantity;
+	numberColoredParts += quantity;
 	
 	[partRecord setObject:[NSNumber numberWithUnsignedInteger:numberColoredParts]
 				   forKey:partColor];
 				   
-}//end registerPart:
+}//end registerPartName:color:quantity:
 
 
 #pragma mark -
@@ -413,3 +644,223 @@ NSString    *PART_REPORT_PART_QUANTITY  = @"QuantityKey";
 }//end dealloc
 
 @end
+
+
+#pragma mark -
+#pragma mark PIECE COUNTING
+#pragma mark -
+
+//========== DiscoverContainer() ===============================================
+//
+// Purpose:		Adds every submodel placed directly in container (or in 
+//				containers inside it, like textures) to nodes, resolving every 
+//				part on the way. 
+//
+//==============================================================================
+static void DiscoverContainer(LDrawContainer *container, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes)
+{
+	struct LDrawPartTable   *table  = NULL;
+	int                     row     = 0;
+	
+	for(LDrawDirective *directive in [container subdirectives])
+	{
+		if([directive isKindOfClass:[LDrawStep class]])
+		{
+			// The part table resolves the step's parts and says which are 
+			// submodels. 
+			table = [(LDrawStep *)directive partTable];
+			for(row = 0; row < table->count; row++)
+			{
+				if(table->flags[row] & part_row_reference)
+					AddNode(table->models[row], nodes, nodeIndexes);
+			}
+			for(LDrawDirective *otherDirective in [(LDrawStep *)directive otherDirectives])
+				DiscoverDirective(otherDirective, nodes, nodeIndexes);
+		}
+		else
+			DiscoverDirective(directive, nodes, nodeIndexes);
+	}
+	
+}//end DiscoverContainer
+
+
+//========== DiscoverDirective() ===============================================
+//
+// Purpose:		DiscoverContainer for anything that isn't in a step.
+//
+//==============================================================================
+static void DiscoverDirective(LDrawDirective *directive, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes)
+{
+	PartTypeT   partType    = PartTypeUnresolved;
+	
+	if([directive isKindOfClass:[LDrawPart class]])
+	{
+		partType = [(LDrawPart *)directive resolvedPartType];
+		if(partType == PartTypeSubmodel || partType == PartTypePeerFile)
+			AddNode([(LDrawPart *)directive resolvedModel], nodes, nodeIndexes);
+	}
+	else if([directive isKindOfClass:[LDrawModel class]])
+	{
+		// e.g. the models in a file
+		AddNode((LDrawModel *)directive, nodes, nodeIndexes);
+	}
+	else if([directive isKindOfClass:[LDrawContainer class]])
+	{
+		DiscoverContainer((LDrawContainer *)directive, nodes, nodeIndexes);
+	}
+	
+}//end DiscoverDirective
+
+
+//========== AddNode() =========================================================
+//
+// Purpose:		Adds container to nodes if it isn't there yet.
+//
+//==============================================================================
+static void AddNode(LDrawContainer *container, NSMutableArray *nodes, CFMutableDictionaryRef nodeIndexes)
+{
+	if(container != nil && CFDictionaryContainsKey(nodeIndexes, container) == false)
+	{
+		CFDictionarySetValue(nodeIndexes, container, (const void *)(NSInteger)[nodes count]);
+		[nodes addObject:container];
+	}
+	
+}//end AddNode
+
+
+//========== CountContainer() ==================================================
+//
+// Purpose:		Counts the library parts and submodel references directly in 
+//				container into node. 
+//
+// Notes:		This runs on any thread, and only reads: the parts were all 
+//				resolved and the part tables built by DiscoverContainer. 
+//
+//==============================================================================
+static void CountContainer(LDrawContainer *container, PartReportNode *node)
+{
+	struct LDrawPartTable   *table  = NULL;
+	LDrawPart               *part   = nil;
+	int                     row     = 0;
+	
+	for(LDrawDirective *directive in [container subdirectives])
+	{
+		if([directive isKindOfClass:[LDrawStep class]])
+		{
+			table = [(LDrawStep *)directive partTable];
+			for(row = 0; row < table->count; row++)
+			{
+				part = table->parts[row];
+				if(table->flags[row] & part_row_library)
+					CountPart([part referenceName], [part LDrawColor], node);
+				else if(table->flags[row] & part_row_reference)
+					CountReference(table->models[row], node);
+			}
+			for(LDrawDirective *otherDirective in [(LDrawStep *)directive otherDirectives])
+				CountDirective(otherDirective, node);
+		}
+		else
+			CountDirective(directive, node);
+	}
+	
+}//end CountContainer
+
+
+//========== CountDirective() ==================================================
+//
+// Purpose:		CountContainer for anything that isn't in a step.
+//
+//==============================================================================
+static void CountDirective(LDrawDirective *directive, PartReportNode *node)
+{
+	PartTypeT   partType    = PartTypeUnresolved;
+	
+	if([directive isKindOfClass:[LDrawPart class]])
+	{
+		partType = [(LDrawPart *)directive resolvedPartType];
+		if(partType == PartTypeLibrary)
+			CountPart([(LDrawPart *)directive referenceName], [(LDrawPart *)directive LDrawColor], node);
+		else if(partType == PartTypeSubmodel || partType == PartTypePeerFile)
+			CountReference([(LDrawPart *)directive resolvedModel], node);
+	}
+	else if([directive isKindOfClass:[LDrawModel class]])
+	{
+		CountReference((LDrawModel *)directive, node);
+	}
+	else if([directive isKindOfClass:[LDrawContainer class]])
+	{
+		CountContainer((LDrawContainer *)directive, node);
+	}
+	
+}//end CountDirective
+
+
+//========== CountPart() =======================================================
+//
+// Purpose:		Counts one library part.
+//
+//==============================================================================
+static void CountPart(NSString *partName, LDrawColor *partColor, PartReportNode *node)
+{
+	NSMutableDictionary	*quantitiesForColor	= [(NSDictionary *)node->counts objectForKey:partName];
+	NSUInteger			quantity			= 0;
+	
+	if(quantitiesForColor == nil)
+	{
+		quantitiesForColor = [[NSMutableDictionary alloc] init];
+		CFDictionarySetValue(node->counts, partName, quantitiesForColor);
+		[quantitiesForColor release];
+	}
+	
+	quantity = [[quantitiesForColor objectForKey:partColor] unsignedIntegerValue];
+	[quantitiesForColor setObject:[NSNumber numberWithUnsignedInteger:quantity + 1] forKey:partColor];
+	
+}//end CountPart
+
+
+//========== CountReference() ==================================================
+//
+// Purpose:		Counts one placement of a submodel.
+//
+//==============================================================================
+static void CountReference(LDrawContainer *container, PartReportNode *node)
+{
+	NSUInteger quantity = (NSUInteger)CFDictionaryGetValue(node->references, container);
+	
+	if(container != nil)
+		CFDictionarySetValue(node->references, container, (const void *)(quantity + 1));
+	
+}//end CountReference
+
+
+//========== OrderNodes() ======================================================
+//
+// Purpose:		Depth-first walk from nodes[index] through the submodels it 
+//				places, numbering each node after all of its children. 
+//
+//==============================================================================
+static void OrderNodes(PartReportNode *nodes, CFDictionaryRef nodeIndexes, NSInteger index, char *visited, NSInteger *order)
+{
+	PartReportNode  *node           = nodes + index;
+	CFIndex         referenceCount  = 0;
+	const void      **submodels     = NULL;
+	CFIndex         referenceIndex  = 0;
+	
+	if(visited[index])
+		return;
+	visited[index] = 1;
+	
+	referenceCount  = CFDictionaryGetCount(node->references);
+	submodels       = malloc(sizeof(void *) * MAX(referenceCount, 1));
+	
+	CFDictionaryGetKeysAndValues(node->references, submodels, NULL);
+	for(referenceIndex = 0; referenceIndex < referenceCount; referenceIndex++)
+	{
+		OrderNodes(nodes, nodeIndexes, (NSInteger)CFDictionaryGetValue(nodeIndexes, submodels[referenceIndex]), visited, order);
+	}
+	free(submodels);
+	
+	node->order = (*order)++;
+	
+}//end OrderNodes
+
@@ -34,6 +34,7 @@
 #define LDRAW_GL_VIEW_PROJECTION					@"LDrawGLView Viewing Projection"
 #define LDRAW_PATH_KEY								@"LDraw Path"
 #define LDRAW_VIEWER_BACKGROUND_COLOR_KEY			@"LDraw Viewer Background Color"
+#define MARQUEE_SELECTS_VISIBLE_ONLY_KEY			@"Marquee Selects Visible Only"
 #define MOUSE_DRAGGING_BEHAVIOR_KEY					@"Mouse Dragging Behavior"
 #define RIGHT_BUTTON_BEHAVIOR_KEY					@"Right Button Behavior"
 #define ROTATE_MODE_KEY								@"Rotate Mode"
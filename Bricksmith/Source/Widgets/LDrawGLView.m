@@ -2011,7 +2011,6 @@ static NSSize Size2ToNSSize(Size2 size)
 	BOOL					 beginCopy			= NO;
 	BOOL					 okayToDrag			= NO;
 	NSPoint					 offset				= NSZeroPoint;
-	NSArray					*archivedDirectives	= nil;
 	NSData					*data				= nil;
 	LDrawDrawableElement	*firstDirective		= nil;
 	NSPoint					 viewPoint			= [self convertPoint:[theEvent locationInWindow] fromView:nil];
@@ -2047,9 +2046,8 @@ static NSSize Size2ToNSSize(Size2 size)
 			// its originating view, its position will be adjusted by that 
 			// offset. Everything will come out looking right. 
 			//
-			archivedDirectives	= [pasteboard propertyListForType:LDrawDraggingPboardType];
-			data				= [archivedDirectives objectAtIndex:0];
-			firstDirective		= [NSKeyedUnarchiver unarchiveObjectWithData:data];
+			data				= [pasteboard dataForType:LDrawDraggingPboardType];
+			firstDirective		= [LDrawUtilities firstDirectiveFromData:data];
 			firstPosition		= [firstDirective position];
 			modelPoint			= [self->renderer modelPointForPoint:V2Make(viewPoint.x, viewPoint.y) depthReferencePoint:firstPosition];
 			displacement		= V3Sub(modelPoint, firstPosition);
@@ -2152,6 +2150,7 @@ static NSSize Size2ToNSSize(Size2 size)
 		
 	if([theEvent type] == NSLeftMouseDragged)
 	{
+		[self->renderer setMarqueeSelectsVisibleOnly:[[NSUserDefaults standardUserDefaults] boolForKey:MARQUEE_SELECTS_VISIBLE_ONLY_KEY]];
 
 		[self->renderer mouseSelectionDragToPoint:V2Make(viewPoint.x, viewPoint.y)
 								  selectionMode:marqueeSelectionMode];
@@ -2430,12 +2429,8 @@ static NSSize Size2ToNSSize(Size2 size)
 	id						sourceView			= [info draggingSource];
 	NSDragOperation 		dragOperation		= NSDragOperationNone;
 	BOOL					setTransform		= NO;
-	NSArray 				*archivedDirectives = nil;
-	NSMutableArray			*directives 		= nil;
-	NSData					*data				= nil;
+	NSArray 				*directives 		= nil;
 	id						currentObject		= nil;
-	NSUInteger				directiveCount		= 0;
-	NSUInteger				counter 			= 0;
 	NSPoint 				dragPointInWindow	= [info draggingLocation];
 	NSPoint 				viewPoint			= [self convertPoint:dragPointInWindow fromView:nil];
 	
@@ -2446,21 +2441,14 @@ static NSSize Size2ToNSSize(Size2 size)
 		dragOperation = NSDragOperationCopy;
 	
 	
-	//---------- unarchive the directives --------------------------------------
+	//---------- decode the directives -----------------------------------------
 	
-	archivedDirectives	= [pasteboard propertyListForType:LDrawDraggingPboardType];
-	directiveCount		= [archivedDirectives count];
-	directives			= [NSMutableArray arrayWithCapacity:directiveCount];
+	directives = [LDrawUtilities directivesFromData:[pasteboard dataForType:LDrawDraggingPboardType]];
 	
-	for(counter = 0; counter < directiveCount; counter++)
+	// while a part is dragged, it is drawn selected
+	for(currentObject in directives)
 	{
-		data			= [archivedDirectives objectAtIndex:counter];
-		currentObject	= [NSKeyedUnarchiver unarchiveObjectWithData:data];
-		
-		// while a part is dragged, it is drawn selected
 		[currentObject setSelected:YES];
-		
-		[directives addObject:currentObject];
 	}
 	
 	if([[pasteboard propertyListForType:LDrawDraggingIsUninitializedPboardType] boolValue] == YES)
@@ -3392,6 +3380,8 @@ static NSSize Size2ToNSSize(Size2 size)
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 	
+	// The renderer frees GL objects.
+	[[self openGLContext] makeCurrentContext];
 	[renderer		release];
 	[canDrawLock	release];
 	[autosaveName	release];
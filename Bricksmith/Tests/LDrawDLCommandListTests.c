@@ -0,0 +1,277 @@
+/*
+ *  LDrawDLCommandListTests.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawDLCommandList.h"
+#include "TestSupport.h"
+
+//==============================================================================
+//
+// File: LDrawDLCommandListTests
+//
+// Builds command lists the way the display list session does - one command
+// per primitive type per instanced segment - and checks the command table
+// and batches that come out of LDrawDLCommandListFinish.
+//
+//==============================================================================
+
+
+//========== test_multi_draw_batches ===========================================
+//
+// Purpose:	Two segments in one arena, each with lines, tris and quads, drawn
+//			with multi-draw: each primitive type becomes one batch, in the
+//			order lines, tris, quads, whatever order the commands came in.
+//
+//==============================================================================
+static void test_multi_draw_batches(void)
+{
+	struct LDrawDLCommandList *			list = LDrawDLCommandListCreate();
+	const struct LDrawDLDrawCommand *	cmds = NULL;
+	const struct LDrawDLBatch *			batches = NULL;
+	unsigned int						limits[1] = { 1000 };
+	int									cmd_count, batch_count;
+
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads, 100, 40, 0, 3);
+	LDrawDLCommandListAdd(list, 0, dl_prim_lines,   0, 20, 0, 3);
+	LDrawDLCommandListAdd(list, 0, dl_prim_tris,   20, 30, 0, 3);
+	LDrawDLCommandListAdd(list, 0, dl_prim_lines, 200, 10, 3, 5);
+	LDrawDLCommandListAdd(list, 0, dl_prim_tris,  210, 60, 3, 5);
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads, 300, 80, 3, 5);
+
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_ok);
+
+	cmd_count = LDrawDLCommandListGetCommands(list, &cmds);
+	batch_count = LDrawDLCommandListGetBatches(list, &batches);
+
+	CHECK(cmd_count == 6);
+	CHECK(batch_count == 3);
+	if(batch_count == 3)
+	{
+		CHECK(batches[0].prim == dl_prim_lines);
+		CHECK(batches[1].prim == dl_prim_tris);
+		CHECK(batches[2].prim == dl_prim_quads);
+		CHECK(batches[2].first_command == 4 && batches[2].command_count == 2);
+	}
+	if(cmd_count == 6)
+	{
+		// The quads batch is the two quad commands, in instance order, laid
+		// out as DrawElementsIndirectCommands.
+		CHECK(cmds[4].first_index == 100 && cmds[4].index_count == 40);
+		CHECK(cmds[4].base_instance == 0 && cmds[4].instance_count == 3);
+		CHECK(cmds[5].first_index == 300 && cmds[5].index_count == 80);
+		CHECK(cmds[5].base_instance == 3 && cmds[5].instance_count == 5);
+		CHECK(cmds[5].base_vertex == 0);
+	}
+
+	LDrawDLCommandListDestroy(list);
+
+}//end test_multi_draw_batches
+
+
+//========== test_quads_merge ==================================================
+//
+// Purpose:	Back-to-back quad runs for the same instances merge into one
+//			command; a gap, or different instances, keeps them apart.
+//
+//==============================================================================
+static void test_quads_merge(void)
+{
+	struct LDrawDLCommandList *			list = LDrawDLCommandListCreate();
+	const struct LDrawDLDrawCommand *	cmds = NULL;
+	const struct LDrawDLBatch *			batches = NULL;
+	unsigned int						limits[1] = { 1000 };
+	int									cmd_count, batch_count;
+
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads,   0, 40, 7, 2);
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads,  40, 20, 7, 2);		// Follows on: merges.
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads,  64,  8, 7, 2);		// Gap of 4 indices.
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads,  72,  8, 9, 2);		// Other instances.
+
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_ok);
+
+	cmd_count = LDrawDLCommandListGetCommands(list, &cmds);
+	batch_count = LDrawDLCommandListGetBatches(list, &batches);
+
+	CHECK(batch_count == 1);
+	CHECK(batch_count < 1 || (batches[0].prim == dl_prim_quads && batches[0].command_count == 3));
+	CHECK(cmd_count == 3);
+	if(cmd_count == 3)
+	{
+		CHECK(cmds[0].first_index == 0 && cmds[0].index_count == 60);
+		CHECK(cmds[1].first_index == 64 && cmds[1].index_count == 8);
+		CHECK(cmds[2].first_index == 72 && cmds[2].base_instance == 9);
+	}
+
+	LDrawDLCommandListDestroy(list);
+
+}//end test_quads_merge
+
+
+//========== test_arenas_and_empty_draws =======================================
+//
+// Purpose:	Commands from several arenas batch per arena, and empty draws
+//			never reach the command table.
+//
+//==============================================================================
+static void test_arenas_and_empty_draws(void)
+{
+	struct LDrawDLCommandList *			list = LDrawDLCommandListCreate();
+	const struct LDrawDLDrawCommand *	cmds = NULL;
+	const struct LDrawDLBatch *			batches = NULL;
+	unsigned int						limits[2] = { 500, 500 };
+	int									batch_count, b;
+
+	LDrawDLCommandListAdd(list, 1, dl_prim_tris,  0, 30, 0, 1);
+	LDrawDLCommandListAdd(list, 0, dl_prim_tris,  0, 30, 1, 1);
+	LDrawDLCommandListAdd(list, 1, dl_prim_quads, 30, 0, 0, 1);		// No indices.
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads, 30, 8, 1, 0);		// No instances.
+	LDrawDLCommandListAdd(list, 1, dl_prim_quads, 40, 8, 2, 1);
+
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 2) == dl_cmd_ok);
+
+	CHECK(LDrawDLCommandListGetCommands(list, &cmds) == 3);
+	batch_count = LDrawDLCommandListGetBatches(list, &batches);
+	CHECK(batch_count == 3);
+	for(b = 0; b < batch_count; ++b)
+		CHECK(batches[b].command_count == 1);
+	if(batch_count == 3)
+	{
+		CHECK(batches[0].arena == 0 && batches[0].prim == dl_prim_tris);
+		CHECK(batches[1].arena == 1 && batches[1].prim == dl_prim_tris);
+		CHECK(batches[2].arena == 1 && batches[2].prim == dl_prim_quads);
+	}
+
+	LDrawDLCommandListDestroy(list);
+
+}//end test_arenas_and_empty_draws
+
+
+//========== test_draw_one_at_a_time ===========================================
+//
+// Purpose:	Without multi-draw, each segment's lines, tris and quads stay
+//			together, so the primitive types repeat across the batches.
+//
+//==============================================================================
+static void test_draw_one_at_a_time(void)
+{
+	struct LDrawDLCommandList *		list = LDrawDLCommandListCreate();
+	const struct LDrawDLBatch *		batches = NULL;
+	unsigned int					limits[1] = { 1000 };
+	int								batch_count;
+
+	LDrawDLCommandListAdd(list, 0, dl_prim_lines,   0, 10, 4, 1);
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads,  10, 16, 4, 1);
+	LDrawDLCommandListAdd(list, 0, dl_prim_lines, 100, 10, 0, 1);
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads, 110, 16, 0, 1);
+
+	LDrawDLCommandListFinish(list, 0);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_ok);
+
+	batch_count = LDrawDLCommandListGetBatches(list, &batches);
+	CHECK(batch_count == 4);
+	if(batch_count == 4)
+	{
+		CHECK(batches[0].prim == dl_prim_lines && batches[1].prim == dl_prim_quads);
+		CHECK(batches[2].prim == dl_prim_lines && batches[3].prim == dl_prim_quads);
+	}
+
+	LDrawDLCommandListDestroy(list);
+
+}//end test_draw_one_at_a_time
+
+
+//========== test_validate_errors ==============================================
+//
+// Purpose:	Validation catches the mistakes the GL would not: reading past
+//			the end of an arena, an arena that doesn't exist, a bad primitive
+//			type, and checking a list before it is finished.
+//
+//==============================================================================
+static void test_validate_errors(void)
+{
+	struct LDrawDLCommandList *	list;
+	unsigned int				limits[1] = { 100 };
+
+	list = LDrawDLCommandListCreate();
+	LDrawDLCommandListAdd(list, 0, dl_prim_quads, 90, 12, 0, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_err_not_finished);
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_err_index_range);
+	CHECK(LDrawDLCommandListValidate(list, NULL, 0) == dl_cmd_ok);
+	LDrawDLCommandListDestroy(list);
+
+	list = LDrawDLCommandListCreate();
+	LDrawDLCommandListAdd(list, 1, dl_prim_tris, 0, 3, 0, 1);
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_err_bad_arena);
+	LDrawDLCommandListDestroy(list);
+
+	list = LDrawDLCommandListCreate();
+	LDrawDLCommandListAdd(list, 0, dl_prim_count, 0, 3, 0, 1);
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_err_bad_prim);
+	LDrawDLCommandListDestroy(list);
+
+	list = LDrawDLCommandListCreate();
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 1) == dl_cmd_ok);
+	LDrawDLCommandListDestroy(list);
+
+}//end test_validate_errors
+
+
+//========== test_many_commands ================================================
+//
+// Purpose:	A list that outgrows its initial capacity, with commands added
+//			in scrambled order, still validates and keeps every index.
+//
+//==============================================================================
+static void test_many_commands(void)
+{
+	struct LDrawDLCommandList *			list = LDrawDLCommandListCreate();
+	const struct LDrawDLDrawCommand *	cmds = NULL;
+	unsigned int						limits[4] = { 100000, 100000, 100000, 100000 };
+	unsigned long						added = 0;
+	unsigned long						drawn = 0;
+	int									cmd_count, i;
+
+	for(i = 0; i < 3000; ++i)
+	{
+		int segment = (i * 7919) % 3000;
+
+		LDrawDLCommandListAdd(list, segment % 4, segment % dl_prim_count, segment * 30, 12, segment, 1);
+		added += 12;
+	}
+
+	LDrawDLCommandListFinish(list, 1);
+	CHECK(LDrawDLCommandListValidate(list, limits, 4) == dl_cmd_ok);
+
+	cmd_count = LDrawDLCommandListGetCommands(list, &cmds);
+	for(i = 0; i < cmd_count; ++i)
+		drawn += cmds[i].index_count * cmds[i].instance_count;
+	CHECK(drawn == added);
+
+	LDrawDLCommandListDestroy(list);
+
+}//end test_many_commands
+
+
+int main(void)
+{
+	test_multi_draw_batches();
+	test_quads_merge();
+	test_arenas_and_empty_draws();
+	test_draw_one_at_a_time();
+	test_validate_errors();
+	test_many_commands();
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,416 @@
+/*
+ *  LDrawDirectiveCodecTests.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawDirectiveCodec.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+//
+// File: LDrawDirectiveCodecTests
+//
+// Round-trips records through the codec, then feeds the reader every
+// truncation and every single-byte corruption of good data.  Bad data may
+// decode to something, or fail; it must never read outside the bytes, which
+// is what running these under -fsanitize=address checks.
+//
+//==============================================================================
+
+
+//========== make_part =========================================================
+//
+// Purpose:	A part record with a transform that is different for each seed.
+//
+//==============================================================================
+static struct LDrawCodecRecord make_part(int seed, const char * name, const char * icon_name)
+{
+	struct LDrawCodecRecord	record;
+	int						i;
+
+	memset(&record, 0, sizeof(record));
+	record.kind			= codec_record_part;
+	record.flags		= (seed % 3 == 0) ? codec_flag_hidden : 0;
+	record.color_code	= seed * 7;
+	record.name			= name;
+	record.icon_name	= icon_name;
+	for(i = 0; i < 16; ++i)
+		record.transform[i] = (float) seed + i * 0.25f;
+
+	return record;
+
+}//end make_part
+
+
+//========== records_equal =====================================================
+//
+// Purpose:	Whether a decoded record carries what was written.
+//
+//==============================================================================
+static int records_equal(const struct LDrawCodecRecord * a, const struct LDrawCodecRecord * b)
+{
+	if(a->kind != b->kind)
+		return 0;
+
+	switch(a->kind)
+	{
+		case codec_record_part:
+			return		a->flags == b->flags
+					&&	a->color_code == b->color_code
+					&&	memcmp(a->transform, b->transform, sizeof(a->transform)) == 0
+					&&	strcmp(a->name, b->name) == 0
+					&&	(a->icon_name == NULL) == (b->icon_name == NULL)
+					&&	(a->icon_name == NULL || strcmp(a->icon_name, b->icon_name) == 0);
+
+		case codec_record_step:
+			return		a->rotation_type == b->rotation_type
+					&&	a->flavor == b->flavor
+					&&	memcmp(a->rotation, b->rotation, sizeof(a->rotation)) == 0;
+
+		case codec_record_archived:
+			return		a->length == b->length
+					&&	memcmp(a->bytes, b->bytes, a->length) == 0;
+	}
+	return 1;
+
+}//end records_equal
+
+
+//========== encode ============================================================
+//
+// Purpose:	Encode count records; returns a malloc'd copy of the bytes.
+//
+//==============================================================================
+static unsigned char * encode(const struct LDrawCodecRecord * records, int count, size_t * length)
+{
+	struct LDrawCodecWriter *	writer = LDrawCodecWriterCreate();
+	const void *				bytes;
+	unsigned char *				copy;
+	int							i;
+
+	for(i = 0; i < count; ++i)
+		LDrawCodecWriteRecord(writer, records + i);
+	bytes = LDrawCodecWriterFinish(writer, length);
+
+	copy = (unsigned char *) malloc(*length);
+	memcpy(copy, bytes, *length);
+	LDrawCodecWriterDestroy(writer);
+
+	return copy;
+
+}//end encode
+
+
+//========== decode_all ========================================================
+//
+// Purpose:	Read every record, checking each against expected if it's given.
+//			Returns the number read, or -1 if the reader failed.
+//
+//==============================================================================
+static int decode_all(const unsigned char * bytes, size_t length, const struct LDrawCodecRecord * expected)
+{
+	struct LDrawCodecReader	reader;
+	struct LDrawCodecRecord	record;
+	int						count = 0;
+	int						result;
+
+	if(LDrawCodecReaderOpen(&reader, bytes, length) != 0)
+		return -1;
+
+	while((result = LDrawCodecReadRecord(&reader, &record)) == 1)
+	{
+		if(expected)
+			CHECK(records_equal(&record, expected + count));
+		++count;
+	}
+	LDrawCodecReaderClose(&reader);
+
+	return result < 0 ? -1 : count;
+
+}//end decode_all
+
+
+//========== sample_records ====================================================
+//
+// Purpose:	A bit of everything: loose parts, a step of parts, archived
+//			directives inside and outside it, and an empty step.
+//
+//==============================================================================
+static int sample_records(struct LDrawCodecRecord * records)
+{
+	static const unsigned char	archived_a[] = { 'b', 'p', 'l', 'i', 's', 't', 0, 1, 2, 3 };
+	static const unsigned char	archived_b[] = { 0xFF };
+	int							count = 0;
+
+	records[count++] = make_part(1, "3001.dat", NULL);
+	records[count++] = make_part(2, "3001.dat", "Brick 2 x 4");
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count].kind				= codec_record_step;
+	records[count].rotation_type	= 2;
+	records[count].flavor			= 1;
+	records[count].rotation[0]		= 45.0f;
+	records[count].rotation[1]		= -30.5f;
+	records[count].rotation[2]		= 0.125f;
+	++count;
+
+	records[count++] = make_part(3, "3003.dat", NULL);
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count].kind		= codec_record_archived;
+	records[count].bytes	= archived_a;
+	records[count].length	= sizeof(archived_a);
+	++count;
+
+	records[count++] = make_part(4, "3001.dat", NULL);
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count++].kind = codec_record_step_end;
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count].kind		= codec_record_archived;
+	records[count].bytes	= archived_b;
+	records[count].length	= sizeof(archived_b);
+	++count;
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count].kind		= codec_record_archived;
+	records[count].bytes	= archived_b;
+	records[count].length	= 0;
+	++count;
+
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count++].kind = codec_record_step;
+	memset(records + count, 0, sizeof(struct LDrawCodecRecord));
+	records[count++].kind = codec_record_step_end;
+
+	return count;
+
+}//end sample_records
+
+
+//========== test_round_trip ===================================================
+//
+// Purpose:	Everything written comes back, in order, unchanged.
+//
+//==============================================================================
+static void test_round_trip(void)
+{
+	struct LDrawCodecRecord	records[16];
+	int						count	= sample_records(records);
+	size_t					length	= 0;
+	unsigned char *			bytes	= encode(records, count, &length);
+
+	CHECK(decode_all(bytes, length, records) == count);
+
+	free(bytes);
+
+}//end test_round_trip
+
+
+//========== test_empty ========================================================
+//
+// Purpose:	No records is valid data, and reads as no records.
+//
+//==============================================================================
+static void test_empty(void)
+{
+	size_t			length	= 0;
+	unsigned char *	bytes	= encode(NULL, 0, &length);
+
+	CHECK(decode_all(bytes, length, NULL) == 0);
+
+	free(bytes);
+
+}//end test_empty
+
+
+//========== test_shared_names =================================================
+//
+// Purpose:	A thousand copies of one part spell its name once.
+//
+//==============================================================================
+static void test_shared_names(void)
+{
+	struct LDrawCodecRecord *	records = (struct LDrawCodecRecord *) malloc(sizeof(struct LDrawCodecRecord) * 1000);
+	char						names[3][16] = { "3001.dat", "3002.dat", "3003.dat" };
+	size_t						length	= 0;
+	unsigned char *				bytes;
+	int							i;
+
+	for(i = 0; i < 1000; ++i)
+		records[i] = make_part(i, names[i % 3], NULL);
+	bytes = encode(records, 1000, &length);
+
+	// Header, 78 bytes a part, and a three-string table.
+	CHECK(length == 16 + 1000 * 78 + 4 + 3 * (4 + 9));
+	CHECK(decode_all(bytes, length, records) == 1000);
+
+	free(bytes);
+	free(records);
+
+}//end test_shared_names
+
+
+//========== test_truncated ====================================================
+//
+// Purpose:	Every prefix of good data is rejected: either the header or the
+//			string table doesn't check out, or a record runs short.
+//
+//==============================================================================
+static void test_truncated(void)
+{
+	struct LDrawCodecRecord	records[16];
+	int						count	= sample_records(records);
+	size_t					length	= 0;
+	unsigned char *			bytes	= encode(records, count, &length);
+	unsigned char *			prefix;
+	size_t					cut;
+
+	for(cut = 0; cut < length; ++cut)
+	{
+		// A copy of just the prefix, so reading past it trips the sanitizer.
+		prefix = (unsigned char *) malloc(cut ? cut : 1);
+		memcpy(prefix, bytes, cut);
+		CHECK(decode_all(prefix, cut, NULL) == -1);
+		free(prefix);
+	}
+
+	free(bytes);
+
+}//end test_truncated
+
+
+//========== test_corrupt ======================================================
+//
+// Purpose:	Every byte of good data, set to a handful of bad values.  Some
+//			of these still decode - a changed transform is still a
+//			transform - but none may read out of bounds or hand back a
+//			string outside the data.
+//
+//==============================================================================
+static void test_corrupt(void)
+{
+	static const unsigned char	values[] = { 0x00, 0x01, 0x05, 0x7F, 0x80, 0xFF };
+	struct LDrawCodecRecord		records[16];
+	struct LDrawCodecReader		reader;
+	struct LDrawCodecRecord		record;
+	int							count		= sample_records(records);
+	size_t						length		= 0;
+	unsigned char *				bytes		= encode(records, count, &length);
+	unsigned char *				corrupt		= (unsigned char *) malloc(length);
+	int							rejected	= 0;
+	int							result;
+	size_t						position, v;
+
+	for(position = 0; position < length; ++position)
+	{
+		for(v = 0; v < sizeof(values); ++v)
+		{
+			memcpy(corrupt, bytes, length);
+			if(corrupt[position] == values[v])
+				continue;
+			corrupt[position] = values[v];
+
+			if(LDrawCodecReaderOpen(&reader, corrupt, length) != 0)
+			{
+				++rejected;
+				continue;
+			}
+			while((result = LDrawCodecReadRecord(&reader, &record)) == 1)
+			{
+				if(record.kind == codec_record_part)
+				{
+					CHECK((const unsigned char *) record.name >= corrupt);
+					CHECK((const unsigned char *) record.name + strlen(record.name) < corrupt + length);
+				}
+				if(record.kind == codec_record_archived)
+					CHECK((const unsigned char *) record.bytes + record.length <= corrupt + length);
+			}
+			LDrawCodecReaderClose(&reader);
+			if(result < 0)
+				++rejected;
+		}
+	}
+
+	// The kinds, counts, offsets and lengths are most of what can go wrong.
+	CHECK(rejected > 0);
+
+	free(corrupt);
+	free(bytes);
+
+}//end test_corrupt
+
+
+//========== test_bad_structure ================================================
+//
+// Purpose:	Well-formed records in an order the codec never writes: a step
+//			inside a step, an end with no step, and a step left open.
+//
+//==============================================================================
+static void test_bad_structure(void)
+{
+	struct LDrawCodecRecord	records[3];
+	unsigned char *			bytes;
+	size_t					length	= 0;
+
+	memset(records, 0, sizeof(records));
+
+	records[0].kind = codec_record_step;
+	records[1].kind = codec_record_step;
+	records[2].kind = codec_record_step_end;
+	bytes = encode(records, 3, &length);
+	CHECK(decode_all(bytes, length, NULL) == -1);
+	free(bytes);
+
+	records[0].kind = codec_record_step_end;
+	bytes = encode(records, 1, &length);
+	CHECK(decode_all(bytes, length, NULL) == -1);
+	free(bytes);
+
+	records[0].kind = codec_record_step;
+	bytes = encode(records, 1, &length);
+	CHECK(decode_all(bytes, length, NULL) == -1);
+	free(bytes);
+
+}//end test_bad_structure
+
+
+//========== test_other_version ================================================
+//
+// Purpose:	Data from another version of the format is refused outright.
+//
+//==============================================================================
+static void test_other_version(void)
+{
+	struct LDrawCodecRecord	record	= make_part(1, "3001.dat", NULL);
+	size_t					length	= 0;
+	unsigned char *			bytes	= encode(&record, 1, &length);
+
+	bytes[4] = LDRAW_CODEC_VERSION + 1;
+	CHECK(decode_all(bytes, length, NULL) == -1);
+
+	free(bytes);
+
+}//end test_other_version
+
+
+int main(void)
+{
+	test_round_trip();
+	test_empty();
+	test_shared_names();
+	test_truncated();
+	test_corrupt();
+	test_bad_structure();
+	test_other_version();
+
+	return TEST_RESULT;
+}
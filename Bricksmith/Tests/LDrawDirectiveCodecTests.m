@@ -0,0 +1,302 @@
+//
+//  LDrawDirectiveCodecTests.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LDrawColor.h"
+#import "LDrawFile.h"
+#import "LDrawMPDModel.h"
+#import "LDrawPart.h"
+#import "LDrawStep.h"
+#import "LDrawUtilities.h"
+
+// Parts copied in the benchmarks.
+#define BENCHMARK_PARTS		2000
+
+
+//==============================================================================
+//
+// LDrawDirectiveCodecTests
+//
+// Copy and paste through +[LDrawUtilities dataForDirectives:] and
+// +directivesFromData:.  The byte-level checks of the codec itself are in
+// LDrawDirectiveCodecTests.c; these check that directives come back as they
+// went in, and time the codec against the property list of keyed archives
+// the pasteboard used to carry.
+//
+//==============================================================================
+@interface LDrawDirectiveCodecTests : XCTestCase
+@end
+
+
+@implementation LDrawDirectiveCodecTests
+
+//========== stepsFromContents: ================================================
+//
+// Purpose:		The steps of the first model in the given file contents.
+//
+//==============================================================================
+- (NSArray *) stepsFromContents:(NSString *)contents
+{
+	LDrawFile *file = [LDrawFile parseFromFileContents:contents];
+
+	return [[file firstModel] steps];
+
+}//end stepsFromContents:
+
+
+//========== assertDirectives:match: ===========================================
+//
+// Purpose:		Decoded directives are the same classes, in the same order,
+//				and write the same LDraw as the originals.
+//
+//==============================================================================
+- (void) assertDirectives:(NSArray *)decoded match:(NSArray *)original
+{
+	NSUInteger counter = 0;
+
+	XCTAssertEqual([decoded count], [original count]);
+	for(counter = 0; counter < [decoded count] && counter < [original count]; counter++)
+	{
+		id decodedDirective     = [decoded objectAtIndex:counter];
+		id originalDirective    = [original objectAtIndex:counter];
+
+		XCTAssertEqualObjects([decodedDirective class], [originalDirective class]);
+		XCTAssertEqualObjects([decodedDirective write], [originalDirective write]);
+	}
+
+}//end assertDirectives:match:
+
+
+//========== testRoundTripPartsAndSteps ========================================
+//
+// Purpose:		Parts and steps - the codec's own records - come back intact,
+//				whether loose or inside a step, hidden or not.
+//
+//==============================================================================
+- (void) testRoundTripPartsAndSteps
+{
+	NSArray         *steps      = [self stepsFromContents:
+									@"0 FILE main.ldr\n"
+									@"1 4 10 -24 30 1 0 0 0 1 0 0 0 1 3001.dat\n"
+									@"1 1 0 0 0 0 0 -1 0 1 0 1 0 0 3001.dat\n"
+									@"0 STEP\n"
+									@"1 14 -20 8 0.5 1 0 0 0 1 0 0 0 1 3003.dat\n"
+									@"0 ROTSTEP 15 -30 45 ABS\n"
+									@"1 16 0 0 0 1 0 0 0 1 0 0 0 1 3004.dat\n"
+									@"0 STEP\n"];
+	LDrawStep       *firstStep  = [steps objectAtIndex:0];
+	LDrawPart       *loosePart  = [[firstStep subdirectives] objectAtIndex:1];
+	NSMutableArray  *copied     = [NSMutableArray array];
+	NSArray         *pasted     = nil;
+
+	[loosePart setHidden:YES];
+	[copied addObjectsFromArray:steps];
+	[copied addObject:loosePart];
+
+	pasted = [LDrawUtilities directivesFromData:[LDrawUtilities dataForDirectives:copied]];
+
+	[self assertDirectives:pasted match:copied];
+	XCTAssertTrue([[pasted lastObject] isHidden]);
+	XCTAssertEqual([[pasted objectAtIndex:1] stepRotationType], [[steps objectAtIndex:1] stepRotationType]);
+
+}//end testRoundTripPartsAndSteps
+
+
+//========== testRoundTripArchivedFallback =====================================
+//
+// Purpose:		Directives the codec has no record for - other commands, parts
+//				in custom RGB colors, and a step inside a step - are archived
+//				into the codec data, and come back intact in place.
+//
+//==============================================================================
+- (void) testRoundTripArchivedFallback
+{
+	NSArray         *steps      = [self stepsFromContents:
+									@"0 FILE main.ldr\n"
+									@"0 Just a comment\n"
+									@"1 0x2FF8000 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+									@"2 24 0 0 0 10 0 0\n"
+									@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+									@"4 16 0 0 0 20 0 0 20 0 20 0 0 20\n"];
+	LDrawStep       *step       = [steps objectAtIndex:0];
+	LDrawStep       *innerStep  = [LDrawStep emptyStep];
+	NSMutableArray  *copied     = [NSMutableArray array];
+	NSArray         *pasted     = nil;
+
+	[innerStep addDirective:[[[[step subdirectives] objectAtIndex:3] copy] autorelease]];
+	[step addDirective:innerStep];
+
+	[copied addObject:step];
+	[copied addObjectsFromArray:[step subdirectives]];
+
+	pasted = [LDrawUtilities directivesFromData:[LDrawUtilities dataForDirectives:copied]];
+
+	[self assertDirectives:pasted match:copied];
+	[self assertDirectives:[[pasted objectAtIndex:0] subdirectives] match:[step subdirectives]];
+
+}//end testRoundTripArchivedFallback
+
+
+//========== testRoundTripFileLocalColor =======================================
+//
+// Purpose:		A part in a color defined by a !COLOUR in its own file - which
+//				the shared color library has never heard of - comes back in
+//				that color, not whatever the library gives for its code.
+//
+//==============================================================================
+- (void) testRoundTripFileLocalColor
+{
+	NSArray         *steps      = [self stepsFromContents:
+									@"0 FILE main.ldr\n"
+									@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+									@"1 4 20 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"];
+	NSArray         *copied     = [[steps objectAtIndex:0] subdirectives];
+	LDrawPart       *localPart  = [copied objectAtIndex:0];
+	LDrawColor      *localColor = [[[LDrawColor alloc] init] autorelease];
+	LDrawColor      *color      = nil;
+	NSArray         *pasted     = nil;
+	GLfloat         rgba[4]     = {1.0, 0.5, 0.0, 1.0};
+	GLfloat         decoded[4];
+
+	// What the parser makes of a code defined by a file-local !COLOUR.
+	[localColor setColorCode:(LDrawColorT)500];
+	[localColor setEdgeColorCode:LDrawBlack];
+	[localColor setColorRGBA:rgba];
+	[localPart setLDrawColor:localColor];
+
+	pasted = [LDrawUtilities directivesFromData:[LDrawUtilities dataForDirectives:copied]];
+
+	[self assertDirectives:pasted match:copied];
+
+	color = [[pasted objectAtIndex:0] LDrawColor];
+	XCTAssertNotNil(color);
+	XCTAssertEqual([color colorCode], (LDrawColorT)500);
+	[color getColorRGBA:decoded];
+	XCTAssertTrue(memcmp(rgba, decoded, sizeof(rgba)) == 0);
+
+	// A library color still comes back as the library's own.
+	XCTAssertTrue([[pasted objectAtIndex:1] LDrawColor] == [[copied objectAtIndex:1] LDrawColor]);
+
+}//end testRoundTripFileLocalColor
+
+
+//========== testDamagedDataIsRejected =========================================
+//
+// Purpose:		Truncated, empty or foreign pasteboard data gives nil rather
+//				than some of the directives, or a crash.
+//
+//==============================================================================
+- (void) testDamagedDataIsRejected
+{
+	NSArray     *steps      = [self stepsFromContents:
+								@"0 FILE main.ldr\n"
+								@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+								@"0 Just a comment\n"
+								@"1 1 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"];
+	NSData      *data       = [LDrawUtilities dataForDirectives:steps];
+	NSUInteger  length      = 0;
+
+	for(length = 0; length < [data length]; length++)
+	{
+		NSData *truncated = [data subdataWithRange:NSMakeRange(0, length)];
+
+		XCTAssertNil([LDrawUtilities directivesFromData:truncated]);
+	}
+
+	XCTAssertNil([LDrawUtilities directivesFromData:nil]);
+	XCTAssertNil([LDrawUtilities directivesFromData:[@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat" dataUsingEncoding:NSUTF8StringEncoding]]);
+	XCTAssertNil([LDrawUtilities firstDirectiveFromData:[data subdataWithRange:NSMakeRange(0, [data length] / 2)]]);
+	XCTAssertNotNil([LDrawUtilities firstDirectiveFromData:data]);
+
+}//end testDamagedDataIsRejected
+
+
+#pragma mark -
+#pragma mark BENCHMARKS
+#pragma mark -
+
+//========== benchmarkParts ====================================================
+//
+// Purpose:		A selection to copy: a step of BENCHMARK_PARTS parts in a few
+//				different bricks and colors.
+//
+//==============================================================================
+- (NSArray *) benchmarkParts
+{
+	NSMutableString *contents   = [NSMutableString stringWithString:@"0 FILE main.ldr\n"];
+	NSUInteger      counter     = 0;
+
+	for(counter = 0; counter < BENCHMARK_PARTS; counter++)
+	{
+		[contents appendFormat:@"1 %lu %lu 0 0 1 0 0 0 1 0 0 0 1 300%lu.dat\n",
+								(unsigned long)(counter % 16), (unsigned long)(counter * 20),
+								(unsigned long)(1 + counter % 4) ];
+	}
+
+	return [[[self stepsFromContents:contents] objectAtIndex:0] subdirectives];
+
+}//end benchmarkParts
+
+
+//========== testPerformanceCodec ==============================================
+//
+// Purpose:		Benchmark: copy and paste the parts through the codec.
+//
+//==============================================================================
+- (void) testPerformanceCodec
+{
+	NSArray *parts = [self benchmarkParts];
+
+	[self measureBlock:^{
+		NSData  *data   = [LDrawUtilities dataForDirectives:parts];
+		NSArray *pasted = [LDrawUtilities directivesFromData:data];
+
+		XCTAssertEqual([pasted count], [parts count]);
+	}];
+
+}//end testPerformanceCodec
+
+
+//========== testPerformancePropertyList =======================================
+//
+// Purpose:		Benchmark: copy and paste the same parts the way the pasteboard
+//				used to - a keyed archive per directive, in a binary property
+//				list.
+//
+//==============================================================================
+- (void) testPerformancePropertyList
+{
+	NSArray *parts = [self benchmarkParts];
+
+	[self measureBlock:^{
+		NSMutableArray  *archivedParts  = [NSMutableArray array];
+		NSMutableArray  *pasted         = [NSMutableArray array];
+		NSData          *data           = nil;
+		NSArray         *objects        = nil;
+
+		for(LDrawDirective *part in parts)
+			[archivedParts addObject:[NSKeyedArchiver archivedDataWithRootObject:part]];
+		data = [NSPropertyListSerialization dataWithPropertyList:archivedParts
+														  format:NSPropertyListBinaryFormat_v1_0
+														 options:0
+														   error:NULL];
+
+		objects = [NSPropertyListSerialization propertyListWithData:data
+															options:NSPropertyListImmutable
+															 format:NULL
+															  error:NULL];
+		for(NSData *partData in objects)
+			[pasted addObject:[NSKeyedUnarchiver unarchiveObjectWithData:partData]];
+
+		XCTAssertEqual([pasted count], [parts count]);
+	}];
+
+}//end testPerformancePropertyList
+
+@end
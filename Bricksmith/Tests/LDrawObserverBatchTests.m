@@ -0,0 +1,175 @@
+//
+//  LDrawObserverBatchTests.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LDrawDirective.h"
+
+
+//==============================================================================
+//
+// BatchTestObserver
+//
+// Counts what it hears from the directive it watches.
+//
+//==============================================================================
+@interface BatchTestObserver : NSObject <LDrawObserver>
+{
+@public
+	NSUInteger	invalidations;
+	NSUInteger	messages;
+	CacheFlagsT	flagsHeard;
+}
+@end
+
+
+@implementation BatchTestObserver
+
+- (void) observableSaysGoodbyeCruelWorld:(id<LDrawObservable>)doomedObservable
+{
+}
+
+- (void) statusInvalidated:(CacheFlagsT)flags who:(id<LDrawObservable>)observable
+{
+	++invalidations;
+	flagsHeard |= flags;
+}
+
+- (void) receiveMessage:(MessageT)msg who:(id<LDrawObservable>)observable
+{
+	++messages;
+}
+
+@end
+
+
+//==============================================================================
+//
+// LDrawObserverBatchTests
+//
+// What an observer batch holds back and delivers, checked against
+// +[LDrawDirective observerBatchStats].  The stats count since launch, so
+// each test looks only at how much they moved.
+//
+//==============================================================================
+@interface LDrawObserverBatchTests : XCTestCase
+{
+	LDrawDirective		*directive;
+	BatchTestObserver	*firstObserver;
+	BatchTestObserver	*secondObserver;
+}
+@end
+
+
+@implementation LDrawObserverBatchTests
+
+//========== setUp =============================================================
+//
+// Purpose:		A directive with two observers.
+//
+//==============================================================================
+- (void) setUp
+{
+	[super setUp];
+
+	directive       = [[LDrawDirective alloc] init];
+	firstObserver   = [[BatchTestObserver alloc] init];
+	secondObserver  = [[BatchTestObserver alloc] init];
+
+	[directive addObserver:firstObserver];
+	[directive addObserver:secondObserver];
+
+}//end setUp
+
+
+//========== tearDown ==========================================================
+//
+// Purpose:		The directive goes first, so it says goodbye to live observers.
+//
+//==============================================================================
+- (void) tearDown
+{
+	[directive release];
+	[firstObserver release];
+	[secondObserver release];
+
+	[super tearDown];
+
+}//end tearDown
+
+
+//========== testBatchCoalescesNotifications ===================================
+//
+// Purpose:		Inside a batch, repeated invalidations and messages reach each
+//				observer once, when the outermost batch ends, and the stats
+//				count both what was asked for and what was sent.
+//
+//==============================================================================
+- (void) testBatchCoalescesNotifications
+{
+	LDrawObserverBatchStatsT	before	= [LDrawDirective observerBatchStats];
+	LDrawObserverBatchStatsT	after;
+
+	[LDrawDirective beginObserverBatch];
+	[LDrawDirective beginObserverBatch];
+
+	[directive invalCache:CacheFlagBounds];
+	[directive revalCache:CacheFlagBounds];
+	[directive invalCache:CacheFlagBounds];
+	[directive invalCache:DisplayList];
+	[directive sendMessageToObservers:MessageObservedChanged];
+	[directive sendMessageToObservers:MessageObservedChanged];
+
+	[LDrawDirective endObserverBatch];
+
+	// The inner batch ending delivers nothing.
+	XCTAssertEqual(firstObserver->invalidations, (NSUInteger)0);
+	XCTAssertEqual(firstObserver->messages, (NSUInteger)0);
+
+	[LDrawDirective endObserverBatch];
+
+	XCTAssertEqual(firstObserver->invalidations, (NSUInteger)1);
+	XCTAssertEqual(firstObserver->messages, (NSUInteger)1);
+	XCTAssertEqual(firstObserver->flagsHeard, (CacheFlagsT)(CacheFlagBounds | DisplayList));
+	XCTAssertEqual(secondObserver->invalidations, (NSUInteger)1);
+	XCTAssertEqual(secondObserver->messages, (NSUInteger)1);
+
+	// Three invalidations and two messages asked for, to two observers; one
+	// of each sent.
+	after = [LDrawDirective observerBatchStats];
+	XCTAssertEqual(after.requested - before.requested, (NSUInteger)(5 * 2));
+	XCTAssertEqual(after.delivered - before.delivered, (NSUInteger)(2 * 2));
+
+}//end testBatchCoalescesNotifications
+
+
+//========== testNoBatchSendsImmediately =======================================
+//
+// Purpose:		Outside a batch, notifications go straight out and the stats
+//				don't move.
+//
+//==============================================================================
+- (void) testNoBatchSendsImmediately
+{
+	LDrawObserverBatchStatsT	before	= [LDrawDirective observerBatchStats];
+	LDrawObserverBatchStatsT	after;
+
+	[directive invalCache:CacheFlagBounds];
+	[directive sendMessageToObservers:MessageObservedChanged];
+	[directive sendMessageToObservers:MessageObservedChanged];
+
+	XCTAssertEqual(firstObserver->invalidations, (NSUInteger)1);
+	XCTAssertEqual(firstObserver->messages, (NSUInteger)2);
+
+	after = [LDrawDirective observerBatchStats];
+	XCTAssertEqual(after.requested, before.requested);
+	XCTAssertEqual(after.delivered, before.delivered);
+
+}//end testNoBatchSendsImmediately
+
+@end
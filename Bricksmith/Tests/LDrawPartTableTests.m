@@ -0,0 +1,380 @@
+//
+//  LDrawPartTableTests.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LDrawColor.h"
+#import "LDrawFile.h"
+#import "LDrawMPDModel.h"
+#import "LDrawPart.h"
+#import "LDrawRenderer.h"
+#import "LDrawStep.h"
+
+// Placements in the benchmark model.
+#define BENCHMARK_PARTS		2000
+
+// Draws per measurement.
+#define BENCHMARK_DRAWS		10
+
+
+//==============================================================================
+//
+// PartTableTestRenderer
+//
+// A renderer that draws nothing and remembers every explicit color pushed on
+// it, and how many quads it was handed.  It also logs the order of color
+// pushes (C) and drag handles (H).  It takes meshes through an immediate collector, so drawing needs no
+// GL context and builds no display lists.
+//
+//==============================================================================
+@interface PartTableTestRenderer : NSObject <LDrawRenderer, LDrawCollector>
+{
+	NSMutableData	*pushedColors;		// 4 floats per explicit pushColor:
+	NSUInteger		quadCount;
+	NSMutableString	*events;
+}
+
+- (NSUInteger) pushedColorCount;
+- (NSUInteger) quadCount;
+- (NSString *) events;
+- (const GLfloat *) pushedColorAtIndex:(NSUInteger)index;
+- (void) reset;
+
+@end
+
+
+@implementation PartTableTestRenderer
+
+- (id) init
+{
+	self = [super init];
+	pushedColors = [[NSMutableData alloc] init];
+	events = [[NSMutableString alloc] init];
+	return self;
+}
+
+- (void) dealloc
+{
+	[pushedColors release];
+	[events release];
+	[super dealloc];
+}
+
+- (NSUInteger) pushedColorCount
+{
+	return [pushedColors length] / (sizeof(GLfloat) * 4);
+}
+
+- (const GLfloat *) pushedColorAtIndex:(NSUInteger)index
+{
+	return (const GLfloat *)[pushedColors bytes] + index * 4;
+}
+
+- (NSUInteger) quadCount
+{
+	return quadCount;
+}
+
+- (NSString *) events
+{
+	return events;
+}
+
+- (void) reset
+{
+	[pushedColors setLength:0];
+	[events setString:@""];
+	quadCount = 0;
+}
+
+- (void) pushColor:(GLfloat *)color
+{
+	if(color != LDrawRenderCurrentColor && color != LDrawRenderComplimentColor)
+	{
+		[pushedColors appendBytes:color length:sizeof(GLfloat) * 4];
+		[events appendString:@"C"];
+	}
+}
+
+- (int) checkCull:(GLfloat *)minXYZ to:(GLfloat *)maxXYZ	{ return cull_draw; }
+- (id<LDrawCollector>) immediateCollector					{ return self; }
+- (id<LDrawCollector>) beginDL								{ return self; }
+
+- (void) endDL:(LDrawDLHandle *)outHandle cleanupFunc:(LDrawDLCleanup_f *)func
+{
+	*outHandle	= NULL;
+	*func		= NULL;
+}
+
+- (void) popColor																	{}
+- (void) pushMatrix:(GLfloat *)matrix												{}
+- (void) popMatrix																	{}
+- (void) drawBoxFrom:(GLfloat *)minXyz to:(GLfloat *)maxXyz						{}
+- (void) pushWireFrame																{}
+- (void) popWireFrame																{}
+- (void) pushTexture:(struct LDrawTextureSpec *)tex_spec							{}
+- (void) popTexture																	{}
+- (void) drawDragHandle:(GLfloat *)xyz withSize:(GLfloat)size						{ [events appendString:@"H"]; }
+- (void) drawDL:(LDrawDLHandle)dl													{}
+- (void) drawQuad:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color	{ ++quadCount; }
+- (void) drawTri:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color	{}
+- (void) drawLine:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color	{}
+
+@end
+
+
+//==============================================================================
+//
+// LDrawPartTableTests
+//
+// Drawing a step goes through its part table; these check that the table
+// draws what the parts themselves would, and time it against drawing the
+// parts one directive at a time.
+//
+//==============================================================================
+@interface LDrawPartTableTests : XCTestCase
+@end
+
+
+@implementation LDrawPartTableTests
+
+//========== fileWithPlacements: ===============================================
+//
+// Purpose:		A two-model file: the main model places a one-quad submodel
+//				count times, alternating red and blue.
+//
+//==============================================================================
+- (LDrawFile *) fileWithPlacements:(NSUInteger)count
+{
+	NSMutableString *contents   = [NSMutableString string];
+	NSUInteger      counter     = 0;
+
+	[contents appendString:@"0 FILE main.ldr\n"];
+	for(counter = 0; counter < count; counter++)
+	{
+		[contents appendFormat:@"1 %d %lu 0 0 1 0 0 0 1 0 0 0 1 brick.ldr\n",
+								(counter % 2) ? 1 : 4, (unsigned long)(counter * 40) ];
+	}
+	[contents appendString:@"0 FILE brick.ldr\n"];
+	[contents appendString:@"4 16 0 0 0 20 0 0 20 0 20 0 0 20\n"];
+
+	return [LDrawFile parseFromFileContents:contents];
+
+}//end fileWithPlacements:
+
+
+//========== testDrawReadsColorWhenDrawing =====================================
+//
+// Purpose:		A color definition edited in place - as a file-local !COLOUR
+//				can be - must show up on the next draw, though no part using it
+//				has changed.
+//
+//==============================================================================
+- (void) testDrawReadsColorWhenDrawing
+{
+	LDrawFile               *file       = [self fileWithPlacements:1];
+	LDrawMPDModel           *model      = [file firstModel];
+	LDrawStep               *step       = [[model steps] objectAtIndex:0];
+	LDrawPart               *part       = [[step subdirectives] objectAtIndex:0];
+	LDrawColor              *color      = [[[LDrawColor alloc] init] autorelease];
+	PartTableTestRenderer   *renderer   = [[[PartTableTestRenderer alloc] init] autorelease];
+	GLfloat                 before[4]   = {0.25, 0.50, 0.75, 1.0};
+	GLfloat                 after[4]    = {1.00, 0.50, 0.00, 1.0};
+
+	[color setColorCode:(LDrawColorT)500];
+	[color setEdgeColorCode:LDrawBlack];
+	[color setColorRGBA:before];
+	[part setLDrawColor:color];
+
+	[step drawSelf:renderer];
+	XCTAssertEqual([renderer pushedColorCount], (NSUInteger)1);
+	XCTAssertTrue(memcmp([renderer pushedColorAtIndex:0], before, sizeof(before)) == 0);
+
+	// No notification goes out for this.
+	[color setColorRGBA:after];
+
+	[renderer reset];
+	[step drawSelf:renderer];
+	XCTAssertEqual([renderer pushedColorCount], (NSUInteger)1);
+	XCTAssertTrue(memcmp([renderer pushedColorAtIndex:0], after, sizeof(after)) == 0);
+
+	// The flattened part list keeps colors the same way.
+	[renderer reset];
+	[model drawFlattened:renderer];
+	XCTAssertEqual([renderer pushedColorCount], (NSUInteger)1);
+	XCTAssertTrue(memcmp([renderer pushedColorAtIndex:0], after, sizeof(after)) == 0);
+
+	[color setColorRGBA:before];
+	[renderer reset];
+	[model drawFlattened:renderer];
+	XCTAssertTrue([renderer pushedColorCount] == 1 && memcmp([renderer pushedColorAtIndex:0], before, sizeof(before)) == 0);
+
+}//end testDrawReadsColorWhenDrawing
+
+
+//========== testTableDrawsLikeParts ===========================================
+//
+// Purpose:		Drawing from the table pushes the same colors, in the same
+//				order, as asking each part to draw itself.
+//
+//==============================================================================
+- (void) testTableDrawsLikeParts
+{
+	LDrawFile               *file       = [self fileWithPlacements:20];
+	LDrawStep               *step       = [[[file firstModel] steps] objectAtIndex:0];
+	PartTableTestRenderer   *fromTable  = [[[PartTableTestRenderer alloc] init] autorelease];
+	PartTableTestRenderer   *fromParts  = [[[PartTableTestRenderer alloc] init] autorelease];
+
+	[step drawSelf:fromTable];
+	for(LDrawDirective *directive in [step subdirectives])
+		[directive drawSelf:fromParts];
+
+	XCTAssertEqual([fromTable pushedColorCount], (NSUInteger)20);
+	XCTAssertEqual([fromTable pushedColorCount], [fromParts pushedColorCount]);
+	XCTAssertTrue(memcmp([fromTable pushedColorAtIndex:0], [fromParts pushedColorAtIndex:0],
+						 sizeof(GLfloat) * 4 * [fromTable pushedColorCount]) == 0);
+
+}//end testTableDrawsLikeParts
+
+
+//========== testTableDrawsInFileOrder =========================================
+//
+// Purpose:		What isn't a part is drawn between the parts around it, as it
+//				comes in the file - not after all of them.
+//
+//==============================================================================
+- (void) testTableDrawsInFileOrder
+{
+	LDrawFile               *file       = [LDrawFile parseFromFileContents:
+											@"0 FILE main.ldr\n"
+											@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 brick.ldr\n"
+											@"4 16 0 0 0 20 0 0 20 0 20 0 0 20\n"
+											@"1 1 40 0 0 1 0 0 0 1 0 0 0 1 brick.ldr\n"
+											@"0 FILE brick.ldr\n"
+											@"4 16 0 0 0 20 0 0 20 0 20 0 0 20\n"];
+	LDrawStep               *step       = [[[file firstModel] steps] objectAtIndex:0];
+	PartTableTestRenderer   *renderer   = [[[PartTableTestRenderer alloc] init] autorelease];
+
+	// A selected quad draws its four drag handles.
+	[[[step subdirectives] objectAtIndex:1] setSelected:YES];
+
+	[step drawSelf:renderer];
+	XCTAssertEqualObjects([renderer events], @"CHHHHC");
+
+}//end testTableDrawsInFileOrder
+
+
+//========== testDrawAfterSubmodelIsReplaced ===================================
+//
+// Purpose:		Deleting a submodel the step places must leave the part table
+//				and the flattened part list drawing nothing for it - not the
+//				freed model - and adding a submodel of that name back must
+//				draw the new one.
+//
+//==============================================================================
+- (void) testDrawAfterSubmodelIsReplaced
+{
+	LDrawFile               *file       = [self fileWithPlacements:2];
+	LDrawMPDModel           *model      = [file firstModel];
+	LDrawStep               *step       = [[model steps] objectAtIndex:0];
+	LDrawMPDModel           *brick      = [file modelWithName:@"brick.ldr"];
+	LDrawFile               *newFile    = [LDrawFile parseFromFileContents:
+											@"0 FILE brick.ldr\n"
+											@"4 16 0 0 0 20 0 0 20 0 20 0 0 20\n"
+											@"4 16 0 0 0 0 0 20 0 20 20 0 20 0\n"];
+	LDrawMPDModel           *newBrick   = [newFile firstModel];
+	PartTableTestRenderer   *renderer   = [[[PartTableTestRenderer alloc] init] autorelease];
+
+	[step drawSelf:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)2);
+	[renderer reset];
+	[model drawFlattened:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)2);
+
+	// Nothing else holds the submodel: it goes away with the removal.
+	[file removeDirective:brick];
+	brick = nil;
+
+	[renderer reset];
+	[step drawSelf:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)0);
+	XCTAssertEqual([renderer pushedColorCount], (NSUInteger)0);
+	[renderer reset];
+	[model drawFlattened:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)0);
+
+	[newBrick retain];
+	[newFile removeDirective:newBrick];
+	[file addSubmodel:newBrick];
+	[newBrick release];
+
+	[renderer reset];
+	[step drawSelf:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)4);
+	XCTAssertEqual([renderer pushedColorCount], (NSUInteger)2);
+	[renderer reset];
+	[model drawFlattened:renderer];
+	XCTAssertEqual([renderer quadCount], (NSUInteger)4);
+
+}//end testDrawAfterSubmodelIsReplaced
+
+
+//========== testPerformanceDrawFromTable ======================================
+//
+// Purpose:		Benchmark: draw a big step through its part table.
+//
+//==============================================================================
+- (void) testPerformanceDrawFromTable
+{
+	LDrawFile               *file       = [self fileWithPlacements:BENCHMARK_PARTS];
+	LDrawStep               *step       = [[[file firstModel] steps] objectAtIndex:0];
+	PartTableTestRenderer   *renderer   = [[[PartTableTestRenderer alloc] init] autorelease];
+
+	[step drawSelf:renderer];
+
+	[self measureBlock:^{
+		int counter;
+		for(counter = 0; counter < BENCHMARK_DRAWS; counter++)
+		{
+			[renderer reset];
+			[step drawSelf:renderer];
+		}
+	}];
+
+}//end testPerformanceDrawFromTable
+
+
+//========== testPerformanceDrawFromDirectives =================================
+//
+// Purpose:		Benchmark: the same step, drawn by asking each part to draw
+//				itself - what drawing a step did before the part table.
+//
+//==============================================================================
+- (void) testPerformanceDrawFromDirectives
+{
+	LDrawFile               *file       = [self fileWithPlacements:BENCHMARK_PARTS];
+	LDrawStep               *step       = [[[file firstModel] steps] objectAtIndex:0];
+	PartTableTestRenderer   *renderer   = [[[PartTableTestRenderer alloc] init] autorelease];
+	NSArray                 *directives = [step subdirectives];
+
+	for(LDrawDirective *directive in directives)
+		[directive drawSelf:renderer];
+
+	[self measureBlock:^{
+		int counter;
+		for(counter = 0; counter < BENCHMARK_DRAWS; counter++)
+		{
+			[renderer reset];
+			for(LDrawDirective *directive in directives)
+				[directive drawSelf:renderer];
+		}
+	}];
+
+}//end testPerformanceDrawFromDirectives
+
+@end
@@ -0,0 +1,290 @@
+/*
+ *  LDrawSoftRasterTests.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawSoftRaster.h"
+#include "TestSupport.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+//
+// File: LDrawSoftRasterTests
+//
+// Draws one fixed scene - overlapping opaque triangles, a translucent one on
+// top, an edge line, and a triangle through the near plane - on an image
+// that doesn't divide evenly into tiles.  Spot checks of single pixels say
+// what went wrong; a checksum of every pixel, ID and depth catches anything
+// else that changes.  If a change to the raster is meant to change its
+// output, look at the image and then update SCENE_CHECKSUM.
+//
+//==============================================================================
+
+#define SCENE_WIDTH		100
+#define SCENE_HEIGHT	70
+
+// FNV-1a of the scene's pixels, IDs and depths (see scene_checksum).
+#define SCENE_CHECKSUM	0x1DF50584u
+
+
+//========== window_to_clip ====================================================
+//
+// Purpose:	The clip coordinates of a window position, with w = 1, so the
+//			scene can be laid out in pixels.  z is window depth, 0 to 1.
+//
+//==============================================================================
+static void window_to_clip(float x, float y, float z, float clip[4])
+{
+	clip[0] = x / SCENE_WIDTH * 2.0f - 1.0f;
+	clip[1] = 1.0f - y / SCENE_HEIGHT * 2.0f;
+	clip[2] = z * 2.0f - 1.0f;
+	clip[3] = 1.0f;
+
+}//end window_to_clip
+
+
+//========== add_tri ===========================================================
+//
+// Purpose:	Add a flat-colored triangle given in window coordinates.
+//
+//==============================================================================
+static void add_tri(struct LDrawSoftRaster * raster, int id, const float xyz[9], const float rgba[4])
+{
+	float	clip[12];
+	float	colors[12];
+	int		v;
+
+	for(v = 0; v < 3; ++v)
+	{
+		window_to_clip(xyz[3 * v], xyz[3 * v + 1], xyz[3 * v + 2], clip + 4 * v);
+		memcpy(colors + 4 * v, rgba, sizeof(float) * 4);
+	}
+	LDrawSoftRasterSetID(raster, id);
+	LDrawSoftRasterAddTri(raster, clip, colors);
+
+}//end add_tri
+
+
+//========== build_scene =======================================================
+//
+// Purpose:	Add the test scene.  Primitive IDs are 1 to 6, in the order they
+//			are added.
+//
+//==============================================================================
+static void build_scene(struct LDrawSoftRaster * raster)
+{
+	static const float	clear[4]	= { 0.0f, 0.0f, 0.0f, 1.0f };
+	static const float	red[4]		= { 1.0f, 0.0f, 0.0f, 1.0f };
+	static const float	green[4]	= { 0.0f, 1.0f, 0.0f, 1.0f };
+	static const float	blue[4]		= { 0.0f, 0.0f, 1.0f, 0.5f };
+
+	// A red triangle at the back, covering most of the left half.
+	static const float	back[9]		= {  2,  2, 0.75f,	 70,  2, 0.75f,	  2, 68, 0.75f };
+
+	// A green quad in front of it, sloping in depth, across the tile seam.
+	static const float	front_a[9]	= { 30, 10, 0.25f,	 90, 10, 0.50f,	 90, 60, 0.50f };
+	static const float	front_b[9]	= { 30, 10, 0.25f,	 90, 60, 0.50f,	 30, 60, 0.25f };
+
+	// Half-transparent blue over everything, added last like the renderer
+	// adds translucent parts.
+	static const float	glass[9]	= { 20, 30, 0.10f,	 80, 30, 0.10f,	 50, 55, 0.10f };
+
+	float	clip[12];
+	float	colors[12];
+	int		v;
+
+	LDrawSoftRasterClear(raster, clear);
+
+	add_tri(raster, 1, back, red);
+	add_tri(raster, 2, front_a, green);
+	add_tri(raster, 3, front_b, green);
+
+	// A white edge along the top of the green quad, on top of it.
+	window_to_clip(30, 20, 0.25f, clip);
+	window_to_clip(90, 20, 0.50f, clip + 4);
+	for(v = 0; v < 8; ++v)
+		colors[v] = 1.0f;
+	LDrawSoftRasterSetID(raster, 4);
+	LDrawSoftRasterAddLine(raster, clip, colors);
+
+	// A yellow triangle with one corner behind the eye, which the raster
+	// must clip rather than project.
+	clip[0] = -0.9f;	clip[1] = -0.9f;	clip[2] = 0.0f;		clip[3] = 1.0f;
+	clip[4] = -0.5f;	clip[5] = -0.9f;	clip[6] = 0.0f;		clip[7] = 1.0f;
+	clip[8] = -0.7f;	clip[9] = -0.5f;	clip[10] = -3.0f;	clip[11] = 1.0f;
+	for(v = 0; v < 3; ++v)
+	{
+		colors[4 * v + 0] = 1.0f;
+		colors[4 * v + 1] = 1.0f;
+		colors[4 * v + 2] = 0.0f;
+		colors[4 * v + 3] = 1.0f;
+	}
+	LDrawSoftRasterSetID(raster, 5);
+	LDrawSoftRasterAddTri(raster, clip, colors);
+
+	add_tri(raster, 6, glass, blue);
+
+}//end build_scene
+
+
+//========== scene_checksum ====================================================
+//
+// Purpose:	FNV-1a over every pixel's color, ID and depth.  Depths are
+//			rounded to 16 bits first, so the last bit of a float can't
+//			change the sum.
+//
+//==============================================================================
+static uint32_t scene_checksum(const struct LDrawSoftRaster * raster)
+{
+	const unsigned char *	pixels	= LDrawSoftRasterGetPixels(raster);
+	const int *				ids		= LDrawSoftRasterGetIDs(raster);
+	const float *			depths	= LDrawSoftRasterGetDepths(raster);
+	uint32_t				hash	= 2166136261u;
+	uint32_t				words[3];
+	int						count	= SCENE_WIDTH * SCENE_HEIGHT;
+	int						i, b;
+
+	for(i = 0; i < count; ++i)
+	{
+		words[0] =	  (uint32_t) pixels[4 * i]
+					| (uint32_t) pixels[4 * i + 1] << 8
+					| (uint32_t) pixels[4 * i + 2] << 16
+					| (uint32_t) pixels[4 * i + 3] << 24;
+		words[1] = (uint32_t) ids[i];
+		words[2] = (uint32_t) lrintf(depths[i] * 65535.0f);
+
+		for(b = 0; b < 12; ++b)
+		{
+			hash ^= (words[b / 4] >> (8 * (b % 4))) & 0xFF;
+			hash *= 16777619u;
+		}
+	}
+
+	return hash;
+
+}//end scene_checksum
+
+
+//========== pixel_is ==========================================================
+//
+// Purpose:	Whether the pixel at x, y has the given color and ID.  Colors
+//			are interpolated, so a channel may be off by one step.
+//
+//==============================================================================
+static int pixel_is(const struct LDrawSoftRaster * raster, int x, int y, int r, int g, int b, int id)
+{
+	const unsigned char *	pixel	= LDrawSoftRasterGetPixels(raster) + 4 * (y * SCENE_WIDTH + x);
+	const int *				ids		= LDrawSoftRasterGetIDs(raster);
+
+	return		abs(pixel[0] - r) <= 1
+			&&	abs(pixel[1] - g) <= 1
+			&&	abs(pixel[2] - b) <= 1
+			&&	ids[y * SCENE_WIDTH + x] == id;
+
+}//end pixel_is
+
+
+//========== depth_at ==========================================================
+//
+// Purpose:	The window depth of the pixel at x, y.
+//
+//==============================================================================
+static float depth_at(const struct LDrawSoftRaster * raster, int x, int y)
+{
+	return LDrawSoftRasterGetDepths(raster)[y * SCENE_WIDTH + x];
+
+}//end depth_at
+
+
+//========== test_scene ========================================================
+//
+// Purpose:	The scene comes out as drawn, pixel for pixel.
+//
+//==============================================================================
+static void test_scene(void)
+{
+	struct LDrawSoftRaster *	raster	= LDrawSoftRasterCreate(SCENE_WIDTH, SCENE_HEIGHT);
+	uint32_t					checksum;
+
+	CHECK(LDrawSoftRasterGetTileCount(raster) == 2 * 2);
+
+	build_scene(raster);
+	LDrawSoftRasterDrawAllTiles(raster);
+
+	// Nothing, then red behind green: the nearer wins, whatever the order.
+	CHECK(pixel_is(raster, 95, 5, 0, 0, 0, -1));
+	CHECK(depth_at(raster, 95, 5) == 1.0f);
+	CHECK(pixel_is(raster, 5, 5, 255, 0, 0, 1));
+	CHECK(fabsf(depth_at(raster, 5, 5) - 0.75f) < 1.0e-5f);
+	CHECK(pixel_is(raster, 35, 15, 0, 255, 0, 3));
+	CHECK(pixel_is(raster, 85, 15, 0, 255, 0, 2));
+
+	// The green quad's depth follows its slope, across the tile seam.
+	CHECK(fabsf(depth_at(raster, 60, 25) - (0.25f + 0.25f * 30.5f / 60.0f)) < 1.0e-5f);
+	CHECK(fabsf(depth_at(raster, 70, 25) - (0.25f + 0.25f * 40.5f / 60.0f)) < 1.0e-5f);
+
+	// The line sits on the green face it lies in.
+	CHECK(pixel_is(raster, 60, 20, 255, 255, 255, 4));
+
+	// The clipped triangle is still drawn, in front of the red.
+	CHECK(pixel_is(raster, 15, 64, 255, 255, 0, 5));
+
+	// Half blue over green, and over red.
+	CHECK(pixel_is(raster, 50, 40, 0, 128, 128, 6));
+	CHECK(pixel_is(raster, 28, 33, 128, 0, 128, 6));
+	CHECK(fabsf(depth_at(raster, 50, 40) - 0.10f) < 1.0e-5f);
+
+	checksum = scene_checksum(raster);
+	if(checksum != SCENE_CHECKSUM)
+		fprintf(stderr, "scene checksum is 0x%08X\n", (unsigned) checksum);
+	CHECK(checksum == SCENE_CHECKSUM);
+
+	LDrawSoftRasterDestroy(raster);
+
+}//end test_scene
+
+
+//========== test_tile_order ===================================================
+//
+// Purpose:	Tiles drawn in any order - as the renderer's threads draw them -
+//			make the same image, and clearing for a second frame leaves
+//			nothing of the first.
+//
+//==============================================================================
+static void test_tile_order(void)
+{
+	static const float			gray[4]	= { 0.5f, 0.5f, 0.5f, 1.0f };
+	struct LDrawSoftRaster *	raster	= LDrawSoftRasterCreate(SCENE_WIDTH, SCENE_HEIGHT);
+	int							tile;
+
+	// A frame of something else first.
+	LDrawSoftRasterClear(raster, gray);
+	LDrawSoftRasterDrawAllTiles(raster);
+	CHECK(pixel_is(raster, 5, 5, 128, 128, 128, -1));
+
+	build_scene(raster);
+	for(tile = LDrawSoftRasterGetTileCount(raster) - 1; tile >= 0; --tile)
+		LDrawSoftRasterDrawTile(raster, tile);
+
+	CHECK(scene_checksum(raster) == SCENE_CHECKSUM);
+
+	LDrawSoftRasterDestroy(raster);
+
+}//end test_tile_order
+
+
+int main(void)
+{
+	test_scene();
+	test_tile_order();
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,345 @@
+/*
+ *  LDrawStreamRingTests.c
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#include "LDrawStreamRing.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+//
+// File: LDrawStreamRingTests
+//
+// Drives a stream ring through the mock backend with the "GPU" a few frames
+// behind, so the ring has to wrap around while fences are still pending.
+//
+// The mock already counts overlapping maps; the tests keep their own list of
+// every range handed out, by frame, and check each new range against the
+// ranges of frames whose fences have not signaled.  That way a mistake in
+// the mock can't hide a mistake in the ring.
+//
+//==============================================================================
+
+// One range handed out by the ring, and the frame it was handed out in.
+struct Region {
+	int		begin;
+	int		end;
+	int		frame;
+};
+
+// Everything a test knows about its ring.
+struct Harness {
+	struct LDrawStreamMock *	mock;
+	struct LDrawStreamRing *	ring;
+
+	struct Region *				regions;
+	int							region_count;
+
+	int							frames_ended;	// Frame 'n' is fenced by mock fence n + 1.
+	int							orphan_count;
+	int							wraps;			// Times a range started below the one before it.
+	int							last_offset;
+};
+
+
+//========== harness_init ======================================================
+//
+// Purpose:	Make a ring of size bytes over a mock, using the given backend
+//			(which must be the mock's, or a copy of it).
+//
+//==============================================================================
+static void harness_init(struct Harness * h, int size, const struct LDrawStreamBackend * backend)
+{
+	memset(h, 0, sizeof(struct Harness));
+	h->mock = LDrawStreamMockCreate(size);
+	h->ring = LDrawStreamRingCreate(size, backend, h->mock);
+	h->regions = (struct Region *) malloc(sizeof(struct Region) * 1024);
+
+}//end harness_init
+
+
+//========== harness_destroy ===================================================
+//
+// Purpose:	Tear down, checking the mock never saw a bad map.
+//
+//==============================================================================
+static void harness_destroy(struct Harness * h)
+{
+	CHECK(LDrawStreamMockGetErrorCount(h->mock) == 0);
+
+	LDrawStreamRingDestroy(h->ring);
+	LDrawStreamMockDestroy(h->mock);
+	free(h->regions);
+
+}//end harness_destroy
+
+
+//========== harness_map =======================================================
+//
+// Purpose:	Map size bytes, check the range against every range still in
+//			flight, and fill it so a bad range would also trash memory.
+//
+//==============================================================================
+static void harness_map(struct Harness * h, int size)
+{
+	int		retired, offset = -1, r, w;
+	char *	ptr = (char *) LDrawStreamRingMap(h->ring, size, &offset);
+
+	CHECK(offset >= 0 && offset + size <= LDrawStreamRingGetSize(h->ring));
+
+	// An orphan gives the ring new storage: nothing from before can clash.
+	if(LDrawStreamRingGetOrphanCount(h->ring) != h->orphan_count)
+	{
+		h->orphan_count = LDrawStreamRingGetOrphanCount(h->ring);
+		h->region_count = 0;
+	}
+
+	retired = h->frames_ended - LDrawStreamMockGetPendingFences(h->mock);
+
+	for(r = 0, w = 0; r < h->region_count; ++r)
+	{
+		if(h->regions[r].frame + 1 <= retired)
+			continue;
+		CHECK(offset >= h->regions[r].end || offset + size <= h->regions[r].begin);
+		h->regions[w++] = h->regions[r];
+	}
+	h->region_count = w;
+
+	CHECK(h->region_count < 1024);
+	h->regions[h->region_count].begin = offset;
+	h->regions[h->region_count].end = offset + size;
+	h->regions[h->region_count].frame = h->frames_ended;
+	++h->region_count;
+
+	if(offset < h->last_offset)
+		++h->wraps;
+	h->last_offset = offset;
+
+	memset(ptr, h->frames_ended & 0xFF, size);
+	LDrawStreamRingUnmap(h->ring);
+
+}//end harness_map
+
+
+//========== harness_end_frame =================================================
+//
+// Purpose:	End a frame in which something was mapped.
+//
+//==============================================================================
+static void harness_end_frame(struct Harness * h)
+{
+	LDrawStreamRingEndFrame(h->ring);
+	++h->frames_ended;
+
+}//end harness_end_frame
+
+
+//========== test_wrap_with_gpu_behind =========================================
+//
+// Purpose:	One 1000-byte map per frame into a 4096-byte ring, with the GPU
+//			always two frames behind.  Three frames fit, so the ring wraps
+//			over and over, each time into space that signaled just in time,
+//			and never has to wait or orphan.
+//
+//==============================================================================
+static void test_wrap_with_gpu_behind(void)
+{
+	struct Harness	h;
+	int				frame;
+
+	harness_init(&h, 4096, LDrawStreamMockGetBackend());
+
+	for(frame = 0; frame < 100; ++frame)
+	{
+		harness_map(&h, 1000);
+		harness_end_frame(&h);
+
+		CHECK(LDrawStreamMockGetPendingFences(h.mock) <= 3);
+		if(LDrawStreamMockGetPendingFences(h.mock) == 3)
+			LDrawStreamMockRetire(h.mock, 1);
+	}
+
+	CHECK(h.wraps >= 20);
+	CHECK(LDrawStreamRingGetOrphanCount(h.ring) == 0);
+
+	harness_destroy(&h);
+
+}//end test_wrap_with_gpu_behind
+
+
+//========== test_wrap_waits_for_gpu ===========================================
+//
+// Purpose:	The GPU never catches up on its own, so every wrap lands on space
+//			that is still pending: the ring must wait on the oldest fence
+//			rather than hand that space out again.
+//
+//==============================================================================
+static void test_wrap_waits_for_gpu(void)
+{
+	struct Harness	h;
+	int				frame;
+	int				waited = 0;
+
+	harness_init(&h, 4096, LDrawStreamMockGetBackend());
+
+	for(frame = 0; frame < 50; ++frame)
+	{
+		int pending_before = LDrawStreamMockGetPendingFences(h.mock);
+
+		harness_map(&h, 1500);
+		if(LDrawStreamMockGetPendingFences(h.mock) < pending_before)
+			++waited;
+		harness_end_frame(&h);
+	}
+
+	CHECK(waited > 0);
+	CHECK(h.wraps > 0);
+	CHECK(LDrawStreamMockGetPendingFences(h.mock) > 0);
+	CHECK(LDrawStreamRingGetOrphanCount(h.ring) == 0);
+
+	harness_destroy(&h);
+
+}//end test_wrap_waits_for_gpu
+
+
+//========== test_wrap_mid_frame ===============================================
+//
+// Purpose:	Several odd-sized maps per frame, so frames straddle the end of
+//			the buffer and the wrap happens between two maps of one frame.
+//
+//==============================================================================
+static void test_wrap_mid_frame(void)
+{
+	struct Harness	h;
+	int				frame, m;
+
+	harness_init(&h, 8192, LDrawStreamMockGetBackend());
+
+	for(frame = 0; frame < 200; ++frame)
+	{
+		for(m = 0; m < 3; ++m)
+			harness_map(&h, 300 + 77 * ((frame + m) % 7));
+		harness_end_frame(&h);
+
+		if(frame % 3 != 0)
+			LDrawStreamMockRetire(h.mock, 1);
+	}
+
+	CHECK(h.wraps > 0);
+	CHECK(LDrawStreamRingGetOrphanCount(h.ring) == 0);
+
+	harness_destroy(&h);
+
+}//end test_wrap_mid_frame
+
+
+//========== test_random_frames ================================================
+//
+// Purpose:	Random map sizes, map counts and GPU progress, for a long time.
+//
+//==============================================================================
+static void test_random_frames(void)
+{
+	struct Harness	h;
+	unsigned int	seed = 12345;
+	int				frame, m, maps;
+
+	harness_init(&h, 16384, LDrawStreamMockGetBackend());
+
+	for(frame = 0; frame < 5000; ++frame)
+	{
+		seed = seed * 1103515245 + 12345;
+		maps = 1 + (seed >> 16) % 4;
+		for(m = 0; m < maps; ++m)
+		{
+			seed = seed * 1103515245 + 12345;
+			harness_map(&h, 1 + (seed >> 16) % 4000);
+		}
+		harness_end_frame(&h);
+
+		seed = seed * 1103515245 + 12345;
+		LDrawStreamMockRetire(h.mock, (seed >> 16) % 3);
+	}
+
+	CHECK(h.wraps > 100);
+
+	harness_destroy(&h);
+
+}//end test_random_frames
+
+
+//========== test_orphan_without_fences ========================================
+//
+// Purpose:	A backend with no fences can't tell when space is free, so the
+//			ring orphans the buffer each time it fills up.
+//
+//==============================================================================
+static void test_orphan_without_fences(void)
+{
+	struct LDrawStreamBackend	no_fences = *LDrawStreamMockGetBackend();
+	struct Harness				h;
+	int							frame;
+
+	no_fences.fence_insert = NULL;
+	harness_init(&h, 4096, &no_fences);
+
+	for(frame = 0; frame < 40; ++frame)
+	{
+		harness_map(&h, 1000);
+		LDrawStreamRingEndFrame(h.ring);
+	}
+
+	// Four 1000-byte maps fill the buffer: each fifth map needs an orphan.
+	CHECK(LDrawStreamRingGetOrphanCount(h.ring) == 40 / 4 - 1);
+	CHECK(LDrawStreamMockGetPendingFences(h.mock) == 0);
+
+	harness_destroy(&h);
+
+}//end test_orphan_without_fences
+
+
+//========== test_frame_bigger_than_ring =======================================
+//
+// Purpose:	A single frame that maps more than the whole buffer has nowhere
+//			to go but a new buffer, fences or not.
+//
+//==============================================================================
+static void test_frame_bigger_than_ring(void)
+{
+	struct Harness	h;
+	int				m;
+
+	harness_init(&h, 4096, LDrawStreamMockGetBackend());
+
+	harness_map(&h, 2000);
+	harness_end_frame(&h);
+
+	for(m = 0; m < 4; ++m)
+		harness_map(&h, 1500);
+	harness_end_frame(&h);
+
+	CHECK(LDrawStreamRingGetOrphanCount(h.ring) >= 1);
+
+	harness_destroy(&h);
+
+}//end test_frame_bigger_than_ring
+
+
+int main(void)
+{
+	test_wrap_with_gpu_behind();
+	test_wrap_waits_for_gpu();
+	test_wrap_mid_frame();
+	test_random_frames();
+	test_orphan_without_fences();
+	test_frame_bigger_than_ring();
+
+	return TEST_RESULT;
+}
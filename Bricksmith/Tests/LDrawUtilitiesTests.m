@@ -0,0 +1,95 @@
+//
+//  LDrawUtilitiesTests.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LDrawFile.h"
+#import "LDrawMPDModel.h"
+#import "LDrawStep.h"
+#import "LDrawUtilities.h"
+
+
+//==============================================================================
+//
+// LDrawUtilitiesTests
+//
+//==============================================================================
+@interface LDrawUtilitiesTests : XCTestCase
+@end
+
+
+@implementation LDrawUtilitiesTests
+
+//========== testTopLevelDirectivesKeepSelectionOrder ==========================
+//
+// Purpose:		A selection mixing a model, steps and parts at several depths
+//				reduces to the directives no selected container encloses, in
+//				the order they were selected - whether a child was selected
+//				before or after its container.
+//
+//==============================================================================
+- (void) testTopLevelDirectivesKeepSelectionOrder
+{
+	LDrawFile       *file       = [LDrawFile parseFromFileContents:
+									@"0 FILE main.ldr\n"
+									@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+									@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3002.dat\n"
+									@"0 STEP\n"
+									@"1 1 0 0 0 1 0 0 0 1 0 0 0 1 3003.dat\n"
+									@"0 STEP\n"
+									@"0 FILE sub.ldr\n"
+									@"1 14 0 0 0 1 0 0 0 1 0 0 0 1 3004.dat\n"
+									@"0 STEP\n"
+									@"1 14 0 0 0 1 0 0 0 1 0 0 0 1 3005.dat\n"
+									@"1 14 0 0 0 1 0 0 0 1 0 0 0 1 3006.dat\n"
+									@"0 STEP\n"];
+	LDrawMPDModel   *mainModel  = [[file submodels] objectAtIndex:0];
+	LDrawMPDModel   *subModel   = [[file submodels] objectAtIndex:1];
+	LDrawStep       *mainStep1  = [[mainModel steps] objectAtIndex:0];
+	LDrawStep       *mainStep2  = [[mainModel steps] objectAtIndex:1];
+	LDrawStep       *subStep1   = [[subModel steps] objectAtIndex:0];
+	LDrawStep       *subStep2   = [[subModel steps] objectAtIndex:1];
+	id              mainPart1   = [[mainStep1 subdirectives] objectAtIndex:0];
+	id              mainPart2   = [[mainStep1 subdirectives] objectAtIndex:1];
+	id              mainPart3   = [[mainStep2 subdirectives] objectAtIndex:0];
+	id              subPart1    = [[subStep1 subdirectives] objectAtIndex:0];
+	id              subPart2    = [[subStep2 subdirectives] objectAtIndex:0];
+	id              subPart3    = [[subStep2 subdirectives] objectAtIndex:1];
+	NSArray         *selection  = nil;
+	NSArray         *expected   = nil;
+	NSArray         *topLevel   = nil;
+	NSUInteger      counter     = 0;
+
+	selection = [NSArray arrayWithObjects:
+					subPart3,		// its step comes later
+					mainPart2,		// its model comes later
+					subPart1,		// nothing of its own selected: kept
+					mainModel,
+					mainStep2,
+					subStep2,
+					mainPart3,
+					mainPart1,
+					subPart2,
+					nil ];
+	expected = [NSArray arrayWithObjects:subPart1, mainModel, subStep2, nil];
+
+	topLevel = [LDrawUtilities topLevelDirectivesInList:selection];
+
+	XCTAssertEqual([topLevel count], [expected count]);
+	for(counter = 0; counter < [topLevel count] && counter < [expected count]; counter++)
+		XCTAssertTrue([topLevel objectAtIndex:counter] == [expected objectAtIndex:counter]);
+
+	// Nothing to reduce: the list comes back as it was.
+	selection = [NSArray arrayWithObjects:subPart2, mainPart1, subPart1, mainPart3, nil];
+	XCTAssertEqualObjects([LDrawUtilities topLevelDirectivesInList:selection], selection);
+
+	XCTAssertEqual([[LDrawUtilities topLevelDirectivesInList:[NSArray array]] count], (NSUInteger)0);
+
+}//end testTopLevelDirectivesKeepSelectionOrder
+
+@end
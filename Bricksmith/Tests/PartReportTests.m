@@ -0,0 +1,143 @@
+//
+//  PartReportTests.m
+//  Bricksmith
+//
+//  Created by agent on 10/18/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LDrawFile.h"
+#import "LDrawMPDModel.h"
+#import "PartLibrary.h"
+#import "PartReport.h"
+
+
+//==============================================================================
+//
+// PartReportTests
+//
+// Piece counts over a folder of files, with no document open.
+//
+//==============================================================================
+@interface PartReportTests : XCTestCase
+{
+	NSString	*directoryPath;
+}
+@end
+
+
+@implementation PartReportTests
+
+//========== setUp =============================================================
+//
+// Purpose:		Writes a folder with a plain model, a multi-part model placing
+//				its submodel twice, and a file which isn't LDraw at all.
+//
+//==============================================================================
+- (void) setUp
+{
+	NSString *uniqueName = [[NSProcessInfo processInfo] globallyUniqueString];
+
+	[super setUp];
+
+	directoryPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:uniqueName] retain];
+	[[NSFileManager defaultManager] createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:NULL];
+
+	[self writeFile:@"plain.ldr" contents:
+		@"0 Plain\n"
+		@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"
+		@"1 4 40 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"];
+
+	[self writeFile:@"nested.mpd" contents:
+		@"0 FILE main.ldr\n"
+		@"1 1 0 0 0 1 0 0 0 1 0 0 0 1 sub.ldr\n"
+		@"1 1 0 -24 0 1 0 0 0 1 0 0 0 1 sub.ldr\n"
+		@"1 14 0 -48 0 1 0 0 0 1 0 0 0 1 3003.dat\n"
+		@"0 FILE sub.ldr\n"
+		@"1 16 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"];
+
+	[self writeFile:@"notes.txt" contents:
+		@"1 4 0 0 0 1 0 0 0 1 0 0 0 1 3001.dat\n"];
+
+}//end setUp
+
+
+//========== tearDown ==========================================================
+//
+// Purpose:		Removes the folder.
+//
+//==============================================================================
+- (void) tearDown
+{
+	[[NSFileManager defaultManager] removeItemAtPath:directoryPath error:NULL];
+	[directoryPath release];
+	directoryPath = nil;
+
+	[super tearDown];
+
+}//end tearDown
+
+
+//========== writeFile:contents: ===============================================
+//
+// Purpose:		Writes one file into the folder.
+//
+//==============================================================================
+- (void) writeFile:(NSString *)fileName contents:(NSString *)contents
+{
+	[contents writeToFile:[directoryPath stringByAppendingPathComponent:fileName]
+			   atomically:NO
+				 encoding:NSUTF8StringEncoding
+					error:NULL];
+
+}//end writeFile:contents:
+
+
+//========== testDirectoryReportCountsEveryFile ================================
+//
+// Purpose:		The folder's report counts the main model of each LDraw file,
+//				as if they were one model, and skips files that aren't LDraw.
+//
+//==============================================================================
+- (void) testDirectoryReportCountsEveryFile
+{
+	PartReport  *report     = [PartReport partReportForFilesInDirectory:directoryPath];
+	NSUInteger  expected    = 0;
+
+	for(NSString *fileName in [NSArray arrayWithObjects:@"plain.ldr", @"nested.mpd", nil])
+	{
+		LDrawFile   *file       = [LDrawFile fileFromContentsAtPath:[directoryPath stringByAppendingPathComponent:fileName]];
+		PartReport  *fileReport = [PartReport partReportForContainer:[file activeModel]];
+
+		[fileReport getPieceCountReport];
+		expected += [fileReport numberOfParts];
+	}
+
+	XCTAssertEqual([report numberOfParts], expected);
+
+	// With the part library loaded, the bricks themselves are counted: two
+	// in the plain model, and one in each copy of the submodel plus one
+	// more in the multi-part model.
+	if([[PartLibrary sharedPartLibrary] modelForName:@"3001.dat"] != nil)
+		XCTAssertEqual([report numberOfParts], (NSUInteger)5);
+
+}//end testDirectoryReportCountsEveryFile
+
+
+//========== testEmptyDirectory ================================================
+//
+// Purpose:		A folder with nothing to count, or no folder at all, reports no
+//				parts.
+//
+//==============================================================================
+- (void) testEmptyDirectory
+{
+	NSString *missingPath = [directoryPath stringByAppendingPathComponent:@"missing"];
+
+	XCTAssertEqual([[PartReport partReportForFilesInDirectory:missingPath] numberOfParts], (NSUInteger)0);
+
+}//end testEmptyDirectory
+
+@end
@@ -0,0 +1,42 @@
+/*
+ *  TestSupport.h
+ *  Bricksmith
+ *
+ *  Created by agent on 10/18/26.
+ *  Copyright 2026 agent. All rights reserved.
+ *
+ */
+
+#ifndef TestSupport_H
+#define TestSupport_H
+
+#include <stdio.h>
+
+//==============================================================================
+//
+// File: TestSupport
+//
+// The smallest test harness that works: each test program is a main() that
+// calls CHECK on everything it expects, and returns TEST_RESULT.  A failed
+// CHECK prints where it failed and carries on, so one run reports every
+// failure.
+//
+// These tests cover the parts of Bricksmith that are portable C - no GL, no
+// Cocoa - so they build and run with the Makefile in this directory on any
+// platform.
+//
+//==============================================================================
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if(!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			++test_failures; \
+		} \
+	} while(0)
+
+#define TEST_RESULT (test_failures ? (fprintf(stderr, "%d checks failed\n", test_failures), 1) : 0)
+
+#endif /* TestSupport_H */
@@ -6,23 +6,18 @@
 #include <math.h>
 #include <float.h>
 
-#include "lsynthcp.h"
-#include "band.h"
-#include "hose.h"
-
-extern int normalize(PRECISION v[3]);
+#include "lsynth.h"
 
 /*
  * 0 SYNTH BEGIN DEFINE BAND <fill> RUBBER_BAND "Descr" <scale> <thresh>
  * 1 <len>  a b c  d e f  g h i  j k l "name"
  * 1 <len>  a b c  d e f  g h i  j k l "name"
  * 0 SYNTH END
+ *
+ * The band types are kept in the context, see lsynth.h.
  */
 
-int           n_band_types;
-band_attrib_t   band_types[32];
-
-#define N_BAND_TYPES n_band_types
+#define N_BAND_TYPES context->n_band_types
 
 /*
  * 0 SYNTH BEGIN DEFINE BAND CONSTRAINTS
@@ -30,13 +25,8 @@ band_attrib_t   band_types[32];
  * 0 SYNTH END
  */
 
-int    n_band_constraints;
-part_t   band_constraints[64];
+#define N_BAND_CONSTRAINTS context->n_band_constraints
 
-#define N_BAND_CONSTRAINTS n_band_constraints
-
-// Make current band_type a global var so we can use it everywhere.
-band_attrib_t *band_type = NULL;
 
 /************************************************************************/
 // Return 1 if the v2 bends left of v1, -1 if right, 0 if straight ahead.
@@ -51,33 +41,33 @@ int turn_vector(PRECISION v1[3], PRECISION v2[3])
 }
 
 //**********************************************************************
-void band_ini(void)
+void band_ini(lsynth_context_t *context)
 {
   int i;
 
   for (i = 0; i < N_BAND_TYPES; i++) {
-    printf("%-20s = SYNTH BEGIN %s 16\n",band_types[i].type, band_types[i].type);
+    printf("%-20s = SYNTH BEGIN %s 16\n",context->band_types[i].type, context->band_types[i].type);
   }
 }
 
 void
-list_band_types(void)
+list_band_types(lsynth_context_t *context)
 {
   int i;
 
   printf("\n\nBand type synthesizable parts\n");
   for (i = 0; i < N_BAND_TYPES; i++) {
-    printf("  %-20s %s\n",band_types[i].type, band_types[i].descr);
+    printf("  %-20s %s\n",context->band_types[i].type, context->band_types[i].descr);
   }
 }
 
 int
-isbandtype(char *type)
+isbandtype(lsynth_context_t *context, char *type)
 {
   int i;
 
   for (i = 0; i < N_BAND_TYPES; i++) {
-    if (strncasecmp(band_types[i].type,type,strlen(band_types[i].type)) == 0) {
+    if (strncasecmp(context->band_types[i].type,type,strlen(context->band_types[i].type)) == 0) {
       return 1;
     }
   }
@@ -85,12 +75,12 @@ isbandtype(char *type)
 }
 
 int
-isbandconstraint(char *type)
+isbandconstraint(lsynth_context_t *context, char *type)
 {
   int i;
 
   for (i = 0; i < N_BAND_CONSTRAINTS; i++) {
-    if (strcasecmp(band_constraints[i].type,type) == 0) {
+    if (strcasecmp(context->band_constraints[i].type,type) == 0) {
       return 1;
     }
   }
@@ -98,13 +88,13 @@ isbandconstraint(char *type)
 }
 
 void
-list_band_constraints(void)
+list_band_constraints(lsynth_context_t *context)
 {
   int i;
 
   printf("\n\nBand type synthesis constraints\n");
   for (i = 0; i < N_BAND_CONSTRAINTS; i++) {
-    printf("    %11s\n",band_constraints[i].type);
+    printf("    %11s\n",context->band_constraints[i].type);
   }
 }
 
@@ -117,7 +107,7 @@ calc_crosses(
   LSL_band_constraint *k,
   LSL_band_constraint *m,
   int                 *layer,
-  FILE *output)
+  lsynth_output_t     *output)
 {
   PRECISION xlk = k->end_line[0] - k->start_line[0];
   PRECISION ylk = k->end_line[1] - k->start_line[1];
@@ -136,13 +126,13 @@ calc_crosses(
     if (s >= 0 && s <= 1.0 && t >= 0 && t <= 1.0) {
       PRECISION x = k->start_line[0] + xlk*s;
       PRECISION y = k->start_line[1] + ylk*s;
-      if (k->n_crossings < 8) {
+      if (k->n_crossings < MAX_CROSSINGS-1) {
         k->crossings[k->n_crossings][0] = x;
         k->crossings[k->n_crossings][1] = y;
         k->crossings[k->n_crossings][2] = 0;
         k->n_crossings++;
       }
-      if (m->n_crossings < 8) {
+      if (m->n_crossings < MAX_CROSSINGS-1) {
         m->crossings[m->n_crossings][0] = x;
         m->crossings[m->n_crossings][1] = y;
         m->crossings[m->n_crossings][2] = 0;
@@ -169,7 +159,7 @@ void
 calc_angles(
   band_attrib_t *type,
   LSL_band_constraint *k,
-  FILE *output)
+  lsynth_output_t     *output)
 {
   PRECISION first_x, first_y, last_x, last_y;
   PRECISION dx,dy;
@@ -225,8 +215,6 @@ calc_angles(
   PRECISION a[3];
   PRECISION b[3];
 
-  extern PRECISION dotprod(PRECISION a[3], PRECISION b[3]);
-  
   if (k->cross || ! k->inside) {
     vectorcp(a, k->end_angle);
     vectorcp(b, k->start_angle);
@@ -273,17 +261,19 @@ calc_angles(
     }
 
     if (k->layer == -2)
-      k->layer == -1;
+      k->layer = -1;
 
 #ifdef DEBUGGING_FIXED3_BANDS
-  if (k->cross || ! k->inside) 
-    printf("OUT(%.2fx, %.2fy, %dr)  A = %.2f from (%.2f, %.2f) r = %.2f (%dT%.2f)\n", 
-	   k->part.offset[0], k->part.offset[1], (int)k->radius,
-	   angle * 180 / pi, dx, dy, r * 180 / pi, i, ta);
-  else
-    printf("IN (%.2fx, %.2fy, %dr)  A = %.2f from (%.2f, %.2f) r = %.2f (%dT%.2f)\n", 
-	   k->part.offset[0], k->part.offset[1], (int)k->radius, 
-	   angle * 180 / pi, dx, dy, r * 180 / pi, i, ta);
+  if (output->verbose) {
+    if (k->cross || ! k->inside) 
+      printf("OUT(%.2fx, %.2fy, %dr)  A = %.2f from (%.2f, %.2f) r = %.2f (%dT%.2f)\n", 
+	     k->part.offset[0], k->part.offset[1], (int)k->radius,
+	     angle * 180 / pi, dx, dy, r * 180 / pi, i, ta);
+    else
+      printf("IN (%.2fx, %.2fy, %dr)  A = %.2f from (%.2f, %.2f) r = %.2f (%dT%.2f)\n", 
+	     k->part.offset[0], k->part.offset[1], (int)k->radius, 
+	     angle * 180 / pi, dx, dy, r * 180 / pi, i, ta);
+  }
 #endif
 
   ta = r;
@@ -342,7 +332,8 @@ calc_angles(
     circ = ta*k->radius;
     k->n_steps = circ*type->scale + 0.5f;
     k->n_steps++; // Not really steps, but segment endpoints?  So add 1 more point.
-    printf("nsteps = %d = (%.2f / %.2f\n", k->n_steps, circ, 1.0 / type->scale);
+    if (output->verbose)
+      printf("nsteps = %d = (%.2f / %.2f\n", k->n_steps, circ, 1.0 / type->scale);
 #else
     n = type->scale * 2 * pi * k->radius + 0.5;
 
@@ -362,7 +353,7 @@ calc_angles(
 #endif
   } else { // (type->fill == STRETCH)
 
-    n =  2 * pi * k->radius/band_res + 0.5f;
+    n =  2 * pi * k->radius/output->band_res + 0.5f;
 
     // circumference
     for (i = 0; i < n; i++) {
@@ -400,30 +391,36 @@ int intersect_line_circle_2D(
 {
   PRECISION fsq, gsq, fgsq;
   PRECISION xjo, yjo;
-  PRECISION fygx;
   PRECISION fxgy;
+#ifdef DEBUGGING_BANDS
+  PRECISION fygx;
   PRECISION root;
+#endif
   PRECISION t;
 
   fsq = f * f;
   gsq = g * g;
   fgsq = fsq + gsq; // dx2 + dy2 (should be 1 if normalized).
 
+#ifdef DEBUGGING_BANDS
   if (fgsq < ACCY) {
     printf("line coefficients are corrupt\n"); // Because dx = dy = 0.
   }
+#endif
 
   xjo = xj - xo;
   yjo = yj - yo;
-  fygx = f*yjo - g*xjo;
-  root = rj*rj*fgsq - fygx*fygx;
 
   // What's the story with this message?  I get it sometimes but this still works.
   // We eliminate the two degenerate cases (circles overlap) in calc_tangent_line() 
   // So this fn should ALWAYS work when it's called.  I suspect this is bogus...
+#ifdef DEBUGGING_BANDS
+  fygx = f*yjo - g*xjo;
+  root = rj*rj*fgsq - fygx*fygx;
   if (root < -ACCY) {
     printf("line does not intersect with circle\n");
   }
+#endif
 
   fxgy = f*xjo + g*yjo;
 
@@ -441,7 +438,7 @@ int intersect_line_circle_2D(
 int calc_tangent_line(
   LSL_band_constraint *k,
   LSL_band_constraint *l,
-  FILE                *output)
+  lsynth_output_t     *output)
 {
   int inside1, inside2;
   PRECISION rl,rk,rlk;
@@ -578,20 +575,21 @@ int calc_tangent_line(
  */
 
 int draw_arc_line(
+  lsynth_context_t    *context,
   band_attrib_t       *type,
   LSL_band_constraint *constraint,
   int                  color,
   int                  draw_line,
-  FILE                *output,
+  lsynth_output_t     *output,
   int                  ghost,
   char                *group,
   part_t      *absolute,
-  LSL_band_constraint *f_constraint)
+  PRECISION    plane_offset[3],
+  PRECISION    plane_inv[3][3])
 {
   int       i,j,n;
   PRECISION dx,dy,dz;
   PRECISION L1,L2;
-  PRECISION inv[3][3];
   int steps;
 
   if (draw_line) {
@@ -608,7 +606,8 @@ int draw_arc_line(
       L1 = sqrtf(dx*dx + dy*dy);
       L2 = sqrtf(dx*dx + dy*dy + dz*dz);
 #ifdef DEBUGGING_FIXED3_BANDS
-      printf("Direction = (%.3f, %.3f, %.3f) => %.3f_L1, %.3f_L2)\n", dx, dy, dz, L1, L2);
+      if (output->verbose)
+        printf("Direction = (%.3f, %.3f, %.3f) => %.3f_L1, %.3f_L2)\n", dx, dy, dz, L1, L2);
       // ******************************
       // Based on this it looks like L2 is already in whole number units of part len
       // (where part len is 1/type->scale).
@@ -702,7 +701,7 @@ int draw_arc_line(
 	
 #endif
 #ifdef DEBUGGING_FIXED3_BANDS
-	if (i == steps)
+	if (i == steps && output->verbose)
 	  printf("Scale(%.2f, %.3f, %d) = %.2f)\n", L2, type->scale, n, L1);
 #endif
 
@@ -740,15 +739,14 @@ int draw_arc_line(
         //       constraint's offset (for things like technic turntable top,
         //       where the gear plane does not go through the origin.
 
-        vectorsub( part.offset,band_constraints[f_constraint->band_constraint_n].offset);
+        vectorsub( part.offset,plane_offset);
 
         //   5.  Orient tangent part based on the orientation of the first
         //       constraint's orientation (for things like technic turntable
         //       who's gear plane is perpendicular to the plane of say the 24T
         //       gears.
 
-	matrixinv(inv,band_constraints[f_constraint->band_constraint_n].orient);
-        vectorrot( part.offset,inv);
+        vectorrot( part.offset,plane_inv);
 
         //   6.  Orient the tangent part offsetation back to the absolute 3D
         //       offsetation.
@@ -765,7 +763,7 @@ int draw_arc_line(
         //       to the standard 24T gear's gear plane
 
         matrixcp(tm,part.orient);
-        matrixmult3(part.orient, inv, tm);
+        matrixmult3(part.orient, plane_inv, tm);
 
         //   9.  Now rotate the part back into its correct orientation in 3D
         //       space.
@@ -793,11 +791,12 @@ int draw_arc_line(
   {
     PRECISION pi = 2*atan2f(1,0);
     PRECISION f[3];
+    PRECISION arc_stretch;
 
     /* now for the arc */
 
     if (type->fill == STRETCH) {
-      n = 2*pi*constraint->radius/band_res;
+      n = 2*pi*constraint->radius/output->band_res;
     } else {
       n = 2*pi*constraint->radius*type->scale;
     }
@@ -814,6 +813,10 @@ int draw_arc_line(
       steps = constraint->n_steps;
     }
 
+    // how much a STRETCH arc part is stretched to close the gaps between them
+
+    arc_stretch = type->scale*sinf(2 * pi / n);
+
     for (i = 1; i < steps; i++) {
       PRECISION orient[3][3];
       PRECISION foffset[3];
@@ -877,8 +880,7 @@ int draw_arc_line(
 
       if (type->fill == STRETCH) {
         PRECISION scale[3][3];
-        PRECISION angle = 2 * pi / n;
-        PRECISION l = type->scale*sinf(angle);
+        PRECISION l = arc_stretch;
         int k,j;
 
         if (i + 1 == steps) {
@@ -930,15 +932,14 @@ int draw_arc_line(
       //       constraint's offset (for things like technic turntable top,
       //       where the gear plane does not go through the origin.)
 
-      vectorsub(part.offset,band_constraints[f_constraint->band_constraint_n].offset);
+      vectorsub(part.offset,plane_offset);
 
       //   5.  Orient arc part based on the orientation of the first
       //       constraint's orientation (for things like technic turntable
       //       who's gear plane is perpendicular to the plane of say the 24T
       //       gears.)
 
-      matrixinv(inv,band_constraints[f_constraint->band_constraint_n].orient);
-      vectorrot(part.offset,inv);
+      vectorrot(part.offset,plane_inv);
 
       //   6.  Orient the arc part offsetation back to the absolute 3D
       //       offsetation.
@@ -955,7 +956,7 @@ int draw_arc_line(
       //       to the standard 24T gear's gear plane)
 
       matrixcp(tm,part.orient);
-      matrixmult3(part.orient, inv, tm);
+      matrixmult3(part.orient, plane_inv, tm);
 
       //   9.  Now rotate the part back into its correct orientation in 3D
       //       space.
@@ -984,7 +985,7 @@ int draw_arc_line(
 
 void
 showconstraints(
-  FILE                *output,
+  lsynth_output_t     *output,
   LSL_band_constraint *constraints,
   int                  n_constraints,
   int                  color)
@@ -1005,11 +1006,40 @@ showconstraints(
       cp->orient[2][0],cp->orient[2][1],cp->orient[2][2],
       cp->type);
   }
-
-  fflush(output);
 #endif
 }
 
+/*
+ * About how many parts draw_arc_line will make: the arc steps around each
+ * constraint, plus a part per 1/scale of its tangent lines (just one for
+ * STRETCH).
+ */
+
+static int
+count_band_parts(
+  band_attrib_t       *type,
+  LSL_band_constraint *constraints,
+  int                  n_constraints)
+{
+  int i,j,n = 0;
+
+  for (i = 0; i < n_constraints; i++) {
+    LSL_band_constraint *k = &constraints[i];
+
+    if (k->radius == 0) {
+      continue;
+    }
+    n += k->n_steps + 2;
+    for (j = 0; j < k->n_crossings - 1; j++) {
+      PRECISION d[3];
+
+      vectorsub3(d,k->crossings[j+1],k->crossings[j]);
+      n += type->fill == STRETCH ? 1 : (int)(vectorlen(d)*type->scale) + 1;
+    }
+  }
+  return n;
+}
+
 static void
 rotate_constraints(
   LSL_band_constraint *constraints,
@@ -1066,11 +1096,12 @@ rotate_constraints(
 
 int
 synth_band(
+  lsynth_context_t *context,
   char *type,
   int n_constraints,
   LSL_band_constraint *constraints,
   int color,
-  FILE *output,
+  lsynth_output_t *output,
   int ghost,
   char *group)
 {
@@ -1080,17 +1111,17 @@ synth_band(
   int inside = 1;
   int first,last;
   part_t absolute;
-  PRECISION inv[3][3],trot[3][3];
+  PRECISION inv[3][3];
+  PRECISION plane_inv[3][3];
+  part_t   *plane;
   int layer = 0;
-
-  // Make band_type a global var so we can use it everywhere.
-  // band_attrib_t *band_type = NULL;
+  band_attrib_t *band_type = NULL;
 
   /* Search for band type */
   band_type = NULL;
   for (i = 0; i < N_BAND_TYPES; i++) {
-    if (strcasecmp(type,band_types[i].type) == 0) {
-      band_type = &band_types[i];
+    if (strcasecmp(type,context->band_types[i].type) == 0) {
+      band_type = &context->band_types[i];
       break;
     }
   }
@@ -1130,10 +1161,10 @@ synth_band(
       // search the constraints table
 
       for (k = 0; k < N_BAND_CONSTRAINTS; k++) {
-        if (strcasecmp(constraints[i].part.type,band_constraints[k].type) == 0) {
+        if (strcasecmp(constraints[i].part.type,context->band_constraints[k].type) == 0) {
           constraints[i].band_constraint_n = k;
 
-          constraints[i].radius = band_constraints[k].attrib;
+          constraints[i].radius = context->band_constraints[k].attrib;
           break;
         }
       }
@@ -1187,7 +1218,7 @@ synth_band(
    */
 
   rotate_constraints(constraints,n_constraints,
-    band_constraints[constraints[first].band_constraint_n].orient);
+    context->band_constraints[constraints[first].band_constraint_n].orient);
 
   //showconstraints(output,constraints,n_constraints,15);
 
@@ -1200,7 +1231,7 @@ synth_band(
   for (i = 0; i < n_constraints; i++) {
     if (constraints[i].radius) {
       vectoradd(constraints[i].part.offset, //was vectorsub()
-        band_constraints[constraints[first].band_constraint_n].offset);
+        context->band_constraints[constraints[first].band_constraint_n].offset);
     }
   }
 
@@ -1219,7 +1250,7 @@ synth_band(
   for (i = 1; i < n_constraints; i++) { // Start at constraint 1, not 0.
     if (constraints[i].radius) {
       vectoradd(constraints[i].part.offset,
-        band_constraints[constraints[i].band_constraint_n].offset);
+        context->band_constraints[constraints[i].band_constraint_n].offset);
       constraints[i].part.offset[2] = 0; // Set Z to zero, just in case.
     }
   }
@@ -1231,9 +1262,8 @@ synth_band(
   //      Perhaps the whole constraint part is crap, or perhaps just the name.
   //***************************************************************************
 
-  fflush(output);
 #ifdef DEBUGGING_FIXED3_BANDS
-  for (i = 0; i < n_constraints; i++) {
+  for (i = 0; i < n_constraints && output->verbose; i++) {
     if (constraints[i].radius) {
       printf("constraint[%d] = (%d, %d, %d)\n", i, 
 	     (int)constraints[i].part.offset[0], 
@@ -1260,7 +1290,8 @@ synth_band(
       for (j = i+1; j < n_constraints; j++) {
         if (constraints[j].radius) {
 #ifdef DEBUGGING_FIXED3_BANDS
-	  printf("calc_tan(%d->%d)\n", i, j);
+	  if (output->verbose)
+	    printf("calc_tan(%d->%d)\n", i, j);
 #endif
           calc_tangent_line(&constraints[i],&constraints[j],output);
           i = j;
@@ -1365,17 +1396,27 @@ synth_band(
     }
   }
 
+  /* every part goes back through the first constraint's gear plane, so
+   * invert it once here rather than for each part */
+
+  plane = &context->band_constraints[constraints[first].band_constraint_n];
+  matrixinv(plane_inv,plane->orient);
+
+  /* and make room for the parts before drawing them */
+
+  output_reserve(output,output->n_parts + count_band_parts(band_type,constraints,n_constraints));
+
   /*****************************************************
    * rotate everything back to whence it came
    * and put all parts back to original absolute
    * coordinates.
    *****************************************************/
 
-  if ( ! ldraw_part) {
-    fprintf(output,"0 SYNTH SYNTHESIZED BEGIN\n");
+  if ( ! output->ldraw_part) {
+    output_comment(output,"0 SYNTH SYNTHESIZED BEGIN\n");
   }
 
-  group_size = 0;
+  output->group_size = 0;
 
   /* now draw out the rubber band in terms of lines and arcs */
   for (i = 0; i < n_constraints; ) {
@@ -1385,6 +1426,7 @@ synth_band(
 
         if (constraints[j].radius) {
           draw_arc_line(
+            context,
             band_type,
             &constraints[i],
             color,
@@ -1393,7 +1435,8 @@ synth_band(
             ghost,
             group,
             &absolute,
-            &constraints[first]);
+            plane->offset,
+            plane_inv);
           i = j;
           break;
         }
@@ -1406,10 +1449,12 @@ synth_band(
     }
   }
   if (group) {
-    fprintf(output,"0 GROUP %d %s\n",group_size,group);
+    char line[512];
+    snprintf(line,sizeof(line),"0 GROUP %d %s\n",output->group_size,group);
+    output_comment(output,line);
   }
-  if ( ! ldraw_part) {
-    fprintf(output,"0 SYNTH SYNTHESIZED END\n");
+  if ( ! output->ldraw_part) {
+    output_comment(output,"0 SYNTH SYNTHESIZED END\n");
   }
   return 0;
 
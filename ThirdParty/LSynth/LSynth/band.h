@@ -9,6 +9,9 @@
 extern "C" {
 #endif
 
+/* Room for where a band's straight runs cross others, plus their ends. */
+#define MAX_CROSSINGS 32
+
 typedef struct {
   part_t    part;
   PRECISION radius;
@@ -17,7 +20,7 @@ typedef struct {
   int       cross;
   PRECISION start_line[3];
   PRECISION end_line[3];
-  PRECISION crossings[8][3];
+  PRECISION crossings[MAX_CROSSINGS][3];
   int       n_crossings;
   int       layer;
 
@@ -46,23 +49,20 @@ typedef struct {
   part_t    end_trans;   // for rubber treads, transition from tangent to arc
 } band_attrib_t;
 
-extern band_attrib_t band_types[];
-extern int n_band_types;
-extern part_t band_constraints[];
-extern int n_band_constraints;
-
-void list_band_types(void);
-void band_ini(       void);
-int isbandtype(      char *type);
-int isbandconstraint(char *type);
+void list_band_types(      lsynth_context_t *context);
+void list_band_constraints(lsynth_context_t *context);
+void band_ini(             lsynth_context_t *context);
+int isbandtype(      lsynth_context_t *context, char *type);
+int isbandconstraint(lsynth_context_t *context, char *type);
 
 int
 synth_band(
+  lsynth_context_t    *context,
   char                *type,
   int                  n_constraints,
   LSL_band_constraint *constraints,
   int                  color,
-  FILE                *output,
+  lsynth_output_t     *output,
   int                  ghost,
   char                *group);
 
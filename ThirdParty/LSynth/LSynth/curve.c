@@ -124,7 +124,23 @@ PRECISION hose_length(
   return length;
 }
 
-PRECISION dotprod(PRECISION a[3], PRECISION b[3]);
+/*
+ * The length of step i along the hose, as hose_length adds it up.  Walking
+ * the hose adding these is the same as calling hose_length at each segment,
+ * but linear rather than quadratic.
+ */
+
+static PRECISION
+step_length(
+  int           i,
+  part_t       *segments)
+{
+  PRECISION l[3];
+
+  vectorsub3(l,segments[i+1].offset,segments[i].offset);
+
+  return vectorlen(l);
+}
 
 void
 orient(
@@ -136,6 +152,7 @@ orient(
   PRECISION start_up[3],end_up[3],up[3];
   PRECISION total_length = hose_length(n_segments,segments);
   PRECISION cur_length;
+  PRECISION run_length = 0;
   int i;
 
   // The up vector of the constraint is along -Z so let's use that instead of +X.
@@ -173,7 +190,10 @@ orient(
     PRECISION front[3];
     PRECISION t[3];
 
-    cur_length = hose_length(i,segments);
+    if (i > 1) {
+      run_length += step_length(i-2,segments);
+    }
+    cur_length = run_length;  // hose_length(i,segments)
 
     cur_length /= total_length;
 
@@ -214,6 +234,27 @@ orient(
   }
 }
 
+/*
+ * One coordinate of the hose's cubic Bezier curve at time t, from p0 leaving
+ * at speed v0 to p1 arriving at speed v1.
+ *
+ * =(1-$A8)^3*D$4 + (1-$A8)^2*3*$A8*(D$4-D$3) +  (1-$A8)*3*$A8^2*(D$5-D$6) + $A8^3*D$5
+ */
+
+static PRECISION
+bezier(
+  PRECISION t,
+  PRECISION p0,
+  PRECISION v0,
+  PRECISION p1,
+  PRECISION v1)
+{
+  return (1 - t) * (1 - t) * (1 - t) * p0 +
+         (1 - t) * (1 - t) * 3 * t * (p0 - v0) +
+         (1 - t) * 3 * t * t * (p1 - v1) +
+               t * t * t * p1;
+}
+
 int
 synth_curve(
   part_t       *start,
@@ -221,16 +262,17 @@ synth_curve(
   part_t       *segments,
   int           n_segments,
   PRECISION     attrib,
-  FILE         *output)
+  lsynth_output_t *output)
 {
   PRECISION vector[3];
   PRECISION start_speed_v[3];
   PRECISION stop_speed_v[3];
-  PRECISION time,time2,i_time,i_time_sum,i_time_sum2,n_time;
-  PRECISION x,x2,y,y2,z,z2;
-  PRECISION ptp,ratio;
+  PRECISION time,i_time,i_time_sum,n_time;
+  PRECISION x,y,z;
+  PRECISION ratio;
   PRECISION ptp_sum;
-  int i,j,n;
+  PRECISION *x_samples,*y_samples,*z_samples,*ptp_v;
+  int i,j;
 
 #if 0
   vector[0] = 0;
@@ -290,121 +332,76 @@ synth_curve(
   }
 #endif
 
+  // Sample the curve evenly in time, one coordinate array at a time, and
+  // measure the distance between neighbouring samples.  Only those distances
+  // are needed; the samples themselves are redone below.
+
+  x_samples = malloc(4*n_segments*sizeof(PRECISION));
+  if (x_samples == NULL) {
+    output->failed = 1;
+    return -1;
+  }
+  y_samples = x_samples + n_segments;
+  z_samples = y_samples + n_segments;
+  ptp_v     = z_samples + n_segments;
+
   for (i = 0; i < n_segments; i++) {
     time  = (PRECISION) i/ (PRECISION) n_segments;
 
-    segments[i].offset[0] =
-      (1 - time) * (1 - time) * (1 - time) * start->offset[0] +
-      (1 - time) * (1 - time) * 3 * time * (start->offset[0] - start_speed_v[0]) +
-      (1 - time) * 3 * time * time * (end->offset[0] - stop_speed_v[0]) +
-            time * time * time * end->offset[0];
-
-    segments[i].offset[1] =
-      (1 - time) * (1 - time) * (1 - time) * start->offset[1] +
-      (1 - time) * (1 - time) * 3 * time * (start->offset[1] - start_speed_v[1]) +
-      (1 - time) * 3 * time * time * (end->offset[1] - stop_speed_v[1]) +
-            time * time * time * end->offset[1];
-/*
-=(1-$A8)^3*D$4 + (1-$A8)^2*3*$A8*(D$4-D$3) +  (1-$A8)*3*$A8^2*(D$5-D$6) + $A8^3*D$5
- */
-    segments[i].offset[2] =
-      (1 - time) * (1 - time) * (1 - time) * start->offset[2] +
-      (1 - time) * (1 - time) * 3 * time * (start->offset[2] - start_speed_v[2]) +
-      (1 - time) * 3 * time * time * (end->offset[2] - stop_speed_v[2]) +
-            time * time * time * end->offset[2];
+    x_samples[i] = bezier(time,start->offset[0],start_speed_v[0],end->offset[0],stop_speed_v[0]);
+    y_samples[i] = bezier(time,start->offset[1],start_speed_v[1],end->offset[1],stop_speed_v[1]);
+    z_samples[i] = bezier(time,start->offset[2],start_speed_v[2],end->offset[2],stop_speed_v[2]);
   }
 
   ptp_sum = 0;
 
   for (i = 0; i < n_segments - 1; i++) {
-    x = segments[i + 1].offset[0] - segments[i].offset[0];
-    y = segments[i + 1].offset[1] - segments[i].offset[1];
-    z = segments[i + 1].offset[2] - segments[i].offset[2];
+    x = x_samples[i + 1] - x_samples[i];
+    y = y_samples[i + 1] - y_samples[i];
+    z = z_samples[i + 1] - z_samples[i];
 
-    ptp = sqrtf(x*x + y*y + z*z);
-    ptp_sum += ptp;
+    ptp_v[i] = sqrtf(x*x + y*y + z*z);
+  }
+  for (i = 0; i < n_segments - 1; i++) {
+    ptp_sum += ptp_v[i];
   }
 
   /* G8 */
 
   i_time_sum = 0;
   for (i = 0; i < n_segments - 1; i++) {
-    time  = (PRECISION) (i+1)/ (PRECISION) n_segments;
-
-    x = segments[i + 1].offset[0] - segments[i].offset[0];
-    y = segments[i + 1].offset[1] - segments[i].offset[1];
-    z = segments[i + 1].offset[2] - segments[i].offset[2];
-
-    ptp = sqrtf(x*x + y*y + z*z);
-
-    ratio = ptp*n_segments/ptp_sum;
+    ratio = ptp_v[i]*n_segments/ptp_sum;     /* F */
     if (ratio == 0) {
       ratio = 1e-20f;
     }
+    ptp_v[i] = ratio;  // from here on, the ratios
     i_time = 1.0f/(n_segments*ratio);
     i_time_sum += i_time;
   }
 
   /* H, I, J */
   n_time = 0;
-  i_time_sum2 = 0;
   for (i = 0; i < n_segments - 1; i++) {
     PRECISION foo;
 
-    x = segments[i + 1].offset[0] - segments[i].offset[0];
-    y = segments[i + 1].offset[1] - segments[i].offset[1];
-    z = segments[i + 1].offset[2] - segments[i].offset[2];
-
-    ptp = sqrtf(x * x + y * y + z * z);  /* E */
-    ratio = ptp*n_segments/ptp_sum;     /* F */
-    if (ratio == 0) {
-      ratio = 1e-20f;
-    }
-    i_time = 1.0f/(n_segments*ratio);    /* G */
-    i_time_sum2 += i_time;
-
     foo = 1.0f/n_segments;
-    foo /= ratio;
+    foo /= ptp_v[i];
     foo /= i_time_sum;
 
-    segments[i].offset[0] =
-      (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[0] +
-      (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[0] - start_speed_v[0]) +
-      (1 - n_time) * 3 * n_time * n_time * (end->offset[0] - stop_speed_v[0]) +
-       n_time * n_time * n_time * end->offset[0];
-
-    segments[i].offset[1] =
-      (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[1] +
-      (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[1] - start_speed_v[1]) +
-      (1 - n_time) * 3 * n_time * n_time * (end->offset[1] - stop_speed_v[1]) +
-       n_time * n_time * n_time * end->offset[1];
-
-    segments[i].offset[2] =
-      (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[2] +
-      (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[2] - start_speed_v[2]) +
-      (1 - n_time) * 3 * n_time * n_time * (end->offset[2] - stop_speed_v[2]) +
-       n_time * n_time * n_time * end->offset[2];
+    for (j = 0; j < 3; j++) {
+      segments[i].offset[j] =
+        bezier(n_time,start->offset[j],start_speed_v[j],end->offset[j],stop_speed_v[j]);
+    }
 
     n_time += foo;  /* H */
   }
 
-  segments[i].offset[0] =
-    (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[0] +
-    (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[0] - start_speed_v[0]) +
-    (1 - n_time) * 3 * n_time * n_time * (end->offset[0] - stop_speed_v[0]) +
-     n_time * n_time * n_time * end->offset[0];
-
-  segments[i].offset[1] =
-    (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[1] +
-    (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[1] - start_speed_v[1]) +
-    (1 - n_time) * 3 * n_time * n_time * (end->offset[1] - stop_speed_v[1]) +
-     n_time * n_time * n_time * end->offset[1];
+  for (j = 0; j < 3; j++) {
+    segments[i].offset[j] =
+      bezier(n_time,start->offset[j],start_speed_v[j],end->offset[j],stop_speed_v[j]);
+  }
 
-  segments[i].offset[2] =
-    (1 - n_time) * (1 - n_time) * (1 - n_time) * start->offset[2] +
-    (1 - n_time) * (1 - n_time) * 3 * n_time * (start->offset[2] - start_speed_v[2]) +
-    (1 - n_time) * 3 * n_time * n_time * (end->offset[2] - stop_speed_v[2]) +
-     n_time * n_time * n_time * end->offset[2];
+  free(x_samples);
 
   // orient(n_segments, segments);
 
@@ -445,23 +442,6 @@ int normalizequat(PRECISION q[4])
   return 1;
 }
 
-/***************************************************************/
-int normalize(PRECISION v[3])
-{
-  PRECISION L;
-
-  L = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
-
-  if (L == 0.0)
-    return 0;  // Uh Oh, the magnitude is zero.
-
-  v[0] /= L;
-  v[1] /= L;
-  v[2] /= L;
-
-  return 1;
-}
-
 /***************************************************************/
 /* returns det(m), m is 3x3 (3x4) matrix */
 /***************************************************************/
@@ -611,12 +591,6 @@ PRECISION quat2axisangle(
   return *a;
 }
 
-//**********************************************************************
-PRECISION dotprod(PRECISION a[3], PRECISION b[3])
-{
-   return (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
-}
-
 //**********************************************************************
 // Calculate the the turn matrix M, turn axis T, and return the turn angle r.
 // In case of emergency preload M and T with reasonable defaults.
@@ -706,19 +680,18 @@ orientq(
 {
   PRECISION start_up[3],end_up[3],up[3];
   PRECISION start_v[3],end_v[3],v[3];
-  PRECISION start_q[4],end_q[4],q[4];
   PRECISION m[3][3];
   PRECISION total_length = hose_length(n_segments,segments);
   PRECISION cur_length;
+  PRECISION run_length;
   PRECISION r, a;
-  PRECISION front[3];
   PRECISION t[3];
   int i;
 
-//#ifdef DEBUG_QUAT_MATH
+#ifdef DEBUG_QUAT_MATH
   PRECISION pi = 2*atan2f(1,0);
   PRECISION degrees = 180.0f / pi;
-//#endif      
+#endif      
 
 #if 0
   // Use simple linear up vector interpolation for 2 segs or less.
@@ -963,12 +936,17 @@ orientq(
   // Probably ought to draw a pretty picture to be absolutely sure.
   //*****************************************************************
   total_length = hose_length(n_segments-1,segments);
+  run_length = 0;
   for (i = 1; i < n_segments; i++) {
 
+    if (i > 1) {
+      run_length += step_length(i-2,segments);
+    }
+
     // Interpolate the twist (if there is any) over the length of segment.
     if ((r != 0.0) && (total_length != 0))
     {
-      cur_length = hose_length(i,segments);
+      cur_length = run_length;  // hose_length(i,segments)
       cur_length /= total_length;
       a = r * cur_length;
 
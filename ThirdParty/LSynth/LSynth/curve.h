@@ -16,7 +16,7 @@ synth_curve(
   part_t   *segments,
   int       n_segments,
   PRECISION attrib,
-  FILE     *output);
+  lsynth_output_t *output);
 
 PRECISION
 hose_length(
@@ -5,8 +5,7 @@
 
 #include <math.h>
 
-#include "lsynthcp.h"
-#include "hose.h"
+#include "lsynth.h"
 #include "curve.h"
 #include "mathlib.h"
 
@@ -17,12 +16,11 @@
  * 1 <length> a b c  d e f  g h i  j k l <part>
  * 1 <length> a b c  d e f  g h i  j k l <part>
  * 0 SYNTH END
+ *
+ * The hose types are kept in the context, see lsynth.h.
  */
 
-int           n_hose_types = 0;
-hose_attrib_t   hose_types[64];
-
-#define N_HOSE_TYPES n_hose_types
+#define N_HOSE_TYPES context->n_hose_types
 
 /* In hoses, the attrib field in constraints, indicates that
  * LSynth should turn the final constraint around to get everything
@@ -36,50 +34,47 @@ hose_attrib_t   hose_types[64];
  * 0 SYNTH END
  */
 
-int    n_hose_constraints = 0;
-part_t   hose_constraints[128];
-
-#define N_HOSE_CONSTRAINTS n_hose_constraints
+#define N_HOSE_CONSTRAINTS context->n_hose_constraints
 
 void
-list_hose_types(void)
+list_hose_types(lsynth_context_t *context)
 {
     int i;
     
     printf("\n\nHose like synthesizable parts\n");
     for (i = 0; i < N_HOSE_TYPES; i++) {
-        printf("  %-20s %s\n",hose_types[i].type, hose_types[i].descr);
+        printf("  %-20s %s\n",context->hose_types[i].type, context->hose_types[i].descr);
     }
 }
 
 void
-list_hose_constraints(void)
+list_hose_constraints(lsynth_context_t *context)
 {
     int i;
     
     printf("\n\nHose constraints\n");
     for (i = 0; i < N_HOSE_CONSTRAINTS; i++) {
-        printf("    %11s\n",hose_constraints[i].type);
+        printf("    %11s\n",context->hose_constraints[i].type);
     }
 }
 
 void
-hose_ini(void)
+hose_ini(lsynth_context_t *context)
 {
     int i;
     
     for (i = 0; i < N_HOSE_TYPES; i++) {
-        printf("%-20s = SYNTH BEGIN %s 16\n",hose_types[i].type, hose_types[i].type);
+        printf("%-20s = SYNTH BEGIN %s 16\n",context->hose_types[i].type, context->hose_types[i].type);
     }
 }
 
 int
-ishosetype(char *type)
+ishosetype(lsynth_context_t *context, char *type)
 {
     int i;
     
     for (i = 0; i < N_HOSE_TYPES; i++) {
-        if (strncasecmp(hose_types[i].type,type,strlen(hose_types[i].type)) == 0) {
+        if (strncasecmp(context->hose_types[i].type,type,strlen(context->hose_types[i].type)) == 0) {
             return 1;
         }
     }
@@ -87,12 +82,12 @@ ishosetype(char *type)
 }
 // casecmp
 int
-ishoseconstraint(char *type)
+ishoseconstraint(lsynth_context_t *context, char *type)
 {
     int i;
     
     for (i = 0; i < N_HOSE_CONSTRAINTS;i++) {
-        if (strcasecmp(hose_constraints[i].type,type) == 0) {
+        if (strcasecmp(context->hose_constraints[i].type,type) == 0) {
             return 1;
         }
     }
@@ -123,6 +118,35 @@ line_angle(
     return theta;
 }
 
+/*
+ * line_angle, for lines whose lengths are already known.
+ */
+
+static PRECISION
+step_angle(
+           PRECISION va[3],
+           PRECISION la,
+           PRECISION vb[3],
+           PRECISION lb)
+{
+    PRECISION denom;
+    PRECISION theta;
+    
+    denom = la*lb;
+    
+    if (fabs(denom) < 1e-9) {
+        return 0;
+    }
+    
+    theta = (va[0]*vb[0]+va[1]*vb[1]+va[2]*vb[2])/denom;
+    if (theta >= 1 || theta <= -1) {
+        theta = 0;
+    } else {
+        theta = acosf(theta);
+    }
+    return theta;
+}
+
 PRECISION
 line_angle3(
             int a,
@@ -131,8 +155,6 @@ line_angle3(
 {
     PRECISION va[3]; /* line A */
     PRECISION vb[3]; /* line B */
-    PRECISION denom;
-    PRECISION theta;
     
     /* we get the line A as point[a] to point[a+1] */
     /* and line B as point[b] to point[b+1] */
@@ -156,7 +178,7 @@ merge_segments_angular(
                        int       *n_segments,
                        PRECISION  max_bend,
                        PRECISION  max_twist,
-                       FILE      *output)
+                       lsynth_output_t *output)
 {
     int a,b;
     int n;
@@ -167,11 +189,33 @@ merge_segments_angular(
     PRECISION cur_up[3]   = { 1, 0, 0 };
     PRECISION next_up[3];
     PRECISION len[3], sub_len;
+    PRECISION (*step)[3];
+    PRECISION *step_len;
+    int i;
+    
+    // Work out each step along the oversampled curve, and its length, once.
+    // (The last step runs to the spare point past the end.)  Merging only
+    // ever writes below a, so the steps still hold as segments are merged.
+    step = malloc(*n_segments*sizeof(step[0]));
+    step_len = malloc(*n_segments*sizeof(PRECISION));
+    if (step == NULL || step_len == NULL) {
+        free(step);
+        free(step_len);
+        output->failed = 1;
+        return -1;
+    }
+    total_length = 0;
+    for (i = 0; i < *n_segments; i++) {
+        vectorsub3(step[i],segments[i+1].offset,segments[i].offset);
+        step_len[i] = vectorlen(step[i]);
+        if (i < *n_segments - 1) {
+            total_length += step_len[i];
+        }
+    }
     
     vectorrot(start_up,start->orient);
     vectorrot(cur_up,  start->orient);
     vectorrot(end_up,  end->orient);
-    total_length = hose_length(*n_segments, segments);
     cur_length = 0;
     
     a = 0; b = 1;
@@ -186,11 +230,10 @@ merge_segments_angular(
     } while (sub_len < 1e-9);
     
     while (b < *n_segments) {
-        PRECISION len[3],normalized;
+        PRECISION normalized;
         
         if (b < *n_segments - 1) {
-            vectorsub3(len,segments[b+1].offset,segments[b].offset);
-            cur_length += vectorlen(len);
+            cur_length += step_len[b];
         } else {
             cur_length += (total_length - cur_length)/2;
         }
@@ -214,7 +257,7 @@ merge_segments_angular(
             next_up[2] /= normalized;
             
             theta2 = line_angle(cur_up,next_up);
-            theta1 = line_angle3(a,b,segments);
+            theta1 = step_angle(step[a],step_len[a],step[b],step_len[b]);
             
             if (theta1 < max_bend && theta2 < max_twist) {
                 b++;
@@ -239,6 +282,8 @@ merge_segments_angular(
         n--;
     }
     *n_segments = n;
+    free(step);
+    free(step_len);
     return 0;
 }
 
@@ -247,7 +292,7 @@ merge_segments_length(
                       part_t    *segments,
                       int       *n_segments,
                       PRECISION  max,
-                      FILE      *output)
+                      lsynth_output_t *output)
 {
     int a,b;
     int n;
@@ -289,7 +334,7 @@ merge_segments_count(
                      part_t    *segments,
                      int       *n_segments,
                      int       count,
-                     FILE      *output)
+                     lsynth_output_t *output)
 {
     int n, i;
     PRECISION d[3],l;
@@ -301,7 +346,8 @@ merge_segments_count(
         vectorsub3(d,segments[i].offset,segments[i+1].offset);
         len += vectorlen(d);
     }
-    printf("Total segment len = %.3f\n", len);
+    if (output->verbose)
+        printf("Total segment len = %.3f\n", len);
     
     // If S or E do not match the N parts subtract their lengths from total.
     if ((strcasecmp(hose->start.type, hose->mid.type) != 0) ||
@@ -313,7 +359,8 @@ merge_segments_count(
         lenE = hose->end.attrib;
         lenM = hose->mid.attrib;
         len = len - (lenS + lenE);
-        printf("Net segment len = %.3f (S=%f, M=%f, E= %f)\n", len, lenS, lenM, lenE);
+        if (output->verbose)
+            printf("Net segment len = %.3f (S=%f, M=%f, E= %f)\n", len, lenS, lenM, lenE);
         len = len / (PRECISION)(count-1); //len /= (count);
     }
     else
@@ -321,7 +368,8 @@ merge_segments_count(
         len = len / (PRECISION)(count-1); //len /= (count);
         lenS = lenE = len;
     }
-    printf("Merging %d segments to %d segments of len %.3f\n", *n_segments, count, len);
+    if (output->verbose)
+        printf("Merging %d segments to %d segments of len %.3f\n", *n_segments, count, len);
     
     // Break up the curve into count intervals of length len.
     l = 0;
@@ -359,8 +407,6 @@ merge_segments_count(
     
     if (0) // Debug printouts
     {
-        extern PRECISION dotprod(PRECISION a[3], PRECISION b[3]); // from curve.c
-        
         PRECISION last, next;
         PRECISION dn[3],dp;
         PRECISION m2[3][3];
@@ -378,7 +424,8 @@ merge_segments_count(
         printf("  last=%g, next=%g, dp=%g\n", last, next, dp);
     }
     
-    printf("Produced %d points (%d segments)\n", *n_segments, *n_segments-1);
+    if (output->verbose)
+        printf("Produced %d points (%d segments)\n", *n_segments, *n_segments-1);
     
     // Reorient the segments.
     // Warning!  Can interact badly with twist if hose makes a dx/dz (dy=0) turn.
@@ -388,43 +435,226 @@ merge_segments_count(
     return 0;
 }
 
-#define MAX_SEGMENTS 1024*8
+/*
+ * The fewest points we sample along a span, however the samples are shared
+ * out, so that long hoses keep their shape.
+ */
+
+#define MIN_SPAN_SAMPLES 256
+
+/*
+ * Span cache.
+ *
+ * A STRETCH or FIXED hose is made one span (pair of constraints) at a time,
+ * and all the work of a span - sampling its curve, merging the samples down
+ * and orienting them - depends only on the span's two (adjusted) ends.  So
+ * we remember each span's oriented segments, keyed by its ends, and the
+ * next synthesis of the same hose only redoes the spans whose ends moved.
+ *
+ * Rendering the segments into parts is cheap and is always redone, which
+ * also carries the running twist through the reused spans.
+ *
+ * N FIXED hoses are shared out along the whole hose, so they aren't cached.
+ */
+
+typedef struct {
+  PRECISION first_orient[3][3];
+  PRECISION first_offset[3];
+  PRECISION second_orient[3][3];
+  PRECISION second_offset[3];
+  int       n_samples;
+  int       last;
+} span_key_t;
+
+typedef struct {
+  unsigned   hash;
+  int        used;          /* by the synthesis in progress */
+  span_key_t key;
+  PRECISION  next[3];       /* where the next span starts */
+  part_t    *segments;
+  int        n_segments;
+} span_t;
+
+struct lsynth_cache {
+  hose_attrib_t hose;       /* what the spans were made with */
+  PRECISION     bend_res;
+  PRECISION     twist_res;
+  span_t       *spans;
+  int           n_spans;
+  int           max_spans;
+};
 
-part_t segments[MAX_SEGMENTS];
+lsynth_cache_t *
+lsynth_cache_create(void)
+{
+  return calloc(1,sizeof(lsynth_cache_t));
+}
+
+static void
+span_cache_clear(lsynth_cache_t *cache)
+{
+  int i;
 
-// Create a second list to combine all patches between constraints.
-part_t seglist[MAX_SEGMENTS];
+  for (i = 0; i < cache->n_spans; i++) {
+    free(cache->spans[i].segments);
+  }
+  cache->n_spans = 0;
+}
 
 void
-output_line(
-            FILE           *output,
-            int             ghost,
-            char           *group,
-            int             color,
-            PRECISION       a,
-            PRECISION       b,
-            PRECISION       c,
-            PRECISION       d,
-            PRECISION       e,
-            PRECISION       f,
-            PRECISION       g,
-            PRECISION       h,
-            PRECISION       i,
-            PRECISION       j,
-            PRECISION       k,
-            PRECISION       l,
-            char            *type)
+lsynth_cache_free(lsynth_cache_t *cache)
 {
-    if (group) {
-        fprintf(output,"0 MLCAD BTG %s\n",group);
-    }
-    fprintf(output,"%s1 %d %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %s\n",
-            ghost ? "0 GHOST " : "",
-            color,
-            a,b,c,d,e,f,g,h,i,j,k,l,
-            type);
-    group_size++;
-    fflush(stdout);
+  if (cache) {
+    span_cache_clear(cache);
+    free(cache->spans);
+    free(cache);
+  }
+}
+
+/*
+ * Throw everything away if the hose isn't made the same way as last time,
+ * and start counting which spans are used.
+ */
+
+static void
+span_cache_begin(
+  lsynth_cache_t *cache,
+  hose_attrib_t  *hose,
+  PRECISION       bend_res,
+  PRECISION       twist_res)
+{
+  int i;
+
+  if (memcmp(&cache->hose,hose,sizeof(hose_attrib_t)) != 0 ||
+      cache->bend_res != bend_res ||
+      cache->twist_res != twist_res) {
+    span_cache_clear(cache);
+    cache->hose      = *hose;
+    cache->bend_res  = bend_res;
+    cache->twist_res = twist_res;
+  }
+  for (i = 0; i < cache->n_spans; i++) {
+    cache->spans[i].used = 0;
+  }
+}
+
+/*
+ * Forget the spans the hose no longer has.
+ */
+
+static void
+span_cache_end(lsynth_cache_t *cache)
+{
+  int i, n = 0;
+
+  for (i = 0; i < cache->n_spans; i++) {
+    if (cache->spans[i].used) {
+      cache->spans[n++] = cache->spans[i];
+    } else {
+      free(cache->spans[i].segments);
+    }
+  }
+  cache->n_spans = n;
+}
+
+static void
+span_key(
+  span_key_t *key,
+  part_t     *first,
+  part_t     *second,
+  int         n_samples,
+  int         last)
+{
+  memset(key,0,sizeof(span_key_t));
+  matrixcp(key->first_orient,first->orient);
+  vectorcp(key->first_offset,first->offset);
+  matrixcp(key->second_orient,second->orient);
+  vectorcp(key->second_offset,second->offset);
+  key->n_samples = n_samples;
+  key->last      = last;
+}
+
+static unsigned
+span_hash(span_key_t *key)
+{
+  unsigned char *bytes = (unsigned char *) key;
+  unsigned       hash = 2166136261u;
+  size_t         i;
+
+  for (i = 0; i < sizeof(span_key_t); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Copies a remembered span into segments.  Returns 1 if we had it.
+ */
+
+static int
+span_cache_find(
+  lsynth_cache_t *cache,
+  span_key_t     *key,
+  part_t         *segments,
+  int            *n_segments,
+  PRECISION       next[3])
+{
+  unsigned hash = span_hash(key);
+  int      i;
+
+  for (i = 0; i < cache->n_spans; i++) {
+    span_t *span = &cache->spans[i];
+
+    if (span->hash == hash && memcmp(&span->key,key,sizeof(span_key_t)) == 0) {
+      memcpy(segments,span->segments,(span->n_segments+1)*sizeof(part_t));
+      *n_segments = span->n_segments;
+      vectorcp(next,span->next);
+      span->used = 1;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Remembers a span.  If we're out of memory we just don't.
+ */
+
+static void
+span_cache_add(
+  lsynth_cache_t *cache,
+  span_key_t     *key,
+  part_t         *segments,
+  int             n_segments,
+  PRECISION       next[3])
+{
+  span_t *span;
+  part_t *copy;
+
+  if (cache->n_spans == cache->max_spans) {
+    int     max   = cache->max_spans ? cache->max_spans * 2 : 16;
+    span_t *spans = realloc(cache->spans,max*sizeof(span_t));
+
+    if (spans == NULL) {
+      return;
+    }
+    cache->spans     = spans;
+    cache->max_spans = max;
+  }
+  /* keep the spare point too: rendering a STRETCH hose looks one past the end */
+  copy = malloc((n_segments+1)*sizeof(part_t));
+  if (copy == NULL) {
+    return;
+  }
+  memcpy(copy,segments,(n_segments+1)*sizeof(part_t));
+
+  span = &cache->spans[cache->n_spans++];
+  span->hash       = span_hash(key);
+  span->used       = 1;
+  span->key        = *key;
+  vectorcp(span->next,next);
+  span->segments   = copy;
+  span->n_segments = n_segments;
 }
 
 /*
@@ -451,10 +681,10 @@ render_hose_segment(
                     PRECISION      *total_twist,
                     int             first,
                     int             last,
-                    FILE           *output,
+                    lsynth_output_t *output,
                     part_t         *constraint)
 {
-    int i,j,k;
+    int i;
     PRECISION pi = 2*atan2f(1,0);
     PRECISION m1[3][3];
     PRECISION m2[3][3];
@@ -463,7 +693,7 @@ render_hose_segment(
     int       gs = *group_size;
     
     for (i = 0; i <  n_segments-1; i++) {
-        PRECISION tx,ty,tz,l,theta;
+        PRECISION l;
         
         if (hose->fill != STRETCH) {
             l = 1;
@@ -518,7 +748,7 @@ render_hose_segment(
             else // Stretch it.
                 matrixmult3(m2,hose->end.orient,m1);
         } else if ((i & 0x01) && (strlen(hose->alt.type) != 0)) {
-            if (i == 1) printf("ALT = %s\n", hose->alt.type);
+            if (i == 1 && output->verbose) printf("ALT = %s\n", hose->alt.type);
             type = hose->alt.type;
             vectorcp(offset,hose->alt.offset);
             matrixmult3(m2,hose->alt.orient,m1);
@@ -604,6 +834,7 @@ render_hose_segment(
 
 void
 adjust_constraint(
+                  lsynth_context_t *context,
                   part_t *part,
                   part_t *orig,
                   int     last)
@@ -614,18 +845,18 @@ adjust_constraint(
     *part = *orig;
     
     for (i = 0; i < N_HOSE_CONSTRAINTS; i++) {
-        if (strcasecmp(part->type,hose_constraints[i].type) == 0) {
+        if (strcasecmp(part->type,context->hose_constraints[i].type) == 0) {
             
             // adjust the constraints offset via hose_constraint
-            vectorcp(part->offset,hose_constraints[i].offset);
-            vectorrot(part->offset,hose_constraints[i].orient);
+            vectorcp(part->offset,context->hose_constraints[i].offset);
+            vectorrot(part->offset,context->hose_constraints[i].orient);
             vectoradd(part->offset,orig->offset);
             
             // compensate part orient via hose_constraint
-            matrixcp(part->orient,hose_constraints[i].orient);
+            matrixcp(part->orient,context->hose_constraints[i].orient);
             matrixmult(part->orient,orig->orient);
             
-            if (hose_constraints[i].attrib && last) {
+            if (context->hose_constraints[i].attrib && last) {
                 matrixcp(m,part->orient);
                 matrixneg(part->orient,m);
             }
@@ -646,6 +877,7 @@ adjust_constraint(
 
 void
 render_hose(
+            lsynth_context_t *context,
             hose_attrib_t  *hose,
             int             n_constraints,
             part_t         *constraints,
@@ -655,19 +887,55 @@ render_hose(
             char           *group,
             int             group_size,
             int             color,
-            FILE *output)
+            lsynth_output_t *output)
 {
     int       c, n_segments;
     part_t    mid_constraint;
     PRECISION total_twist = 0;
+    part_t   *segments;
+    part_t   *seglist = NULL;
+    int       samples = output->hose_samples;
+    lsynth_cache_t *cache = NULL;
     
-    if ( ! ldraw_part) {
-        fprintf(output,"0 SYNTH SYNTHESIZED BEGIN\n");
+    // For N FIXED segments the spans between constraints are sampled into
+    // one list, and the samples are shared out between them.
+    if (hose->fill > FIXED && n_constraints > 2) {
+        // We could do better by considering the actual length of each chunk...
+        samples /= n_constraints - 1;
+    }
+    if (samples < MIN_SPAN_SAMPLES) {
+        samples = MIN_SPAN_SAMPLES;
+    }
+    
+    // Each hose gets its own curve buffers, so hoses can be synthesized at
+    // the same time.  They are far too big for a thread's stack.
+    // One spare: merge_segments_angular looks one point past the end of the curve.
+    segments = calloc(samples+1,sizeof(part_t));
+    
+    // Create a second list to combine all patches between constraints.
+    if (hose->fill > FIXED) {
+        seglist = malloc((samples*(n_constraints-1)+1)*sizeof(part_t));
+    }
+    
+    if (segments == NULL || (hose->fill > FIXED && seglist == NULL)) {
+        free(segments);
+        free(seglist);
+        output->failed = 1;
+        return;
+    }
+    
+    if ( ! output->ldraw_part) {
+        output_comment(output,"0 SYNTH SYNTHESIZED BEGIN\n");
+    }
+    
+    if (output->cache && (hose->fill == STRETCH || hose->fill == FIXED)) {
+        cache = output->cache;
+        span_cache_begin(cache,hose,bend_res,twist_res);
     }
     
     // First and Last parts for STRETCH hose could be FIXED length.
     // Add up to two new constraints to handle this.  They're not used afterwards.
-    // Just don't go over 128 constraints.
+    // The caller leaves room for them.
     if (hose->fill == STRETCH) {
         PRECISION offset[3];
         PRECISION l;
@@ -705,24 +973,29 @@ render_hose(
     
     for (c = 0; c < n_constraints - 1; c++) {
         part_t first,second;
+        span_key_t key;
         
         // reorient imperfectly oriented or displaced constraint types
         
-        adjust_constraint(&first,&mid_constraint,0);
+        adjust_constraint(context,&first,&mid_constraint,0);
         
         // reorient imperflectly oriented or displaced constraint types
         
-        adjust_constraint(&second, &constraints[c+1],c == n_constraints-2);
+        adjust_constraint(context,&second, &constraints[c+1],c == n_constraints-2);
+        
+        n_segments = samples;
         
-        n_segments = MAX_SEGMENTS;
+        // reuse the span if its ends haven't moved since last time
         
-        // For N FIXED segments break up segments[MAX_SEGMENTS] into chunks.
-        if (hose->fill > FIXED)
-        {
-            // Break up seglist into fixed size chunks based on number of constraints.
-            // We could do better by considering the actual length of each chunk...
-            n_segments = MAX_SEGMENTS / (n_constraints - 1);
-            //if (c == 0) printf("FIXED%d, N_constraints = %d, chunksize = %d\n", hose->fill, n_constraints, n_segments);
+        if (cache) {
+            PRECISION next[3];
+            
+            span_key(&key,&first,&second,n_segments,c == n_constraints-2);
+            if (span_cache_find(cache,&key,segments,&n_segments,next)) {
+                mid_constraint = constraints[c+1];
+                vectorcp(mid_constraint.offset,next);
+                goto render;
+            }
         }
         
         // create an oversampled curve
@@ -796,6 +1069,11 @@ render_hose(
             memcpy(seglist+(n_segments*c), segments, n_segments*sizeof(part_t));
         }
         
+        if (cache) {
+            span_cache_add(cache,&key,segments,n_segments,mid_constraint.offset);
+        }
+        
+    render:
         // output the result (if not FIXED number of segments)
         if (hose->fill <= FIXED)
             render_hose_segment(
@@ -813,19 +1091,19 @@ render_hose(
     }
     
     // output the result (if FIXED number of segments)
-    if (hose->fill > FIXED) {
+    if (hose->fill > FIXED && c > 0) {
         part_t first,second;
         
         // Reorient imperfectly oriented or displaced constraint types.
         // NOTE: I really need to study the new orient code and see why it 
         // does not seem to work until after merge_segment_count() below.
         // It needs to orient based on ALL constraints, not just first and last.
-        adjust_constraint(&first,&constraints[0],0);
-        adjust_constraint(&second, &constraints[n_constraints-1],1);
+        adjust_constraint(context,&first,&constraints[0],0);
+        adjust_constraint(context,&second, &constraints[n_constraints-1],1);
         
         n_segments *= c;
         // Make sure final segment matches second constraint
-        vectorcp(segments[n_segments-1].offset,second.offset);
+        vectorcp(seglist[n_segments-1].offset,second.offset);
         merge_segments_count(hose,&first,&second,seglist,&n_segments,hose->fill,output);
         //printf("Merged segments to %d segments of len %d\n", n_segments, hose->mid.attrib);
         //orient(&first,&second,n_segments,seglist);
@@ -848,16 +1126,26 @@ render_hose(
     }
     
     if (group) {
-        fprintf(output,"0 GROUP %d %s\n",group_size,group);
+        char line[512];
+        snprintf(line,sizeof(line),"0 GROUP %d %s\n",group_size,group);
+        output_comment(output,line);
     }
     
-    if ( ! ldraw_part) {
-        fprintf(output,"0 SYNTH SYNTHESIZED END\n");
+    if ( ! output->ldraw_part) {
+        output_comment(output,"0 SYNTH SYNTHESIZED END\n");
     }
+    
+    if (cache) {
+        span_cache_end(cache);
+    }
+    
+    free(segments);
+    free(seglist);
 }
 
 int
 synth_hose(
+           lsynth_context_t *context,
            char   *type,
            int     n_constraints,
            part_t *constraints,
@@ -865,17 +1153,18 @@ synth_hose(
            char   *group,
            int     group_size,
            int     color,
-           FILE   *output)
+           lsynth_output_t *output)
 {
     int i;
     
     for (i = 0; i < N_HOSE_TYPES; i++) {
-        if (strcasecmp(hose_types[i].type,type) == 0) {
+        if (strcasecmp(context->hose_types[i].type,type) == 0) {
             render_hose(
-                        &hose_types[i],
+                        context,
+                        &context->hose_types[i],
                         n_constraints,constraints,
-                        max_bend,
-                        max_twist,
+                        output->max_bend,
+                        output->max_twist,
                         ghost,
                         group,
                         group_size,
@@ -22,27 +22,23 @@ typedef struct {
   part_t    alt;          // LDraw part alternate for mid of hose
 } hose_attrib_t;
 
-extern hose_attrib_t hose_types[];
-extern int n_hose_types;
-extern part_t hose_constraints[];
-extern int n_hose_constraints;
-
-void list_hose_types(      void);
-void list_hose_constraints(void);
-void hose_ini(             void);
-int ishosetype(      char *type);
-int ishoseconstraint(char *type);
+void list_hose_types(      lsynth_context_t *context);
+void list_hose_constraints(lsynth_context_t *context);
+void hose_ini(             lsynth_context_t *context);
+int ishosetype(      lsynth_context_t *context, char *type);
+int ishoseconstraint(lsynth_context_t *context, char *type);
 
 int
 synth_hose(
-  char   *type,
-  int     n_constraints,
-  part_t *constraints,
-  int     ghost,
-  char   *group,
-  int     group_size,
-  int     color,
-  FILE   *output);
+  lsynth_context_t *context,
+  char             *type,
+  int               n_constraints,
+  part_t           *constraints,
+  int               ghost,
+  char             *group,
+  int               group_size,
+  int               color,
+  lsynth_output_t  *output);
 #ifdef _cplusplus
 };
 #endif
@@ -0,0 +1,845 @@
+/*
+ * This is the LDRAW parts synthesis library.
+ *
+ * This file holds what lsynthcp and programs linking the library share:
+ * reading lsynth.mpd into a context, writing out synthesized parts, and
+ * the lsynth_synthesize entry point.  See lsynth.h.
+ */
+
+#include "lsynth.h"
+
+/* Fail on definitions the context has no room for, rather than overrun it. */
+#define TABLE_FULL(table,n) ((n) >= (int)(sizeof(table)/sizeof((table)[0])))
+
+//---------------------------------------------------------------------------
+/* If this code works, it was written by Lars C. Hassing. */
+/* If not, I don't know who wrote it.                     */
+
+/* Like fgets, except that 1) any line ending is accepted (\n (unix),
+ \r\n (DOS/Windows), \r (Mac (OS9)) and 2) Str is ALWAYS zero terminated
+ (even if no line ending was found) */
+//---------------------------------------------------------------------------
+char *L3fgets(char *Str, int n, FILE *fp)
+{
+    register int   c;
+    int            nextc;
+    register char *s = Str;
+    
+    while (--n > 0)
+    {
+        if ((c = getc(fp)) == EOF)
+            break;
+        if (c == '\032')
+            continue;              /* Skip CTRL+Z                               */
+        if (c == '\r' || c == '\n')
+        {
+            *s++ = '\n';
+            /* We got CR or LF, eat next character if LF or CR respectively */
+            if ((nextc = getc(fp)) == EOF)
+                break;
+            if (nextc == c || (nextc != '\r' && nextc != '\n'))
+                ungetc(nextc, fp);  /* CR-CR or LF-LF or ordinary character      */
+            break;
+        }
+        *s++ = c;
+    }
+    *s = 0;
+    
+    /* if (ferror(fp)) return NULL; if (s == Str) return NULL; */
+    if (s == Str)
+        return NULL;
+    
+    return Str;
+}
+
+//---------------------------------------------------------------------------
+
+char *
+fgetline(
+         char *line,
+         int   len,
+         FILE *file)
+{
+    char *rc;
+    while ((rc = L3fgets(line,len,file))) {
+        char *nonwhite;
+        
+        nonwhite = line + strspn(line," \t");
+        
+        if (strncasecmp(nonwhite,"0 ROTATION C",strlen("0 ROTATION C")) == 0 ||
+            strncasecmp(nonwhite,"0 COLOR",strlen("0 COLOR")) == 0) {
+            continue;
+        }
+        
+        nonwhite = line + strspn(line," \t");
+        if (strncasecmp(nonwhite,"0 WRITE ",strlen("0 WRITE ")) == 0) {
+            strcpy(nonwhite + 2, nonwhite + strlen("0 WRITE "));
+        }
+        break;
+    }
+    return rc;
+}
+
+void
+strclean(char *str)
+{
+    if (strncasecmp(str,"0 WRITE ",strlen("0 WRITE ")) == 0) {
+        strcpy(str + 2, str + strlen("0 WRITE "));
+    }
+}
+
+/*****************************************************************************
+ *
+ * Output of synthesized parts.
+ *
+ ****************************************************************************/
+
+void
+output_init(
+            lsynth_output_t *output,
+            FILE            *file)
+{
+    memset(output,0,sizeof(lsynth_output_t));
+    output->max_bend  = DEFAULT_MAX_BEND;
+    output->max_twist = DEFAULT_MAX_TWIST;
+    output->hose_samples = DEFAULT_HOSE_SAMPLES;
+    output->band_res  = DEFAULT_BAND_RES;
+    output->file      = file;
+}
+
+/*
+ * Make sure the parts array has room for n parts in all, so a synthesis that
+ * knows about how many parts it will make can collect them without growing
+ * the array as it goes.  Returns -1 (and fails the output) if we ran out of
+ * memory.
+ */
+
+int
+output_reserve(
+               lsynth_output_t *output,
+               int              n)
+{
+    int     max = output->max_parts ? output->max_parts : 64;
+    part_t *parts;
+    
+    if (output->file || n <= output->max_parts) {
+        return 0;
+    }
+    while (max < n) {
+        max *= 2;
+    }
+    parts = realloc(output->parts, max * sizeof(part_t));
+    if (parts == NULL) {
+        output->failed = 1;
+        return -1;
+    }
+    output->parts     = parts;
+    output->max_parts = max;
+    return 0;
+}
+
+void
+output_line(
+            lsynth_output_t *output,
+            int             ghost,
+            char           *group,
+            int             color,
+            PRECISION       a,
+            PRECISION       b,
+            PRECISION       c,
+            PRECISION       d,
+            PRECISION       e,
+            PRECISION       f,
+            PRECISION       g,
+            PRECISION       h,
+            PRECISION       i,
+            PRECISION       j,
+            PRECISION       k,
+            PRECISION       l,
+            char            *type)
+{
+    part_t *part;
+    
+    output->group_size++;
+    
+    if (output->file) {
+        if (group) {
+            fprintf(output->file,"0 MLCAD BTG %s\n",group);
+        }
+        fprintf(output->file,"%s1 %d %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %s\n",
+                ghost ? "0 GHOST " : "",
+                color,
+                a,b,c,d,e,f,g,h,i,j,k,l,
+                type);
+        return;
+    }
+    
+    if (output->n_parts == output->max_parts && output_reserve(output,output->n_parts+1)) {
+        return;
+    }
+    
+    part = &output->parts[output->n_parts++];
+    memset(part,0,sizeof(part_t));
+    strncpy(part->type,type,sizeof(part->type)-1);
+    part->attrib = color;
+    part->offset[0] = a;     part->offset[1] = b;     part->offset[2] = c;
+    part->orient[0][0] = d;  part->orient[0][1] = e;  part->orient[0][2] = f;
+    part->orient[1][0] = g;  part->orient[1][1] = h;  part->orient[1][2] = i;
+    part->orient[2][0] = j;  part->orient[2][1] = k;  part->orient[2][2] = l;
+}
+
+/*
+ * Meta lines around the synthesized parts only mean something in LDraw
+ * output.
+ */
+
+void
+output_comment(
+               lsynth_output_t *output,
+               char            *comment)
+{
+    if (output->file) {
+        fputs(comment,output->file);
+    }
+}
+
+
+/*****************************************************************************
+ *
+ * Read in and parse up synthesis descriptions and constraints.
+ *
+ ****************************************************************************/
+
+static int
+parse_descr(lsynth_context_t *context, FILE *mpd)
+{
+    char line[256];
+    
+    while(fgetline(line,sizeof(line),mpd)) {
+        char stretch[64];
+        char type[64];
+        char product[126], nickname[128], method[128];
+        int  d,st,i;
+        PRECISION s,t;
+        int got_end = 0;
+        
+        strclean(line);
+        
+        if (sscanf(line,"0 !VERSION %d.%d\n", &i, &d) == 2) {
+            sprintf(context->mpdversion, "%d.%d", i, d);
+        }
+        
+        if (sscanf(line,"0 SYNTH PART %s %s %s\n",product, nickname, method) == 3) {
+            if (TABLE_FULL(context->products,context->n_products)) {
+                printf("Error: Too many products in lsynth.mpd.  Aborting\n");
+                return -1;
+            }
+            strcpy(context->products[context->n_products].name,product);
+            strcpy(context->products[context->n_products].nickname,nickname);
+            strcpy(context->products[context->n_products].method,method);
+            context->n_products++;
+        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s HOSE %s %d %d %f\n",
+                          type,stretch,&d,&st,&t) == 5) {
+            if (TABLE_FULL(context->hose_types,context->n_hose_types)) {
+                printf("Error: Too many hose types in lsynth.mpd.  Aborting\n");
+                return -1;
+            }
+            if (strcasecmp(stretch,"STRETCH") == 0) {
+                context->hose_types[context->n_hose_types].fill = STRETCH;
+            } else if (strcasecmp(stretch,"FIXED") == 0) {
+                context->hose_types[context->n_hose_types].fill = FIXED;
+            } else if ((strncasecmp(stretch,"FIXED",strlen("FIXED")) == 0) &&
+                       (sscanf(stretch, "FIXED%d", &i) == 1) && (i >1)) {
+                context->hose_types[context->n_hose_types].fill = i;
+            } else {
+                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
+                       stretch,type);
+                return -1;
+            }
+            
+            strcpy(context->hose_types[context->n_hose_types].type,type);
+            context->hose_types[context->n_hose_types].diameter = d;
+            context->hose_types[context->n_hose_types].stiffness = st;
+            context->hose_types[context->n_hose_types].twist = t;
+            
+            for (i = 0; i < 3; i++) {
+                part_t *part;
+                int     got_part = 0;
+                
+                if (i == 0) {
+                    part = &context->hose_types[context->n_hose_types].start;
+                } else if (i == 1) {
+                    part = &context->hose_types[context->n_hose_types].mid;
+                } else {
+                    part = &context->hose_types[context->n_hose_types].end;
+                }
+                
+                while (fgetline(line,sizeof(line),mpd)) {
+                    
+                    int n;
+                    
+                    n = sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                               &part->attrib,
+                               &part->offset[0],    &part->offset[1],    &part->offset[2],
+                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
+                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
+                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
+                               part->type);
+                    
+                    if (n == 14) {
+                        got_part = 1;
+                        break;
+                    }
+                }
+                if ( ! got_part) {
+                    printf("Error: Unexpected end of file\n");
+                        return -1;
+                }
+            }
+            
+            // Assume no alternate mid part.
+            strcpy(context->hose_types[context->n_hose_types].alt.type, "");
+            
+            got_end = 0;
+            while (fgetline(line,sizeof(line),mpd)) {
+                part_t *part;
+                int n;
+                
+                if (strcasecmp(line,"0 SYNTH END\n") == 0) {
+                    got_end = 1;
+                    break;
+                }
+                
+                // Look for an alternate mid part
+                part = &context->hose_types[context->n_hose_types].alt;
+                
+                n = sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                           &part->attrib,
+                           &part->offset[0],    &part->offset[1],    &part->offset[2],
+                           &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
+                           &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
+                           &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
+                           part->type);
+                
+                if (n != 14)
+                    strcpy(context->hose_types[context->n_hose_types].alt.type, ""); // Skip comments
+                else
+                {
+#ifdef DEBUGGING_HOSES
+                    printf("Found HOSE alt segment %s\n", context->hose_types[context->n_hose_types].alt.type);
+#endif
+                }
+            }
+            if ( ! got_end) {
+                printf("Error: Unexepcted end of file\n");
+                return -1;
+            }
+            context->n_hose_types++;
+        } else if (strcasecmp(line,"0 SYNTH BEGIN DEFINE HOSE CONSTRAINTS\n") == 0) {
+            while(fgetline(line,sizeof(line),mpd)) {
+                part_t  part;
+                
+                memset(&part,0,sizeof(part));
+                if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                           &part.attrib,
+                           &part.offset[0],    &part.offset[1],    &part.offset[2],
+                           &part.orient[0][0], &part.orient[0][1], &part.orient[0][2],
+                           &part.orient[1][0], &part.orient[1][1], &part.orient[1][2],
+                           &part.orient[2][0], &part.orient[2][1], &part.orient[2][2],
+                           part.type) == 14) {
+                    if (TABLE_FULL(context->hose_constraints,context->n_hose_constraints)) {
+                        printf("Error: Too many hose constraints in lsynth.mpd.  Aborting\n");
+                        return -1;
+                    }
+                    context->hose_constraints[context->n_hose_constraints++] = part;
+                } else if (strcasecmp(line,"0 SYNTH END\n") == 0) {
+                    break;
+                }
+            }
+        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s BAND %s %f %f\n",
+                          type,stretch,&s,&t) == 4) {
+            int n;
+            
+            if (TABLE_FULL(context->band_types,context->n_band_types)) {
+                printf("Error: Too many band types in lsynth.mpd.  Aborting\n");
+                return -1;
+            }
+            
+            if (strcasecmp(stretch,"STRETCH") == 0) {
+                context->band_types[context->n_band_types].fill = STRETCH;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED3") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED3;
+                n = 4;
+            } else {
+                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
+                       stretch,type);
+                return -1;
+            }
+            
+            strcpy(context->band_types[context->n_band_types].type,type);
+            context->band_types[context->n_band_types].scale = s;
+            context->band_types[context->n_band_types].thresh = t;
+            
+            for (i = 0; i < n; i++) {
+                part_t *part;
+                int     got_part = 0;
+                
+                if (i == 0) {
+                    part = &context->band_types[context->n_band_types].tangent;
+                } else if (i == 1) {
+                    part = &context->band_types[context->n_band_types].arc;
+                } else if (i == 2) {
+                    part = &context->band_types[context->n_band_types].start_trans;
+                } else {
+                    part = &context->band_types[context->n_band_types].end_trans;
+                }
+                
+                while (fgetline(line,sizeof(line),mpd)) {
+                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                               &part->attrib,
+                               &part->offset[0],    &part->offset[1],    &part->offset[2],
+                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
+                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
+                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
+                               part->type) == 14) {
+                        got_part = 1;
+                        break;
+                    }
+                }
+                if ( ! got_part) {
+                    printf("Error: Unexpected end of file\n");
+                        return -1;
+                }
+            }
+            
+            if (L3fgets(line,sizeof(line),mpd)) {
+                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
+                    printf("Error: Expected SYNTH END, got this instead\n");
+                    printf("%s", line);
+                        return -1;
+                }
+            } else {
+                printf("Error: Unexepcted end of file\n");
+                return -1;
+            }
+            context->n_band_types++;
+        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s BAND %s %f %f\n",
+                          type,stretch,&s,&t) == 4) {
+            int n;
+            
+            if (TABLE_FULL(context->band_types,context->n_band_types)) {
+                printf("Error: Too many band types in lsynth.mpd.  Aborting\n");
+                return -1;
+            }
+            
+            if (strcasecmp(stretch,"STRETCH") == 0) {
+                context->band_types[context->n_band_types].fill = STRETCH;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED3") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED3;
+                n = 4;
+            } else {
+                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
+                       stretch,type);
+                return -1;
+            }
+            
+            strcpy(context->band_types[context->n_band_types].type,type);
+            context->band_types[context->n_band_types].scale = s;
+            context->band_types[context->n_band_types].thresh = t;
+            context->band_types[context->n_band_types].pulley = 0;
+            
+            for (i = 0; i < n; i++) {
+                part_t *part;
+                int     got_part = 0;
+                
+                if (i == 0) {
+                    part = &context->band_types[context->n_band_types].tangent;
+                } else if (i == 1) {
+                    part = &context->band_types[context->n_band_types].arc;
+                } else if (i == 2) {
+                    part = &context->band_types[context->n_band_types].start_trans;
+                } else {
+                    part = &context->band_types[context->n_band_types].end_trans;
+                }
+                
+                while(fgetline(line,sizeof(line),mpd)) {
+                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                               &part->attrib,
+                               &part->offset[0],    &part->offset[1],    &part->offset[2],
+                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
+                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
+                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
+                               part->type) == 14) {
+                        got_part = 1;
+                        break;
+                    }
+                }
+                if ( ! got_part) {
+                    printf("Error: Unexpected end of file\n");
+                        return -1;
+                }
+            }
+            
+            if (L3fgets(line,sizeof(line),mpd)) {
+                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
+                    printf("Error: Expected SYNTH END, got this instead\n");
+                    printf("%s", line);
+                        return -1;
+                }
+            } else {
+                printf("Error: Unexepcted end of file\n");
+                return -1;
+            }
+            context->n_band_types++;
+        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s PULLEY %s %f %f\n",
+                          type,stretch,&s,&t) == 4) {
+            int n;
+            
+            if (TABLE_FULL(context->band_types,context->n_band_types)) {
+                printf("Error: Too many band types in lsynth.mpd.  Aborting\n");
+                return -1;
+            }
+            
+            if (strcasecmp(stretch,"STRETCH") == 0) {
+                context->band_types[context->n_band_types].fill = STRETCH;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED;
+                n = 2;
+            } else if (strcasecmp(stretch,"FIXED3") == 0) {
+                context->band_types[context->n_band_types].fill = FIXED3;
+                n = 4;
+            } else {
+                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
+                       stretch,type);
+                return -1;
+            }
+            
+            strcpy(context->band_types[context->n_band_types].type,type);
+            context->band_types[context->n_band_types].scale = s;
+            context->band_types[context->n_band_types].thresh = t;
+            
+            context->band_types[context->n_band_types].pulley = 1;
+            
+            for (i = 0; i < n; i++) {
+                part_t *part;
+                int     got_part = 0;
+                
+                if (i == 0) {
+                    part = &context->band_types[context->n_band_types].tangent;
+                } else if (i == 1) {
+                    part = &context->band_types[context->n_band_types].arc;
+                } else if (i == 2) {
+                    part = &context->band_types[context->n_band_types].start_trans;
+                } else {
+                    part = &context->band_types[context->n_band_types].end_trans;
+                }
+                
+                while (fgetline(line,sizeof(line),mpd)) {
+                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                               &part->attrib,
+                               &part->offset[0],    &part->offset[1],    &part->offset[2],
+                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
+                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
+                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
+                               part->type) != 14) {
+                        got_part = 1;
+                        break;
+                    }
+                }
+                if ( ! got_part) {
+                    printf("Error: Unexpected end of file\n");
+                        return -1;
+                }
+            }
+            
+            if (L3fgets(line,sizeof(line),mpd)) {
+                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
+                    printf("Error: Expected SYNTH END, got this instead\n");
+                    printf("%s", line);
+                        return -1;
+                }
+            } else {
+                printf("Error: Unexepcted end of file\n");
+                return -1;
+            }
+            context->n_band_types++;
+            
+        } else if (strcasecmp(line,"0 SYNTH BEGIN DEFINE BAND CONSTRAINTS\n") == 0) {
+            while(fgetline(line,sizeof(line),mpd)) {
+                part_t  part;
+                
+                memset(&part,0,sizeof(part));
+                if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
+                           &part.attrib,
+                           &part.offset[0],    &part.offset[1],    &part.offset[2],
+                           &part.orient[0][0], &part.orient[0][1], &part.orient[0][2],
+                           &part.orient[1][0], &part.orient[1][1], &part.orient[1][2],
+                           &part.orient[2][0], &part.orient[2][1], &part.orient[2][2],
+                           part.type) == 14) {
+                    if (TABLE_FULL(context->band_constraints,context->n_band_constraints)) {
+                        printf("Error: Too many band constraints in lsynth.mpd.  Aborting\n");
+                        return -1;
+                    }
+                    context->band_constraints[context->n_band_constraints++] = part;
+                } else if (strcasecmp(line,"0 SYNTH END\n") == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    
+    return 0;
+}
+
+
+lsynth_context_t *
+lsynth_context_create(char *filename)
+{
+    lsynth_context_t *context;
+    FILE *mpd;
+    int   rc;
+    
+    mpd = fopen(filename,"r");
+    
+    if (mpd == NULL) {
+        printf("Failed to open lsynth.mpd for reading.\n");
+        return NULL;
+    }
+    
+    context = calloc(1,sizeof(lsynth_context_t));
+    if (context == NULL) {
+        fclose(mpd);
+        return NULL;
+    }
+    strcpy(context->mpdversion,"UNKNOWN");
+    
+    rc = parse_descr(context,mpd);
+    fclose(mpd);
+    
+    if (rc) {
+        lsynth_context_free(context);
+        return NULL;
+    }
+    return context;
+}
+
+void
+lsynth_context_free(lsynth_context_t *context)
+{
+    free(context);
+}
+
+void list_products(lsynth_context_t *context)
+{
+    int i;
+    
+    printf("\n\nComplete parts LSynth can create\n");
+    for (i = 0; i < context->n_products; i++) {
+        printf("  %s %s (%s)\n",
+               context->products[i].name,
+               context->products[i].nickname,
+               context->products[i].method);
+    }
+}
+
+void product_ini(lsynth_context_t *context)
+{
+    int i;
+    
+    for (i = 0; i < context->n_products; i++) {
+        printf("%-20s = SYNTH BEGIN %s 16\n",
+               context->products[i].nickname,
+               context->products[i].nickname);
+    }
+    
+    for (i = 0; i < context->n_products; i++) {
+        printf("%-20s = SYNTH BEGIN %s 16\n",
+               context->products[i].name,
+               context->products[i].name);
+    }
+}
+
+char *
+isproduct(lsynth_context_t *context, char *type)
+{
+    int i;
+    
+    for (i = 0; i < context->n_products; i++) {
+        if (strncasecmp(context->products[i].name,type,strlen(context->products[i].name)) == 0) {
+            return context->products[i].name;
+        }
+        if (strncasecmp(context->products[i].nickname,type,strlen(context->products[i].nickname)) == 0) {
+            return context->products[i].name;
+        }
+    }
+    return NULL;
+}
+
+char *
+product_method(lsynth_context_t *context, char *type)
+{
+    int i;
+    
+    for (i = 0; i < context->n_products; i++) {
+        if (strncasecmp(context->products[i].name,type,strlen(context->products[i].name)) == 0) {
+            return context->products[i].method;
+        }
+        if (strncasecmp(context->products[i].nickname,type,strlen(context->products[i].nickname)) == 0) {
+            return context->products[i].method;
+        }
+    }
+    return NULL;
+}
+
+char *
+product_nickname(lsynth_context_t *context, char *type)
+{
+    int i;
+    
+    for (i = 0; i < context->n_products; i++) {
+        if (strncasecmp(context->products[i].name,type,strlen(context->products[i].name)) == 0) {
+            return context->products[i].nickname;
+        }
+        if (strncasecmp(context->products[i].nickname,type,strlen(context->products[i].nickname)) == 0) {
+            return context->products[i].nickname;
+        }
+    }
+    return NULL;
+}
+
+
+
+
+/*****************************************************************************
+ *
+ * Synthesize one hose or band.
+ *
+ ****************************************************************************/
+
+/*
+ * Synthesizes one hose, band or complete part into output.  Returns -1 if
+ * the type is unknown, or we ran out of memory (which also fails the output).
+ */
+
+static int
+synthesize(
+           lsynth_context_t *context,
+           char             *type,
+           int               color,
+           part_t           *constraints,
+           int               n_constraints,
+           lsynth_output_t  *output)
+{
+    char *method;
+    int   i, n = 0;
+    int   rc = 0;
+    
+    method = product_method(context,type);
+    if (method == NULL) {
+        method = type;
+    }
+    
+    if (ishosetype(context,method)) {
+        
+        // render_hose may add a constraint at each end of the hose.
+        part_t *hose = calloc(n_constraints + 2,sizeof(part_t));
+        
+        if (hose == NULL) {
+            output->failed = 1;
+            return -1;
+        }
+        for (i = 0; i < n_constraints; i++) {
+            if (ishoseconstraint(context,constraints[i].type)) {
+                hose[n] = constraints[i];
+                hose[n].attrib = 0;
+                n++;
+            }
+        }
+        
+        // A hose needs both of its ends.
+        if (n >= 2) {
+            rc = synth_hose(context,method,n,hose,0,NULL,0,color,output);
+        }
+        free(hose);
+        
+    } else if (isbandtype(context,method)) {
+        
+        // synth_band closes the band with a copy of its first constraint.
+        LSL_band_constraint *band = calloc(n_constraints + 1,sizeof(LSL_band_constraint));
+        int                  n_pulleys = 0;
+        
+        if (band == NULL) {
+            output->failed = 1;
+            return -1;
+        }
+        for (i = 0; i < n_constraints; i++) {
+            char *ctype = constraints[i].type;
+            
+            if (isbandconstraint(context,ctype)) {
+                band[n].part = constraints[i];
+                band[n].part.attrib = color;
+                n++;
+                n_pulleys++;
+            } else if (strcasecmp(ctype,"INSIDE")  == 0 ||
+                       strcasecmp(ctype,"OUTSIDE") == 0 ||
+                       strcasecmp(ctype,"CROSS")   == 0) {
+                strcpy(band[n].part.type,ctype);
+                n++;
+            }
+        }
+        
+        // A band needs something to go around.
+        if (n_pulleys > 0) {
+            rc = synth_band(context,method,n,band,color,output,0,NULL);
+        }
+        free(band);
+        
+    } else {
+        return -1;
+    }
+    
+    if (rc != 0 || output->failed) {
+        return -1;
+    }
+    return 0;
+}
+
+int
+lsynth_synthesize(
+                  lsynth_context_t *context,
+                  char             *type,
+                  int               color,
+                  part_t           *constraints,
+                  int               n_constraints,
+                  int               hose_samples,
+                  lsynth_cache_t   *cache,
+                  part_t          **parts,
+                  int              *n_parts)
+{
+    lsynth_output_t output;
+    
+    output_init(&output,NULL);
+    if (hose_samples > 0) {
+        output.hose_samples = hose_samples;
+    }
+    output.cache = cache;
+    *parts   = NULL;
+    *n_parts = 0;
+    
+    if (synthesize(context,type,color,constraints,n_constraints,&output)) {
+        free(output.parts);
+        return -1;
+    }
+    *parts   = output.parts;
+    *n_parts = output.n_parts;
+    return 0;
+}
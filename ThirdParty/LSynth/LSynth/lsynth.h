@@ -0,0 +1,105 @@
+/*
+ * This file describes the library interface to the LDRAW synthesizable parts
+ * library, for programs which link LSynth instead of running lsynthcp.
+ *
+ * Read lsynth.mpd once with lsynth_context_create, then call
+ * lsynth_synthesize for each hose or band.  The context is not changed
+ * after it is read, and synthesis keeps no global state, so any number of
+ * threads may synthesize from one context at the same time.  Synthesis
+ * prints nothing, so threads don't interleave notes on stdout; lsynthcp
+ * turns its notes on with output->verbose.
+ */
+#ifndef LSYNTH_LIBRARY_H
+#define LSYNTH_LIBRARY_H
+
+#include "lsynthcp.h"
+#include "hose.h"
+#include "band.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  char name[126];
+  char nickname[128];
+  char method[128];
+} product_t;
+
+/*
+ * Everything read from lsynth.mpd.
+ */
+
+struct lsynth_context {
+  char          mpdversion[32];
+
+  product_t     products[256];
+  int           n_products;
+
+  hose_attrib_t hose_types[64];
+  int           n_hose_types;
+  part_t        hose_constraints[128];
+  int           n_hose_constraints;
+
+  band_attrib_t band_types[32];
+  int           n_band_types;
+  part_t        band_constraints[64];
+  int           n_band_constraints;
+};
+
+lsynth_context_t *
+lsynth_context_create(
+  char             *filename);
+
+void
+lsynth_context_free(
+  lsynth_context_t *context);
+
+/*
+ * A cache remembers the spans of one hose between syntheses, so that when
+ * one of its constraints moves only the spans next to it are made again.
+ * Give each hose its own cache, and don't use a cache from two threads at
+ * once.
+ */
+
+lsynth_cache_t *
+lsynth_cache_create(void);
+
+void
+lsynth_cache_free(
+  lsynth_cache_t   *cache);
+
+/*
+ * Synthesizes the hose, band or complete part named by type.  The
+ * constraints are the parts inside its SYNTH block, in order; a band's
+ * INSIDE, OUTSIDE and CROSS directives are given as parts of those types.
+ * Parts which are not constraints for the type are ignored.
+ *
+ * hose_samples is the hose quality: how many points are sampled along the
+ * curve between each pair of constraints, before it is cut into parts.  Pass
+ * 0 for the default (see lsynthcp.h).  Bands and the other resolutions use
+ * their defaults.
+ *
+ * cache is the hose's span cache, or NULL.
+ *
+ * Returns 0 and a malloc'ed array of parts (color in attrib), which the
+ * caller frees, or -1 if the type is unknown or we ran out of memory.
+ */
+
+int
+lsynth_synthesize(
+  lsynth_context_t *context,
+  char             *type,
+  int               color,
+  part_t           *constraints,
+  int               n_constraints,
+  int               hose_samples,
+  lsynth_cache_t   *cache,
+  part_t          **parts,
+  int              *n_parts);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
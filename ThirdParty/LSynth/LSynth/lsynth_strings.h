@@ -16,6 +16,8 @@ int strcasecmp(
   const char *s1,
   const char *s2);
 #endif
+#else
+#include <strings.h>
 #endif
 
 #endif
@@ -1,6 +1,8 @@
 //---------------------------------------------------------------------------
 
+#ifdef __BORLANDC__
 #pragma hdrstop
+#endif
 
 /*
  * Program Name: LSynth
@@ -29,7 +31,9 @@
  *   methodology.
  */
 
+#ifdef __BORLANDC__
 #pragma hdrstop
+#endif
 
 #ifdef WIN32
 // Added a messagebox for lsynth.mpd version mismatch.
@@ -38,30 +42,68 @@
 
 #include <ctype.h>
 
-#include "lsynthcp.h"
-#include "hose.h"
-#include "band.h"
+#include "lsynth.h"
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdbool.h>
-#import <string.h>
-
-typedef struct {
-    char name[126];
-    char nickname[128];
-    char method[128];
-} product_t;
-
-product_t products[256];
-int       n_products = 0;
+#include <string.h>
 
 char version[] = "3.1";
 char beta[] = ""; // " Beta I";
 
-char mpdversion[32] = "UNKNOWN";
+lsynth_context_t *context;
+
+/*
+ * Settings for the whole run, copied into each synthesis' output.
+ */
+
+static PRECISION max_bend = DEFAULT_MAX_BEND;
+static PRECISION max_twist = DEFAULT_MAX_TWIST;
+static int hose_samples = DEFAULT_HOSE_SAMPLES;
+static PRECISION band_res = DEFAULT_BAND_RES;
 
-int ldraw_part = 0;
-int group_size;
+static int ldraw_part = 0;
+
+static void
+setup_output(lsynth_output_t *output, FILE *temp)
+{
+    output_init(output,temp);
+    output->max_bend   = max_bend;
+    output->max_twist  = max_twist;
+    output->hose_samples = hose_samples;
+    output->band_res   = band_res;
+    output->ldraw_part = ldraw_part;
+    output->verbose    = 1;
+}
+
+/*
+ * Make sure an array of constraints has room for at least n of them,
+ * doubling it as needed.  New room is zeroed.  Returns -1 if we ran out of
+ * memory.
+ */
+
+static int
+reserve_constraints(void **constraints, int *max_n, int n, size_t size)
+{
+    int   max = *max_n ? *max_n : 128;
+    char *grown;
+    
+    if (n <= *max_n) {
+        return 0;
+    }
+    while (max < n) {
+        max *= 2;
+    }
+    grown = realloc(*constraints, max*size);
+    if (grown == NULL) {
+        fprintf(stderr,"Out of memory for %d constraints\n",n);
+        return -1;
+    }
+    memset(grown + *max_n*size, 0, (max - *max_n)*size);
+    *constraints = grown;
+    *max_n = max;
+    return 0;
+}
 
 //---------------------------------------------------------------------------
 void messagebox( const char* title, const char* message )
@@ -107,83 +149,6 @@ void messagebox( const char* title, const char* message )
 #endif
 }
 
-//---------------------------------------------------------------------------
-/* If this code works, it was written by Lars C. Hassing. */
-/* If not, I don't know who wrote it.                     */
-
-/* Like fgets, except that 1) any line ending is accepted (\n (unix),
- \r\n (DOS/Windows), \r (Mac (OS9)) and 2) Str is ALWAYS zero terminated
- (even if no line ending was found) */
-//---------------------------------------------------------------------------
-char *L3fgets(char *Str, int n, FILE *fp)
-{
-    register int   c;
-    int            nextc;
-    register char *s = Str;
-    
-    while (--n > 0)
-    {
-        if ((c = getc(fp)) == EOF)
-            break;
-        if (c == '\032')
-            continue;              /* Skip CTRL+Z                               */
-        if (c == '\r' || c == '\n')
-        {
-            *s++ = '\n';
-            /* We got CR or LF, eat next character if LF or CR respectively */
-            if ((nextc = getc(fp)) == EOF)
-                break;
-            if (nextc == c || (nextc != '\r' && nextc != '\n'))
-                ungetc(nextc, fp);  /* CR-CR or LF-LF or ordinary character      */
-            break;
-        }
-        *s++ = c;
-    }
-    *s = 0;
-    
-    /* if (ferror(fp)) return NULL; if (s == Str) return NULL; */
-    if (s == Str)
-        return NULL;
-    
-    return Str;
-}
-
-//---------------------------------------------------------------------------
-
-char *
-fgetline(
-         char *line,
-         int   len,
-         FILE *file)
-{
-    char *rc;
-    while ((rc = L3fgets(line,len,file))) {
-        char *nonwhite;
-        
-        nonwhite = line + strspn(line," \t");
-        
-        if (strncasecmp(nonwhite,"0 ROTATION C",strlen("0 ROTATION C")) == 0 ||
-            strncasecmp(nonwhite,"0 COLOR",strlen("0 COLOR")) == 0) {
-            continue;
-        }
-        
-        nonwhite = line + strspn(line," \t");
-        if (strncasecmp(nonwhite,"0 WRITE ",strlen("0 WRITE ")) == 0) {
-            strcpy(nonwhite + 2, nonwhite + strlen("0 WRITE "));
-        }
-        break;
-    }
-    return rc;
-}
-
-void
-strclean(char *str)
-{
-    if (strncasecmp(str,"0 WRITE ",strlen("0 WRITE ")) == 0) {
-        strcpy(str + 2, str + strlen("0 WRITE "));
-    }
-}
-
 //---------------------------------------------------------------------------
 
 /*
@@ -207,502 +172,6 @@ static int skip_rot(char *line, int n_line, FILE *dat, FILE *temp)
 }
 
 
-/*****************************************************************************
- *
- * Read in and parse up synthesis descriptions and constraints.
- *
- ****************************************************************************/
-
-int
-parse_descr(bool custom_config, char *fullpath_progname)
-{
-    char filename[256];
-    FILE *mpd;
-    char line[256];
-    
-    if (!custom_config) {
-        strcpy(filename,fullpath_progname);
-        {
-            char *l, *p;
-
-            for (l = p = filename; *p; *p++) {
-                if (*p == '\\' || *p == '/') {
-                    l = p+1;
-                }
-            }
-            *l = '\0';
-        }
-        strcat(filename,"lsynth.mpd");
-    }
-    else {
-        strcpy(filename,fullpath_progname);
-    }
-
-    mpd = fopen(filename,"r");
-    
-    if (mpd == NULL) {
-        printf("Failed to open lsynth.mpd for reading.\n");
-        messagebox("LSynth", "Failed to open lsynth.mpd for reading.");
-        return -1;
-    }
-    
-    while(fgetline(line,sizeof(line),mpd)) {
-        char stretch[64];
-        char type[64];
-        char product[126], nickname[128], method[128];
-        int  d,st,i;
-        PRECISION s,t;
-        int got_end = 0;
-        
-        strclean(line);
-        
-        if (sscanf(line,"0 !VERSION %d.%d\n", &i, &d) == 2) {
-            sprintf(mpdversion, "%d.%d", i, d);
-        }
-        else if (!strncmp(line,"0 SYNTH ", 8))
-        {
-            if (strcmp(mpdversion, version))
-            {
-                char s[256];
-                sprintf(s, "\nWarning: lsynth.mpd version %s does not match executable version %s!",
-                        mpdversion, version);
-                printf("%s\n\n", s);
-                messagebox("LSynth", s);
-                strcpy(mpdversion, version); // Only warn once.
-            }
-        }
-        
-        if (sscanf(line,"0 SYNTH PART %s %s %s\n",product, nickname, method) == 3) {
-            strcpy(products[n_products].name,product);
-            strcpy(products[n_products].nickname,nickname);
-            strcpy(products[n_products].method,method);
-            n_products++;
-        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s HOSE %s %d %d %f\n",
-                          type,stretch,&d,&st,&t) == 5) {
-            if (strcasecmp(stretch,"STRETCH") == 0) {
-                hose_types[n_hose_types].fill = STRETCH;
-            } else if (strcasecmp(stretch,"FIXED") == 0) {
-                hose_types[n_hose_types].fill = FIXED;
-            } else if ((strncasecmp(stretch,"FIXED",strlen("FIXED")) == 0) &&
-                       (sscanf(stretch, "FIXED%d", &i) == 1) && (i >1)) {
-                hose_types[n_hose_types].fill = i;
-            } else {
-                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
-                       stretch,type);
-                fclose(mpd);
-                return -1;
-            }
-            
-            strcpy(hose_types[n_hose_types].type,type);
-            hose_types[n_hose_types].diameter = d;
-            hose_types[n_hose_types].stiffness = st;
-            hose_types[n_hose_types].twist = t;
-            
-            for (i = 0; i < 3; i++) {
-                part_t *part;
-                int     got_part = 0;
-                
-                if (i == 0) {
-                    part = &hose_types[n_hose_types].start;
-                } else if (i == 1) {
-                    part = &hose_types[n_hose_types].mid;
-                } else {
-                    part = &hose_types[n_hose_types].end;
-                }
-                
-                while (fgetline(line,sizeof(line),mpd)) {
-                    
-                    int n;
-                    
-                    n = sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                               &part->attrib,
-                               &part->offset[0],    &part->offset[1],    &part->offset[2],
-                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                               part->type);
-                    
-                    if (n == 14) {
-                        got_part = 1;
-                        break;
-                    }
-                }
-                if ( ! got_part) {
-                    printf("Error: Unexpected end of file\n");
-                    fclose(mpd);
-                    return -1;
-                }
-            }
-            
-            // Assume no alternate mid part.
-            strcpy(hose_types[n_hose_types].alt.type, "");
-            
-            got_end = 0;
-            while (fgetline(line,sizeof(line),mpd)) {
-                part_t *part;
-                int n;
-                
-                if (strcasecmp(line,"0 SYNTH END\n") == 0) {
-                    got_end = 1;
-                    break;
-                }
-                
-                // Look for an alternate mid part
-                part = &hose_types[n_hose_types].alt;
-                
-                n = sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                           &part->attrib,
-                           &part->offset[0],    &part->offset[1],    &part->offset[2],
-                           &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                           &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                           &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                           part->type);
-                
-                if (n != 14)
-                    strcpy(hose_types[n_hose_types].alt.type, ""); // Skip comments
-                else
-                {
-#ifdef DEBUGGING_HOSES
-                    printf("Found HOSE alt segment %s\n", hose_types[n_hose_types].alt.type);
-#endif
-                }
-            }
-            if ( ! got_end) {
-                printf("Error: Unexepcted end of file\n");
-                fclose(mpd);
-                return -1;
-            }
-            n_hose_types++;
-        } else if (strcasecmp(line,"0 SYNTH BEGIN DEFINE HOSE CONSTRAINTS\n") == 0) {
-            while(fgetline(line,sizeof(line),mpd)) {
-                part_t *part = &hose_constraints[n_hose_constraints];
-                if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                           &part->attrib,
-                           &part->offset[0],    &part->offset[1],    &part->offset[2],
-                           &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                           &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                           &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                           part->type) == 14) {
-                    n_hose_constraints++;
-                } else if (strcasecmp(line,"0 SYNTH END\n") == 0) {
-                    break;
-                }
-            }
-        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s BAND %s %f %f\n",
-                          type,stretch,&s,&t) == 4) {
-            int n;
-            
-            if (strcasecmp(stretch,"STRETCH") == 0) {
-                band_types[n_band_types].fill = STRETCH;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED") == 0) {
-                band_types[n_band_types].fill = FIXED;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED3") == 0) {
-                band_types[n_band_types].fill = FIXED3;
-                n = 4;
-            } else {
-                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
-                       stretch,type);
-                fclose(mpd);
-                return -1;
-            }
-            
-            strcpy(band_types[n_band_types].type,type);
-            band_types[n_band_types].scale = s;
-            band_types[n_band_types].thresh = t;
-            
-            for (i = 0; i < n; i++) {
-                part_t *part;
-                int     got_part = 0;
-                
-                if (i == 0) {
-                    part = &band_types[n_band_types].tangent;
-                } else if (i == 1) {
-                    part = &band_types[n_band_types].arc;
-                } else if (i == 2) {
-                    part = &band_types[n_band_types].start_trans;
-                } else {
-                    part = &band_types[n_band_types].end_trans;
-                }
-                
-                while (fgetline(line,sizeof(line),mpd)) {
-                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                               &part->attrib,
-                               &part->offset[0],    &part->offset[1],    &part->offset[2],
-                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                               part->type) == 14) {
-                        got_part = 1;
-                        break;
-                    }
-                }
-                if ( ! got_part) {
-                    printf("Error: Unexpected end of file\n");
-                    fclose(mpd);
-                    return -1;
-                }
-            }
-            
-            if (L3fgets(line,sizeof(line),mpd)) {
-                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
-                    printf("Error: Expected SYNTH END, got this instead\n");
-                    printf("%s", line);
-                    fclose(mpd);
-                    return -1;
-                }
-            } else {
-                printf("Error: Unexepcted end of file\n");
-                fclose(mpd);
-                return -1;
-            }
-            n_band_types++;
-        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s BAND %s %f %f\n",
-                          type,stretch,&s,&t) == 4) {
-            int n;
-            
-            if (strcasecmp(stretch,"STRETCH") == 0) {
-                band_types[n_band_types].fill = STRETCH;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED") == 0) {
-                band_types[n_band_types].fill = FIXED;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED3") == 0) {
-                band_types[n_band_types].fill = FIXED3;
-                n = 4;
-            } else {
-                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
-                       stretch,type);
-                fclose(mpd);
-                return -1;
-            }
-            
-            strcpy(band_types[n_band_types].type,type);
-            band_types[n_band_types].scale = s;
-            band_types[n_band_types].thresh = t;
-            band_types[n_band_types].pulley = 0;
-            
-            for (i = 0; i < n; i++) {
-                part_t *part;
-                int     got_part = 0;
-                
-                if (i == 0) {
-                    part = &band_types[n_band_types].tangent;
-                } else if (i == 1) {
-                    part = &band_types[n_band_types].arc;
-                } else if (i == 2) {
-                    part = &band_types[n_band_types].start_trans;
-                } else {
-                    part = &band_types[n_band_types].end_trans;
-                }
-                
-                while(fgetline(line,sizeof(line),mpd)) {
-                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                               &part->attrib,
-                               &part->offset[0],    &part->offset[1],    &part->offset[2],
-                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                               part->type) == 14) {
-                        got_part = 1;
-                        break;
-                    }
-                }
-                if ( ! got_part) {
-                    printf("Error: Unexpected end of file\n");
-                    fclose(mpd);
-                    return -1;
-                }
-            }
-            
-            if (L3fgets(line,sizeof(line),mpd)) {
-                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
-                    printf("Error: Expected SYNTH END, got this instead\n");
-                    printf("%s", line);
-                    fclose(mpd);
-                    return -1;
-                }
-            } else {
-                printf("Error: Unexepcted end of file\n");
-                fclose(mpd);
-                return -1;
-            }
-            n_band_types++;
-        } else if (sscanf(line,"0 SYNTH BEGIN DEFINE %s PULLEY %s %f %f\n",
-                          type,stretch,&s,&t) == 4) {
-            int n;
-            
-            if (strcasecmp(stretch,"STRETCH") == 0) {
-                band_types[n_band_types].fill = STRETCH;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED") == 0) {
-                band_types[n_band_types].fill = FIXED;
-                n = 2;
-            } else if (strcasecmp(stretch,"FIXED3") == 0) {
-                band_types[n_band_types].fill = FIXED3;
-                n = 4;
-            } else {
-                printf("Error: Unrecognized fill type %s for hose type %s.  Aborting\n",
-                       stretch,type);
-                fclose(mpd);
-                return -1;
-            }
-            
-            strcpy(band_types[n_band_types].type,type);
-            band_types[n_band_types].scale = s;
-            band_types[n_band_types].thresh = t;
-            
-            band_types[n_band_types].pulley = 1;
-            
-            for (i = 0; i < n; i++) {
-                part_t *part;
-                int     got_part = 0;
-                
-                if (i == 0) {
-                    part = &band_types[n_band_types].tangent;
-                } else if (i == 1) {
-                    part = &band_types[n_band_types].arc;
-                } else if (i == 2) {
-                    part = &band_types[n_band_types].start_trans;
-                } else {
-                    part = &band_types[n_band_types].end_trans;
-                }
-                
-                while (fgetline(line,sizeof(line),mpd)) {
-                    if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                               &part->attrib,
-                               &part->offset[0],    &part->offset[1],    &part->offset[2],
-                               &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                               &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                               &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                               part->type) != 14) {
-                        got_part = 1;
-                        break;
-                    }
-                }
-                if ( ! got_part) {
-                    printf("Error: Unexpected end of file\n");
-                    fclose(mpd);
-                    return -1;
-                }
-            }
-            
-            if (L3fgets(line,sizeof(line),mpd)) {
-                if (strcasecmp(line,"0 SYNTH END\n") != 0) {
-                    printf("Error: Expected SYNTH END, got this instead\n");
-                    printf("%s", line);
-                    fclose(mpd);
-                    return -1;
-                }
-            } else {
-                printf("Error: Unexepcted end of file\n");
-                fclose(mpd);
-                return -1;
-            }
-            n_band_types++;
-            
-        } else if (strcasecmp(line,"0 SYNTH BEGIN DEFINE BAND CONSTRAINTS\n") == 0) {
-            while(fgetline(line,sizeof(line),mpd)) {
-                part_t *part = &band_constraints[n_band_constraints];
-                if (sscanf(line,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s\n",
-                           &part->attrib,
-                           &part->offset[0],    &part->offset[1],    &part->offset[2],
-                           &part->orient[0][0], &part->orient[0][1], &part->orient[0][2],
-                           &part->orient[1][0], &part->orient[1][1], &part->orient[1][2],
-                           &part->orient[2][0], &part->orient[2][1], &part->orient[2][2],
-                           part->type) == 14) {
-                    n_band_constraints++;
-                } else if (strcasecmp(line,"0 SYNTH END\n") == 0) {
-                    break;
-                }
-            }
-        }
-    }
-    
-    fclose(mpd);
-    return 0;
-}
-
-void list_products()
-{
-    int i;
-    
-    printf("\n\nComplete parts LSynth can create\n");
-    for (i = 0; i < n_products; i++) {
-        printf("  %s %s (%s)\n",
-               products[i].name,
-               products[i].nickname,
-               products[i].method);
-    }
-}
-
-void product_ini(void)
-{
-    int i;
-    
-    for (i = 0; i < n_products; i++) {
-        printf("%-20s = SYNTH BEGIN %s 16\n",
-               products[i].nickname,
-               products[i].nickname);
-    }
-    
-    for (i = 0; i < n_products; i++) {
-        printf("%-20s = SYNTH BEGIN %s 16\n",
-               products[i].name,
-               products[i].name);
-    }
-}
-
-char *
-isproduct(char *type)
-{
-    int i;
-    
-    for (i = 0; i < n_products; i++) {
-        if (strncasecmp(products[i].name,type,strlen(products[i].name)) == 0) {
-            return products[i].name;
-        }
-        if (strncasecmp(products[i].nickname,type,strlen(products[i].nickname)) == 0) {
-            return products[i].name;
-        }
-    }
-    return NULL;
-}
-
-char *
-product_method(char *type)
-{
-    int i;
-    
-    for (i = 0; i < n_products; i++) {
-        if (strncasecmp(products[i].name,type,strlen(products[i].name)) == 0) {
-            return products[i].method;
-        }
-        if (strncasecmp(products[i].nickname,type,strlen(products[i].nickname)) == 0) {
-            return products[i].method;
-        }
-    }
-    return NULL;
-}
-
-char *
-product_nickname(char *type)
-{
-    int i;
-    
-    for (i = 0; i < n_products; i++) {
-        if (strncasecmp(products[i].name,type,strlen(products[i].name)) == 0) {
-            return products[i].nickname;
-        }
-        if (strncasecmp(products[i].nickname,type,strlen(products[i].nickname)) == 0) {
-            return products[i].nickname;
-        }
-    }
-    return NULL;
-}
-
-
 /*
  * Skip over results rom previous syntesis efforts.
  */
@@ -735,16 +204,18 @@ int synth_hose_class(
 {
     char   line[512];
     char  *nonwhite;
-    part_t constraints[128];
+    part_t *constraints = NULL;
     int    constraint_n = 0;
+    int    max_constraints = 0;
     int    color;
-    char   start_type[64];
+    char   start_type[128];
     float  x,y,z, a,b,c, d,e,f, g,h,i;
     int    rc = 0;
     int    hide = 1;
     int    ghost = 0;
     int    group_count = 0;
     char   group_name[512];
+    lsynth_output_t output;
     
     if (group) {
         strcpy(group_name,group);
@@ -753,7 +224,7 @@ int synth_hose_class(
         group_name[0] = '\0';
     }
     
-    memset(constraints, 0, 128*sizeof(part_t));
+    setup_output(&output, temp);
     
     /* gather up the constraints */
     
@@ -773,11 +244,19 @@ int synth_hose_class(
         
         strclean(nonwhite);
         
-        if (sscanf(nonwhite,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s",
+        if (sscanf(nonwhite,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %127s",
                    &color, &x,&y,&z, &a,&b,&c, &d,&e,&f, &g,&h,&i, start_type) == 14) {
 
-            if (ishoseconstraint(start_type)) {
-                part_t *constr = &constraints[constraint_n];
+            if (ishoseconstraint(context,start_type)) {
+                part_t *constr;
+                
+                // Leave room for the two ends render_hose may add.
+                if (reserve_constraints((void **) &constraints, &max_constraints,
+                                        constraint_n + 3, sizeof(part_t))) {
+                    rc = -1;
+                    break;
+                }
+                constr = &constraints[constraint_n];
                 
                 if ( ! ldraw_part) {
                     if (hide) {
@@ -822,7 +301,15 @@ int synth_hose_class(
             }
         } else if (strncasecmp(nonwhite,"0 SYNTH END\n",strlen("0 SYNTH END\n")) == 0 ||
                    strncasecmp(nonwhite,"0 WRITE SYNTH END\n",strlen("0 WRITE SYNTH END\n")) == 0) {
-            rc = synth_hose(method,constraint_n,constraints,ghost,group,group_count,hose_color,temp);
+            if (reserve_constraints((void **) &constraints, &max_constraints,
+                                    constraint_n + 2, sizeof(part_t))) {
+                rc = -1;
+                break;
+            }
+            rc = synth_hose(context,method,constraint_n,constraints,ghost,group,group_count,hose_color,&output);
+            if (output.failed) {
+                fprintf(stderr,"Out of memory synthesizing %s\n",method);
+            }
             if ( ! ldraw_part ) {
                 fputs(line,temp);
             }
@@ -831,6 +318,7 @@ int synth_hose_class(
             fputs(line,temp);
         }
     }
+    free(constraints);
     return rc;
 }
 
@@ -848,21 +336,30 @@ int synth_band_class(
 {
     char line[512];
     char *nonwhite;
-    LSL_band_constraint constraints[128];
+    LSL_band_constraint *constraints = NULL;
     int  constraint_n = 0;
+    int  max_constraints = 0;
     int  rc = 0;
     int  hide = 0;
     int  ghost = 0;
+    lsynth_output_t output;
     
-    memset(constraints, 0, sizeof(LSL_band_constraint)*128);
+    setup_output(&output, temp);
     
     /* gather up the constraints */
     
     while (L3fgets(line,sizeof(line), dat)) {
         float x,y,z, a,b,c, d,e,f, g,h,i;
-        char start_type[64];
+        char start_type[128];
         int t;
         
+        // Leave room for the copy of the first pulley synth_band closes
+        // the band with.
+        if (reserve_constraints((void **) &constraints, &max_constraints,
+                                constraint_n + 2, sizeof(LSL_band_constraint))) {
+            break;
+        }
+        
         nonwhite = line + strspn(line, " \t");
         
         skip_rot(line,sizeof(line),dat,temp);
@@ -876,10 +373,10 @@ int synth_band_class(
             nonwhite += strspn(nonwhite," \t");
         }
         
-        if (sscanf(nonwhite,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %s",
+        if (sscanf(nonwhite,"1 %d %f %f %f %f %f %f %f %f %f %f %f %f %127s",
                    &t, &x,&y,&z, &a,&b,&c, &d,&e,&f, &g,&h,&i, start_type) == 14) {
             
-            if (isbandconstraint(start_type)) {
+            if (isbandconstraint(context,start_type)) {
                 part_t *cp = &constraints[constraint_n].part;
                 
                 if (hide) {
@@ -935,7 +432,7 @@ int synth_band_class(
             } else if (strncasecmp(nonwhite,"0 SYNTH END\n",strlen("0 SYNTH END\n")) == 0 ||
                        strncasecmp(nonwhite,"0 WRITE SYNTH END\n",strlen("0 WRITE SYNTH END\n")) == 0) {
                 
-                rc = synth_band(method,constraint_n,constraints,color,temp,ghost,group);
+                rc = synth_band(context,method,constraint_n,constraints,color,&output,ghost,group);
                 if ( ! ldraw_part ) {
                     fputs(line,temp);
                 }
@@ -945,13 +442,10 @@ int synth_band_class(
             }
         }
     }
+    free(constraints);
     return 0;
 }
 
-PRECISION max_bend = 0.05f;
-PRECISION max_twist = 0.0174f;
-PRECISION band_res = 1;
-
 //---------------------------------------------------------------------------
 
 char * stripquotes(char *s)
@@ -988,10 +482,6 @@ char * stripquotes(char *s)
 }
 
 void usage() {
-    extern void list_hose_types(void);
-    extern void list_band_types(void);
-    extern void list_band_constraints(void);
-
     printf("LSynth is an LDraw compatible flexible part synthesizer\n");
     printf("  usage: lsynthcp [-p] | [[-v] [-h] [-m] [-l] [-c <CONFIG FILE> <src> <dst>] [-]\n");
     printf("    -v - prints lsynthcp version\n");
@@ -1009,19 +499,20 @@ void usage() {
     printf("To create a flexible part, you put specifications for the part\n");
     printf("directly into your LDraw file, where the part is needed.\n");
 
-    list_products();
-    list_hose_types();
-    list_hose_constraints();
-    list_band_types();
-    list_band_constraints();
+    list_products(context);
+    list_hose_types(context);
+    list_hose_constraints(context);
+    list_band_types(context);
+    list_band_constraints(context);
 }
 
+#ifdef __BORLANDC__
 #pragma argsused
+#endif
 int main(int argc, char* argv[])
 {
-    int   dat_argc = 1;
-    char *dat_name;
-    char *dst_name;
+    char *dat_name = NULL;
+    char *dst_name = NULL;
     char *synth_name = NULL;
     char  filename[512];
     FILE *outfile;
@@ -1087,15 +578,35 @@ int main(int argc, char* argv[])
 
     // lsynth config
     if (copt) {
-        if (parse_descr(true, config_file)) {
-            return 1;
-        }
+        strcpy(filename,config_file);
     }
 
     else {
-        if (parse_descr(false, argv[0])) {
-            return 1;
+        char *l, *p;
+
+        // lsynth.mpd lives next to the executable
+        strcpy(filename,argv[0]);
+        for (l = p = filename; *p; p++) {
+            if (*p == '\\' || *p == '/') {
+                l = p+1;
+            }
         }
+        *l = '\0';
+        strcat(filename,"lsynth.mpd");
+    }
+
+    context = lsynth_context_create(filename);
+    if (context == NULL) {
+        messagebox("LSynth", "Failed to read lsynth.mpd.");
+        return 1;
+    }
+
+    if (strcmp(context->mpdversion, version)) {
+        char s[256];
+        sprintf(s, "\nWarning: lsynth.mpd version %s does not match executable version %s!",
+                context->mpdversion, version);
+        printf("%s\n\n", s);
+        messagebox("LSynth", s);
     }
 
     // handle arguments
@@ -1138,9 +649,9 @@ int main(int argc, char* argv[])
 
             printf("[LSYNTH]\n");
             printf("%%PATH = \"%s\"\n",path);
-            product_ini();
-            hose_ini();
-            band_ini();
+            product_ini(context);
+            hose_ini(context);
+            band_ini(context);
             printf("Tangent Statement: INSIDE = SYNTH INSIDE\n");
             printf("Tangent Statement: OUTSIDE = SYNTH OUTSIDE\n");
             printf("Tangent Statement: CROSS = SYNTH CROSS\n");
@@ -1164,6 +675,8 @@ int main(int argc, char* argv[])
             dat = stdin;
             outfile = stdout;
             useSTDIN_STDOUT = true;
+            // Subfiles are numbered lsynthN.ldr.
+            dst_name = "lsynth";
         }
         else {
             printf("Problem understanding what you want for input/output.\n\n");
@@ -1175,8 +688,10 @@ int main(int argc, char* argv[])
     // I/O: two extra arguments
     else if (optind == argc - 2) {
         printf("%i %s", optind, argv[optind]);
-        dat = fopen(argv[optind],"r");
-        outfile = fopen(argv[optind + 1],"w");
+        dat_name = argv[optind];
+        dst_name = argv[optind + 1];
+        dat = fopen(dat_name,"r");
+        outfile = fopen(dst_name,"w");
 
         if (dat == NULL) {
             printf("%s: Failed to open file %s for reading\n",argv[0],dat_name);
@@ -1279,10 +794,10 @@ int main(int argc, char* argv[])
                 return -1;
             }
             
-            product = isproduct(tmp);
+            product = isproduct(context,tmp);
             if (product) {
                 fprintf(outfile,"0 LPUB PLI BEGIN SUB %s %d\n",product,color);
-                method = product_method(product);
+                method = product_method(context,product);
             } else {
                 method = tmp;
             }
@@ -1291,10 +806,10 @@ int main(int argc, char* argv[])
                 fputs(line,outfile);
             }
             
-            if (ishosetype(method)) {
+            if (ishosetype(context,method)) {
                 synth_hose_class(method,color,dat,synthfile,group);
                 
-            } else if (isbandtype(method)) {
+            } else if (isbandtype(context,method)) {
                 synth_band_class(method,color,dat,synthfile,group);
                 
             } else {
@@ -1304,7 +819,7 @@ int main(int argc, char* argv[])
             if (! useSTDIN_STDOUT) {
                 if (product) {
                     fprintf(outfile,"0 LPUB PLI END\n");
-                    printf("Synthesized %s (%s)\n",product,product_nickname(product));
+                    printf("Synthesized %s (%s)\n",product,product_nickname(context,product));
                 } else {
                     printf("Synthesized %s\n",method);
                 }
@@ -1319,6 +834,7 @@ int main(int argc, char* argv[])
             }
         } else {
             float foo,bar;
+            int   samples;
             
             if (sscanf(nonwhite,"0 SYNTH HOSE_RES %f %f",&foo,&bar) == 1) {
                 max_bend = foo;
@@ -1326,6 +842,12 @@ int main(int argc, char* argv[])
                 if ( ! ldraw_part ) {
                     fputs(line,outfile);
                 }
+            } else if (sscanf(nonwhite,"0 SYNTH HOSE_SAMPLES %d",&samples) == 1 &&
+                       samples > 0) {
+                hose_samples = samples;
+                if ( ! ldraw_part ) {
+                    fputs(line,outfile);
+                }
             } else if (sscanf(nonwhite,"0 SYNTH BAND_RES %f",&foo) == 1) {
                 band_res = foo;
                 if ( ! ldraw_part ) {
@@ -1338,7 +860,8 @@ int main(int argc, char* argv[])
     }
     fclose(dat);
     fclose(outfile);
+    lsynth_context_free(context);
     
     printf("lynthcp complete\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -11,7 +11,7 @@
 #include <string.h>
 
 #include "mathlib.h"
-#include "strings.h"
+#include "lsynth_strings.h"
 
 #define ACCY (1e-6)
 
@@ -23,15 +23,66 @@ typedef struct {
   int       attrib;
 } part_t;
 
-extern PRECISION max_bend;
-extern PRECISION max_twist;
-extern PRECISION band_res;
-extern int group_size;
-extern int ldraw_part;
+/* Default resolutions, until a 0 SYNTH HOSE_RES or BAND_RES says otherwise. */
+#define DEFAULT_MAX_BEND  0.05f
+#define DEFAULT_MAX_TWIST 0.0174f
+#define DEFAULT_BAND_RES  1
+
+/* Default hose quality, until a 0 SYNTH HOSE_SAMPLES says otherwise. */
+#define DEFAULT_HOSE_SAMPLES (1024*8)
+
+/*
+ * The synthesis tables read from lsynth.mpd.  See lsynth.h.
+ */
+
+typedef struct lsynth_context lsynth_context_t;
+
+/*
+ * The spans of a hose from its last synthesis.  See lsynth.h.
+ */
+
+typedef struct lsynth_cache lsynth_cache_t;
+
+/*
+ * One synthesis: the resolution to synthesize at, and where the synthesized
+ * parts go.  lsynthcp writes them to a file as LDraw lines; programs linking
+ * the library collect them into an array of parts instead (with each part's
+ * color in its attrib field).
+ *
+ * Everything a synthesis changes lives here, so separate syntheses may run
+ * at the same time, each with its own output.
+ */
+
+typedef struct {
+  PRECISION max_bend;   /* hose resolution */
+  PRECISION max_twist;
+  int       hose_samples; /* hose quality: points sampled along each span */
+  PRECISION band_res;   /* band resolution */
+  int       ldraw_part; /* writing a plain LDraw part: no SYNTH meta lines */
+  lsynth_cache_t *cache; /* spans to reuse, or NULL */
+  int       verbose;    /* print synthesis notes to stdout */
+
+  FILE     *file;       /* LDraw output, or NULL to collect parts */
+  part_t   *parts;
+  int       n_parts;
+  int       max_parts;
+  int       group_size; /* parts output so far */
+  int       failed;     /* ran out of memory */
+} lsynth_output_t;
+
+void
+output_init(
+  lsynth_output_t *output,
+  FILE            *file);
+
+int
+output_reserve(
+  lsynth_output_t *output,
+  int              n);
 
 void
 output_line(
-  FILE           *output,
+  lsynth_output_t *output,
   int             ghost,
   char           *group,
   int             color,
@@ -49,7 +100,20 @@ output_line(
   PRECISION       l,
   char            *type);
 
-void list_products( void );
+void
+output_comment(
+  lsynth_output_t *output,
+  char            *comment);
+
+char *L3fgets(char *Str, int n, FILE *fp);
+char *fgetline(char *line, int len, FILE *file);
+void  strclean(char *str);
+
+void  list_products(   lsynth_context_t *context);
+void  product_ini(     lsynth_context_t *context);
+char *isproduct(       lsynth_context_t *context, char *type);
+char *product_method(  lsynth_context_t *context, char *type);
+char *product_nickname(lsynth_context_t *context, char *type);
 
 /************************************************************************
  *
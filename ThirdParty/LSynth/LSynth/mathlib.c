@@ -78,6 +78,34 @@ vectorlen(
   return sqrtf(len);
 }
 
+PRECISION
+dotprod(
+  PRECISION a[3],
+  PRECISION b[3])
+{
+  return (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+}
+
+/* Returns 0, leaving v alone, if it has no length. */
+
+int
+normalize(
+  PRECISION v[3])
+{
+  PRECISION L;
+
+  L = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+  if (L == 0.0)
+    return 0;  // Uh Oh, the magnitude is zero.
+
+  v[0] /= L;
+  v[1] /= L;
+  v[2] /= L;
+
+  return 1;
+}
+
 void
 vectorrot3(
   PRECISION t[3],
@@ -9,6 +9,8 @@ void       vectoradd(PRECISION lft[3],PRECISION rht[3]);
 void      vectorsub3(PRECISION dst[3],PRECISION lft[3], PRECISION rht[3]);
 void       vectorsub(PRECISION lft[3],PRECISION rht[3]);
 PRECISION  vectorlen(PRECISION vect[3]);
+PRECISION    dotprod(PRECISION a[3],  PRECISION b[3]);
+int        normalize(PRECISION v[3]);
 void      vectorrot3(PRECISION res[3],PRECISION src[3],PRECISION rot[3][3]);
 void       vectorrot(PRECISION loc[3],PRECISION m[3][3]);
 
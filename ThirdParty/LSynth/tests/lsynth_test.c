@@ -0,0 +1,330 @@
+/*
+ * Golden-output tests and timings for the LSynth library.
+ *
+ * Synthesizes every hose and band type defined in lsynth.mpd across a few
+ * constraint layouts, compares the parts made against the golden files, and
+ * reports how long each type took to synthesize.
+ *
+ *   lsynth_test [-c lsynth.mpd] [-g golden_dir] [-t tolerance] [-r repeat] [-u]
+ *
+ * Each type has one golden file, <type>.ldr, holding the parts made for each
+ * layout under a "0 // <layout>" line.  Part types and colors must match
+ * exactly; positions and matrices must match within the tolerance, since the
+ * last digit can differ between compilers and CPUs.
+ *
+ * -r synthesizes each layout that many times, for steadier timings.
+ * -u writes the golden files from the current output instead of checking it.
+ *
+ * Exits 0 if every type matched its golden file.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lsynth.h"
+
+#define MAX_LAYOUT_CONSTRAINTS 8
+
+typedef struct {
+  char      *type;
+  PRECISION  offset[3];
+  PRECISION  turn;       /* degrees about Z */
+} placement_t;
+
+typedef struct {
+  char        *name;
+  int          n_constraints;
+  placement_t  constraints[MAX_LAYOUT_CONSTRAINTS];
+} layout_t;
+
+/*
+ * Hoses run between LS01 constraints.  The layouts cover a plain span, a
+ * span whose ends face different ways, and a hose through a middle point.
+ */
+
+static layout_t hose_layouts[] = {
+  { "span", 2, {
+    { "LS01.dat", {   0,    0,   0 },   0 },
+    { "LS01.dat", {  40, -160,   0 },   0 } } },
+  { "bend", 2, {
+    { "LS01.dat", {   0,    0,   0 },   0 },
+    { "LS01.dat", { 120,  -80,  40 },  90 } } },
+  { "three", 3, {
+    { "LS01.dat", {   0,    0,   0 },   0 },
+    { "LS01.dat", {  60, -100,  20 },  45 },
+    { "LS01.dat", { 160, -120, -20 }, 180 } } },
+};
+
+/*
+ * Bands go around tread sprockets (32007) and 24 tooth gears (3648a) in the
+ * XY plane.  The layouts cover two pulleys, three of different sizes, and a
+ * band taken around the inside of one pulley and crossed between two others.
+ */
+
+static layout_t band_layouts[] = {
+  { "two", 2, {
+    { "32007.DAT", {   0,    0, 0 }, 0 },
+    { "32007.DAT", { 200,    0, 0 }, 0 } } },
+  { "three", 3, {
+    { "32007.DAT", {   0,    0, 0 }, 0 },
+    { "3648a.dat", { 220,    0, 0 }, 0 },
+    { "3648a.dat", { 110, -140, 0 }, 0 } } },
+  { "inside", 6, {
+    { "32007.DAT", {   0,    0, 0 }, 0 },
+    { "32007.DAT", { 240,    0, 0 }, 0 },
+    { "INSIDE",    {   0,    0, 0 }, 0 },
+    { "3648a.dat", { 120,  -20, 0 }, 0 },
+    { "CROSS",     {   0,    0, 0 }, 0 },
+    { "3648a.dat", { 120, -200, 0 }, 0 } } },
+};
+
+#define N_HOSE_LAYOUTS (int)(sizeof(hose_layouts)/sizeof(hose_layouts[0]))
+#define N_BAND_LAYOUTS (int)(sizeof(band_layouts)/sizeof(band_layouts[0]))
+
+static double
+now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+make_constraints(layout_t *layout, part_t *constraints)
+{
+  PRECISION a;
+  int       i;
+
+  memset(constraints,0,sizeof(part_t) * layout->n_constraints);
+  for (i = 0; i < layout->n_constraints; i++) {
+    placement_t *p = &layout->constraints[i];
+
+    a = p->turn * 3.14159265f / 180;
+    strcpy(constraints[i].type,p->type);
+    constraints[i].orient[0][0] =  cosf(a);
+    constraints[i].orient[0][1] = -sinf(a);
+    constraints[i].orient[1][0] =  sinf(a);
+    constraints[i].orient[1][1] =  cosf(a);
+    constraints[i].orient[2][2] =  1;
+    vectorcp(constraints[i].offset,p->offset);
+  }
+}
+
+/*
+ * Writes parts as LDraw lines, the way lsynthcp does.
+ */
+
+static void
+write_parts(FILE *file, part_t *parts, int n_parts)
+{
+  int i;
+
+  for (i = 0; i < n_parts; i++) {
+    part_t *p = &parts[i];
+
+    fprintf(file,"1 %d %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %1.4f %s\n",
+            p->attrib,
+            p->offset[0],p->offset[1],p->offset[2],
+            p->orient[0][0],p->orient[0][1],p->orient[0][2],
+            p->orient[1][0],p->orient[1][1],p->orient[1][2],
+            p->orient[2][0],p->orient[2][1],p->orient[2][2],
+            p->type);
+  }
+}
+
+/*
+ * Compares the output for one type with its golden file, line by line.
+ * Prints the first difference and returns -1 if there is one.
+ */
+
+static int
+compare_output(char *type, char *output, size_t length, char *golden_path, double tolerance)
+{
+  FILE   *golden = fopen(golden_path,"r");
+  FILE   *actual = fmemopen(output,length,"r");
+  char    expect_line[512];
+  char    actual_line[512];
+  int     line_number = 0;
+  int     rc = 0;
+
+  if (golden == NULL) {
+    printf("FAIL %s: can't read %s (%s); run make golden\n",type,golden_path,strerror(errno));
+    fclose(actual);
+    return -1;
+  }
+
+  for (;;) {
+    char *e = fgets(expect_line,sizeof(expect_line),golden);
+    char *a = fgets(actual_line,sizeof(actual_line),actual);
+    double ev[13], av[13];
+    char   etype[256], atype[256];
+    int    ecolor, acolor;
+    int    i;
+
+    line_number++;
+    if (e == NULL || a == NULL) {
+      if (e != a) {
+        printf("FAIL %s: line %d: %s\n",type,line_number,
+               e ? "output is shorter than the golden file" : "output is longer than the golden file");
+        rc = -1;
+      }
+      break;
+    }
+    if (expect_line[0] != '1') {
+      if (strcmp(expect_line,actual_line) != 0) {
+        printf("FAIL %s: line %d: expected %s",type,line_number,expect_line);
+        rc = -1;
+        break;
+      }
+      continue;
+    }
+    if (sscanf(expect_line,"1 %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %255s",
+               &ecolor,&ev[0],&ev[1],&ev[2],&ev[3],&ev[4],&ev[5],&ev[6],
+               &ev[7],&ev[8],&ev[9],&ev[10],&ev[11],etype) != 14 ||
+        sscanf(actual_line,"1 %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %255s",
+               &acolor,&av[0],&av[1],&av[2],&av[3],&av[4],&av[5],&av[6],
+               &av[7],&av[8],&av[9],&av[10],&av[11],atype) != 14 ||
+        ecolor != acolor ||
+        strcmp(etype,atype) != 0) {
+      printf("FAIL %s: line %d:\n  expected %s  got      %s",type,line_number,expect_line,actual_line);
+      rc = -1;
+      break;
+    }
+    for (i = 0; i < 12; i++) {
+      /* NaN never compares equal, so it always fails. */
+      if (!(fabs(ev[i] - av[i]) <= tolerance)) {
+        break;
+      }
+    }
+    if (i < 12) {
+      printf("FAIL %s: line %d:\n  expected %s  got      %s",type,line_number,expect_line,actual_line);
+      rc = -1;
+      break;
+    }
+  }
+  fclose(golden);
+  fclose(actual);
+  return rc;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,"usage: lsynth_test [-c lsynth.mpd] [-g golden_dir] [-t tolerance] [-r repeat] [-u]\n");
+  exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char             *config = "lsynth.mpd";
+  char             *golden_dir = "golden";
+  double            tolerance = 0.002;
+  int               repeat = 1;
+  int               update = 0;
+  lsynth_context_t *context;
+  int               n_types;
+  int               n_failed = 0;
+  double            total_ms = 0;
+  int               t, c;
+
+  while ((c = getopt(argc,argv,"c:g:t:r:u")) != -1) {
+    switch (c) {
+      case 'c': config = optarg;                break;
+      case 'g': golden_dir = optarg;            break;
+      case 't': tolerance = atof(optarg);       break;
+      case 'r': repeat = atoi(optarg);          break;
+      case 'u': update = 1;                     break;
+      default:  usage();
+    }
+  }
+  if (repeat < 1) {
+    usage();
+  }
+
+  context = lsynth_context_create(config);
+  if (context == NULL) {
+    fprintf(stderr,"Failed to read %s\n",config);
+    return 2;
+  }
+  n_types = context->n_hose_types + context->n_band_types;
+
+  printf("%-40s %8s %8s %12s\n","type","layouts","parts","ms/synth");
+
+  for (t = 0; t < n_types; t++) {
+    int        is_hose   = t < context->n_hose_types;
+    char      *type      = is_hose ? context->hose_types[t].type
+                                   : context->band_types[t - context->n_hose_types].type;
+    layout_t  *layouts   = is_hose ? hose_layouts : band_layouts;
+    int        n_layouts = is_hose ? N_HOSE_LAYOUTS : N_BAND_LAYOUTS;
+    char      *output = NULL;
+    size_t     length = 0;
+    FILE      *file = open_memstream(&output,&length);
+    char       golden_path[1024];
+    double     ms = 0;
+    int        n_parts_total = 0;
+    int        l, r;
+
+    for (l = 0; l < n_layouts; l++) {
+      part_t  constraints[MAX_LAYOUT_CONSTRAINTS];
+      part_t *parts = NULL;
+      int     n_parts = 0;
+      int     rc = 0;
+
+      make_constraints(&layouts[l],constraints);
+
+      for (r = 0; r < repeat; r++) {
+        double start;
+
+        free(parts);
+        start = now_ms();
+        rc = lsynth_synthesize(context,type,16,constraints,layouts[l].n_constraints,
+                               0,NULL,&parts,&n_parts);
+        ms += now_ms() - start;
+      }
+
+      fprintf(file,"0 // %s\n",layouts[l].name);
+      if (rc == 0) {
+        write_parts(file,parts,n_parts);
+        n_parts_total += n_parts;
+      } else {
+        fprintf(file,"0 // failed\n");
+      }
+      free(parts);
+    }
+    fclose(file);
+
+    ms /= repeat * n_layouts;
+    total_ms += ms;
+    printf("%-40s %8d %8d %12.3f\n",type,n_layouts,n_parts_total,ms);
+
+    snprintf(golden_path,sizeof(golden_path),"%s/%s.ldr",golden_dir,type);
+    if (update) {
+      FILE *golden = fopen(golden_path,"w");
+
+      if (golden == NULL ||
+          fwrite(output,1,length,golden) != length ||
+          fclose(golden) != 0) {
+        printf("FAIL %s: can't write %s\n",type,golden_path);
+        n_failed++;
+      }
+    } else if (compare_output(type,output,length,golden_path,tolerance)) {
+      n_failed++;
+    }
+    free(output);
+  }
+
+  printf("%-40s %8s %8s %12.3f\n","all types","","",total_ms);
+
+  if (!update) {
+    printf("%d of %d types matched their golden files\n",n_types - n_failed,n_types);
+  }
+
+  lsynth_context_free(context);
+  return n_failed ? 1 : 0;
+}